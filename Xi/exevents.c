@@ -2500,6 +2500,7 @@ AddExtensionClient(WindowPtr pWin, ClientPtr client, Mask mask, int mskidx)
     others->resource = FakeClientID(client->index);
     others->next = pWin->optional->inputMasks->inputClients;
     pWin->optional->inputMasks->inputClients = others;
+    DeliveryCacheInvalidate(pWin);
     if (!AddResource(others->resource, RT_INPUTCLIENT, (void *) pWin))
         goto bail;
     return Success;
@@ -2542,6 +2543,9 @@ RecalculateDeviceDeliverableEvents(WindowPtr pWin)
     WindowPtr pChild, tmp;
     int i;
 
+    /* the masks of pWin's clients changed, its descendants' didn't */
+    DeliveryCacheInvalidate(pWin);
+
     pChild = pWin;
     while (1) {
         if ((inputMasks = wOtherInputMasks(pChild)) != 0) {
@@ -2585,6 +2589,7 @@ InputClientGone(WindowPtr pWin, XID id)
     for (other = wOtherInputMasks(pWin)->inputClients; other;
          other = other->next) {
         if (other->resource == id) {
+            DeliveryCacheInvalidate(pWin);
             if (prev) {
                 prev->next = other->next;
                 FreeInputClient(&other);
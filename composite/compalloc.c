@@ -193,6 +193,9 @@ compRedirectWindow(ClientPtr pClient, WindowPtr pWin, int update)
         cw->damageRegistered = FALSE;
         cw->damaged = FALSE;
         cw->pOldPixmap = NullPixmap;
+        cw->storageWidth = cw->storageHeight = 0;
+        cw->oldStorageWidth = cw->oldStorageHeight = 0;
+        cw->bypassed = FALSE;
         dixSetPrivate(&pWin->devPrivates, CompWindowPrivateKey, cw);
     }
     ccw->next = cw->clients;
@@ -200,6 +203,10 @@ compRedirectWindow(ClientPtr pClient, WindowPtr pWin, int update)
     if (!AddResource(ccw->id, CompositeClientWindowType, pWin))
         return BadAlloc;
     if (ccw->update == CompositeRedirectManual) {
+        /* the compositor gets a pixmap, and decides for itself */
+        if (cw->bypassed)
+            compSetBypass(pWin, FALSE);
+
         if (!anyMarked)
             anyMarked = compMarkWindows(pWin, &pLayerWin);
 
@@ -265,6 +272,7 @@ compFreeClientWindow(WindowPtr pWin, XID id)
     Bool anyMarked = FALSE;
     WindowPtr pLayerWin;
     PixmapPtr pPixmap = NULL;
+    int storageWidth = 0, storageHeight = 0;
 
     if (!cw)
         return;
@@ -282,6 +290,8 @@ compFreeClientWindow(WindowPtr pWin, XID id)
 
         if (pWin->redirectDraw != RedirectDrawNone) {
             pPixmap = (*pScreen->GetWindowPixmap) (pWin);
+            storageWidth = cw->storageWidth;
+            storageHeight = cw->storageHeight;
             compSetParentPixmap(pWin);
         }
 
@@ -290,6 +300,8 @@ compFreeClientWindow(WindowPtr pWin, XID id)
 
         RegionUninit(&cw->borderClip);
 
+        if (cw->bypassed)
+            GetCompScreen(pScreen)->pBypassWin = NullWindow;
         dixSetPrivate(&pWin->devPrivates, CompWindowPrivateKey, NULL);
         free(cw);
     }
@@ -308,7 +320,7 @@ compFreeClientWindow(WindowPtr pWin, XID id)
 
     if (pPixmap) {
         compRestoreWindow(pWin, pPixmap);
-        (*pScreen->DestroyPixmap) (pPixmap);
+        compReleasePixmap(pScreen, pPixmap, storageWidth, storageHeight);
     }
 }
 
@@ -525,21 +537,195 @@ compUnredirectOneSubwindow(WindowPtr pParent, WindowPtr pWin)
     return Success;
 }
 
-static PixmapPtr
-compNewPixmap(WindowPtr pWin, int x, int y, int w, int h)
+static int
+compExposeLost(WindowPtr pWin, void *data)
+{
+    RegionPtr pLost = data;
+    RegionRec exposed;
+
+    if (!pWin->viewable)
+        return WT_DONTWALKCHILDREN;
+    RegionNull(&exposed);
+    RegionIntersect(&exposed, pLost, &pWin->clipList);
+    if (RegionNotEmpty(&exposed))
+        (*pWin->drawable.pScreen->WindowExposures) (pWin, &exposed);
+    RegionUninit(&exposed);
+    return WT_WALKCHILDREN;
+}
+
+/*
+ * Stop or start drawing an automatically redirected window straight to
+ * the screen.  Once something covers part of it, that part is gone; when
+ * it goes back to a pixmap, the pixmap starts with what's on the screen
+ * and the rest is exposed, as backing store may always do.
+ */
+void
+compSetBypass(WindowPtr pWin, Bool bypass)
 {
     ScreenPtr pScreen = pWin->drawable.pScreen;
-    WindowPtr pParent = pWin->parent;
+    CompScreenPtr cs = GetCompScreen(pScreen);
+    CompWindowPtr cw = GetCompWindow(pWin);
+    Bool anyMarked;
+    WindowPtr pLayerWin;
+    RegionRec lost;
+
+    RegionNull(&lost);
+    if (!bypass && pWin->redirectDraw == RedirectDrawNone)
+        RegionSubtract(&lost, &pWin->borderSize, &pWin->borderClip);
+
+    cw->bypassed = bypass;
+    cs->pBypassWin = bypass ? pWin : NullWindow;
+
+    anyMarked = compMarkWindows(pWin, &pLayerWin);
+    compCheckRedirect(pWin);
+    if (anyMarked)
+        compHandleMarkedWindows(pWin, pLayerWin);
+
+    if (RegionNotEmpty(&lost) && pWin->redirectDraw != RedirectDrawNone)
+        TraverseTree(pWin, compExposeLost, &lost);
+    RegionUninit(&lost);
+}
+
+/*
+ * Storage for w x h: whole steps, so that a window being resized
+ * interactively can keep its pixmap for a while
+ */
+static int
+compStorageStep(int size)
+{
+    return (size + COMP_PIXMAP_STEP - 1) & ~(COMP_PIXMAP_STEP - 1);
+}
+
+/* Storage is worth using for w x h when it's less than twice what's needed */
+static Bool
+compStorageFits(int storageWidth, int storageHeight, int w, int h)
+{
+    return w <= storageWidth && h <= storageHeight &&
+        (CARD64) storageWidth * storageHeight <=
+        (CARD64) compStorageStep(w) * compStorageStep(h) * 2;
+}
+
+static size_t
+compStorageBytes(PixmapPtr pPixmap, int storageHeight)
+{
+    return (size_t) pPixmap->devKind * storageHeight;
+}
+
+/*
+ * Give a pixmap of ours a new size within its storage.  The stride and
+ * the bits stay where they are; the new serial number tells everything
+ * holding state for the old size to look again.
+ */
+static void
+compSetPixmapSize(PixmapPtr pPixmap, int w, int h)
+{
+    ScreenPtr pScreen = pPixmap->drawable.pScreen;
+
+    (*pScreen->ModifyPixmapHeader) (pPixmap, w, h, 0, 0, 0, NULL);
+    pPixmap->drawable.serialNumber = NEXT_SERIAL_NUMBER;
+}
+
+/*
+ * Only pixmaps in memory that mi looks after can be cut down to less than
+ * their storage; accelerated pixmaps are left to the driver.
+ */
+static Bool
+compCanPoolPixmap(ScreenPtr pScreen, PixmapPtr pPixmap)
+{
+    return pScreen->ModifyPixmapHeader == miModifyPixmapHeader &&
+        pPixmap->devPrivate.ptr && pPixmap->devKind > 0;
+}
+
+static PixmapPtr
+compTakePooledPixmap(ScreenPtr pScreen, int depth, int w, int h,
+                     int *storageWidth, int *storageHeight)
+{
+    CompScreenPtr cs = GetCompScreen(pScreen);
+    CompPooledPixmapRec *pooled;
     PixmapPtr pPixmap;
+    int i, best = -1;
+
+    for (i = 0; i < cs->numPooled; i++) {
+        pooled = &cs->pool[i];
+        if (pooled->pPixmap->drawable.depth != depth ||
+            !compStorageFits(pooled->width, pooled->height, w, h))
+            continue;
+        if (best < 0 ||
+            (CARD64) pooled->width * pooled->height <
+            (CARD64) cs->pool[best].width * cs->pool[best].height)
+            best = i;
+    }
+    if (best < 0)
+        return NULL;
+
+    pooled = &cs->pool[best];
+    pPixmap = pooled->pPixmap;
+    *storageWidth = pooled->width;
+    *storageHeight = pooled->height;
+    cs->pooledBytes -= compStorageBytes(pPixmap, pooled->height);
+    cs->numPooled--;
+    memmove(pooled, pooled + 1, (cs->numPooled - best) * sizeof(*pooled));
+
+    compSetPixmapSize(pPixmap, w, h);
+    return pPixmap;
+}
 
-    pPixmap = (*pScreen->CreatePixmap) (pScreen, w, h, pWin->drawable.depth,
-                                        CREATE_PIXMAP_USAGE_BACKING_PIXMAP);
+/*
+ * Done with a backing pixmap: keep it for the next window that needs one
+ * its size if it's ours and no one else holds it, making room by dropping
+ * the oldest, otherwise destroy it.
+ */
+void
+compReleasePixmap(ScreenPtr pScreen, PixmapPtr pPixmap,
+                  int storageWidth, int storageHeight)
+{
+    CompScreenPtr cs = GetCompScreen(pScreen);
+    size_t bytes = compStorageBytes(pPixmap, storageHeight);
 
-    if (!pPixmap)
-        return 0;
+    if (!storageWidth || pPixmap->refcnt != 1 || bytes > COMP_POOL_BYTES) {
+        (*pScreen->DestroyPixmap) (pPixmap);
+        return;
+    }
 
-    pPixmap->screen_x = x;
-    pPixmap->screen_y = y;
+    while (cs->numPooled == COMP_POOL_SIZE ||
+           cs->pooledBytes + bytes > COMP_POOL_BYTES) {
+        PixmapPtr pOldest = cs->pool[0].pPixmap;
+
+        cs->pooledBytes -= compStorageBytes(pOldest, cs->pool[0].height);
+        cs->numPooled--;
+        memmove(cs->pool, cs->pool + 1, cs->numPooled * sizeof(cs->pool[0]));
+        (*pScreen->DestroyPixmap) (pOldest);
+    }
+
+    cs->pool[cs->numPooled].pPixmap = pPixmap;
+    cs->pool[cs->numPooled].width = storageWidth;
+    cs->pool[cs->numPooled].height = storageHeight;
+    cs->numPooled++;
+    cs->pooledBytes += bytes;
+}
+
+void
+compFreePixmapPool(ScreenPtr pScreen)
+{
+    CompScreenPtr cs = GetCompScreen(pScreen);
+
+    while (cs->numPooled)
+        (*pScreen->DestroyPixmap) (cs->pool[--cs->numPooled].pPixmap);
+    cs->pooledBytes = 0;
+}
+
+/*
+ * Fill w x h at x, y in the backing pixmap of pWin with what its parent
+ * shows there
+ */
+static void
+compCopyFromParent(WindowPtr pWin, PixmapPtr pPixmap, int x, int y,
+                   int w, int h)
+{
+    ScreenPtr pScreen = pWin->drawable.pScreen;
+    WindowPtr pParent = pWin->parent;
+    int src_x = pPixmap->screen_x + x - pParent->drawable.x;
+    int src_y = pPixmap->screen_y + y - pParent->drawable.y;
 
     if (pParent->drawable.depth == pWin->drawable.depth) {
         GCPtr pGC = GetScratchGC(pWin->drawable.depth, pScreen);
@@ -552,9 +738,7 @@ compNewPixmap(WindowPtr pWin, int x, int y, int w, int h)
             ValidateGC(&pPixmap->drawable, pGC);
             (*pGC->ops->CopyArea) (&pParent->drawable,
                                    &pPixmap->drawable,
-                                   pGC,
-                                   x - pParent->drawable.x,
-                                   y - pParent->drawable.y, w, h, 0, 0);
+                                   pGC, src_x, src_y, w, h, x, y);
             FreeScratchGC(pGC);
         }
     }
@@ -582,14 +766,58 @@ compNewPixmap(WindowPtr pWin, int x, int y, int w, int h)
                              pSrcPicture,
                              NULL,
                              pDstPicture,
-                             x - pParent->drawable.x,
-                             y - pParent->drawable.y, 0, 0, 0, 0, w, h);
+                             src_x, src_y, 0, 0, x, y, w, h);
         }
         if (pSrcPicture)
             FreePicture(pSrcPicture, 0);
         if (pDstPicture)
             FreePicture(pDstPicture, 0);
     }
+}
+
+/*
+ * A backing pixmap for pWin at x, y of w x h, from the pool if one there
+ * fits, with the storage behind it left in storageWidth x storageHeight,
+ * or 0 x 0 when it can't be pooled
+ */
+static PixmapPtr
+compNewPixmap(WindowPtr pWin, int x, int y, int w, int h,
+              int *storageWidth, int *storageHeight)
+{
+    ScreenPtr pScreen = pWin->drawable.pScreen;
+    CompScreenPtr cs = GetCompScreen(pScreen);
+    int depth = pWin->drawable.depth;
+    PixmapPtr pPixmap;
+    int sw = w, sh = h;
+
+    pPixmap = compTakePooledPixmap(pScreen, depth, w, h, storageWidth,
+                                   storageHeight);
+    if (!pPixmap) {
+        /* the first pixmap shows whether it's worth making them bigger */
+        if (cs->poolPixmaps > 0) {
+            sw = compStorageStep(w);
+            sh = compStorageStep(h);
+        }
+        pPixmap = (*pScreen->CreatePixmap) (pScreen, sw, sh, depth,
+                                            CREATE_PIXMAP_USAGE_BACKING_PIXMAP);
+        if (!pPixmap)
+            return 0;
+        if (cs->poolPixmaps < 0)
+            cs->poolPixmaps = compCanPoolPixmap(pScreen, pPixmap);
+        if (cs->poolPixmaps) {
+            *storageWidth = sw;
+            *storageHeight = sh;
+            if (sw != w || sh != h)
+                compSetPixmapSize(pPixmap, w, h);
+        }
+        else
+            *storageWidth = *storageHeight = 0;
+    }
+
+    pPixmap->screen_x = x;
+    pPixmap->screen_y = y;
+
+    compCopyFromParent(pWin, pPixmap, 0, 0, w, h);
     return pPixmap;
 }
 
@@ -601,8 +829,9 @@ compAllocPixmap(WindowPtr pWin)
     int y = pWin->drawable.y - bw;
     int w = pWin->drawable.width + (bw << 1);
     int h = pWin->drawable.height + (bw << 1);
-    PixmapPtr pPixmap = compNewPixmap(pWin, x, y, w, h);
     CompWindowPtr cw = GetCompWindow(pWin);
+    PixmapPtr pPixmap = compNewPixmap(pWin, x, y, w, h, &cw->storageWidth,
+                                      &cw->storageHeight);
 
     if (!pPixmap)
         return FALSE;
@@ -654,8 +883,10 @@ compSetParentPixmap(WindowPtr pWin)
 }
 
 /*
- * Make sure the pixmap is the right size and offset.  Allocate a new
- * pixmap to change size, adjust origin to change offset, leaving the
+ * Make sure the pixmap is the right size and offset.  A pixmap of ours
+ * with storage enough for the new size, that no one else holds, just
+ * changes size, keeping its bits where they are.  Otherwise allocate a
+ * new pixmap to change size, adjust origin to change offset, leaving the
  * old pixmap in cw->pOldPixmap so bits can be recovered
  */
 Bool
@@ -668,6 +899,7 @@ compReallocPixmap(WindowPtr pWin, int draw_x, int draw_y,
     CompWindowPtr cw = GetCompWindow(pWin);
     int pix_x, pix_y;
     int pix_w, pix_h;
+    int old_w = pOld->drawable.width, old_h = pOld->drawable.height;
 
     assert(cw && pWin->redirectDraw != RedirectDrawNone);
     cw->oldx = pOld->screen_x;
@@ -676,11 +908,34 @@ compReallocPixmap(WindowPtr pWin, int draw_x, int draw_y,
     pix_y = draw_y - bw;
     pix_w = w + (bw << 1);
     pix_h = h + (bw << 1);
-    if (pix_w != pOld->drawable.width || pix_h != pOld->drawable.height) {
-        pNew = compNewPixmap(pWin, pix_x, pix_y, pix_w, pix_h);
+    if ((pix_w != old_w || pix_h != old_h) &&
+        cw->storageWidth && pOld->refcnt == 1 &&
+        compStorageFits(cw->storageWidth, cw->storageHeight, pix_w, pix_h)) {
+        compSetPixmapSize(pOld, pix_w, pix_h);
+        pOld->screen_x = pix_x;
+        pOld->screen_y = pix_y;
+        /* what the window grows into starts out as the parent, as in a
+         * new pixmap */
+        if (pix_w > old_w)
+            compCopyFromParent(pWin, pOld, old_w, 0, pix_w - old_w, pix_h);
+        if (pix_h > old_h)
+            compCopyFromParent(pWin, pOld, 0, old_h, min(old_w, pix_w),
+                               pix_h - old_h);
+        pNew = pOld;
+        cw->pOldPixmap = 0;
+    }
+    else if (pix_w != old_w || pix_h != old_h) {
+        int storageWidth, storageHeight;
+
+        pNew = compNewPixmap(pWin, pix_x, pix_y, pix_w, pix_h,
+                             &storageWidth, &storageHeight);
         if (!pNew)
             return FALSE;
         cw->pOldPixmap = pOld;
+        cw->oldStorageWidth = cw->storageWidth;
+        cw->oldStorageHeight = cw->storageHeight;
+        cw->storageWidth = storageWidth;
+        cw->storageHeight = storageHeight;
         compSetPixmap(pWin, pNew, bw);
     }
     else {
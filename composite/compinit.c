@@ -58,6 +58,7 @@ compCloseScreen(ScreenPtr pScreen)
     CompScreenPtr cs = GetCompScreen(pScreen);
     Bool ret;
 
+    compFreePixmapPool(pScreen);
     free(cs->alternateVisuals);
 
     pScreen->CloseScreen = cs->CloseScreen;
@@ -389,6 +390,17 @@ compScreenInit(ScreenPtr pScreen)
 
     cs->pendingScreenUpdate = FALSE;
 
+    cs->numPooled = 0;
+    cs->pooledBytes = 0;
+    cs->poolPixmaps = -1;
+
+    cs->fullscreenWid = None;
+    cs->pBypassWin = NullWindow;
+    cs->pendingFullscreenCheck = FALSE;
+    cs->fullscreenAtom = MakeAtom("_COMPOSITE_FULLSCREEN_WINDOW",
+                                  strlen("_COMPOSITE_FULLSCREEN_WINDOW"),
+                                  TRUE);
+
     cs->numAlternateVisuals = 0;
     cs->alternateVisuals = NULL;
     cs->numImplicitRedirectExceptions = 0;
@@ -97,10 +97,28 @@ typedef struct _CompWindow {
     int oldy;
     PixmapPtr pOldPixmap;
     int borderClipX, borderClipY;
+    /* storage behind the pixmap and pOldPixmap, 0 when it can't be pooled */
+    int storageWidth, storageHeight;
+    int oldStorageWidth, oldStorageHeight;
+    Bool bypassed;              /* drawn straight to the screen for now */
 } CompWindowRec, *CompWindowPtr;
 
 #define COMP_ORIGIN_INVALID	    0x80000000
 
+/*
+ * Backing pixmaps in memory get storage a step bigger than the window,
+ * so it can grow without a new pixmap, and go back to a pool per screen
+ * when the window is done with them.
+ */
+#define COMP_PIXMAP_STEP	    64
+#define COMP_POOL_SIZE		    8
+#define COMP_POOL_BYTES		    (64 << 20)
+
+typedef struct _CompPooledPixmap {
+    PixmapPtr pPixmap;
+    int width, height;          /* of its storage */
+} CompPooledPixmapRec;
+
 typedef struct _CompSubwindows {
     int update;
     CompClientWindowPtr clients;
@@ -171,6 +189,20 @@ typedef struct _CompScreen {
     GetImageProcPtr GetImage;
     GetSpansProcPtr GetSpans;
     SourceValidateProcPtr SourceValidate;
+
+    /*
+     * The redirected window covering the screen, as last put in the root
+     * window property, and the window drawn straight to the screen
+     */
+    Window fullscreenWid;
+    WindowPtr pBypassWin;
+    Bool pendingFullscreenCheck;
+    Atom fullscreenAtom;
+
+    int poolPixmaps;            /* -1 until the first backing pixmap */
+    CompPooledPixmapRec pool[COMP_POOL_SIZE];   /* oldest first */
+    int numPooled;
+    size_t pooledBytes;
 } CompScreenRec, *CompScreenPtr;
 
 extern DevPrivateKeyRec CompScreenPrivateKeyRec;
@@ -239,6 +271,16 @@ compReallocPixmap(WindowPtr pWin, int x, int y,
 
 void compMarkAncestors(WindowPtr pWin);
 
+void
+ compReleasePixmap(ScreenPtr pScreen, PixmapPtr pPixmap,
+                   int storageWidth, int storageHeight);
+
+void
+ compFreePixmapPool(ScreenPtr pScreen);
+
+void
+ compSetBypass(WindowPtr pWin, Bool bypass);
+
 /*
  * compinit.c
  */
@@ -294,6 +336,9 @@ Bool
 void
  compClipNotify(WindowPtr pWin, int dx, int dy);
 
+void
+ compQueueFullscreenCheck(ScreenPtr pScreen);
+
 void
  compMoveWindow(WindowPtr pWin, int x, int y, WindowPtr pSib, VTKind kind);
 
@@ -43,4 +43,8 @@ extern _X_EXPORT Bool CompositeRegisterImplicitRedirectionException(ScreenPtr pS
 extern _X_EXPORT Bool compIsAlternateVisual(ScreenPtr pScreen, XID visual);
 extern _X_EXPORT RESTYPE CompositeClientWindowType;
 
+/* Draw automatically redirected fullscreen windows straight to the screen
+ * (-unredirectfullscreen) */
+extern _X_EXPORT Bool CompositeUnredirectFullscreen;
+
 #endif                          /* _COMPOSITEEXT_H_ */
@@ -46,6 +46,7 @@
 #endif
 
 #include "compint.h"
+#include <X11/Xatom.h>
 
 #ifdef PANORAMIX
 #include "panoramiXsrv.h"
@@ -153,7 +154,7 @@ compCheckRedirect(WindowPtr pWin)
     Bool should;
 
     should = pWin->realized && (pWin->drawable.class != InputOnly) &&
-        (cw != NULL) && (pWin->parent != NULL);
+        (cw != NULL) && !cw->bypassed && (pWin->parent != NULL);
 
     /* Never redirect the overlay window */
     if (cs->pOverlayWin != NULL) {
@@ -171,7 +172,8 @@ compCheckRedirect(WindowPtr pWin)
 
             compSetParentPixmap(pWin);
             compRestoreWindow(pWin, pPixmap);
-            (*pScreen->DestroyPixmap) (pPixmap);
+            compReleasePixmap(pScreen, pPixmap, cw ? cw->storageWidth : 0,
+                              cw ? cw->storageHeight : 0);
         }
     }
     else if (should) {
@@ -312,6 +314,9 @@ compClipNotify(WindowPtr pWin, int dx, int dy)
             cw->borderClipY = pWin->drawable.y;
         }
     }
+    /* a top level window moved, or something did over it */
+    if (pWin->parent && !pWin->parent->parent)
+        compQueueFullscreenCheck(pScreen);
     if (cs->ClipNotify) {
         pScreen->ClipNotify = cs->ClipNotify;
         (*pScreen->ClipNotify) (pWin, dx, dy);
@@ -320,6 +325,120 @@ compClipNotify(WindowPtr pWin, int dx, int dy)
     }
 }
 
+/*
+ * Whether pWin, at the top of the stack, is redirected, covers the whole
+ * screen and has nothing to blend with what's under it, so that drawing
+ * it straight to the screen would look no different
+ */
+static Bool
+compIsFullscreen(WindowPtr pWin)
+{
+    WindowPtr pRoot = pWin->drawable.pScreen->root;
+    PictFormatPtr pFormat;
+
+    if (!GetCompWindow(pWin) ||
+        pWin->drawable.depth != pRoot->drawable.depth)
+        return FALSE;
+    pFormat = PictureWindowFormat(pWin);
+    if (pFormat && pFormat->direct.alphaMask)
+        return FALSE;
+    return RegionContainsRect(&pWin->borderSize,
+                              RegionExtents(&pRoot->winSize)) == rgnIN;
+}
+
+/*
+ * Only a window redirected automatically, and by no one else, can be
+ * unredirected behind the clients' backs, and only with nothing over it,
+ * not even the overlay window.  A client holding the window pixmap from
+ * NameWindowPixmap would be left with one that stops updating.
+ */
+static Bool
+compCanBypass(WindowPtr pWin)
+{
+    ScreenPtr pScreen = pWin->drawable.pScreen;
+    CompWindowPtr cw = GetCompWindow(pWin);
+    CompClientWindowPtr ccw;
+
+    if (cw->update != CompositeRedirectAutomatic)
+        return FALSE;
+    for (ccw = cw->clients; ccw; ccw = ccw->next)
+        if (ccw->update != CompositeRedirectAutomatic)
+            return FALSE;
+    if ((*pScreen->GetWindowPixmap) (pWin)->refcnt > 1)
+        return FALSE;
+    return TRUE;
+}
+
+/*
+ * The root window property _COMPOSITE_FULLSCREEN_WINDOW names the
+ * redirected window covering the screen, so that compositors hear of it
+ * in a PropertyNotify and can unredirect it themselves
+ */
+static void
+compSetFullscreenWindow(ScreenPtr pScreen, WindowPtr pWin)
+{
+    CompScreenPtr cs = GetCompScreen(pScreen);
+    Window wid = pWin ? pWin->drawable.id : None;
+
+    if (cs->fullscreenWid == wid)
+        return;
+    cs->fullscreenWid = wid;
+    if (wid)
+        dixChangeWindowProperty(serverClient, pScreen->root,
+                                cs->fullscreenAtom, XA_WINDOW, 32,
+                                PropModeReplace, 1, &wid, TRUE);
+    else
+        DeleteProperty(serverClient, pScreen->root, cs->fullscreenAtom);
+}
+
+static Bool
+compCheckFullscreen(ClientPtr pClient, void *closure)
+{
+    ScreenPtr pScreen = closure;
+    CompScreenPtr cs = GetCompScreen(pScreen);
+    WindowPtr pWin, pTop = NullWindow, pFullscreen = NullWindow;
+
+    cs->pendingFullscreenCheck = FALSE;
+    if (!pScreen->root)
+        return TRUE;
+
+    /* the overlay window is the compositor's, so look under it */
+    for (pWin = pScreen->root->firstChild; pWin; pWin = pWin->nextSib) {
+        if (!pWin->viewable || pWin->drawable.class == InputOnly)
+            continue;
+        if (!pTop)
+            pTop = pWin;
+        if (pWin != cs->pOverlayWin) {
+            if (compIsFullscreen(pWin))
+                pFullscreen = pWin;
+            break;
+        }
+    }
+
+    if (cs->pBypassWin &&
+        (cs->pBypassWin != pFullscreen || pTop != pFullscreen))
+        compSetBypass(cs->pBypassWin, FALSE);
+    if (pFullscreen && pTop == pFullscreen && !cs->pBypassWin &&
+        compCanBypass(pFullscreen))
+        compSetBypass(pFullscreen, TRUE);
+
+    compSetFullscreenWindow(pScreen, pFullscreen);
+    return TRUE;
+}
+
+void
+compQueueFullscreenCheck(ScreenPtr pScreen)
+{
+    CompScreenPtr cs = GetCompScreen(pScreen);
+
+    /* no bypass and no _COMPOSITE_FULLSCREEN_WINDOW unless asked for */
+    if (!CompositeUnredirectFullscreen)
+        return;
+    if (!cs->pendingFullscreenCheck)
+        cs->pendingFullscreenCheck =
+            QueueWorkProc(compCheckFullscreen, serverClient, pScreen);
+}
+
 Bool
 compIsAlternateVisual(ScreenPtr pScreen, XID visual)
 {
@@ -375,7 +494,8 @@ compFreeOldPixmap(WindowPtr pWin)
         CompWindowPtr cw = GetCompWindow(pWin);
 
         if (cw->pOldPixmap) {
-            (*pScreen->DestroyPixmap) (cw->pOldPixmap);
+            compReleasePixmap(pScreen, cw->pOldPixmap, cw->oldStorageWidth,
+                              cw->oldStorageHeight);
             cw->pOldPixmap = NullPixmap;
         }
     }
@@ -599,6 +719,8 @@ compDestroyWindow(WindowPtr pWin)
     Bool ret;
 
     pScreen->DestroyWindow = cs->DestroyWindow;
+    if (pWin->parent && cs->fullscreenWid == pWin->drawable.id)
+        compSetFullscreenWindow(pScreen, NullWindow);
     while ((cw = GetCompWindow(pWin)))
         FreeResource(cw->clients->id, RT_NONE);
     while ((csw = GetCompSubwindows(pWin)))
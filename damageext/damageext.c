@@ -29,6 +29,7 @@
 #include "damagestr.h"
 #include "protocol-versions.h"
 #include "extinit.h"
+#include "globals.h"
 
 #ifdef PANORAMIX
 #include "panoramiX.h"
@@ -244,6 +245,10 @@ DamageExtCreate(DrawablePtr pDrawable, DamageReportLevel level,
         free(pDamageExt);
         return NULL;
     }
+    /* without batching a client drawing in small pieces sets off an event
+     * for every one */
+    if (DamageBatchReports)
+        DamageSetReportBatched(pDamageExt->pDamage, TRUE);
 
     if (!AddResource(id, DamageExtType, (void *) pDamageExt))
         return NULL;
@@ -425,9 +430,12 @@ ProcDamageSubtract(ClientPtr client)
         }
         else {
             if (pParts)
-                RegionCopy(pParts, DamageRegion(pDamage));
-            DamageEmpty(pDamage);
+                DamageTakeRegion(pDamage, pParts);
+            else
+                DamageEmpty(pDamage);
         }
+        if (pParts)
+            XFixesRegionChanged(stuff->parts);
     }
 
     return Success;
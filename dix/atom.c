@@ -56,88 +56,186 @@ SOFTWARE.
 #include "resource.h"
 #include "dix.h"
 
+/*
+ * Atoms live in an array indexed by atom, for NameForAtom(), and in an
+ * open-addressed hash of atoms keyed by name, for MakeAtom().  Atoms are
+ * never freed before the server resets, so there are no deletions to deal
+ * with, and their names are copied into large arena blocks that are all
+ * released together by FreeAllAtoms().
+ */
+
 #define InitialTableSize 256
+#define ArenaBlockSize 16384
 
-typedef struct _Node {
-    struct _Node *left, *right;
-    Atom a;
-    unsigned int fingerPrint;
+typedef struct _AtomName {
     const char *string;
-} NodeRec, *NodePtr;
+    unsigned int len;
+    unsigned int hash;
+} AtomNameRec, *AtomNamePtr;
+
+typedef struct _AtomArena {
+    struct _AtomArena *next;
+    size_t used, size;
+    char data[];
+} AtomArenaRec, *AtomArenaPtr;
 
 static Atom lastAtom = None;
-static NodePtr atomRoot = NULL;
 static unsigned long tableLength;
-static NodePtr *nodeTable;
+static AtomNamePtr atomTable;
+static unsigned long hashSize;          /* power of two, >= 2 * tableLength */
+static Atom *hashTable;                 /* None marks an empty slot */
+static AtomArenaPtr atomArena;
 
-Atom
-MakeAtom(const char *string, unsigned len, Bool makeit)
+static unsigned int
+AtomHash(const char *string, unsigned len)
 {
-    NodePtr *np;
+    unsigned int hash = 2166136261U;
     unsigned i;
-    int comp;
-    unsigned int fp = 0;
 
-    np = &atomRoot;
-    for (i = 0; i < (len + 1) / 2; i++) {
-        fp = fp * 27 + string[i];
-        fp = fp * 27 + string[len - 1 - i];
+    for (i = 0; i < len; i++)
+        hash = (hash ^ (unsigned char) string[i]) * 16777619U;
+    return hash;
+}
+
+static Atom *
+AtomSlot(const char *string, unsigned len, unsigned int hash)
+{
+    unsigned long mask = hashSize - 1;
+    unsigned long i = hash & mask;
+    AtomNamePtr name;
+    Atom a;
+
+    while ((a = hashTable[i]) != None) {
+        name = &atomTable[a];
+        if (name->hash == hash && name->len == len &&
+            memcmp(name->string, string, len) == 0)
+            break;
+        i = (i + 1) & mask;
     }
-    while (*np != NULL) {
-        if (fp < (*np)->fingerPrint)
-            np = &((*np)->left);
-        else if (fp > (*np)->fingerPrint)
-            np = &((*np)->right);
-        else {                  /* now start testing the strings */
-            comp = strncmp(string, (*np)->string, (int) len);
-            if ((comp < 0) || ((comp == 0) && (len < strlen((*np)->string))))
-                np = &((*np)->left);
-            else if (comp > 0)
-                np = &((*np)->right);
-            else
-                return (*np)->a;
-        }
+    return &hashTable[i];
+}
+
+/* Make room for count more atoms without further allocation */
+static Bool
+AtomReserve(unsigned long count)
+{
+    unsigned long length = tableLength, size = hashSize;
+    AtomNamePtr table;
+    Atom *hash, a;
+
+    while (lastAtom + count >= length)
+        length <<= 1;
+    if (length != tableLength) {
+        table = reallocarray(atomTable, length, sizeof(AtomNameRec));
+        if (!table)
+            return FALSE;
+        atomTable = table;
+        tableLength = length;
     }
-    if (makeit) {
-        NodePtr nd;
 
-        nd = malloc(sizeof(NodeRec));
-        if (!nd)
-            return BAD_RESOURCE;
-        if (lastAtom < XA_LAST_PREDEFINED) {
-            nd->string = string;
+    while (size < 2 * length)
+        size <<= 1;
+    if (size != hashSize) {
+        hash = calloc(size, sizeof(Atom));
+        if (!hash)
+            return FALSE;
+        free(hashTable);
+        hashTable = hash;
+        hashSize = size;
+        for (a = None + 1; a <= lastAtom; a++)
+            *AtomSlot(atomTable[a].string, atomTable[a].len,
+                      atomTable[a].hash) = a;
+    }
+    return TRUE;
+}
+
+static char *
+AtomArenaCopy(const char *string, unsigned len)
+{
+    AtomArenaPtr block = atomArena;
+    char *copy;
+
+    if (!block || block->size - block->used < len + 1) {
+        size_t size = max(ArenaBlockSize, (size_t) len + 1);
+
+        block = malloc(sizeof(AtomArenaRec) + size);
+        if (!block)
+            return NULL;
+        block->used = 0;
+        block->size = size;
+        /* Keep filling the current block if the new one is just for this */
+        if (atomArena && size > ArenaBlockSize) {
+            block->next = atomArena->next;
+            atomArena->next = block;
         }
         else {
-            nd->string = strndup(string, len);
-            if (!nd->string) {
-                free(nd);
-                return BAD_RESOURCE;
-            }
-        }
-        if ((lastAtom + 1) >= tableLength) {
-            NodePtr *table;
-
-            table = reallocarray(nodeTable, tableLength, 2 * sizeof(NodePtr));
-            if (!table) {
-                if (nd->string != string) {
-                    /* nd->string has been strdup'ed */
-                    free((char *) nd->string);
-                }
-                free(nd);
-                return BAD_RESOURCE;
-            }
-            tableLength <<= 1;
-            nodeTable = table;
+            block->next = atomArena;
+            atomArena = block;
         }
-        *np = nd;
-        nd->left = nd->right = NULL;
-        nd->fingerPrint = fp;
-        nd->a = ++lastAtom;
-        nodeTable[lastAtom] = nd;
-        return nd->a;
     }
-    else
+
+    copy = block->data + block->used;
+    memcpy(copy, string, len);
+    copy[len] = '\0';
+    block->used += len + 1;
+    return copy;
+}
+
+static Atom
+AtomLookup(const char *string, unsigned len, Bool makeit)
+{
+    unsigned int hash = AtomHash(string, len);
+    Atom *slot = AtomSlot(string, len, hash);
+    AtomNamePtr name;
+
+    if (*slot != None)
+        return *slot;
+    if (!makeit)
         return None;
+
+    if (lastAtom + 1 >= tableLength) {
+        if (!AtomReserve(1))
+            return BAD_RESOURCE;
+        slot = AtomSlot(string, len, hash);
+    }
+
+    name = &atomTable[lastAtom + 1];
+    if (lastAtom < XA_LAST_PREDEFINED)
+        name->string = string;
+    else if (!(name->string = AtomArenaCopy(string, len)))
+        return BAD_RESOURCE;
+    name->len = len;
+    name->hash = hash;
+    *slot = ++lastAtom;
+    return lastAtom;
+}
+
+Atom
+MakeAtom(const char *string, unsigned len, Bool makeit)
+{
+    return AtomLookup(string, len, makeit);
+}
+
+/*
+ * Intern (or with makeit FALSE, just look up) count nul-terminated names
+ * at once, with all the table growth done up front.  Returns FALSE if
+ * any of them could not be created.
+ */
+Bool
+MakeAtoms(const char *const *names, int count, Bool makeit, Atom *atoms)
+{
+    Bool ret = TRUE;
+    int i;
+
+    if (makeit && !AtomReserve(count))
+        return FALSE;
+
+    for (i = 0; i < count; i++) {
+        atoms[i] = AtomLookup(names[i], strlen(names[i]), makeit);
+        if (atoms[i] == BAD_RESOURCE)
+            ret = FALSE;
+    }
+    return ret;
 }
 
 Bool
@@ -149,13 +247,9 @@ ValidAtom(Atom atom)
 const char *
 NameForAtom(Atom atom)
 {
-    NodePtr node;
-
-    if (atom > lastAtom)
-        return 0;
-    if ((node = nodeTable[atom]) == NULL)
+    if (atom == None || atom > lastAtom)
         return 0;
-    return node->string;
+    return atomTable[atom].string;
 }
 
 void
@@ -164,32 +258,21 @@ AtomError(void)
     FatalError("initializing atoms");
 }
 
-static void
-FreeAtom(NodePtr patom)
-{
-    if (patom->left)
-        FreeAtom(patom->left);
-    if (patom->right)
-        FreeAtom(patom->right);
-    if (patom->a > XA_LAST_PREDEFINED) {
-        /*
-         * All strings above XA_LAST_PREDEFINED are strdup'ed, so it's safe to
-         * cast here
-         */
-        free((char *) patom->string);
-    }
-    free(patom);
-}
-
 void
 FreeAllAtoms(void)
 {
-    if (atomRoot == NULL)
-        return;
-    FreeAtom(atomRoot);
-    atomRoot = NULL;
-    free(nodeTable);
-    nodeTable = NULL;
+    AtomArenaPtr block;
+
+    while ((block = atomArena)) {
+        atomArena = block->next;
+        free(block);
+    }
+    free(atomTable);
+    atomTable = NULL;
+    tableLength = 0;
+    free(hashTable);
+    hashTable = NULL;
+    hashSize = 0;
     lastAtom = None;
 }
 
@@ -198,10 +281,11 @@ InitAtoms(void)
 {
     FreeAllAtoms();
     tableLength = InitialTableSize;
-    nodeTable = xallocarray(InitialTableSize, sizeof(NodePtr));
-    if (!nodeTable)
+    atomTable = xallocarray(InitialTableSize, sizeof(AtomNameRec));
+    hashSize = 2 * InitialTableSize;
+    hashTable = calloc(hashSize, sizeof(Atom));
+    if (!atomTable || !hashTable)
         AtomError();
-    nodeTable[None] = NULL;
     MakePredeclaredAtoms();
     if (lastAtom != XA_LAST_PREDEFINED)
         AtomError();
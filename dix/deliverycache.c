@@ -0,0 +1,177 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Event delivery cache.
+ *
+ * Delivering an event to a window tries every client on the window's list
+ * of other clients, core or XI, and most of them turn out not to have
+ * selected for it: the root window of a desktop has dozens of XI2 clients
+ * on it, each listening for a few raw events only.  Once a window has a
+ * long list, it gets a small table of the clients that select for an
+ * event, keyed by the event type, the device and the filter, which is all
+ * GetEventMask and the filter test depend on.  Each list keeps the order
+ * of the window's list, so delivery tries the same clients in the same
+ * order it would have, just without the ones it would have filtered out.
+ *
+ * Anything that changes a window's list or the masks on it throws away its
+ * table: EventSelectForWindow and OtherClientGone for core clients,
+ * AddExtensionClient, InputClientGone and RecalculateDeviceDeliverableEvents
+ * for XI ones, which covers XSelectExtensionEvent, XISelectEvents and
+ * clients going away.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <X11/X.h>
+#include <X11/Xproto.h>
+
+#include "misc.h"
+#include "windowstr.h"
+#include "inputstr.h"
+
+/* Cache lists of windows with at least this many clients */
+#define DELIVERY_CACHE_MIN 8
+/* Lists per window, a power of two */
+#define DELIVERY_CACHE_SLOTS 64
+
+typedef struct _DeliveryList {
+    Bool valid;
+    CARD8 type;                 /* key: event type, */
+    CARD16 evtype;              /* XI2 event type, */
+    int deviceid;               /* device, */
+    Bool master;
+    Mask filter;                /* and filter */
+    int n;
+    InputClientsPtr *clients;
+} DeliveryListRec, *DeliveryListPtr;
+
+typedef struct _DeliveryCache {
+    DeliveryListRec lists[DELIVERY_CACHE_SLOTS];
+} DeliveryCacheRec, *DeliveryCachePtr;
+
+static inline DeliveryCachePtr
+DeliveryCacheGet(WindowPtr pWin)
+{
+    return pWin->optional ? pWin->optional->deliveryCache : NULL;
+}
+
+static void
+DeliveryCacheBuild(DeliveryListPtr list, DeviceIntPtr dev, xEvent *ev,
+                   Mask filter, InputClientsPtr clients)
+{
+    InputClientsPtr other;
+    int n = 0;
+
+    free(list->clients);
+    list->clients = NULL;
+    list->valid = FALSE;
+
+    for (other = clients; other; other = other->next)
+        if (GetEventMask(dev, ev, other) & filter)
+            n++;
+    if (n && !(list->clients = xallocarray(n, sizeof(InputClientsPtr))))
+        return;
+
+    list->n = 0;
+    for (other = clients; other; other = other->next)
+        if (GetEventMask(dev, ev, other) & filter)
+            list->clients[list->n++] = other;
+    list->valid = TRUE;
+}
+
+/**
+ * The clients on pWin's list that select for the event from dev, in the
+ * order of that list.  clients is the head of the list, core or XI, that
+ * the event goes to.  Returns FALSE if pWin has too few clients to be
+ * worth caching or memory ran out; the caller then has to try every
+ * client on the list.
+ */
+Bool
+DeliveryCacheLookup(DeviceIntPtr dev, WindowPtr pWin, xEvent *ev,
+                    Mask filter, InputClientsPtr clients,
+                    InputClientsPtr **list, int *n)
+{
+    DeliveryCachePtr cache = DeliveryCacheGet(pWin);
+    DeliveryListPtr entry;
+    CARD8 type = ev->u.u.type;
+    CARD16 evtype = 0;
+    Bool master = IsMaster(dev);
+    unsigned hash;
+
+    /* CantBeFiltered events go to every client */
+    if (filter == NoEventMask)
+        return FALSE;
+    if (!cache) {
+        InputClientsPtr other;
+        int count = 0;
+
+        for (other = clients; other && count < DELIVERY_CACHE_MIN;
+             other = other->next)
+            count++;
+        if (count < DELIVERY_CACHE_MIN || !pWin->optional)
+            return FALSE;
+        if (!(cache = calloc(1, sizeof(DeliveryCacheRec))))
+            return FALSE;
+        pWin->optional->deliveryCache = cache;
+    }
+
+    if (type == GenericEvent)
+        evtype = ((xGenericEvent *) ev)->evtype;
+
+    hash = type * 31 + evtype * 7 + dev->id * 131 + filter;
+    entry = &cache->lists[(hash ^ (hash >> 8)) & (DELIVERY_CACHE_SLOTS - 1)];
+    if (!entry->valid || entry->type != type || entry->evtype != evtype ||
+        entry->deviceid != dev->id || entry->master != master ||
+        entry->filter != filter) {
+        entry->type = type;
+        entry->evtype = evtype;
+        entry->deviceid = dev->id;
+        entry->master = master;
+        entry->filter = filter;
+        DeliveryCacheBuild(entry, dev, ev, filter, clients);
+        if (!entry->valid)
+            return FALSE;
+    }
+
+    *list = entry->clients;
+    *n = entry->n;
+    return TRUE;
+}
+
+/**
+ * The clients on pWin or their masks changed; forget all of pWin's lists.
+ */
+void
+DeliveryCacheInvalidate(WindowPtr pWin)
+{
+    DeliveryCachePtr cache = DeliveryCacheGet(pWin);
+    int i;
+
+    if (!cache)
+        return;
+    for (i = 0; i < DELIVERY_CACHE_SLOTS; i++)
+        free(cache->lists[i].clients);
+    free(cache);
+    pWin->optional->deliveryCache = NULL;
+}
@@ -405,6 +405,7 @@ Dispatch(void)
     int result;
     ClientPtr client;
     long start_tick;
+    CARD64 start_ns = 0;
 
     nextFreeClientID = 1;
     nClients = 0;
@@ -470,14 +471,19 @@ Dispatch(void)
                                           client->index,
                                           client->requestBuffer);
 #endif
+                if (RequestStatsEnable)
+                    start_ns = GetTimeInNanos();
                 if (result > (maxBigRequestSize << 2))
                     result = BadLength;
                 else {
                     result = XaceHookDispatch(client, client->majorOp);
-                    if (result == Success)
+                    if (result == Success &&
+                        !(DispatchThreadCount && DispatchThreadQueue(client)))
                         result =
                             (*client->requestVector[client->majorOp]) (client);
                 }
+                if (RequestStatsEnable)
+                    RequestStatsRecord(client, GetTimeInNanos() - start_ns);
                 if (!SmartScheduleSignalEnable)
                     SmartScheduleTime = GetTimeInMillis();
 
@@ -508,6 +514,7 @@ Dispatch(void)
 #if defined(DDXBEFORERESET)
     ddxBeforeReset();
 #endif
+    RequestStatsDump();
     KillAllClients();
     dispatchException &= ~DE_RESET;
     SmartScheduleLatencyLimited = 0;
@@ -2066,6 +2073,28 @@ ProcPutImage(ClientPtr client)
     return Success;
 }
 
+/* Hand a finished strip of image data to the OS layer without copying it,
+ * as long as there is a spare buffer to render the next strip into.  The
+ * strip buffer is only replaced when the OS layer kept it. */
+static void
+WriteImageStrip(ClientPtr client, int count, char **pBuf, char **pSpare,
+                long size)
+{
+    void *buf = *pBuf;
+
+    if (!*pSpare)
+        *pSpare = malloc(size);
+    if (!*pSpare) {
+        WriteToClient(client, count, buf);
+        return;
+    }
+    WriteToClientLend(client, count, &buf);
+    if (!buf) {
+        *pBuf = *pSpare;
+        *pSpare = NULL;
+    }
+}
+
 static int
 DoGetImage(ClientPtr client, int format, Drawable drawable,
            int x, int y, int width, int height,
@@ -2079,7 +2108,7 @@ DoGetImage(ClientPtr client, int format, Drawable drawable,
     int relx, rely;
     long widthBytesLine, length;
     Mask plane = 0;
-    char *pBuf;
+    char *pBuf, *pSpare = NULL;
     xGetImageReply xgi;
     RegionPtr pVisibleRegion = NULL;
 
@@ -2222,7 +2251,8 @@ DoGetImage(ClientPtr client, int format, Drawable drawable,
             ReformatImage(pBuf, (int) (nlines * widthBytesLine),
                           BitsPerPixel(pDraw->depth), ClientOrder(client));
 
-            WriteToClient(client, (int) (nlines * widthBytesLine), pBuf);
+            WriteImageStrip(client, (int) (nlines * widthBytesLine),
+                            &pBuf, &pSpare, length);
             linesDone += nlines;
         }
     }
@@ -2250,13 +2280,15 @@ DoGetImage(ClientPtr client, int format, Drawable drawable,
                     ReformatImage(pBuf, (int) (nlines * widthBytesLine),
                                   1, ClientOrder(client));
 
-                    WriteToClient(client, (int)(nlines * widthBytesLine), pBuf);
+                    WriteImageStrip(client, (int) (nlines * widthBytesLine),
+                                    &pBuf, &pSpare, length);
                     linesDone += nlines;
                 }
             }
         }
     }
     free(pBuf);
+    free(pSpare);
     return Success;
 }
 
@@ -3409,6 +3441,8 @@ CloseDownClient(ClientPtr client)
     Bool really_close_down = client->clientGone ||
         client->closeDownMode == DestroyAll;
 
+    DispatchThreadCancel(client);
+
     if (!client->clientGone) {
         /* ungrab server if grabbing client dies */
         if (grabState != GrabNone && grabClient == client) {
@@ -0,0 +1,477 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Threaded request dispatch.
+ *
+ * With -dispatchthreads N, large rendering requests that only touch a
+ * client's own offscreen pixmaps are run on a pool of N worker threads,
+ * so one client's software PutImage or fill doesn't hold up every other
+ * client.  Everything else is still dispatched on the main thread, which
+ * remains the only thread that reads requests, writes events, replies and
+ * errors, or changes any state shared between clients.
+ *
+ * A request is handed off only when it is a PutImage or PolyFillRectangle,
+ * the core handler is installed, no XACE resource hooks are registered,
+ * the drawable is a pixmap created by this client that nothing else holds
+ * a reference to and that isn't being tracked by Damage, the GC also
+ * belongs to the client, and the screen has been marked safe by the DDX
+ * with DispatchThreadAllowScreen() (i.e. rendering is plain fb with no
+ * shared per-screen state).  CopyArea stays on the main thread: it calls
+ * SourceValidate, whose misprite and composite wrappers swap screen hooks.
+ * Small requests stay on the main thread, where they are cheaper than the
+ * handoff.  The request is copied out of the client's input buffer before
+ * it is queued, since the io layer may recycle that buffer as soon as
+ * another client is read.
+ *
+ * While a request is on a worker, the client is ignored.  Any main-thread
+ * access to that client's resources -- lookups by other clients, adds,
+ * frees, iteration, CloseDownClient -- first goes through
+ * DispatchThreadBarrier(), which waits for the request to finish (or runs
+ * it inline if no worker has picked it up yet).  This is the serialisation
+ * fallback: anything that might observe the pixmap or GC sees the request
+ * as having completed in order.  The worker signals completion through a
+ * pipe, and the main thread then reports any error and resumes the
+ * client.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <X11/X.h>
+#include <X11/Xproto.h>
+#include "misc.h"
+#include "os.h"
+#include "opaque.h"
+#include "dixstruct.h"
+#include "resource.h"
+#include "scrnintstr.h"
+#include "pixmapstr.h"
+#include "gcstruct.h"
+#include "xace.h"
+#include "damage.h"
+#include "dispatch.h"
+
+int DispatchThreadCount;
+volatile char DispatchThreadBusy[MAXCLIENTS];
+
+#if INPUTTHREAD
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+
+/* Below this many pixels the request is cheaper to run than to hand off */
+#define DISPATCH_THREAD_MIN_PIXELS 65536
+
+#define MAX_DISPATCH_THREADS 64
+
+typedef enum {
+    JOB_IDLE,
+    JOB_QUEUED,
+    JOB_RUNNING,
+    JOB_INLINE,
+    JOB_DONE,
+} DispatchJobState;
+
+typedef struct _DispatchJob {
+    struct _DispatchJob *next;
+    ClientPtr client;
+    DispatchJobState state;
+    int result;
+    void *request;
+} DispatchJobRec, *DispatchJobPtr;
+
+static DispatchJobRec jobs[MAXCLIENTS];
+static DispatchJobPtr queueHead, *queueTail = &queueHead;
+static Bool allowScreen[MAXSCREENS];
+
+static pthread_mutex_t jobLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t jobQueued = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t jobDone = PTHREAD_COND_INITIALIZER;
+static pthread_t mainThread;
+static pthread_t threads[MAX_DISPATCH_THREADS];
+static int numThreads;
+static int donePipe[2] = { -1, -1 };
+
+void
+DispatchThreadAllowScreen(ScreenPtr pScreen)
+{
+    allowScreen[pScreen->myNum] = TRUE;
+}
+
+static void
+DispatchThreadSignalDone(void)
+{
+    char byte = 0;
+
+    while (write(donePipe[1], &byte, 1) < 0 && errno == EINTR)
+        ;
+}
+
+static void
+DispatchThreadRun(DispatchJobPtr job)
+{
+    ClientPtr client = job->client;
+
+    job->result = (*client->requestVector[client->majorOp]) (client);
+}
+
+static void *
+DispatchThreadMain(void *arg)
+{
+    DispatchJobPtr job;
+    sigset_t set;
+
+    /* Signals are handled by the main thread */
+    sigfillset(&set);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+#if defined(HAVE_PTHREAD_SETNAME_NP_WITH_TID)
+    pthread_setname_np(pthread_self(), "DispatchThread");
+#elif defined(HAVE_PTHREAD_SETNAME_NP_WITHOUT_TID)
+    pthread_setname_np("DispatchThread");
+#endif
+
+    pthread_mutex_lock(&jobLock);
+    for (;;) {
+        while (!queueHead)
+            pthread_cond_wait(&jobQueued, &jobLock);
+
+        job = queueHead;
+        queueHead = job->next;
+        if (!queueHead)
+            queueTail = &queueHead;
+        job->state = JOB_RUNNING;
+        pthread_mutex_unlock(&jobLock);
+
+        /* keep the main thread's region pool to itself */
+        __atomic_add_fetch(&RegionPoolThreads, 1, __ATOMIC_SEQ_CST);
+        DispatchThreadRun(job);
+        __atomic_sub_fetch(&RegionPoolThreads, 1, __ATOMIC_SEQ_CST);
+
+        pthread_mutex_lock(&jobLock);
+        job->state = JOB_DONE;
+        pthread_cond_broadcast(&jobDone);
+        DispatchThreadSignalDone();
+    }
+
+    return NULL;
+}
+
+/*
+ * Wait for the request in flight for this client, if any.  Must be called
+ * before the main thread touches anything that request might be using;
+ * requests running on a worker call this too (through the resource
+ * lookups) and pass straight through.
+ */
+void
+DispatchThreadBarrierSlow(int cid)
+{
+    DispatchJobPtr job = &jobs[cid];
+    DispatchJobPtr *prev;
+
+    if (!pthread_equal(pthread_self(), mainThread))
+        return;
+
+    pthread_mutex_lock(&jobLock);
+    if (job->state == JOB_QUEUED) {
+        /* Nobody has picked it up yet, quicker to just run it here */
+        for (prev = &queueHead; *prev != job; prev = &(*prev)->next)
+            ;
+        *prev = job->next;
+        if (!*prev)
+            queueTail = prev;
+        job->state = JOB_INLINE;
+        pthread_mutex_unlock(&jobLock);
+
+        DispatchThreadRun(job);
+
+        pthread_mutex_lock(&jobLock);
+        job->state = JOB_DONE;
+        DispatchThreadSignalDone();
+    }
+    while (job->state == JOB_RUNNING)
+        pthread_cond_wait(&jobDone, &jobLock);
+    pthread_mutex_unlock(&jobLock);
+}
+
+static void
+DispatchThreadRelease(ClientPtr client)
+{
+    DispatchJobPtr job = &jobs[client->index];
+
+    DispatchThreadBusy[client->index] = FALSE;
+    job->state = JOB_IDLE;
+    job->client = NULL;
+    if (client->requestBuffer == job->request)
+        client->requestBuffer = NULL;
+    free(job->request);
+    job->request = NULL;
+}
+
+static void
+DispatchThreadFinish(ClientPtr client)
+{
+    DispatchJobPtr job = &jobs[client->index];
+
+    DispatchThreadRelease(client);
+
+    if (client->noClientException != Success) {
+        AttendClient(client);
+        CloseDownClient(client);
+        return;
+    }
+    if (job->result != Success)
+        SendErrorToClient(client, client->majorOp, client->minorOp,
+                          client->errorValue, job->result);
+    AttendClient(client);
+}
+
+static void
+DispatchThreadNotify(int fd, int ready, void *data)
+{
+    char buf[64];
+    int i;
+
+    while (read(fd, buf, sizeof(buf)) == sizeof(buf))
+        ;
+
+    for (i = 1; i < currentMaxClients; i++) {
+        ClientPtr client = jobs[i].client;
+
+        if (!DispatchThreadBusy[i] || !client)
+            continue;
+        pthread_mutex_lock(&jobLock);
+        if (jobs[i].state != JOB_DONE)
+            client = NULL;
+        pthread_mutex_unlock(&jobLock);
+        if (client)
+            DispatchThreadFinish(client);
+    }
+}
+
+/*
+ * The client is going away; let its request finish and throw the result
+ * away along with everything else.
+ */
+void
+DispatchThreadCancel(ClientPtr client)
+{
+    if (!DispatchThreadBusy[client->index])
+        return;
+
+    DispatchThreadBarrierSlow(client->index);
+    DispatchThreadRelease(client);
+}
+
+static PixmapPtr
+DispatchThreadPixmap(ClientPtr client, XID id)
+{
+    void *value;
+    PixmapPtr pPixmap;
+
+    if (CLIENT_ID(id) != client->index)
+        return NULL;
+    if (dixLookupResourceByType(&value, id, RT_PIXMAP, client,
+                                DixWriteAccess) != Success)
+        return NULL;
+
+    pPixmap = value;
+    if (pPixmap->refcnt != 1 ||
+        !allowScreen[pPixmap->drawable.pScreen->myNum] ||
+        DamageDrawableIsTracked(&pPixmap->drawable))
+        return NULL;
+
+    return pPixmap;
+}
+
+static GCPtr
+DispatchThreadGC(ClientPtr client, XID id, PixmapPtr pPixmap)
+{
+    void *value;
+    GCPtr pGC;
+
+    if (CLIENT_ID(id) != client->index)
+        return NULL;
+    if (dixLookupResourceByType(&value, id, RT_GC, client,
+                                DixUseAccess) != Success)
+        return NULL;
+
+    /* ValidateGC may pad tile and stipple pixmaps, which can be shared */
+    pGC = value;
+    if (pGC->pScreen != pPixmap->drawable.pScreen ||
+        pGC->fillStyle != FillSolid ||
+        (pGC->stateChanges & (GCTile | GCStipple)))
+        return NULL;
+
+    return pGC;
+}
+
+static Bool
+DispatchThreadEligible(ClientPtr client)
+{
+    PixmapPtr pDst;
+    CARD32 pixels = 0;
+
+    if (client->requestVector != ProcVector || client->clientGone)
+        return FALSE;
+    if (XaceHooks[XACE_RESOURCE_ACCESS])
+        return FALSE;
+
+    switch (client->majorOp) {
+    case X_PutImage: {
+        REQUEST(xPutImageReq);
+
+        if (ProcVector[X_PutImage] != ProcPutImage ||
+            client->req_len < bytes_to_int32(sizeof(xPutImageReq)))
+            return FALSE;
+        pixels = (CARD32) stuff->width * stuff->height;
+        if (pixels < DISPATCH_THREAD_MIN_PIXELS)
+            return FALSE;
+        if (!(pDst = DispatchThreadPixmap(client, stuff->drawable)))
+            return FALSE;
+        return DispatchThreadGC(client, stuff->gc, pDst) != NULL;
+    }
+    case X_PolyFillRectangle: {
+        REQUEST(xPolyFillRectangleReq);
+        xRectangle *rect;
+        int n;
+
+        if (ProcVector[X_PolyFillRectangle] != ProcPolyFillRectangle ||
+            client->req_len < bytes_to_int32(sizeof(xPolyFillRectangleReq)))
+            return FALSE;
+        n = (client->req_len << 2) - sizeof(xPolyFillRectangleReq);
+        if (n & 4)
+            return FALSE;
+        rect = (xRectangle *) &stuff[1];
+        for (n >>= 3; n && pixels < DISPATCH_THREAD_MIN_PIXELS; n--, rect++)
+            pixels += (CARD32) rect->width * rect->height;
+        if (pixels < DISPATCH_THREAD_MIN_PIXELS)
+            return FALSE;
+        if (!(pDst = DispatchThreadPixmap(client, stuff->drawable)))
+            return FALSE;
+        return DispatchThreadGC(client, stuff->gc, pDst) != NULL;
+    }
+    default:
+        return FALSE;
+    }
+}
+
+/*
+ * Called from Dispatch() for each request; returns TRUE if the request
+ * has been handed to a worker, in which case the client is ignored until
+ * it completes.
+ */
+Bool
+DispatchThreadQueue(ClientPtr client)
+{
+    DispatchJobPtr job = &jobs[client->index];
+    size_t len;
+
+    if (!numThreads || !DispatchThreadEligible(client))
+        return FALSE;
+
+    /*
+     * The input buffer belongs to the io layer, which may reuse or free it
+     * while the request is still running; give the worker its own copy.
+     */
+    len = (size_t) client->req_len << 2;
+    if (!(job->request = malloc(len)))
+        return FALSE;
+    memcpy(job->request, client->requestBuffer, len);
+    client->requestBuffer = job->request;
+
+    IgnoreClient(client);
+    DispatchThreadBusy[client->index] = TRUE;
+
+    pthread_mutex_lock(&jobLock);
+    job->client = client;
+    job->result = Success;
+    job->state = JOB_QUEUED;
+    job->next = NULL;
+    *queueTail = job;
+    queueTail = &job->next;
+    pthread_cond_signal(&jobQueued);
+    pthread_mutex_unlock(&jobLock);
+
+    return TRUE;
+}
+
+void
+DispatchThreadsInit(void)
+{
+    pthread_attr_t attr;
+
+    memset(allowScreen, 0, sizeof(allowScreen));
+    if (DispatchThreadCount <= 0)
+        return;
+
+    if (donePipe[0] < 0) {
+        mainThread = pthread_self();
+        if (pipe(donePipe) < 0) {
+            ErrorF("dispatch-threads: could not create pipe, disabled\n");
+            DispatchThreadCount = 0;
+            return;
+        }
+        fcntl(donePipe[0], F_SETFL, O_NONBLOCK);
+        fcntl(donePipe[0], F_SETFD, FD_CLOEXEC);
+        fcntl(donePipe[1], F_SETFD, FD_CLOEXEC);
+
+        if (DispatchThreadCount > MAX_DISPATCH_THREADS)
+            DispatchThreadCount = MAX_DISPATCH_THREADS;
+
+        pthread_attr_init(&attr);
+        for (numThreads = 0; numThreads < DispatchThreadCount; numThreads++)
+            if (pthread_create(&threads[numThreads], &attr,
+                               DispatchThreadMain, NULL) != 0)
+                break;
+        pthread_attr_destroy(&attr);
+
+        if (!numThreads)
+            ErrorF("dispatch-threads: could not create threads, disabled\n");
+        else
+            LogMessageVerb(X_INFO, 1, "dispatch-threads: %d threads\n",
+                           numThreads);
+    }
+
+    SetNotifyFd(donePipe[0], DispatchThreadNotify, X_NOTIFY_READ, NULL);
+}
+
+#else /* INPUTTHREAD */
+
+void
+DispatchThreadsInit(void)
+{
+    if (DispatchThreadCount > 0)
+        ErrorF("dispatch-threads: not supported in this build\n");
+    DispatchThreadCount = 0;
+}
+
+void DispatchThreadAllowScreen(ScreenPtr pScreen) {}
+Bool DispatchThreadQueue(ClientPtr client) { return FALSE; }
+void DispatchThreadCancel(ClientPtr client) {}
+void DispatchThreadBarrierSlow(int client) {}
+
+#endif /* INPUTTHREAD */
@@ -2139,54 +2139,132 @@ GetClientsForDelivery(DeviceIntPtr dev, WindowPtr win,
     return rc;
 }
 
+/**
+ * Filter out raw events for XI 2.0 and XI 2.1 clients.
+ *
+ * If there is a grab on the device, 2.0 clients only get raw events if they
+ * have the grab. 2.1+ clients get raw events in all cases.
+ *
+ * @return TRUE if the event should be discarded, FALSE otherwise.
+ */
+static BOOL
+FilterRawEvents(const ClientPtr client, const GrabPtr grab, WindowPtr root)
+{
+    XIClientPtr client_xi_version;
+    int cmp;
+
+    /* device not grabbed -> don't filter */
+    if (!grab)
+        return FALSE;
+
+    client_xi_version =
+        dixLookupPrivate(&client->devPrivates, XIClientPrivateKey);
+
+    cmp = version_compare(client_xi_version->major_version,
+                          client_xi_version->minor_version, 2, 0);
+    /* XI 2.0: if device is grabbed, skip
+       XI 2.1: if device is grabbed by us, skip, we've already delivered */
+    if (cmp == 0)
+        return TRUE;
+
+    return (grab->window != root) ? FALSE : SameClient(grab, client);
+}
+
+/**
+ * Try delivery to one client in inputclients, provided the event mask
+ * accepts it and there is no interfering core grab.
+ */
+static enum EventDeliveryState
+DeliverEventToInputClient(DeviceIntPtr dev, InputClients * inputclient,
+                          WindowPtr win, xEvent *events,
+                          int count, Mask filter, GrabPtr grab,
+                          Mask *mask_return)
+{
+    int attempt;
+    Mask mask;
+    ClientPtr client = rClient(inputclient);
+
+    if (IsInterferingGrab(client, dev, events))
+        return EVENT_SKIP;
+
+    if (IsWrongPointerBarrierClient(client, dev, events))
+        return EVENT_SKIP;
+
+    mask = GetEventMask(dev, events, inputclient);
+
+    if (XaceHook(XACE_RECEIVE_ACCESS, client, win, events, count))
+        return EVENT_SKIP;
+
+    attempt = TryClientEvents(client, dev, events, count, mask, filter, grab);
+    if (attempt > 0) {
+        *mask_return = mask;
+        return EVENT_DELIVERED;
+    }
+    return attempt < 0 ? EVENT_REJECTED : EVENT_NOT_DELIVERED;
+}
+
 /**
  * Try delivery on each client in inputclients, provided the event mask
  * accepts it and there is no interfering core grab..
+ *
+ * Windows with many clients keep a list of the ones selecting for the
+ * event, see dix/deliverycache.c, so only those are tried.
+ *
+ * @param rawgrab For raw events, the grab on the device; clients that
+ * FilterRawEvents() filters out don't get the event.
  */
 static enum EventDeliveryState
 DeliverEventToInputClients(DeviceIntPtr dev, InputClients * inputclients,
                            WindowPtr win, xEvent *events,
                            int count, Mask filter, GrabPtr grab,
+                           GrabPtr rawgrab,
                            ClientPtr *client_return, Mask *mask_return)
 {
-    int attempt;
     enum EventDeliveryState rc = EVENT_NOT_DELIVERED;
     Bool have_device_button_grab_class_client = FALSE;
+    InputClients **cached = NULL;
+    int i = 0, ncached = 0;
+
+    if (DeliveryCacheLookup(dev, win, events, filter, inputclients,
+                            &cached, &ncached))
+        inputclients = ncached ? cached[0] : NULL;
 
-    for (; inputclients; inputclients = inputclients->next) {
+    while (inputclients) {
+        InputClients *other = inputclients;
         Mask mask;
-        ClientPtr client = rClient(inputclients);
 
-        if (IsInterferingGrab(client, dev, events))
-            continue;
+        if (cached)
+            inputclients = ++i < ncached ? cached[i] : NULL;
+        else
+            inputclients = other->next;
 
-        if (IsWrongPointerBarrierClient(client, dev, events))
+        if (FilterRawEvents(rClient(other), rawgrab, win))
             continue;
 
-        mask = GetEventMask(dev, events, inputclients);
-
-        if (XaceHook(XACE_RECEIVE_ACCESS, client, win, events, count))
-            /* do nothing */ ;
-        else if ((attempt = TryClientEvents(client, dev,
-                                            events, count,
-                                            mask, filter, grab))) {
-            if (attempt > 0) {
-                /*
-                 * The order of clients is arbitrary therefore if one
-                 * client belongs to DeviceButtonGrabClass make sure to
-                 * catch it.
-                 */
-                if (!have_device_button_grab_class_client) {
-                    rc = EVENT_DELIVERED;
-                    *client_return = client;
-                    *mask_return = mask;
-                    /* Success overrides non-success, so if we've been
-                     * successful on one client, return that */
-                    if (mask & DeviceButtonGrabMask)
-                        have_device_button_grab_class_client = TRUE;
-                }
-            } else if (rc == EVENT_NOT_DELIVERED)
+        switch (DeliverEventToInputClient(dev, other, win, events, count,
+                                          filter, grab, &mask)) {
+        case EVENT_DELIVERED:
+            /*
+             * The order of clients is arbitrary therefore if one
+             * client belongs to DeviceButtonGrabClass make sure to
+             * catch it.
+             */
+            if (!have_device_button_grab_class_client) {
+                rc = EVENT_DELIVERED;
+                *client_return = rClient(other);
+                *mask_return = mask;
+                /* Success overrides non-success, so if we've been
+                 * successful on one client, return that */
+                if (mask & DeviceButtonGrabMask)
+                    have_device_button_grab_class_client = TRUE;
+            }
+            break;
+        case EVENT_REJECTED:
+            if (rc == EVENT_NOT_DELIVERED)
                 rc = EVENT_REJECTED;
+            break;
+        default:
+            break;
         }
     }
 
@@ -2211,7 +2289,7 @@ DeliverEventToWindowMask(DeviceIntPtr dev, WindowPtr win, xEvent *events,
         return EVENT_SKIP;
 
     return DeliverEventToInputClients(dev, iclients, win, events, count, filter,
-                                      grab, client_return, mask_return);
+                                      grab, NULL, client_return, mask_return);
 
 }
 
@@ -2310,37 +2388,6 @@ DeliverEventsToWindow(DeviceIntPtr pDev, WindowPtr pWin, xEvent
     return nondeliveries;
 }
 
-/**
- * Filter out raw events for XI 2.0 and XI 2.1 clients.
- *
- * If there is a grab on the device, 2.0 clients only get raw events if they
- * have the grab. 2.1+ clients get raw events in all cases.
- *
- * @return TRUE if the event should be discarded, FALSE otherwise.
- */
-static BOOL
-FilterRawEvents(const ClientPtr client, const GrabPtr grab, WindowPtr root)
-{
-    XIClientPtr client_xi_version;
-    int cmp;
-
-    /* device not grabbed -> don't filter */
-    if (!grab)
-        return FALSE;
-
-    client_xi_version =
-        dixLookupPrivate(&client->devPrivates, XIClientPrivateKey);
-
-    cmp = version_compare(client_xi_version->major_version,
-                          client_xi_version->minor_version, 2, 0);
-    /* XI 2.0: if device is grabbed, skip
-       XI 2.1: if device is grabbed by us, skip, we've already delivered */
-    if (cmp == 0)
-        return TRUE;
-
-    return (grab->window != root) ? FALSE : SameClient(grab, client);
-}
-
 /**
  * Deliver a raw event to the grab owner (if any) and to all root windows.
  *
@@ -2373,28 +2420,17 @@ DeliverRawEvent(RawDeviceEvent *ev, DeviceIntPtr device)
     for (i = 0; i < screenInfo.numScreens; i++) {
         WindowPtr root;
         InputClients *inputclients;
+        ClientPtr c;            /* unused */
+        Mask m;                 /* unused */
 
         root = screenInfo.screens[i]->root;
         if (!GetClientsForDelivery(device, root, xi, filter, &inputclients))
             continue;
 
-        for (; inputclients; inputclients = inputclients->next) {
-            ClientPtr c;        /* unused */
-            Mask m;             /* unused */
-            InputClients ic = *inputclients;
-
-            /* Because we run through the list manually, copy the actual
-             * list, shorten the copy to only have one client and then pass
-             * that down to DeliverEventToInputClients. This way we avoid
-             * double events on XI 2.1 clients that have a grab on the
-             * device.
-             */
-            ic.next = NULL;
-
-            if (!FilterRawEvents(rClient(&ic), grab, root))
-                DeliverEventToInputClients(device, &ic, root, xi, 1,
-                                           filter, NULL, &c, &m);
-        }
+        /* XI 2.1 clients that have a grab on the device already got the
+         * event above, so the grab filters them out here. */
+        DeliverEventToInputClients(device, inputclients, root, xi, 1,
+                                   filter, NULL, grab, &c, &m);
     }
 
     free(xi);
@@ -4385,6 +4421,7 @@ OtherClientGone(void *value, XID id)
     prev = 0;
     for (other = wOtherClients(pWin); other; other = other->next) {
         if (other->resource == id) {
+            DeliveryCacheInvalidate(pWin);
             if (prev)
                 prev->next = other->next;
             else {
@@ -4468,6 +4505,7 @@ EventSelectForWindow(WindowPtr pWin, ClientPtr client, Mask mask)
                 dev->valuator->motionHintWindow = NullWindow;
         }
     }
+    DeliveryCacheInvalidate(pWin);
     RecalculateDeliverableEvents(pWin);
     return Success;
 }
@@ -190,6 +190,9 @@ dix_main(int argc, char *argv[], char *envp[])
         dixResetRegistry();
         InitFonts();
         InitCallbackManager();
+        RequestStatsInit();
+        DispatchThreadsInit();
+        RenderThreadsInit();
         InitOutput(&screenInfo, argc, argv);
 
         if (screenInfo.numScreens < 1)
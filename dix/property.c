@@ -67,6 +67,180 @@ SOFTWARE.
  *
  *****************************************************************/
 
+/*
+ * Windows with more than a handful of properties (root windows under
+ * most desktops carry hundreds) also get a hash of them keyed by atom,
+ * so lookups don't have to walk the list.  The list itself stays as it
+ * is: it defines the ListProperties order, and other code walks it.
+ *
+ * A name can appear more than once in the list when a security module
+ * polyinstantiates a property; the hash then points at the first one and
+ * the module walks on from there, just as it would without the hash.
+ */
+#define PROPERTY_INDEX_MIN 8
+
+typedef struct _PropertySlot {
+    ATOM name;                  /* None if the slot has never been used */
+    unsigned int count;         /* properties with this name, 0 if deleted */
+    PropertyPtr first;          /* first of them in the list */
+} PropertySlotRec, *PropertySlotPtr;
+
+typedef struct _PropertyIndex {
+    int bits;
+    unsigned int used;          /* slots with a name, including deleted */
+    unsigned int count;         /* properties on the window */
+    PropertySlotRec slots[];
+} PropertyIndexRec, *PropertyIndexPtr;
+
+static inline unsigned int
+PropertyHash(ATOM name, int bits)
+{
+    return (name * 0x9e3779b1U) >> (32 - bits);
+}
+
+static PropertySlotPtr
+PropertyIndexFind(PropertyIndexPtr index, ATOM name)
+{
+    unsigned int mask = (1U << index->bits) - 1;
+    unsigned int i = PropertyHash(name, index->bits);
+    PropertySlotPtr slot;
+
+    for (;; i = (i + 1) & mask) {
+        slot = &index->slots[i];
+        if (slot->name == name)
+            return slot->count ? slot : NULL;
+        if (slot->name == None)
+            return NULL;
+    }
+}
+
+/* pProp has just been put at the head of the list */
+static void
+PropertyIndexInsert(PropertyIndexPtr index, PropertyPtr pProp)
+{
+    unsigned int mask = (1U << index->bits) - 1;
+    unsigned int i = PropertyHash(pProp->propertyName, index->bits);
+    PropertySlotPtr slot, reuse = NULL;
+
+    index->count++;
+    for (;; i = (i + 1) & mask) {
+        slot = &index->slots[i];
+        if (slot->name == pProp->propertyName) {
+            slot->count++;
+            slot->first = pProp;
+            return;
+        }
+        if (slot->name == None)
+            break;
+        if (!slot->count && !reuse)
+            reuse = slot;
+    }
+
+    if (reuse)
+        slot = reuse;
+    else
+        index->used++;
+    slot->name = pProp->propertyName;
+    slot->count = 1;
+    slot->first = pProp;
+}
+
+static PropertyIndexPtr
+PropertyIndexCreate(PropertyPtr list, unsigned int count)
+{
+    PropertyIndexPtr index;
+    PropertyPtr *tail, pProp;
+    int bits = 4;
+
+    while ((1U << bits) < count * 2)
+        bits++;
+
+    index = calloc(1, sizeof(PropertyIndexRec) +
+                   (sizeof(PropertySlotRec) << bits));
+    if (!index)
+        return NULL;
+    index->bits = bits;
+
+    /* Insert back to front so that the first of any duplicates wins */
+    tail = xallocarray(count, sizeof(PropertyPtr));
+    if (!tail) {
+        free(index);
+        return NULL;
+    }
+    count = 0;
+    for (pProp = list; pProp; pProp = pProp->next)
+        tail[count++] = pProp;
+    while (count)
+        PropertyIndexInsert(index, tail[--count]);
+    free(tail);
+
+    return index;
+}
+
+static void
+LinkProperty(WindowPtr pWin, PropertyPtr pProp)
+{
+    WindowOptPtr optional = pWin->optional;
+    PropertyIndexPtr index = optional->propIndex;
+    PropertyPtr p;
+    unsigned int count;
+
+    pProp->next = optional->userProps;
+    optional->userProps = pProp;
+
+    if (index) {
+        PropertyIndexInsert(index, pProp);
+        /* Rebuild at 3/4 full, which also drops the deleted slots */
+        if (index->used * 4 < (3U << index->bits))
+            return;
+        count = index->count;
+    }
+    else {
+        for (count = 0, p = pProp; p && count <= PROPERTY_INDEX_MIN; p = p->next)
+            count++;
+        if (count <= PROPERTY_INDEX_MIN)
+            return;
+        for (; p; p = p->next)
+            count++;
+    }
+
+    /* If this fails we just carry on with the old index, or the list */
+    if ((index = PropertyIndexCreate(optional->userProps, count))) {
+        free(optional->propIndex);
+        optional->propIndex = index;
+    }
+}
+
+static void
+UnlinkProperty(WindowPtr pWin, PropertyPtr pProp)
+{
+    WindowOptPtr optional = pWin->optional;
+    PropertyIndexPtr index = optional->propIndex;
+    PropertySlotPtr slot;
+    PropertyPtr *prev, p;
+
+    for (prev = &optional->userProps; *prev != pProp; prev = &(*prev)->next)
+        ;
+    *prev = pProp->next;
+
+    if (index) {
+        slot = PropertyIndexFind(index, pProp->propertyName);
+        index->count--;
+        if (--slot->count && slot->first == pProp) {
+            for (p = pProp->next; p->propertyName != pProp->propertyName;
+                 p = p->next)
+                ;
+            slot->first = p;
+        }
+    }
+
+    if (!optional->userProps) {
+        free(optional->propIndex);
+        optional->propIndex = NULL;
+        CheckWindowOptionalNeed(pWin);
+    }
+}
+
 #ifdef notdef
 static void
 PrintPropertys(WindowPtr pWin)
@@ -95,9 +269,17 @@ dixLookupProperty(PropertyPtr *result, WindowPtr pWin, Atom propertyName,
 
     client->errorValue = propertyName;
 
-    for (pProp = wUserProps(pWin); pProp; pProp = pProp->next)
-        if (pProp->propertyName == propertyName)
-            break;
+    if (pWin->optional && pWin->optional->propIndex) {
+        PropertySlotPtr slot = PropertyIndexFind(pWin->optional->propIndex,
+                                                 propertyName);
+
+        pProp = slot ? slot->first : NULL;
+    }
+    else {
+        for (pProp = wUserProps(pWin); pProp; pProp = pProp->next)
+            if (pProp->propertyName == propertyName)
+                break;
+    }
 
     if (pProp)
         rc = XaceHookPropertyAccess(client, pWin, &pProp, access_mode);
@@ -293,8 +475,7 @@ dixChangeWindowProperty(ClientPtr pClient, WindowPtr pWin, Atom property,
             pClient->errorValue = property;
             return rc;
         }
-        pProp->next = pWin->optional->userProps;
-        pWin->optional->userProps = pProp;
+        LinkProperty(pWin, pProp);
     }
     else if (rc == Success) {
         /* To append or prepend to a property the request format and type
@@ -368,7 +549,7 @@ dixChangeWindowProperty(ClientPtr pClient, WindowPtr pWin, Atom property,
 int
 DeleteProperty(ClientPtr client, WindowPtr pWin, Atom propName)
 {
-    PropertyPtr pProp, prevProp;
+    PropertyPtr pProp;
     int rc;
 
     rc = dixLookupProperty(&pProp, pWin, propName, client, DixDestroyAccess);
@@ -376,19 +557,7 @@ DeleteProperty(ClientPtr client, WindowPtr pWin, Atom propName)
         return Success;         /* Succeed if property does not exist */
 
     if (rc == Success) {
-        if (pWin->optional->userProps == pProp) {
-            /* Takes care of head */
-            if (!(pWin->optional->userProps = pProp->next))
-                CheckWindowOptionalNeed(pWin);
-        }
-        else {
-            /* Need to traverse to find the previous element */
-            prevProp = pWin->optional->userProps;
-            while (prevProp->next != pProp)
-                prevProp = prevProp->next;
-            prevProp->next = pProp->next;
-        }
-
+        UnlinkProperty(pWin, pProp);
         deliverPropertyNotifyEvent(pWin, PropertyDelete, pProp);
         free(pProp->data);
         dixFreeObjectWithPrivates(pProp, PRIVATE_PROPERTY);
@@ -410,8 +579,11 @@ DeleteAllWindowProperties(WindowPtr pWin)
         pProp = pNextProp;
     }
 
-    if (pWin->optional)
+    if (pWin->optional) {
         pWin->optional->userProps = NULL;
+        free(pWin->optional->propIndex);
+        pWin->optional->propIndex = NULL;
+    }
 }
 
 static int
@@ -443,7 +615,7 @@ NullPropertyReply(ClientPtr client, ATOM propertyType, int format)
 int
 ProcGetProperty(ClientPtr client)
 {
-    PropertyPtr pProp, prevProp;
+    PropertyPtr pProp;
     unsigned long n, len, ind;
     int rc;
     WindowPtr pWin;
@@ -546,19 +718,7 @@ ProcGetProperty(ClientPtr client)
 
     if (stuff->delete && (reply.bytesAfter == 0)) {
         /* Delete the Property */
-        if (pWin->optional->userProps == pProp) {
-            /* Takes care of head */
-            if (!(pWin->optional->userProps = pProp->next))
-                CheckWindowOptionalNeed(pWin);
-        }
-        else {
-            /* Need to traverse to find the previous element */
-            prevProp = pWin->optional->userProps;
-            while (prevProp->next != pProp)
-                prevProp = prevProp->next;
-            prevProp->next = pProp->next;
-        }
-
+        UnlinkProperty(pWin, pProp);
         free(pProp->data);
         dixFreeObjectWithPrivates(pProp, PRIVATE_PROPERTY);
     }
@@ -85,6 +85,15 @@ Equipment Corporation.
 #include "gc.h"
 #include <pixman.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#endif
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 #undef assert
 #ifdef REGION_DEBUG
 #define assert(expr) { \
@@ -169,7 +178,7 @@ Equipment Corporation.
         ((r1)->y1 <= (r2)->y1) && \
         ((r1)->y2 >= (r2)->y2) )
 
-#define xfreeData(reg) if ((reg)->data && (reg)->data->size) free((reg)->data)
+#define xfreeData(reg) if ((reg)->data && (reg)->data->size) RegionDataFree((reg)->data)
 
 #define RECTALLOC_BAIL(pReg,n,bail) \
 if (!(pReg)->data || (((pReg)->data->numRects + (n)) > (pReg)->data->size)) \
@@ -214,6 +223,311 @@ if (((numRects) < ((reg)->data->size >> 1)) && ((reg)->data->size > 50)) \
     }									 \
 }
 
+/*
+ * Box kernels for the band walking code below.  A BoxRec is four shorts,
+ * so a 128-bit vector holds two boxes and a 256-bit one four; coalescing
+ * bands and finding extents then become a handful of compares, blends and
+ * min/max per vector instead of per box.  Level 0 is the plain C code,
+ * level 1 SSE2 or NEON, level 2 AVX2, which is picked at run time.
+ */
+
+typedef struct _RegionBoxOps {
+    /* TRUE iff the n boxes at a and b have the same x1 and x2 */
+    Bool (*bandsMatch) (const BoxRec *a, const BoxRec *b, int n);
+    /* set y2 of the n boxes at box */
+    void (*setY2) (BoxPtr box, int n, short y2);
+    /* grow extents->x1 and extents->x2 to cover the n boxes at box */
+    void (*extents) (const BoxRec *box, int n, BoxPtr extents);
+} RegionBoxOpsRec;
+
+/* Bands shorter than this are handled inline */
+#define REGION_SIMD_MIN 4
+
+static inline Bool
+RegionBandsMatchC(const BoxRec *a, const BoxRec *b, int n)
+{
+    for (; n; n--, a++, b++)
+        if (a->x1 != b->x1 || a->x2 != b->x2)
+            return FALSE;
+    return TRUE;
+}
+
+static inline void
+RegionBandSetY2C(BoxPtr box, int n, short y2)
+{
+    for (; n; n--, box++)
+        box->y2 = y2;
+}
+
+static inline void
+RegionBoxesExtentsC(const BoxRec *box, int n, BoxPtr extents)
+{
+    for (; n; n--, box++) {
+        if (box->x1 < extents->x1)
+            extents->x1 = box->x1;
+        if (box->x2 > extents->x2)
+            extents->x2 = box->x2;
+    }
+}
+
+static Bool
+RegionBandsMatchPlain(const BoxRec *a, const BoxRec *b, int n)
+{
+    return RegionBandsMatchC(a, b, n);
+}
+
+static void
+RegionBandSetY2Plain(BoxPtr box, int n, short y2)
+{
+    RegionBandSetY2C(box, n, y2);
+}
+
+static void
+RegionBoxesExtentsPlain(const BoxRec *box, int n, BoxPtr extents)
+{
+    RegionBoxesExtentsC(box, n, extents);
+}
+
+static const RegionBoxOpsRec regionBoxOpsC = {
+    RegionBandsMatchPlain, RegionBandSetY2Plain, RegionBoxesExtentsPlain
+};
+
+#ifdef __SSE2__
+#define REGION_SIMD_VECTOR 1
+
+/* x1 and x2 of both boxes, as bits of _mm_movemask_epi8 */
+#define REGION_SSE2_X_MASK 0x3333
+
+static inline void
+RegionExtentsReduceSSE2(__m128i lo, __m128i hi, BoxPtr extents)
+{
+    short x1 = min((short) _mm_extract_epi16(lo, 0),
+                   (short) _mm_extract_epi16(lo, 4));
+    short x2 = max((short) _mm_extract_epi16(hi, 2),
+                   (short) _mm_extract_epi16(hi, 6));
+
+    if (x1 < extents->x1)
+        extents->x1 = x1;
+    if (x2 > extents->x2)
+        extents->x2 = x2;
+}
+
+static Bool
+RegionBandsMatchSSE2(const BoxRec *a, const BoxRec *b, int n)
+{
+    for (; n >= 2; n -= 2, a += 2, b += 2) {
+        __m128i eq = _mm_cmpeq_epi16(_mm_loadu_si128((const __m128i *) a),
+                                     _mm_loadu_si128((const __m128i *) b));
+
+        if ((_mm_movemask_epi8(eq) & REGION_SSE2_X_MASK) != REGION_SSE2_X_MASK)
+            return FALSE;
+    }
+    return RegionBandsMatchC(a, b, n);
+}
+
+static void
+RegionBandSetY2SSE2(BoxPtr box, int n, short y2)
+{
+    const __m128i keep = _mm_set_epi16(0, -1, -1, -1, 0, -1, -1, -1);
+    const __m128i v = _mm_set1_epi16(y2);
+
+    for (; n >= 2; n -= 2, box += 2) {
+        __m128i b = _mm_loadu_si128((const __m128i *) box);
+
+        _mm_storeu_si128((__m128i *) box,
+                         _mm_or_si128(_mm_and_si128(b, keep),
+                                      _mm_andnot_si128(keep, v)));
+    }
+    RegionBandSetY2C(box, n, y2);
+}
+
+static void
+RegionBoxesExtentsSSE2(const BoxRec *box, int n, BoxPtr extents)
+{
+    __m128i lo = _mm_set1_epi16(MAXSHORT);
+    __m128i hi = _mm_set1_epi16(MINSHORT);
+
+    for (; n >= 2; n -= 2, box += 2) {
+        __m128i b = _mm_loadu_si128((const __m128i *) box);
+
+        lo = _mm_min_epi16(lo, b);
+        hi = _mm_max_epi16(hi, b);
+    }
+    RegionExtentsReduceSSE2(lo, hi, extents);
+    RegionBoxesExtentsC(box, n, extents);
+}
+
+static const RegionBoxOpsRec regionBoxOpsVector = {
+    RegionBandsMatchSSE2, RegionBandSetY2SSE2, RegionBoxesExtentsSSE2
+};
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define REGION_SIMD_AVX2 2
+
+__attribute__((target("avx2")))
+static Bool
+RegionBandsMatchAVX2(const BoxRec *a, const BoxRec *b, int n)
+{
+    for (; n >= 4; n -= 4, a += 4, b += 4) {
+        __m256i eq =
+            _mm256_cmpeq_epi16(_mm256_loadu_si256((const __m256i *) a),
+                               _mm256_loadu_si256((const __m256i *) b));
+
+        if ((_mm256_movemask_epi8(eq) & 0x33333333) != 0x33333333)
+            return FALSE;
+    }
+    return RegionBandsMatchSSE2(a, b, n);
+}
+
+__attribute__((target("avx2")))
+static void
+RegionBandSetY2AVX2(BoxPtr box, int n, short y2)
+{
+    const __m256i v = _mm256_set1_epi16(y2);
+
+    for (; n >= 4; n -= 4, box += 4) {
+        __m256i b = _mm256_loadu_si256((const __m256i *) box);
+
+        /* y2 is the fourth short of each box */
+        _mm256_storeu_si256((__m256i *) box, _mm256_blend_epi16(b, v, 0x88));
+    }
+    RegionBandSetY2SSE2(box, n, y2);
+}
+
+__attribute__((target("avx2")))
+static void
+RegionBoxesExtentsAVX2(const BoxRec *box, int n, BoxPtr extents)
+{
+    __m256i lo = _mm256_set1_epi16(MAXSHORT);
+    __m256i hi = _mm256_set1_epi16(MINSHORT);
+
+    for (; n >= 4; n -= 4, box += 4) {
+        __m256i b = _mm256_loadu_si256((const __m256i *) box);
+
+        lo = _mm256_min_epi16(lo, b);
+        hi = _mm256_max_epi16(hi, b);
+    }
+    RegionExtentsReduceSSE2(_mm_min_epi16(_mm256_castsi256_si128(lo),
+                                          _mm256_extracti128_si256(lo, 1)),
+                            _mm_max_epi16(_mm256_castsi256_si128(hi),
+                                          _mm256_extracti128_si256(hi, 1)),
+                            extents);
+    RegionBoxesExtentsSSE2(box, n, extents);
+}
+
+static const RegionBoxOpsRec regionBoxOpsAVX2 = {
+    RegionBandsMatchAVX2, RegionBandSetY2AVX2, RegionBoxesExtentsAVX2
+};
+#endif
+
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define REGION_SIMD_VECTOR 1
+
+/* the y1 and y2 lanes of two boxes */
+static const uint16_t regionNeonYMask[8] = {
+    0, 0xffff, 0, 0xffff, 0, 0xffff, 0, 0xffff
+};
+
+/* the y2 lanes of two boxes */
+static const uint16_t regionNeonY2Mask[8] = {
+    0, 0, 0, 0xffff, 0, 0, 0, 0xffff
+};
+
+static Bool
+RegionBandsMatchNEON(const BoxRec *a, const BoxRec *b, int n)
+{
+    const uint16x8_t ymask = vld1q_u16(regionNeonYMask);
+
+    for (; n >= 2; n -= 2, a += 2, b += 2) {
+        uint16x8_t eq = vceqq_s16(vld1q_s16((const int16_t *) a),
+                                  vld1q_s16((const int16_t *) b));
+
+        if (vminvq_u16(vorrq_u16(eq, ymask)) != 0xffff)
+            return FALSE;
+    }
+    return RegionBandsMatchC(a, b, n);
+}
+
+static void
+RegionBandSetY2NEON(BoxPtr box, int n, short y2)
+{
+    const uint16x8_t y2mask = vld1q_u16(regionNeonY2Mask);
+    const int16x8_t v = vdupq_n_s16(y2);
+
+    for (; n >= 2; n -= 2, box += 2)
+        vst1q_s16((int16_t *) box,
+                  vbslq_s16(y2mask, v, vld1q_s16((const int16_t *) box)));
+    RegionBandSetY2C(box, n, y2);
+}
+
+static void
+RegionBoxesExtentsNEON(const BoxRec *box, int n, BoxPtr extents)
+{
+    int16x8_t lo = vdupq_n_s16(MAXSHORT);
+    int16x8_t hi = vdupq_n_s16(MINSHORT);
+    short x1, x2;
+
+    for (; n >= 2; n -= 2, box += 2) {
+        int16x8_t b = vld1q_s16((const int16_t *) box);
+
+        lo = vminq_s16(lo, b);
+        hi = vmaxq_s16(hi, b);
+    }
+    x1 = min(vgetq_lane_s16(lo, 0), vgetq_lane_s16(lo, 4));
+    x2 = max(vgetq_lane_s16(hi, 2), vgetq_lane_s16(hi, 6));
+    if (x1 < extents->x1)
+        extents->x1 = x1;
+    if (x2 > extents->x2)
+        extents->x2 = x2;
+    RegionBoxesExtentsC(box, n, extents);
+}
+
+static const RegionBoxOpsRec regionBoxOpsVector = {
+    RegionBandsMatchNEON, RegionBandSetY2NEON, RegionBoxesExtentsNEON
+};
+#endif
+
+static const RegionBoxOpsRec *regionBoxOps = &regionBoxOpsC;
+
+/*
+ * Select the box kernels: 0 for plain C, 1 for SSE2 or NEON, 2 for AVX2.
+ * A negative level or one this machine can't run picks the best that it
+ * can.  Returns the level in use.
+ */
+int
+RegionSetSimdLevel(int level)
+{
+    int best = 0;
+
+#ifdef REGION_SIMD_VECTOR
+    best = REGION_SIMD_VECTOR;
+#endif
+#ifdef REGION_SIMD_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        best = REGION_SIMD_AVX2;
+#endif
+    if (level < 0 || level > best)
+        level = best;
+
+    switch (level) {
+#ifdef REGION_SIMD_AVX2
+    case REGION_SIMD_AVX2:
+        regionBoxOps = &regionBoxOpsAVX2;
+        break;
+#endif
+#ifdef REGION_SIMD_VECTOR
+    case REGION_SIMD_VECTOR:
+        regionBoxOps = &regionBoxOpsVector;
+        break;
+#endif
+    default:
+        regionBoxOps = &regionBoxOpsC;
+        break;
+    }
+    return level;
+}
+
 BoxRec RegionEmptyBox = { 0, 0, 0, 0 };
 RegDataRec RegionEmptyData = { 0, 0 };
 
@@ -225,6 +539,101 @@ InitRegions(void)
 {
     pixman_region_set_static_pointers(&RegionEmptyBox, &RegionEmptyData,
                                       &RegionBrokenData);
+    RegionSetSimdLevel(-1);
+}
+
+/*
+ * Region data pool.
+ *
+ * Region data is malloc()ed memory that pixman also frees and reallocs
+ * behind our back, so the pool can only ever hold malloc blocks: data the
+ * server releases goes onto a free list by size class instead of back to
+ * free(), and RegionDataAlloc takes from there first.  Classes are powers
+ * of two boxes and the data records the full class size, so later growth
+ * (ours or pixman's) often fits without a realloc.  Blocks freed by pixman
+ * simply never come back, and blocks bigger than the largest class are
+ * freed rather than pooled.
+ *
+ * The pool belongs to the main thread; dispatch threads bump
+ * RegionPoolThreads around their requests so that, meanwhile, everybody
+ * goes straight to malloc.
+ */
+
+#define REGION_POOL_MIN_SHIFT 3         /* smallest class is 8 boxes */
+#define REGION_POOL_CLASSES 8           /* largest is 1024 */
+#define REGION_POOL_DEPTH 64            /* blocks kept per class */
+#define REGION_POOL_MAX_BOXES \
+    (1 << (REGION_POOL_CLASSES - 1 + REGION_POOL_MIN_SHIFT))
+
+/* The next block in a free list is kept in place of the first box */
+#define RegionPoolNext(data) (*(RegDataPtr *) ((data) + 1))
+
+static RegDataPtr regionPool[REGION_POOL_CLASSES];
+static int regionPoolDepth[REGION_POOL_CLASSES];
+
+RegionPoolStatsRec RegionPoolStats;
+volatile int RegionPoolThreads;
+
+RegDataPtr
+RegionDataAlloc(int n)
+{
+    RegDataPtr data;
+    size_t rgnSize;
+    int c;
+
+    for (c = 0; c < REGION_POOL_CLASSES; c++)
+        if (n <= 1 << (c + REGION_POOL_MIN_SHIFT))
+            break;
+    if (c < REGION_POOL_CLASSES)
+        n = 1 << (c + REGION_POOL_MIN_SHIFT);
+
+    if (!RegionPoolThreads) {
+        RegionPoolStats.allocs++;
+        if (c < REGION_POOL_CLASSES && regionPool[c]) {
+            data = regionPool[c];
+            regionPool[c] = RegionPoolNext(data);
+            regionPoolDepth[c]--;
+            RegionPoolStats.hits++;
+            data->size = n;
+            return data;
+        }
+    }
+
+    rgnSize = RegionSizeof(n);
+    data = (rgnSize > 0) ? malloc(rgnSize) : NULL;
+    if (data)
+        data->size = n;
+    return data;
+}
+
+void
+RegionDataFree(RegDataPtr data)
+{
+    int c;
+
+    if (!data || !data->size)
+        return;
+
+    if (!RegionPoolThreads) {
+        RegionPoolStats.frees++;
+        /* don't let big regions pin memory in the largest class */
+        if (data->size > REGION_POOL_MAX_BOXES) {
+            free(data);
+            return;
+        }
+        /* the largest class that fits in the block */
+        for (c = REGION_POOL_CLASSES; --c >= 0;)
+            if (data->size >= 1 << (c + REGION_POOL_MIN_SHIFT))
+                break;
+        if (c >= 0 && regionPoolDepth[c] < REGION_POOL_DEPTH) {
+            RegionPoolNext(data) = regionPool[c];
+            regionPool[c] = data;
+            regionPoolDepth[c]++;
+            RegionPoolStats.pooled++;
+            return;
+        }
+    }
+    free(data);
 }
 
 /*****************************************************************
@@ -250,7 +659,7 @@ RegionCreate(BoxPtr rect, int size)
 void
 RegionDestroy(RegionPtr pReg)
 {
-    pixman_region_fini(pReg);
+    RegionUninit(pReg);
     if (pReg != &RegionBrokenRegion)
         free(pReg);
 }
@@ -348,17 +757,14 @@ RegionRectAlloc(RegionPtr pRgn, int n)
     size_t rgnSize;
 
     if (!pRgn->data) {
-        n++;
-        rgnSize = RegionSizeof(n);
-        pRgn->data = (rgnSize > 0) ? malloc(rgnSize) : NULL;
+        pRgn->data = RegionDataAlloc(n + 1);
         if (!pRgn->data)
             return RegionBreak(pRgn);
         pRgn->data->numRects = 1;
         *RegionBoxptr(pRgn) = pRgn->extents;
     }
     else if (!pRgn->data->size) {
-        rgnSize = RegionSizeof(n);
-        pRgn->data = (rgnSize > 0) ? malloc(rgnSize) : NULL;
+        pRgn->data = RegionDataAlloc(n);
         if (!pRgn->data)
             return RegionBreak(pRgn);
         pRgn->data->numRects = 0;
@@ -370,13 +776,25 @@ RegionRectAlloc(RegionPtr pRgn, int n)
                 n = 250;
         }
         n += pRgn->data->numRects;
-        rgnSize = RegionSizeof(n);
-        data = (rgnSize > 0) ? realloc(pRgn->data, rgnSize) : NULL;
-        if (!data)
-            return RegionBreak(pRgn);
+        if (n <= 1 << (REGION_POOL_CLASSES + REGION_POOL_MIN_SHIFT - 1)) {
+            /* move to the next size class */
+            data = RegionDataAlloc(n);
+            if (!data)
+                return RegionBreak(pRgn);
+            memcpy(data + 1, pRgn->data + 1,
+                   pRgn->data->numRects * sizeof(BoxRec));
+            data->numRects = pRgn->data->numRects;
+            RegionDataFree(pRgn->data);
+        }
+        else {
+            rgnSize = RegionSizeof(n);
+            data = (rgnSize > 0) ? realloc(pRgn->data, rgnSize) : NULL;
+            if (!data)
+                return RegionBreak(pRgn);
+            data->size = n;
+        }
         pRgn->data = data;
     }
-    pRgn->data->size = n;
     return TRUE;
 }
 
@@ -407,8 +825,8 @@ RegionCoalesce(RegionPtr pReg,  /* Region to coalesce                */
                int prevStart,   /* Index of start of previous band   */
                int curStart)
 {                               /* Index of start of current band    */
-    BoxPtr pPrevBox;            /* Current box in previous band      */
-    BoxPtr pCurBox;             /* Current box in current band       */
+    BoxPtr pPrevBox;            /* First box in previous band        */
+    BoxPtr pCurBox;             /* First box in current band         */
     int numRects;               /* Number rectangles in both bands   */
     int y2;                     /* Bottom of current band            */
 
@@ -438,26 +856,22 @@ RegionCoalesce(RegionPtr pReg,  /* Region to coalesce                */
      */
     y2 = pCurBox->y2;
 
-    do {
-        if ((pPrevBox->x1 != pCurBox->x1) || (pPrevBox->x2 != pCurBox->x2)) {
+    if (numRects < REGION_SIMD_MIN) {
+        if (!RegionBandsMatchC(pPrevBox, pCurBox, numRects))
             return curStart;
-        }
-        pPrevBox++;
-        pCurBox++;
-        numRects--;
-    } while (numRects);
+    }
+    else if (!regionBoxOps->bandsMatch(pPrevBox, pCurBox, numRects))
+        return curStart;
 
     /*
      * The bands may be merged, so set the bottom y of each box
      * in the previous band to the bottom y of the current band.
      */
-    numRects = curStart - prevStart;
     pReg->data->numRects -= numRects;
-    do {
-        pPrevBox--;
-        pPrevBox->y2 = y2;
-        numRects--;
-    } while (numRects);
+    if (numRects < REGION_SIMD_MIN)
+        RegionBandSetY2C(pPrevBox, numRects, y2);
+    else
+        regionBoxOps->setY2(pPrevBox, numRects, y2);
     return prevStart;
 }
 
@@ -768,7 +1182,7 @@ RegionOp(RegionPtr newReg,      /* Place to store result         */
         AppendRegions(newReg, r2BandEnd, r2End);
     }
 
-    free(oldData);
+    RegionDataFree(oldData);
 
     if (!(numRects = newReg->data->numRects)) {
         xfreeData(newReg);
@@ -830,13 +1244,7 @@ RegionSetExtents(RegionPtr pReg)
     pReg->extents.y2 = pBoxEnd->y2;
 
     assert(pReg->extents.y1 < pReg->extents.y2);
-    while (pBox <= pBoxEnd) {
-        if (pBox->x1 < pReg->extents.x1)
-            pReg->extents.x1 = pBox->x1;
-        if (pBox->x2 > pReg->extents.x2)
-            pReg->extents.x2 = pBox->x2;
-        pBox++;
-    };
+    regionBoxOps->extents(pBox, pBoxEnd - pBox + 1, &pReg->extents);
 
     assert(pReg->extents.x1 < pReg->extents.x2);
 }
@@ -1316,7 +1724,6 @@ RegionFromRects(int nrects, xRectangle *prect, int ctype)
 {
 
     RegionPtr pRgn;
-    size_t rgnSize;
     RegDataPtr pData;
     BoxPtr pBox;
     int i;
@@ -1343,8 +1750,7 @@ RegionFromRects(int nrects, xRectangle *prect, int ctype)
         }
         return pRgn;
     }
-    rgnSize = RegionSizeof(nrects);
-    pData = (rgnSize > 0) ? malloc(rgnSize) : NULL;
+    pData = RegionDataAlloc(nrects);
     if (!pData) {
         RegionBreak(pRgn);
         return pRgn;
@@ -1366,7 +1772,6 @@ RegionFromRects(int nrects, xRectangle *prect, int ctype)
         }
     }
     if (pBox != (BoxPtr) (pData + 1)) {
-        pData->size = nrects;
         pData->numRects = pBox - (BoxPtr) (pData + 1);
         pRgn->data = pData;
         if (ctype != CT_YXBANDED) {
@@ -1380,7 +1785,7 @@ RegionFromRects(int nrects, xRectangle *prect, int ctype)
         good(pRgn);
     }
     else {
-        free(pData);
+        RegionDataFree(pData);
     }
     return pRgn;
 }
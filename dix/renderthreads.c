@@ -0,0 +1,208 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Render threads.
+ *
+ * With -renderthreads N, a single large software rendering operation can
+ * be split into horizontal bands that N worker threads and the calling
+ * thread work through together; fb does this for big composites and
+ * copies.  RenderThreadsRun() returns once every band is done, so to the
+ * rest of the server the operation still happens in one go, on the thread
+ * that asked for it.
+ *
+ * The caller is responsible for the bands being independent -- each one
+ * writing its own rows and reading nothing another band writes -- which
+ * makes the result the same however many threads there are and in
+ * whatever order the bands run.  Band procedures must not touch server
+ * state: no allocation from the region pool, no resources, no output.
+ *
+ * There is one set of bands in flight at a time.  Should a second thread
+ * (a dispatch thread, say) want the pool while it is busy, it runs its
+ * bands itself rather than wait.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include "misc.h"
+#include "os.h"
+#include "dixstruct.h"
+
+int RenderThreadCount;
+
+#if INPUTTHREAD
+
+#include <pthread.h>
+#include <signal.h>
+
+#define MAX_RENDER_THREADS 64
+
+static pthread_mutex_t runLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t bandLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t bandQueued = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t bandDone = PTHREAD_COND_INITIALIZER;
+static pthread_t threads[MAX_RENDER_THREADS];
+static int numThreads;
+
+/* The bands in flight, all protected by bandLock */
+static RenderBandProcPtr bandProc;
+static void *bandClosure;
+static int numBands, nextBand, doneBands;
+
+/* Run bands until there are none left to start; called with bandLock */
+static void
+RenderThreadWork(void)
+{
+    while (nextBand < numBands) {
+        RenderBandProcPtr proc = bandProc;
+        void *closure = bandClosure;
+        int band = nextBand++, nbands = numBands;
+
+        pthread_mutex_unlock(&bandLock);
+        (*proc) (closure, band, nbands);
+        pthread_mutex_lock(&bandLock);
+
+        if (++doneBands == numBands)
+            pthread_cond_signal(&bandDone);
+    }
+}
+
+static void *
+RenderThreadMain(void *arg)
+{
+    sigset_t set;
+
+    /* Signals are handled by the main thread */
+    sigfillset(&set);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+#if defined(HAVE_PTHREAD_SETNAME_NP_WITH_TID)
+    pthread_setname_np(pthread_self(), "RenderThread");
+#elif defined(HAVE_PTHREAD_SETNAME_NP_WITHOUT_TID)
+    pthread_setname_np("RenderThread");
+#endif
+
+    pthread_mutex_lock(&bandLock);
+    for (;;) {
+        while (nextBand >= numBands)
+            pthread_cond_wait(&bandQueued, &bandLock);
+        RenderThreadWork();
+    }
+
+    return NULL;
+}
+
+/*
+ * How many threads, the caller's included, would share an operation
+ * split into bands; 1 if there is no pool.
+ */
+int
+RenderThreadsAvailable(void)
+{
+    return numThreads + 1;
+}
+
+/*
+ * Call proc(closure, band, nbands) for every band from 0 to nbands - 1,
+ * spread over the pool and the calling thread, and return when all of
+ * them have finished.
+ */
+void
+RenderThreadsRun(int nbands, RenderBandProcPtr proc, void *closure)
+{
+    int band;
+
+    if (nbands <= 1 || !numThreads || pthread_mutex_trylock(&runLock) != 0) {
+        for (band = 0; band < nbands; band++)
+            (*proc) (closure, band, nbands);
+        return;
+    }
+
+    pthread_mutex_lock(&bandLock);
+    bandProc = proc;
+    bandClosure = closure;
+    numBands = nbands;
+    nextBand = doneBands = 0;
+    pthread_cond_broadcast(&bandQueued);
+
+    RenderThreadWork();
+    while (doneBands < numBands)
+        pthread_cond_wait(&bandDone, &bandLock);
+
+    numBands = nextBand = 0;
+    bandProc = NULL;
+    bandClosure = NULL;
+    pthread_mutex_unlock(&bandLock);
+    pthread_mutex_unlock(&runLock);
+}
+
+void
+RenderThreadsInit(void)
+{
+    pthread_attr_t attr;
+
+    if (RenderThreadCount <= 0 || numThreads)
+        return;
+
+    if (RenderThreadCount > MAX_RENDER_THREADS)
+        RenderThreadCount = MAX_RENDER_THREADS;
+
+    pthread_attr_init(&attr);
+    for (numThreads = 0; numThreads < RenderThreadCount; numThreads++)
+        if (pthread_create(&threads[numThreads], &attr,
+                           RenderThreadMain, NULL) != 0)
+            break;
+    pthread_attr_destroy(&attr);
+
+    if (!numThreads)
+        ErrorF("render-threads: could not create threads, disabled\n");
+    else
+        LogMessageVerb(X_INFO, 1, "render-threads: %d threads\n", numThreads);
+}
+
+#else /* INPUTTHREAD */
+
+void
+RenderThreadsInit(void)
+{
+    if (RenderThreadCount > 0)
+        ErrorF("render-threads: not supported in this build\n");
+    RenderThreadCount = 0;
+}
+
+int
+RenderThreadsAvailable(void)
+{
+    return 1;
+}
+
+void
+RenderThreadsRun(int nbands, RenderBandProcPtr proc, void *closure)
+{
+    int band;
+
+    for (band = 0; band < nbands; band++)
+        (*proc) (closure, band, nbands);
+}
+
+#endif /* INPUTTHREAD */
@@ -0,0 +1,249 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Request statistics.
+ *
+ * When enabled with -reqstats, Dispatch() times every request and
+ * accumulates per-opcode counters with a log2 latency histogram, plus
+ * per-client totals.  Server reset, and every -reqstatsinterval seconds
+ * if given, writes the current numbers to the log.  With the option off
+ * the cost is one test of RequestStatsEnable on either side of the
+ * request handler.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include "misc.h"
+#include "os.h"
+#include "opaque.h"
+#include "dixstruct.h"
+#include "extnsionst.h"
+#include "client.h"
+#include "registry.h"
+#include "regionstr.h"
+
+/* Bucket 0 is < 1us, bucket n is [2^(n+9), 2^(n+10)) ns, the last
+ * bucket holds everything from ~1s up */
+#define REQSTATS_BUCKETS 22
+#define REQSTATS_SHIFT 10
+
+typedef struct _RequestStats {
+    CARD64 count;
+    CARD64 time;                /* ns */
+    CARD64 max;                 /* ns */
+    CARD32 hist[REQSTATS_BUCKETS];
+} RequestStatsRec, *RequestStatsPtr;
+
+Bool RequestStatsEnable = FALSE;
+int RequestStatsInterval = 0;   /* seconds */
+
+static RequestStatsRec coreStats[EXTENSION_BASE];
+/* per extension major, indexed by minor opcode; allocated on first use */
+static RequestStatsPtr extStats[MAXEXTENSIONS];
+static RequestStatsRec clientStats[MAXCLIENTS];
+static CARD64 statsStart;
+
+static CARD32
+RequestStatsTimer(OsTimerPtr timer, CARD32 now, void *arg)
+{
+    RequestStatsDump();
+    return RequestStatsInterval * 1000;
+}
+
+static void
+RequestStatsClientState(CallbackListPtr *pcbl, void *unused, void *data)
+{
+    NewClientInfoRec *clientinfo = (NewClientInfoRec *) data;
+    ClientPtr client = clientinfo->client;
+
+    if (client->clientState == ClientStateInitial)
+        memset(&clientStats[client->index], 0, sizeof(RequestStatsRec));
+}
+
+static void
+RequestStatsReset(void)
+{
+    int i;
+
+    memset(coreStats, 0, sizeof(coreStats));
+    memset(clientStats, 0, sizeof(clientStats));
+    for (i = 0; i < MAXEXTENSIONS; i++) {
+        free(extStats[i]);
+        extStats[i] = NULL;
+    }
+    statsStart = GetTimeInNanos();
+}
+
+void
+RequestStatsInit(void)
+{
+    if (!RequestStatsEnable)
+        return;
+
+    RequestStatsReset();
+    AddCallback(&ClientStateCallback, RequestStatsClientState, NULL);
+    /* OsInit() has freed any timer from the last generation */
+    if (RequestStatsInterval > 0)
+        TimerSet(NULL, 0, RequestStatsInterval * 1000,
+                 RequestStatsTimer, NULL);
+}
+
+static inline void
+RequestStatsAdd(RequestStatsPtr stats, CARD64 elapsed, int bucket)
+{
+    stats->count++;
+    stats->time += elapsed;
+    if (elapsed > stats->max)
+        stats->max = elapsed;
+    stats->hist[bucket]++;
+}
+
+void
+RequestStatsRecord(ClientPtr client, CARD64 elapsed)
+{
+    RequestStatsPtr stats;
+    CARD64 v = elapsed >> REQSTATS_SHIFT;
+    int bucket = 0;
+
+    while (v && bucket < REQSTATS_BUCKETS - 1) {
+        v >>= 1;
+        bucket++;
+    }
+
+    if (client->majorOp < EXTENSION_BASE)
+        stats = &coreStats[client->majorOp];
+    else {
+        RequestStatsPtr *ext = &extStats[client->majorOp - EXTENSION_BASE];
+
+        if (!*ext) {
+            *ext = calloc(256, sizeof(RequestStatsRec));
+            if (!*ext)
+                return;
+        }
+        stats = &(*ext)[client->minorOp & 0xff];
+    }
+
+    RequestStatsAdd(stats, elapsed, bucket);
+    RequestStatsAdd(&clientStats[client->index], elapsed, bucket);
+}
+
+static const char *
+RequestStatsName(int major, int minor, char *buf, size_t len)
+{
+#ifdef X_REGISTRY_REQUEST
+    if (major < EXTENSION_BASE)
+        return LookupMajorName(major);
+    return LookupRequestName(major, minor);
+#else
+    if (major < EXTENSION_BASE)
+        snprintf(buf, len, "%d", major);
+    else
+        snprintf(buf, len, "%d:%d", major, minor);
+    return buf;
+#endif
+}
+
+static void
+RequestStatsPrint(const char *name, RequestStatsPtr stats)
+{
+    char hist[REQSTATS_BUCKETS * 16];
+    int i, len = 0;
+
+    hist[0] = '\0';
+    for (i = 0; i < REQSTATS_BUCKETS; i++) {
+        if (!stats->hist[i])
+            continue;
+        len += snprintf(hist + len, sizeof(hist) - len, " %d:%u",
+                        i, (unsigned) stats->hist[i]);
+        if (len >= sizeof(hist))
+            break;
+    }
+
+    LogMessageVerb(X_INFO, 0, "reqstats: %-40s %10llu avg %8llu ns "
+                   "max %10llu ns hist%s\n", name,
+                   (unsigned long long) stats->count,
+                   (unsigned long long) (stats->time / stats->count),
+                   (unsigned long long) stats->max, hist);
+}
+
+void
+RequestStatsDump(void)
+{
+    RequestStatsRec total = { 0 };
+    char name[64];
+    CARD64 elapsed;
+    int major, minor, i;
+
+    if (!RequestStatsEnable)
+        return;
+
+    LogMessageVerb(X_INFO, 0, "reqstats: histogram bucket 0 is < 1us, "
+                   "bucket n is [2^(n-1), 2^n) us\n");
+
+    for (major = 0; major < EXTENSION_BASE; major++) {
+        if (!coreStats[major].count)
+            continue;
+        RequestStatsPrint(RequestStatsName(major, 0, name, sizeof(name)),
+                          &coreStats[major]);
+        total.count += coreStats[major].count;
+        total.time += coreStats[major].time;
+    }
+
+    for (i = 0; i < MAXEXTENSIONS; i++) {
+        if (!extStats[i])
+            continue;
+        major = i + EXTENSION_BASE;
+        for (minor = 0; minor < 256; minor++) {
+            if (!extStats[i][minor].count)
+                continue;
+            RequestStatsPrint(RequestStatsName(major, minor,
+                                               name, sizeof(name)),
+                              &extStats[i][minor]);
+            total.count += extStats[i][minor].count;
+            total.time += extStats[i][minor].time;
+        }
+    }
+
+    for (i = 0; i < currentMaxClients; i++) {
+        if (!clients[i] || !clientStats[i].count)
+            continue;
+        snprintf(name, sizeof(name), "client %d (pid %ld)", i,
+                 (long) GetClientPid(clients[i]));
+        RequestStatsPrint(name, &clientStats[i]);
+    }
+
+    elapsed = GetTimeInNanos() - statsStart;
+    LogMessageVerb(X_INFO, 0, "reqstats: %llu requests in %llu ms, "
+                   "%llu req/s, %llu%% of the time in request handlers\n",
+                   (unsigned long long) total.count,
+                   (unsigned long long) (elapsed / 1000000),
+                   elapsed ? (unsigned long long) (total.count * 1000000000ULL
+                                                   / elapsed) : 0,
+                   elapsed ? (unsigned long long) (total.time * 100 / elapsed)
+                           : 0);
+    LogMessageVerb(X_INFO, 0, "reqstats: region data: %lu allocations, "
+                   "%lu from the pool; %lu frees, %lu kept in the pool\n",
+                   RegionPoolStats.allocs, RegionPoolStats.hits,
+                   RegionPoolStats.frees, RegionPoolStats.pooled);
+}
@@ -105,8 +105,8 @@ Equipment Corporation.
  *      A resource ID is a 32 bit quantity, the upper 2 bits of which are
  *	off-limits for client-visible resources.  The next 8 bits are
  *      used as client ID, and the low 22 bits come from the client.
- *	A resource ID is "hashed" by extracting and xoring subfields
- *      (varying with the size of the hash table).
+ *	A resource ID is hashed multiplicatively into the owning client's
+ *      open-addressed resource table (see ResourceSlotRec below).
  *
  *      It is sometimes necessary for the server to create an ID that looks
  *      like it belongs to a client.  This ID, however,  must not be one
@@ -156,24 +156,59 @@ static void RebuildTable(int    /*client */
 
 #define INITBUCKETS 64
 #define INITHASHSIZE 6
-#define MAXHASHSIZE 16
+
+/* Slots of a retired table moved to the current one per AddResource */
+#define MIGRATESLOTS 8
 
 typedef struct _Resource {
-    struct _Resource *next;
+    struct _Resource *next;     /* next resource with the same id */
     XID id;
     RESTYPE type;
     void *value;
 } ResourceRec, *ResourcePtr;
 
-typedef struct _ClientResource {
-    ResourcePtr *resources;
-    int elements;
+/*
+ * Resources are kept in an open-addressed, linearly probed table of
+ * slots keyed by resource ID.  The ID is stored in the slot itself so a
+ * probe only touches the ResourceRec once the ID matches; the slot then
+ * heads the list of all resources sharing that ID, most recent first.
+ * Removing the last resource of an ID leaves a tombstone so that other
+ * probe sequences stay intact; tombstones are dropped on the next
+ * rebuild.
+ *
+ * Growing the table does not rehash everything at once: the previous
+ * table is kept around as "old" and drained a few slots at a time by
+ * subsequent AddResource calls, so no single request pays for moving
+ * tens of thousands of resources.  Lookups check the current table
+ * first and fall back to the old one until it is empty.
+ */
+typedef struct _ResourceSlot {
+    XID id;
+    ResourcePtr res;            /* NULL if empty, or ResourceDeleted */
+} ResourceSlotRec, *ResourceSlotPtr;
+
+typedef struct _ResourceTable {
+    ResourceSlotPtr slots;
     int buckets;
     int hashsize;               /* log(2)(buckets) */
+    int ids;                    /* slots holding a live ID */
+    int used;                   /* live IDs plus tombstones */
+} ResourceTableRec, *ResourceTablePtr;
+
+typedef struct _ClientResource {
+    ResourceTableRec table;
+    ResourceTableRec old;       /* being migrated into table, if slots */
+    int migrated;               /* slots of old already migrated */
+    int elements;
+    unsigned int generation;    /* bumped whenever a slot array goes away */
     XID fakeID;
     XID endFakeID;
 } ClientResourceRec;
 
+static ResourceRec deletedResource;
+
+#define ResourceDeleted (&deletedResource)
+
 RESTYPE lastResourceType;
 static RESTYPE lastResourceClass;
 RESTYPE TypeMask;
@@ -632,7 +667,7 @@ ResourceClientBits(void)
 Bool
 InitClientResources(ClientPtr client)
 {
-    int i, j;
+    ClientResourceRec *rrec;
 
     if (client == serverClient) {
         lastResourceType = RT_LASTPREDEF;
@@ -644,24 +679,25 @@ InitClientResources(ClientPtr client)
             return FALSE;
         memcpy(resourceTypes, predefTypes, sizeof(predefTypes));
     }
-    clientTable[i = client->index].resources =
-        malloc(INITBUCKETS * sizeof(ResourcePtr));
-    if (!clientTable[i].resources)
+    rrec = &clientTable[client->index];
+    rrec->table.slots = calloc(INITBUCKETS, sizeof(ResourceSlotRec));
+    if (!rrec->table.slots)
         return FALSE;
-    clientTable[i].buckets = INITBUCKETS;
-    clientTable[i].elements = 0;
-    clientTable[i].hashsize = INITHASHSIZE;
+    rrec->table.buckets = INITBUCKETS;
+    rrec->table.hashsize = INITHASHSIZE;
+    rrec->table.ids = 0;
+    rrec->table.used = 0;
+    memset(&rrec->old, 0, sizeof(rrec->old));
+    rrec->migrated = 0;
+    rrec->elements = 0;
     /* Many IDs allocated from the server client are visible to clients,
      * so we don't use the SERVER_BIT for them, but we have to start
      * past the magic value constants used in the protocol.  For normal
      * clients, we can start from zero, with SERVER_BIT set.
      */
-    clientTable[i].fakeID = client->clientAsMask |
+    rrec->fakeID = client->clientAsMask |
         (client->index ? SERVER_BIT : SERVER_MINID);
-    clientTable[i].endFakeID = (clientTable[i].fakeID | RESOURCE_ID_MASK) + 1;
-    for (j = 0; j < INITBUCKETS; j++) {
-        clientTable[i].resources[j] = NULL;
-    }
+    rrec->endFakeID = (rrec->fakeID | RESOURCE_ID_MASK) + 1;
     return TRUE;
 }
 
@@ -678,18 +714,173 @@ HashResourceID(XID id, int numBits)
     return (id ^ (id >> numBits)) & ~((~0) << numBits);
 }
 
+/*
+ * Slot hash for the per-client tables.  Unlike HashResourceID this keeps
+ * SERVER_BIT, so the server's fake IDs for a client don't pile up on the
+ * same slots as the client's own, equally sequential, IDs.
+ */
+static inline int
+HashResourceSlot(XID id, int numBits)
+{
+    return (CARD32) ((CARD32) id * 0x9e3779b1U) >> (32 - numBits);
+}
+
+static inline Bool
+ResourceTableFull(ResourceTablePtr table)
+{
+    return (table->used + 1) * 4 > table->buckets * 3;
+}
+
+static inline ResourceSlotPtr
+LookupResourceSlot(ResourceTablePtr table, XID id)
+{
+    int mask = table->buckets - 1;
+    int i = HashResourceSlot(id, table->hashsize);
+    ResourceSlotPtr slot;
+
+    for (;;) {
+        slot = &table->slots[i];
+        if (!slot->res)
+            return NULL;
+        if (slot->id == id && slot->res != ResourceDeleted)
+            return slot;
+        i = (i + 1) & mask;
+    }
+}
+
+/*
+ * Find the slot holding id, if any.  If ptable is non-NULL it is set to
+ * the table that owns the slot.
+ */
+static inline ResourceSlotPtr
+FindResourceSlot(ClientResourceRec *rrec, XID id, ResourceTablePtr *ptable)
+{
+    ResourceSlotPtr slot;
+
+    slot = LookupResourceSlot(&rrec->table, id);
+    if (slot) {
+        if (ptable)
+            *ptable = &rrec->table;
+        return slot;
+    }
+    if (rrec->old.slots) {
+        slot = LookupResourceSlot(&rrec->old, id);
+        if (slot && ptable)
+            *ptable = &rrec->old;
+    }
+    return slot;
+}
+
+/*
+ * Claim a slot for id, which must not already be in the table, and make
+ * it head res.  Tombstones are reused.  Returns NULL if doing so would
+ * leave the table without an empty slot to terminate probes.
+ */
+static ResourceSlotPtr
+InsertResourceSlot(ResourceTablePtr table, XID id, ResourcePtr res)
+{
+    int mask = table->buckets - 1;
+    int i = HashResourceSlot(id, table->hashsize);
+    ResourceSlotPtr slot;
+
+    for (;;) {
+        slot = &table->slots[i];
+        if (slot->res == ResourceDeleted)
+            break;
+        if (!slot->res) {
+            if (table->used + 1 >= table->buckets)
+                return NULL;
+            table->used++;
+            break;
+        }
+        i = (i + 1) & mask;
+    }
+    slot->id = id;
+    slot->res = res;
+    table->ids++;
+    return slot;
+}
+
+/*
+ * Unlink *prev, which is a resource listed from slot, from the table.
+ */
+static void
+RemoveResource(ClientResourceRec *rrec, ResourceTablePtr table,
+               ResourceSlotPtr slot, ResourcePtr *prev)
+{
+    *prev = (*prev)->next;
+    if (!slot->res) {
+        slot->res = ResourceDeleted;
+        table->ids--;
+    }
+    rrec->elements--;
+}
+
+/*
+ * Move up to count slots from the retired table into the current one,
+ * freeing the retired table once it has been drained.
+ */
+static void
+MigrateResources(ClientResourceRec *rrec, int count)
+{
+    ResourceSlotPtr slot;
+
+    while (rrec->old.slots && count-- > 0) {
+        slot = &rrec->old.slots[rrec->migrated++];
+        if (slot->res && slot->res != ResourceDeleted) {
+            /* Cannot fail, the current table is at least as large */
+            InsertResourceSlot(&rrec->table, slot->id, slot->res);
+            slot->res = ResourceDeleted;
+            rrec->old.ids--;
+        }
+        if (rrec->migrated == rrec->old.buckets) {
+            free(rrec->old.slots);
+            memset(&rrec->old, 0, sizeof(rrec->old));
+            rrec->migrated = 0;
+            rrec->generation++;
+        }
+    }
+}
+
+/*
+ * Walk the live slots of a client, those of the retired table first.
+ * *pos is a cursor over both tables; start with 0 and advance it past
+ * the returned slot to continue.  Code which may add or free resources
+ * while walking must restart from 0 if rrec->generation changes.
+ */
+static ResourceSlotPtr
+NextResourceSlot(ClientResourceRec *rrec, int *pos)
+{
+    ResourceSlotPtr slot;
+    int i;
+
+    for (i = *pos; i < rrec->old.buckets + rrec->table.buckets; i++) {
+        if (i < rrec->old.buckets)
+            slot = &rrec->old.slots[i];
+        else
+            slot = &rrec->table.slots[i - rrec->old.buckets];
+        if (slot->res && slot->res != ResourceDeleted) {
+            *pos = i;
+            return slot;
+        }
+    }
+    *pos = i;
+    return NULL;
+}
+
+static inline ResourceTablePtr
+ResourceSlotTable(ClientResourceRec *rrec, int pos)
+{
+    return pos < rrec->old.buckets ? &rrec->old : &rrec->table;
+}
+
 static XID
 AvailableID(int client, XID id, XID maxid, XID goodid)
 {
-    ResourcePtr res;
-
     if ((goodid >= id) && (goodid <= maxid))
         return goodid;
     for (; id <= maxid; id++) {
-        res = clientTable[client].resources[HashResourceID(id, clientTable[client].hashsize)];
-        while (res && (res->id != id))
-            res = res->next;
-        if (!res)
+        if (!FindResourceSlot(&clientTable[client], id, NULL))
             return id;
     }
     return 0;
@@ -699,8 +890,8 @@ void
 GetXIDRange(int client, Bool server, XID *minp, XID *maxp)
 {
     XID id, maxid;
-    ResourcePtr *resp;
-    ResourcePtr res;
+    ResourceSlotPtr slot;
+    XID rid;
     int i;
     XID goodid;
 
@@ -709,18 +900,16 @@ GetXIDRange(int client, Bool server, XID *minp, XID *maxp)
         id |= client ? SERVER_BIT : SERVER_MINID;
     maxid = id | RESOURCE_ID_MASK;
     goodid = 0;
-    for (resp = clientTable[client].resources, i = clientTable[client].buckets;
-         --i >= 0;) {
-        for (res = *resp++; res; res = res->next) {
-            if ((res->id < id) || (res->id > maxid))
-                continue;
-            if (((res->id - id) >= (maxid - res->id)) ?
-                (goodid = AvailableID(client, id, res->id - 1, goodid)) :
-                !(goodid = AvailableID(client, res->id + 1, maxid, goodid)))
-                maxid = res->id - 1;
-            else
-                id = res->id + 1;
-        }
+    for (i = 0; (slot = NextResourceSlot(&clientTable[client], &i)); i++) {
+        rid = slot->id;
+        if ((rid < id) || (rid > maxid))
+            continue;
+        if (((rid - id) >= (maxid - rid)) ?
+            (goodid = AvailableID(client, id, rid - 1, goodid)) :
+            !(goodid = AvailableID(client, rid + 1, maxid, goodid)))
+            maxid = rid - 1;
+        else
+            id = rid + 1;
     }
     if (id > maxid)
         id = maxid = 0;
@@ -798,77 +987,78 @@ AddResource(XID id, RESTYPE type, void *value)
 {
     int client;
     ClientResourceRec *rrec;
-    ResourcePtr res, *head;
+    ResourceSlotPtr slot;
+    ResourcePtr res;
 
 #ifdef XSERVER_DTRACE
     XSERVER_RESOURCE_ALLOC(id, type, value, TypeNameString(type));
 #endif
     client = CLIENT_ID(id);
+    DispatchThreadBarrier(client);
     rrec = &clientTable[client];
-    if (!rrec->buckets) {
+    if (!rrec->table.buckets) {
         ErrorF("[dix] AddResource(%lx, %x, %lx), client=%d \n",
                (unsigned long) id, type, (unsigned long) value, client);
         FatalError("client not in use\n");
     }
-    if ((rrec->elements >= 4 * rrec->buckets) && (rrec->hashsize < MAXHASHSIZE))
+    if (ResourceTableFull(&rrec->table))
         RebuildTable(client);
-    head = &rrec->resources[HashResourceID(id, clientTable[client].hashsize)];
+    MigrateResources(rrec, MIGRATESLOTS);
     res = malloc(sizeof(ResourceRec));
     if (!res) {
         (*resourceTypes[type & TypeMask].deleteFunc) (value, id);
         return FALSE;
     }
-    res->next = *head;
     res->id = id;
     res->type = type;
     res->value = value;
-    *head = res;
+    slot = FindResourceSlot(rrec, id, NULL);
+    if (slot) {
+        res->next = slot->res;
+        slot->res = res;
+    }
+    else {
+        res->next = NULL;
+        if (!InsertResourceSlot(&rrec->table, id, res)) {
+            free(res);
+            (*resourceTypes[type & TypeMask].deleteFunc) (value, id);
+            return FALSE;
+        }
+    }
     rrec->elements++;
     CallResourceStateCallback(ResourceStateAdding, res);
     return TRUE;
 }
 
+/*
+ * Retire the current table and start migrating into a fresh one, twice
+ * the size unless most of the used slots were tombstones.  Any previous
+ * migration is completed first.
+ */
 static void
 RebuildTable(int client)
 {
-    int j;
-    ResourcePtr res, next;
-    ResourcePtr **tails, *resources;
-    ResourcePtr **tptr, *rptr;
+    ClientResourceRec *rrec = &clientTable[client];
+    ResourceSlotPtr slots;
+    int hashsize;
 
-    /*
-     * For now, preserve insertion order, since some ddx layers depend
-     * on resources being free in the opposite order they are added.
-     */
+    MigrateResources(rrec, rrec->old.buckets);
 
-    j = 2 * clientTable[client].buckets;
-    tails =  xallocarray(j, sizeof(ResourcePtr *));
-    if (!tails)
+    hashsize = rrec->table.hashsize;
+    if (rrec->table.ids * 2 >= rrec->table.buckets)
+        hashsize++;
+    slots = calloc(1 << hashsize, sizeof(ResourceSlotRec));
+    if (!slots)
         return;
-    resources =  xallocarray(j, sizeof(ResourcePtr));
-    if (!resources) {
-        free(tails);
-        return;
-    }
-    for (rptr = resources, tptr = tails; --j >= 0; rptr++, tptr++) {
-        *rptr = NULL;
-        *tptr = rptr;
-    }
-    clientTable[client].hashsize++;
-    for (j = clientTable[client].buckets,
-         rptr = clientTable[client].resources; --j >= 0; rptr++) {
-        for (res = *rptr; res; res = next) {
-            next = res->next;
-            res->next = NULL;
-            tptr = &tails[HashResourceID(res->id, clientTable[client].hashsize)];
-            **tptr = res;
-            *tptr = &res->next;
-        }
-    }
-    free(tails);
-    clientTable[client].buckets *= 2;
-    free(clientTable[client].resources);
-    clientTable[client].resources = resources;
+
+    rrec->old = rrec->table;
+    rrec->migrated = 0;
+    rrec->table.slots = slots;
+    rrec->table.buckets = 1 << hashsize;
+    rrec->table.hashsize = hashsize;
+    rrec->table.ids = 0;
+    rrec->table.used = 0;
+    rrec->generation++;
 }
 
 static void
@@ -886,34 +1076,25 @@ void
 FreeResource(XID id, RESTYPE skipDeleteFuncType)
 {
     int cid;
+    ClientResourceRec *rrec;
+    ResourceTablePtr table;
+    ResourceSlotPtr slot;
     ResourcePtr res;
-    ResourcePtr *prev, *head;
-    int *eltptr;
-    int elements;
-
-    if (((cid = CLIENT_ID(id)) < LimitClients) && clientTable[cid].buckets) {
-        head = &clientTable[cid].resources[HashResourceID(id, clientTable[cid].hashsize)];
-        eltptr = &clientTable[cid].elements;
 
-        prev = head;
-        while ((res = *prev)) {
-            if (res->id == id) {
-                RESTYPE rtype = res->type;
+    if (((cid = CLIENT_ID(id)) < LimitClients) && clientTable[cid].table.buckets) {
+        DispatchThreadBarrier(cid);
+        rrec = &clientTable[cid];
 
+        /* the slot may have moved if a delete function added resources */
+        while ((slot = FindResourceSlot(rrec, id, &table))) {
+            res = slot->res;
 #ifdef XSERVER_DTRACE
-                XSERVER_RESOURCE_FREE(res->id, res->type,
-                                      res->value, TypeNameString(res->type));
+            XSERVER_RESOURCE_FREE(res->id, res->type,
+                                  res->value, TypeNameString(res->type));
 #endif
-                *prev = res->next;
-                elements = --*eltptr;
+            RemoveResource(rrec, table, slot, &slot->res);
 
-                doFreeResource(res, rtype == skipDeleteFuncType);
-
-                if (*eltptr != elements)
-                    prev = head;        /* prev may no longer be valid */
-            }
-            else
-                prev = &res->next;
+            doFreeResource(res, res->type == skipDeleteFuncType);
         }
     }
 }
@@ -922,28 +1103,29 @@ void
 FreeResourceByType(XID id, RESTYPE type, Bool skipFree)
 {
     int cid;
+    ResourceTablePtr table;
+    ResourceSlotPtr slot;
     ResourcePtr res;
-    ResourcePtr *prev, *head;
+    ResourcePtr *prev;
 
-    if (((cid = CLIENT_ID(id)) < LimitClients) && clientTable[cid].buckets) {
-        head = &clientTable[cid].resources[HashResourceID(id, clientTable[cid].hashsize)];
+    if (((cid = CLIENT_ID(id)) < LimitClients) && clientTable[cid].table.buckets) {
+        DispatchThreadBarrier(cid);
+        slot = FindResourceSlot(&clientTable[cid], id, &table);
+        if (!slot)
+            return;
 
-        prev = head;
-        while ((res = *prev)) {
-            if (res->id == id && res->type == type) {
+        for (prev = &slot->res; (res = *prev); prev = &res->next) {
+            if (res->type == type) {
 #ifdef XSERVER_DTRACE
                 XSERVER_RESOURCE_FREE(res->id, res->type,
                                       res->value, TypeNameString(res->type));
 #endif
-                *prev = res->next;
-                clientTable[cid].elements--;
+                RemoveResource(&clientTable[cid], table, slot, prev);
 
                 doFreeResource(res, skipFree);
 
                 break;
             }
-            else
-                prev = &res->next;
         }
     }
 }
@@ -958,13 +1140,17 @@ Bool
 ChangeResourceValue(XID id, RESTYPE rtype, void *value)
 {
     int cid;
+    ResourceSlotPtr slot;
     ResourcePtr res;
 
-    if (((cid = CLIENT_ID(id)) < LimitClients) && clientTable[cid].buckets) {
-        res = clientTable[cid].resources[HashResourceID(id, clientTable[cid].hashsize)];
+    if (((cid = CLIENT_ID(id)) < LimitClients) && clientTable[cid].table.buckets) {
+        DispatchThreadBarrier(cid);
+        slot = FindResourceSlot(&clientTable[cid], id, NULL);
+        if (!slot)
+            return FALSE;
 
-        for (; res; res = res->next)
-            if ((res->id == id) && (res->type == rtype)) {
+        for (res = slot->res; res; res = res->next)
+            if (res->type == rtype) {
                 res->value = value;
                 return TRUE;
             }
@@ -982,24 +1168,33 @@ void
 FindClientResourcesByType(ClientPtr client,
                           RESTYPE type, FindResType func, void *cdata)
 {
-    ResourcePtr *resources;
+    ClientResourceRec *rrec;
+    ResourceSlotPtr slot;
     ResourcePtr this, next;
     int i, elements;
-    int *eltptr;
+    unsigned int generation;
 
     if (!client)
         client = serverClient;
 
-    resources = clientTable[client->index].resources;
-    eltptr = &clientTable[client->index].elements;
-    for (i = 0; i < clientTable[client->index].buckets; i++) {
-        for (this = resources[i]; this; this = next) {
+    DispatchThreadBarrier(client->index);
+    rrec = &clientTable[client->index];
+    generation = rrec->generation;
+    for (i = 0; (slot = NextResourceSlot(rrec, &i)); i++) {
+        for (this = slot->res; this; this = next) {
             next = this->next;
             if (!type || this->type == type) {
-                elements = *eltptr;
+                elements = rrec->elements;
                 (*func) (this->value, this->id, cdata);
-                if (*eltptr != elements)
-                    next = resources[i];        /* start over */
+                if (rrec->generation != generation) {
+                    generation = rrec->generation;
+                    i = -1;                             /* start over */
+                    break;
+                }
+                if (rrec->elements != elements)
+                    next = slot->res;                   /* start over */
+                if (next == ResourceDeleted)
+                    break;
             }
         }
     }
@@ -1017,23 +1212,32 @@ void FindSubResources(void *resource,
 void
 FindAllClientResources(ClientPtr client, FindAllRes func, void *cdata)
 {
-    ResourcePtr *resources;
+    ClientResourceRec *rrec;
+    ResourceSlotPtr slot;
     ResourcePtr this, next;
     int i, elements;
-    int *eltptr;
+    unsigned int generation;
 
     if (!client)
         client = serverClient;
 
-    resources = clientTable[client->index].resources;
-    eltptr = &clientTable[client->index].elements;
-    for (i = 0; i < clientTable[client->index].buckets; i++) {
-        for (this = resources[i]; this; this = next) {
+    DispatchThreadBarrier(client->index);
+    rrec = &clientTable[client->index];
+    generation = rrec->generation;
+    for (i = 0; (slot = NextResourceSlot(rrec, &i)); i++) {
+        for (this = slot->res; this; this = next) {
             next = this->next;
-            elements = *eltptr;
+            elements = rrec->elements;
             (*func) (this->value, this->id, this->type, cdata);
-            if (*eltptr != elements)
-                next = resources[i];    /* start over */
+            if (rrec->generation != generation) {
+                generation = rrec->generation;
+                i = -1;                                 /* start over */
+                break;
+            }
+            if (rrec->elements != elements)
+                next = slot->res;                       /* start over */
+            if (next == ResourceDeleted)
+                break;
         }
     }
 }
@@ -1043,7 +1247,8 @@ LookupClientResourceComplex(ClientPtr client,
                             RESTYPE type,
                             FindComplexResType func, void *cdata)
 {
-    ResourcePtr *resources;
+    ClientResourceRec *rrec;
+    ResourceSlotPtr slot;
     ResourcePtr this, next;
     void *value;
     int i;
@@ -1051,9 +1256,10 @@ LookupClientResourceComplex(ClientPtr client,
     if (!client)
         client = serverClient;
 
-    resources = clientTable[client->index].resources;
-    for (i = 0; i < clientTable[client->index].buckets; i++) {
-        for (this = resources[i]; this; this = next) {
+    DispatchThreadBarrier(client->index);
+    rrec = &clientTable[client->index];
+    for (i = 0; (slot = NextResourceSlot(rrec, &i)); i++) {
+        for (this = slot->res; this && this != ResourceDeleted; this = next) {
             next = this->next;
             if (!type || this->type == type) {
                 /* workaround func freeing the type as DRI1 does */
@@ -1069,20 +1275,21 @@ LookupClientResourceComplex(ClientPtr client,
 void
 FreeClientNeverRetainResources(ClientPtr client)
 {
-    ResourcePtr *resources;
+    ClientResourceRec *rrec;
+    ResourceSlotPtr slot;
     ResourcePtr this;
     ResourcePtr *prev;
-    int j, elements;
-    int *eltptr;
+    int j;
+    unsigned int generation;
 
     if (!client)
         return;
 
-    resources = clientTable[client->index].resources;
-    eltptr = &clientTable[client->index].elements;
-    for (j = 0; j < clientTable[client->index].buckets; j++) {
-        prev = &resources[j];
-        while ((this = *prev)) {
+    DispatchThreadBarrier(client->index);
+    rrec = &clientTable[client->index];
+    for (j = 0; (slot = NextResourceSlot(rrec, &j)); j++) {
+        prev = &slot->res;
+        while ((this = *prev) && this != ResourceDeleted) {
             RESTYPE rtype = this->type;
 
             if (rtype & RC_NEVERRETAIN) {
@@ -1090,14 +1297,16 @@ FreeClientNeverRetainResources(ClientPtr client)
                 XSERVER_RESOURCE_FREE(this->id, this->type,
                                       this->value, TypeNameString(this->type));
 #endif
-                *prev = this->next;
-                clientTable[client->index].elements--;
-                elements = *eltptr;
+                RemoveResource(rrec, ResourceSlotTable(rrec, j), slot, prev);
+                generation = rrec->generation;
 
                 doFreeResource(this, FALSE);
 
-                if (*eltptr != elements)
-                    prev = &resources[j];       /* prev may no longer be valid */
+                if (rrec->generation != generation) {
+                    j = -1;                     /* slot is gone, start over */
+                    break;
+                }
+                prev = &slot->res;      /* prev may no longer be valid */
             }
             else
                 prev = &this->next;
@@ -1108,9 +1317,11 @@ FreeClientNeverRetainResources(ClientPtr client)
 void
 FreeClientResources(ClientPtr client)
 {
-    ResourcePtr *resources;
+    ClientResourceRec *rrec;
+    ResourceSlotPtr slot;
     ResourcePtr this;
     int j;
+    unsigned int generation;
 
     /* This routine shouldn't be called with a null client, but just in
        case ... */
@@ -1120,35 +1331,37 @@ FreeClientResources(ClientPtr client)
 
     HandleSaveSet(client);
 
-    resources = clientTable[client->index].resources;
-    for (j = 0; j < clientTable[client->index].buckets; j++) {
-        /* It may seem silly to update the head of this resource list as
-           we delete the members, since the entire list will be deleted any way,
-           but there are some resource deletion functions "FreeClientPixels" for
-           one which do a LookupID on another resource id (a Colormap id in this
-           case), so the resource list must be kept valid up to the point that
-           it is deleted, so every time we delete a resource, we must update the
-           head, just like in FreeResource. I hope that this doesn't slow down
-           mass deletion appreciably. PRH */
-
-        ResourcePtr *head;
-
-        head = &resources[j];
-
-        for (this = *head; this; this = *head) {
+    DispatchThreadBarrier(client->index);
+    rrec = &clientTable[client->index];
+    for (j = 0; (slot = NextResourceSlot(rrec, &j));) {
+        /* It may seem silly to update the table as we delete the members,
+           since the entire table will be deleted any way, but there are
+           some resource deletion functions "FreeClientPixels" for one
+           which do a LookupID on another resource id (a Colormap id in
+           this case), so the table must be kept valid up to the point
+           that it is deleted, so every time we delete a resource, we must
+           unlink it, just like in FreeResource. I hope that this doesn't
+           slow down mass deletion appreciably. PRH */
+
+        this = slot->res;
 #ifdef XSERVER_DTRACE
-            XSERVER_RESOURCE_FREE(this->id, this->type,
-                                  this->value, TypeNameString(this->type));
+        XSERVER_RESOURCE_FREE(this->id, this->type,
+                              this->value, TypeNameString(this->type));
 #endif
-            *head = this->next;
-            clientTable[client->index].elements--;
+        RemoveResource(rrec, ResourceSlotTable(rrec, j), slot, &slot->res);
+        generation = rrec->generation;
 
-            doFreeResource(this, FALSE);
-        }
+        doFreeResource(this, FALSE);
+
+        if (rrec->generation != generation)
+            j = 0;
     }
-    free(clientTable[client->index].resources);
-    clientTable[client->index].resources = NULL;
-    clientTable[client->index].buckets = 0;
+    free(rrec->old.slots);
+    free(rrec->table.slots);
+    memset(&rrec->old, 0, sizeof(rrec->old));
+    memset(&rrec->table, 0, sizeof(rrec->table));
+    rrec->migrated = 0;
+    rrec->generation++;
 }
 
 void
@@ -1157,7 +1370,7 @@ FreeAllResources(void)
     int i;
 
     for (i = currentMaxClients; --i >= 0;) {
-        if (clientTable[i].buckets)
+        if (clientTable[i].table.buckets)
             FreeClientResources(clients[i]);
     }
 }
@@ -1198,12 +1411,16 @@ dixLookupResourceByType(void **result, XID id, RESTYPE rtype,
     if ((rtype & TypeMask) > lastResourceType)
         return BadImplementation;
 
-    if ((cid < LimitClients) && clientTable[cid].buckets) {
-        res = clientTable[cid].resources[HashResourceID(id, clientTable[cid].hashsize)];
+    if ((cid < LimitClients) && clientTable[cid].table.buckets) {
+        ResourceSlotPtr slot;
 
-        for (; res; res = res->next)
-            if (res->id == id && res->type == rtype)
-                break;
+        DispatchThreadBarrier(cid);
+        slot = FindResourceSlot(&clientTable[cid], id, NULL);
+
+        if (slot)
+            for (res = slot->res; res; res = res->next)
+                if (res->type == rtype)
+                    break;
     }
     if (client) {
         client->errorValue = id;
@@ -1233,12 +1450,16 @@ dixLookupResourceByClass(void **result, XID id, RESTYPE rclass,
 
     *result = NULL;
 
-    if ((cid < LimitClients) && clientTable[cid].buckets) {
-        res = clientTable[cid].resources[HashResourceID(id, clientTable[cid].hashsize)];
+    if ((cid < LimitClients) && clientTable[cid].table.buckets) {
+        ResourceSlotPtr slot;
 
-        for (; res; res = res->next)
-            if (res->id == id && (res->type & rclass))
-                break;
+        DispatchThreadBarrier(cid);
+        slot = FindResourceSlot(&clientTable[cid], id, NULL);
+
+        if (slot)
+            for (res = slot->res; res; res = res->next)
+                if (res->type & rclass)
+                    break;
     }
     if (client) {
         client->errorValue = id;
@@ -608,6 +608,9 @@ CreateRootWindow(ScreenPtr pScreen)
     pWin->optional->inputShape = NULL;
     pWin->optional->inputMasks = NULL;
     pWin->optional->deviceCursors = NULL;
+    pWin->optional->propIndex = NULL;
+    pWin->optional->pickIndex = NULL;
+    pWin->optional->deliveryCache = NULL;
     pWin->optional->colormap = pScreen->defColormap;
     pWin->optional->visual = pScreen->rootVisual;
 
@@ -918,6 +921,7 @@ CreateWindow(Window wid, WindowPtr pParent, int x, int y, unsigned w,
             pParent->lastChild = pWin;
         pParent->firstChild = pWin;
     }
+    WindowPickInvalidate(pParent);
 
     SetWinSize(pWin);
     SetBorderSize(pWin);
@@ -999,6 +1003,8 @@ DisposeWindowOptional(WindowPtr pWin)
         pWin->optional->deviceCursors = NULL;
     }
 
+    WindowPickFree(pWin);
+    DeliveryCacheInvalidate(pWin);
     free(pWin->optional);
     pWin->optional = NULL;
 }
@@ -1067,6 +1073,7 @@ CrushTree(WindowPtr pWin)
             pChild = pParent;
             pChild->firstChild = NullWindow;
             pChild->lastChild = NullWindow;
+            WindowPickInvalidate(pChild);
             if (pChild == pWin)
                 return;
         }
@@ -1106,6 +1113,7 @@ DeleteWindow(void *value, XID wid)
             pWin->nextSib->prevSib = pWin->prevSib;
         if (pWin->prevSib)
             pWin->prevSib->nextSib = pWin->nextSib;
+        WindowPickInvalidate(pParent);
     }
     else
         pWin->drawable.pScreen->root = NULL;
@@ -1702,6 +1710,7 @@ MoveWindowInStack(WindowPtr pWin, WindowPtr pNextSib)
                     pFirstChange = pFirstChange->nextSib;
             }
         }
+        WindowPickInvalidate(pParent);
         if (pWin->drawable.pScreen->RestackWindow)
             (*pWin->drawable.pScreen->RestackWindow) (pWin, pOldNextSib);
     }
@@ -1879,6 +1888,7 @@ ResizeChildrenWinSize(WindowPtr pWin, int dx, int dy, int dw, int dh)
                 DeliverEvents(pSib, &event, 1, NullWindow);
                 pSib->origin.x = cwsx;
                 pSib->origin.y = cwsy;
+                WindowPickInvalidate(pWin);
             }
         }
         pSib->drawable.x = pWin->drawable.x + pSib->origin.x;
@@ -2557,6 +2567,7 @@ ReparentWindow(WindowPtr pWin, WindowPtr pParent,
         pWin->nextSib->prevSib = pWin->prevSib;
     if (pWin->prevSib)
         pWin->prevSib->nextSib = pWin->nextSib;
+    WindowPickInvalidate(pPrev);
 
     /* insert at begining of pParent */
     pWin->parent = pParent;
@@ -2580,6 +2591,8 @@ ReparentWindow(WindowPtr pWin, WindowPtr pParent,
         pParent->firstChild = pWin;
     }
 
+    WindowPickInvalidate(pParent);
+
     pWin->origin.x = x + bw;
     pWin->origin.y = y + bw;
     pWin->drawable.x = x + bw + pParent->drawable.x;
@@ -3428,6 +3441,9 @@ MakeWindowOptional(WindowPtr pWin)
     optional->inputShape = NULL;
     optional->inputMasks = NULL;
     optional->deviceCursors = NULL;
+    optional->propIndex = NULL;
+    optional->pickIndex = NULL;
+    optional->deliveryCache = NULL;
 
     parentOptional = FindWindowWithOptional(pWin)->optional;
     optional->visual = parentOptional->visual;
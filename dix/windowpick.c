@@ -0,0 +1,240 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Pointer picking index.
+ *
+ * XYToWindow finds the window under the pointer by walking down the tree,
+ * at each level testing the children top to bottom until one contains the
+ * point.  For a parent with many children that walk is most of the cost of
+ * a motion event, so once a walk has had to look at many siblings the
+ * parent gets a grid over its children's bounding boxes: every cell lists,
+ * in stacking order, the children whose box touches it, and only those
+ * need testing.  The caller still makes every test the walk made, shapes
+ * included, so the grid only ever narrows down the candidates.
+ *
+ * Boxes are kept relative to the parent, so moving an ancestor leaves the
+ * grid alone.  Creating, destroying, reparenting, restacking, moving or
+ * resizing a child invalidates its parent's grid, which is rebuilt on the
+ * next lookup.  Mapping and unmapping don't, as the caller tests mapped.
+ * The root window's grid covers the top-level windows of the screen.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <string.h>
+
+#include "misc.h"
+#include "windowstr.h"
+
+/* Index parents once a walk has examined this many children */
+#define WINDOW_PICK_MIN 16
+/* At most this many cells along each side, no smaller than 1 << 4 pixels */
+#define WINDOW_PICK_CELLS 32
+#define WINDOW_PICK_MIN_SHIFT 4
+/* Give up when children span this many cells each on average */
+#define WINDOW_PICK_MAX_SPAN 64
+
+typedef struct _WindowPick {
+    Bool valid;
+    int x, y;                   /* parent-relative origin of the grid */
+    int shift;
+    int cols, rows;
+    int *start;                 /* cols * rows + 1 offsets into list */
+    WindowPtr *list;            /* NULL when not worth indexing */
+} WindowPickRec, *WindowPickPtr;
+
+static inline WindowPickPtr
+WindowPickGet(WindowPtr pWin)
+{
+    return pWin->optional ? pWin->optional->pickIndex : NULL;
+}
+
+/* The cells covered by a child's bounding box, inclusive */
+static void
+WindowPickSpan(WindowPickPtr pick, WindowPtr pChild, BoxPtr cells)
+{
+    int bw = wBorderWidth(pChild);
+
+    cells->x1 = (pChild->origin.x - bw - pick->x) >> pick->shift;
+    cells->y1 = (pChild->origin.y - bw - pick->y) >> pick->shift;
+    cells->x2 = (pChild->origin.x + (int) pChild->drawable.width + bw - 1 -
+                 pick->x) >> pick->shift;
+    cells->y2 = (pChild->origin.y + (int) pChild->drawable.height + bw - 1 -
+                 pick->y) >> pick->shift;
+}
+
+/*
+ * Build the grid from the current children.  Leaves pick->list NULL when
+ * there are too few children, they overlap too much to be worth it, or
+ * memory ran out; the caller then walks the siblings as usual.
+ */
+static void
+WindowPickBuild(WindowPtr pParent, WindowPickPtr pick)
+{
+    WindowPtr pChild;
+    BoxRec cells;
+    int x1 = MAXINT, y1 = MAXINT, x2 = MININT, y2 = MININT;
+    int n = 0, total = 0, ncells, cx, cy, c;
+
+    free(pick->start);
+    free(pick->list);
+    pick->start = NULL;
+    pick->list = NULL;
+    pick->valid = TRUE;
+
+    for (pChild = pParent->firstChild; pChild; pChild = pChild->nextSib) {
+        int bw = wBorderWidth(pChild);
+
+        x1 = min(x1, pChild->origin.x - bw);
+        y1 = min(y1, pChild->origin.y - bw);
+        x2 = max(x2, pChild->origin.x + (int) pChild->drawable.width + bw);
+        y2 = max(y2, pChild->origin.y + (int) pChild->drawable.height + bw);
+        n++;
+    }
+    if (n < WINDOW_PICK_MIN)
+        return;
+
+    pick->x = x1;
+    pick->y = y1;
+    pick->shift = WINDOW_PICK_MIN_SHIFT;
+    while (((x2 - x1 - 1) >> pick->shift) >= WINDOW_PICK_CELLS ||
+           ((y2 - y1 - 1) >> pick->shift) >= WINDOW_PICK_CELLS)
+        pick->shift++;
+    pick->cols = ((x2 - x1 - 1) >> pick->shift) + 1;
+    pick->rows = ((y2 - y1 - 1) >> pick->shift) + 1;
+    ncells = pick->cols * pick->rows;
+
+    for (pChild = pParent->firstChild; pChild; pChild = pChild->nextSib) {
+        WindowPickSpan(pick, pChild, &cells);
+        total += (cells.x2 - cells.x1 + 1) * (cells.y2 - cells.y1 + 1);
+    }
+    if (total > n * WINDOW_PICK_MAX_SPAN)
+        return;
+
+    pick->start = calloc(ncells + 1, sizeof(int));
+    pick->list = xallocarray(total, sizeof(WindowPtr));
+    if (!pick->start || !pick->list) {
+        free(pick->start);
+        free(pick->list);
+        pick->start = NULL;
+        pick->list = NULL;
+        return;
+    }
+
+    /* Count the children in each cell, then turn counts into offsets */
+    for (pChild = pParent->firstChild; pChild; pChild = pChild->nextSib) {
+        WindowPickSpan(pick, pChild, &cells);
+        for (cy = cells.y1; cy <= cells.y2; cy++)
+            for (cx = cells.x1; cx <= cells.x2; cx++)
+                pick->start[cy * pick->cols + cx + 1]++;
+    }
+    for (c = 0; c < ncells; c++)
+        pick->start[c + 1] += pick->start[c];
+
+    /*
+     * Fill in top to bottom, advancing each cell's start to its end as we
+     * go; moving the array up one slot puts the starts back.
+     */
+    for (pChild = pParent->firstChild; pChild; pChild = pChild->nextSib) {
+        WindowPickSpan(pick, pChild, &cells);
+        for (cy = cells.y1; cy <= cells.y2; cy++)
+            for (cx = cells.x1; cx <= cells.x2; cx++)
+                pick->list[pick->start[cy * pick->cols + cx]++] = pChild;
+    }
+    memmove(pick->start + 1, pick->start, ncells * sizeof(int));
+    pick->start[0] = 0;
+}
+
+/**
+ * Called after a walk of pParent's children that examined n of them;
+ * sets up an index for pParent if that was a long walk.
+ */
+void
+WindowPickWalked(WindowPtr pParent, int n)
+{
+    if (n < WINDOW_PICK_MIN || WindowPickGet(pParent))
+        return;
+    if (!MakeWindowOptional(pParent))
+        return;
+    pParent->optional->pickIndex = calloc(1, sizeof(WindowPickRec));
+}
+
+/**
+ * The children of pParent that may contain the point x, y, in screen
+ * coordinates, top first.  Returns FALSE if pParent has no usable index,
+ * in which case the caller has to walk all the children.
+ */
+Bool
+WindowPickCandidates(WindowPtr pParent, int x, int y,
+                     WindowPtr **list, int *n)
+{
+    WindowPickPtr pick = WindowPickGet(pParent);
+    int cx, cy, c;
+
+    if (!pick)
+        return FALSE;
+    if (!pick->valid)
+        WindowPickBuild(pParent, pick);
+    if (!pick->list)
+        return FALSE;
+
+    cx = x - pParent->drawable.x - pick->x;
+    cy = y - pParent->drawable.y - pick->y;
+    if (cx < 0 || cy < 0 ||
+        (cx >>= pick->shift) >= pick->cols ||
+        (cy >>= pick->shift) >= pick->rows) {
+        *n = 0;
+        return TRUE;
+    }
+
+    c = cy * pick->cols + cx;
+    *list = pick->list + pick->start[c];
+    *n = pick->start[c + 1] - pick->start[c];
+    return TRUE;
+}
+
+/**
+ * The children of pParent changed; rebuild the index on the next lookup.
+ */
+void
+WindowPickInvalidate(WindowPtr pParent)
+{
+    WindowPickPtr pick;
+
+    if (pParent && (pick = WindowPickGet(pParent)))
+        pick->valid = FALSE;
+}
+
+void
+WindowPickFree(WindowPtr pWin)
+{
+    WindowPickPtr pick = WindowPickGet(pWin);
+
+    if (!pick)
+        return;
+    free(pick->start);
+    free(pick->list);
+    free(pick);
+    pWin->optional->pickIndex = NULL;
+}
@@ -111,6 +111,36 @@ typedef FbBits FbStip;
 
 typedef int FbStride;
 
+/*
+ * Vector kernels for the middle words of each line in fbSolid and fbBlt:
+ * level 1 is SSE2 or NEON, level 2 AVX2, picked at run time by
+ * fbSetSimdLevel.  They access memory directly, so not with wfb.
+ */
+#ifndef FB_ACCESS_WRAPPER
+#if defined(__SSE2__)
+#define FB_SIMD_VECTOR 1
+#if defined(__GNUC__) && defined(__x86_64__)
+#define FB_SIMD_AVX2 2
+#endif
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define FB_SIMD_VECTOR 1
+#endif
+#endif
+
+/* Lines with fewer middle words than this use the plain loops */
+#define FB_SIMD_MIN 8
+/* Write-only operations this large use non-temporal stores, on x86 */
+#define FB_SIMD_STREAM_BYTES (4 << 20)
+
+/*
+ * Composites and copies of at least this many pixels are split into up
+ * to FB_BAND_MAX bands of at least FB_BAND_MIN_ROWS lines, for the render
+ * threads, see fbBands.
+ */
+#define FB_BAND_MIN_PIXELS (256 * 1024)
+#define FB_BAND_MIN_ROWS 32
+#define FB_BAND_MAX 16
+
 #ifdef FB_DEBUG
 extern _X_EXPORT void fbValidateDrawable(DrawablePtr d);
 extern _X_EXPORT void fbInitializeDrawable(DrawablePtr d);
@@ -410,6 +440,13 @@ typedef struct {
 #endif
     DevPrivateKeyRec    gcPrivateKeyRec;
     DevPrivateKeyRec    winPrivateKeyRec;
+    DevPrivateKeyRec    picturePrivateKeyRec;
+    /* wrapped to keep the cached pixman images of Pictures current */
+    DestroyPictureProcPtr DestroyPicture;
+    ChangePictureProcPtr ChangePicture;
+    ValidatePictureProcPtr ValidatePicture;
+    ChangePictureTransformProcPtr ChangePictureTransform;
+    ChangePictureFilterProcPtr ChangePictureFilter;
 } FbScreenPrivRec, *FbScreenPrivPtr;
 
 #define fbGetScreenPrivate(pScreen) ((FbScreenPrivPtr) \
@@ -1102,6 +1139,12 @@ fbSolid(FbBits * dst,
  */
 extern _X_EXPORT FbBits fbReplicatePixel(Pixel p, int bpp);
 
+extern _X_EXPORT int fbSetSimdLevel(int level);
+
+extern int fbSimdLevel;
+
+extern _X_EXPORT int fbBands(CARD64 pixels, int lines);
+
 #ifdef FB_ACCESS_WRAPPER
 extern _X_EXPORT ReadMemoryProcPtr wfbReadMemory;
 extern _X_EXPORT WriteMemoryProcPtr wfbWriteMemory;
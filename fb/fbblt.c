@@ -27,6 +27,15 @@
 #include <string.h>
 #include "fb.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#ifdef FB_SIMD_AVX2
+#include <immintrin.h>
+#endif
+#elif defined(FB_SIMD_VECTOR)
+#include <arm_neon.h>
+#endif
+
 #define InitializeShifts(sx,dx,ls,rs) { \
     if (sx != dx) { \
 	if (sx > dx) { \
@@ -39,6 +48,194 @@
     } \
 }
 
+#ifdef FB_SIMD_VECTOR
+/*
+ * The middle words of a line where source and destination are aligned
+ * alike, n of them starting at dst and src, done from the last word down
+ * if reverse.  stream says the destination is only written and may go
+ * around the cache.
+ */
+typedef void (*FbBltSpanProc) (FbBits * dst, const FbBits * src, int n,
+                               const FbMergeRopRec * rop, Bool reverse,
+                               Bool stream);
+
+#define FbBltMergeRop(src, dst, rop) \
+    (((dst) & (((src) & (rop)->ca1) ^ (rop)->cx1)) ^ \
+     (((src) & (rop)->ca2) ^ (rop)->cx2))
+
+static inline void
+fbBltWords(FbBits * dst, const FbBits * src, int n,
+           const FbMergeRopRec * rop)
+{
+    for (; n; n--, dst++, src++)
+        *dst = FbBltMergeRop(*src, *dst, rop);
+}
+
+/* The same, from dst + n - 1 and src + n - 1 down */
+static inline void
+fbBltWordsReverse(FbBits * dst, const FbBits * src, int n,
+                  const FbMergeRopRec * rop)
+{
+    dst += n;
+    src += n;
+    while (n--) {
+        --dst;
+        --src;
+        *dst = FbBltMergeRop(*src, *dst, rop);
+    }
+}
+
+#ifdef __SSE2__
+static inline void
+fbBltVectorSSE2(FbBits * dst, const FbBits * src, const FbMergeRopRec * rop,
+                Bool invariant, Bool stream)
+{
+    __m128i s = _mm_loadu_si128((const __m128i *) src);
+    __m128i v = _mm_xor_si128(_mm_and_si128(s, _mm_set1_epi32(rop->ca2)),
+                              _mm_set1_epi32(rop->cx2));
+
+    if (!invariant) {
+        __m128i a = _mm_xor_si128(_mm_and_si128(s, _mm_set1_epi32(rop->ca1)),
+                                  _mm_set1_epi32(rop->cx1));
+
+        v = _mm_xor_si128(_mm_and_si128(_mm_load_si128((__m128i *) dst), a),
+                          v);
+    }
+    if (stream)
+        _mm_stream_si128((__m128i *) dst, v);
+    else
+        _mm_store_si128((__m128i *) dst, v);
+}
+
+static void
+fbBltSpanSSE2(FbBits * dst, const FbBits * src, int n,
+              const FbMergeRopRec * rop, Bool reverse, Bool stream)
+{
+    Bool invariant = !rop->ca1 && !rop->cx1;
+    int head;
+
+    if (!reverse) {
+        head = (-(uintptr_t) dst >> 2) & 3;
+        fbBltWords(dst, src, head, rop);
+        for (dst += head, src += head, n -= head; n >= 4;
+             n -= 4, dst += 4, src += 4)
+            fbBltVectorSSE2(dst, src, rop, invariant, stream);
+        fbBltWords(dst, src, n, rop);
+    }
+    else {
+        head = ((uintptr_t) (dst + n) >> 2) & 3;
+        fbBltWordsReverse(dst + n - head, src + n - head, head, rop);
+        for (n -= head; n >= 4; n -= 4)
+            fbBltVectorSSE2(dst + n - 4, src + n - 4, rop, invariant, stream);
+        fbBltWordsReverse(dst, src, n, rop);
+    }
+    if (stream)
+        _mm_sfence();
+}
+
+#ifdef FB_SIMD_AVX2
+__attribute__((target("avx2")))
+static inline void
+fbBltVectorAVX2(FbBits * dst, const FbBits * src, const FbMergeRopRec * rop,
+                Bool invariant, Bool stream)
+{
+    __m256i s = _mm256_loadu_si256((const __m256i *) src);
+    __m256i v = _mm256_xor_si256(_mm256_and_si256(s,
+                                                  _mm256_set1_epi32(rop->ca2)),
+                                 _mm256_set1_epi32(rop->cx2));
+
+    if (!invariant) {
+        __m256i a = _mm256_xor_si256(_mm256_and_si256(s,
+                                                      _mm256_set1_epi32(rop->ca1)),
+                                     _mm256_set1_epi32(rop->cx1));
+
+        v = _mm256_xor_si256(_mm256_and_si256(_mm256_load_si256((__m256i *) dst),
+                                              a), v);
+    }
+    if (stream)
+        _mm256_stream_si256((__m256i *) dst, v);
+    else
+        _mm256_store_si256((__m256i *) dst, v);
+}
+
+__attribute__((target("avx2")))
+static void
+fbBltSpanAVX2(FbBits * dst, const FbBits * src, int n,
+              const FbMergeRopRec * rop, Bool reverse, Bool stream)
+{
+    Bool invariant = !rop->ca1 && !rop->cx1;
+    int head;
+
+    if (!reverse) {
+        head = (-(uintptr_t) dst >> 2) & 7;
+        fbBltWords(dst, src, head, rop);
+        for (dst += head, src += head, n -= head; n >= 8;
+             n -= 8, dst += 8, src += 8)
+            fbBltVectorAVX2(dst, src, rop, invariant, stream);
+        fbBltWords(dst, src, n, rop);
+    }
+    else {
+        head = ((uintptr_t) (dst + n) >> 2) & 7;
+        fbBltWordsReverse(dst + n - head, src + n - head, head, rop);
+        for (n -= head; n >= 8; n -= 8)
+            fbBltVectorAVX2(dst + n - 8, src + n - 8, rop, invariant, stream);
+        fbBltWordsReverse(dst, src, n, rop);
+    }
+    if (stream)
+        _mm_sfence();
+}
+#endif
+
+static const FbBltSpanProc fbBltSpans[] = {
+    NULL,
+    fbBltSpanSSE2,
+#ifdef FB_SIMD_AVX2
+    fbBltSpanAVX2,
+#endif
+};
+
+#else
+
+static inline void
+fbBltVectorNEON(FbBits * dst, const FbBits * src, const FbMergeRopRec * rop,
+                Bool invariant)
+{
+    uint32x4_t s = vld1q_u32(src);
+    uint32x4_t v = veorq_u32(vandq_u32(s, vdupq_n_u32(rop->ca2)),
+                             vdupq_n_u32(rop->cx2));
+
+    if (!invariant)
+        v = veorq_u32(vandq_u32(vld1q_u32(dst),
+                                veorq_u32(vandq_u32(s, vdupq_n_u32(rop->ca1)),
+                                          vdupq_n_u32(rop->cx1))), v);
+    vst1q_u32(dst, v);
+}
+
+static void
+fbBltSpanNEON(FbBits * dst, const FbBits * src, int n,
+              const FbMergeRopRec * rop, Bool reverse, Bool stream)
+{
+    Bool invariant = !rop->ca1 && !rop->cx1;
+
+    if (!reverse) {
+        for (; n >= 4; n -= 4, dst += 4, src += 4)
+            fbBltVectorNEON(dst, src, rop, invariant);
+        fbBltWords(dst, src, n, rop);
+    }
+    else {
+        for (; n >= 4; n -= 4)
+            fbBltVectorNEON(dst + n - 4, src + n - 4, rop, invariant);
+        fbBltWordsReverse(dst, src, n, rop);
+    }
+}
+
+static const FbBltSpanProc fbBltSpans[] = {
+    NULL,
+    fbBltSpanNEON,
+};
+#endif
+#endif
+
 void
 fbBlt(FbBits * srcLine,
       FbStride srcStride,
@@ -57,6 +254,12 @@ fbBlt(FbBits * srcLine,
     Bool destInvarient;
     int startbyte, endbyte;
 
+#ifdef FB_SIMD_VECTOR
+    FbBltSpanProc span;
+    FbMergeRopRec rop;
+    Bool stream;
+#endif
+
     FbDeclareMergeRop();
 
     if (alu == GXcopy && pm == FB_ALLONES &&
@@ -94,6 +297,15 @@ fbBlt(FbBits * srcLine,
 
     FbInitializeMergeRop(alu, pm);
     destInvarient = FbDestInvarientMergeRop();
+#ifdef FB_SIMD_VECTOR
+    span = fbBltSpans[fbSimdLevel];
+    rop.ca1 = _ca1;
+    rop.cx1 = _cx1;
+    rop.ca2 = _ca2;
+    rop.cx2 = _cx2;
+    stream = destInvarient &&
+        (size_t) (width >> 3) * height >= FB_SIMD_STREAM_BYTES;
+#endif
     if (upsidedown) {
         srcLine += (height - 1) * (srcStride);
         dstLine += (height - 1) * (dstStride);
@@ -127,6 +339,14 @@ fbBlt(FbBits * srcLine,
                     FbDoRightMaskByteMergeRop(dst, bits, endbyte, endmask);
                 }
                 n = nmiddle;
+#ifdef FB_SIMD_VECTOR
+                if (span && n >= FB_SIMD_MIN) {
+                    dst -= n;
+                    src -= n;
+                    (*span) (dst, src, n, &rop, TRUE, stream);
+                    n = 0;
+                }
+#endif
                 if (destInvarient) {
                     while (n--)
                         WRITE(--dst, FbDoDestInvarientMergeRop(READ(--src)));
@@ -151,6 +371,14 @@ fbBlt(FbBits * srcLine,
                     dst++;
                 }
                 n = nmiddle;
+#ifdef FB_SIMD_VECTOR
+                if (span && n >= FB_SIMD_MIN) {
+                    (*span) (dst, src, n, &rop, FALSE, stream);
+                    dst += n;
+                    src += n;
+                    n = 0;
+                }
+#endif
                 if (destInvarient) {
 #if 0
                     /*
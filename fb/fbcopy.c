@@ -27,18 +27,9 @@
 #include <stdlib.h>
 
 #include "fb.h"
+#include "dixstruct.h"
 
-void
-fbCopyNtoN(DrawablePtr pSrcDrawable,
-           DrawablePtr pDstDrawable,
-           GCPtr pGC,
-           BoxPtr pbox,
-           int nbox,
-           int dx,
-           int dy, Bool reverse, Bool upsidedown, Pixel bitplane, void *closure)
-{
-    CARD8 alu = pGC ? pGC->alu : GXcopy;
-    FbBits pm = pGC ? fbGetGCPrivate(pGC)->pm : FB_ALLONES;
+typedef struct _FbCopyNtoN {
     FbBits *src;
     FbStride srcStride;
     int srcBpp;
@@ -47,38 +38,113 @@ fbCopyNtoN(DrawablePtr pSrcDrawable,
     FbStride dstStride;
     int dstBpp;
     int dstXoff, dstYoff;
+    BoxPtr pbox;
+    int nbox;
+    int dx, dy;
+    CARD8 alu;
+    FbBits pm;
+    Bool reverse, upsidedown;
+    int y1, y2;                 /* extents of the boxes */
+} FbCopyNtoNRec, *FbCopyNtoNPtr;
 
-    fbGetDrawable(pSrcDrawable, src, srcStride, srcBpp, srcXoff, srcYoff);
-    fbGetDrawable(pDstDrawable, dst, dstStride, dstBpp, dstXoff, dstYoff);
+/* Copy the lines from top to bottom of every box */
+static void
+fbCopyNtoNLines(FbCopyNtoNPtr copy, int top, int bottom)
+{
+    BoxPtr pbox = copy->pbox;
+    int nbox = copy->nbox;
 
-    while (nbox--) {
+    for (; nbox--; pbox++) {
+        int y1 = max(pbox->y1, top);
+        int y2 = min(pbox->y2, bottom);
+
+        if (y1 >= y2)
+            continue;
 #ifndef FB_ACCESS_WRAPPER       /* pixman_blt() doesn't support accessors yet */
-        if (pm == FB_ALLONES && alu == GXcopy && !reverse && !upsidedown) {
-            if (!pixman_blt
-                ((uint32_t *) src, (uint32_t *) dst, srcStride, dstStride,
-                 srcBpp, dstBpp, (pbox->x1 + dx + srcXoff),
-                 (pbox->y1 + dy + srcYoff), (pbox->x1 + dstXoff),
-                 (pbox->y1 + dstYoff), (pbox->x2 - pbox->x1),
-                 (pbox->y2 - pbox->y1)))
-                goto fallback;
-            else
-                goto next;
+        if (copy->pm == FB_ALLONES && copy->alu == GXcopy &&
+            !copy->reverse && !copy->upsidedown) {
+            if (pixman_blt
+                ((uint32_t *) copy->src, (uint32_t *) copy->dst,
+                 copy->srcStride, copy->dstStride,
+                 copy->srcBpp, copy->dstBpp,
+                 (pbox->x1 + copy->dx + copy->srcXoff),
+                 (y1 + copy->dy + copy->srcYoff),
+                 (pbox->x1 + copy->dstXoff),
+                 (y1 + copy->dstYoff), (pbox->x2 - pbox->x1), (y2 - y1)))
+                continue;
         }
- fallback:
-#endif
-        fbBlt(src + (pbox->y1 + dy + srcYoff) * srcStride,
-              srcStride,
-              (pbox->x1 + dx + srcXoff) * srcBpp,
-              dst + (pbox->y1 + dstYoff) * dstStride,
-              dstStride,
-              (pbox->x1 + dstXoff) * dstBpp,
-              (pbox->x2 - pbox->x1) * dstBpp,
-              (pbox->y2 - pbox->y1), alu, pm, dstBpp, reverse, upsidedown);
-#ifndef FB_ACCESS_WRAPPER
- next:
 #endif
-        pbox++;
+        fbBlt(copy->src + (y1 + copy->dy + copy->srcYoff) * copy->srcStride,
+              copy->srcStride,
+              (pbox->x1 + copy->dx + copy->srcXoff) * copy->srcBpp,
+              copy->dst + (y1 + copy->dstYoff) * copy->dstStride,
+              copy->dstStride,
+              (pbox->x1 + copy->dstXoff) * copy->dstBpp,
+              (pbox->x2 - pbox->x1) * copy->dstBpp,
+              (y2 - y1), copy->alu, copy->pm, copy->dstBpp,
+              copy->reverse, copy->upsidedown);
     }
+}
+
+static void
+fbCopyNtoNBand(void *closure, int band, int nbands)
+{
+    FbCopyNtoNPtr copy = closure;
+    int h = copy->y2 - copy->y1;
+
+    fbCopyNtoNLines(copy, copy->y1 + h * band / nbands,
+                    copy->y1 + h * (band + 1) / nbands);
+}
+
+void
+fbCopyNtoN(DrawablePtr pSrcDrawable,
+           DrawablePtr pDstDrawable,
+           GCPtr pGC,
+           BoxPtr pbox,
+           int nbox,
+           int dx,
+           int dy, Bool reverse, Bool upsidedown, Pixel bitplane, void *closure)
+{
+    FbCopyNtoNRec copy;
+    int nbands = 1;
+
+    fbGetDrawable(pSrcDrawable, copy.src, copy.srcStride, copy.srcBpp,
+                  copy.srcXoff, copy.srcYoff);
+    fbGetDrawable(pDstDrawable, copy.dst, copy.dstStride, copy.dstBpp,
+                  copy.dstXoff, copy.dstYoff);
+    copy.pbox = pbox;
+    copy.nbox = nbox;
+    copy.dx = dx;
+    copy.dy = dy;
+    copy.alu = pGC ? pGC->alu : GXcopy;
+    copy.pm = pGC ? fbGetGCPrivate(pGC)->pm : FB_ALLONES;
+    copy.reverse = reverse;
+    copy.upsidedown = upsidedown;
+    copy.y1 = MAXSHORT;
+    copy.y2 = MINSHORT;
+
+    /*
+     * Bands of lines can be copied in any order as long as none of them
+     * reads lines another one writes: the source is another pixmap, or the
+     * same lines of this one.
+     */
+    if (copy.src != copy.dst || copy.dy + copy.srcYoff == copy.dstYoff) {
+        CARD64 pixels = 0;
+
+        for (; nbox--; pbox++) {
+            copy.y1 = min(copy.y1, pbox->y1);
+            copy.y2 = max(copy.y2, pbox->y2);
+            pixels += (pbox->x2 - pbox->x1) * (pbox->y2 - pbox->y1);
+        }
+        if (copy.y1 < copy.y2)
+            nbands = fbBands(pixels, copy.y2 - copy.y1);
+    }
+
+    if (nbands > 1)
+        RenderThreadsRun(nbands, fbCopyNtoNBand, &copy);
+    else
+        fbCopyNtoNLines(&copy, MINSHORT, MAXSHORT);
+
     fbFinishAccess(pDstDrawable);
     fbFinishAccess(pSrcDrawable);
 }
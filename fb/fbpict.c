@@ -30,11 +30,67 @@
 #include <string.h>
 
 #include "fb.h"
+#include "dixstruct.h"
 
 #include "picturestr.h"
 #include "mipict.h"
 #include "fbpict.h"
 
+typedef struct _FbCompositeBand {
+    pixman_image_t *src, *mask, *dest;
+} FbCompositeBandRec;
+
+typedef struct _FbComposite {
+    CARD8 op;
+    int xSrc, ySrc;
+    int xMask, yMask;
+    int xDst, yDst;
+    int width, height;
+    FbCompositeBandRec bands[FB_BAND_MAX];
+} FbCompositeRec, *FbCompositePtr;
+
+/*
+ * Composite the lines of one band.  Every band has images of its own, as
+ * pixman updates an image's cached state while compositing with it.
+ */
+static void
+fbCompositeBand(void *closure, int band, int nbands)
+{
+    FbCompositePtr composite = closure;
+    FbCompositeBandRec *images = &composite->bands[band];
+    int y1 = composite->height * band / nbands;
+    int y2 = composite->height * (band + 1) / nbands;
+
+    pixman_image_composite(composite->op, images->src, images->mask,
+                           images->dest,
+                           composite->xSrc, composite->ySrc + y1,
+                           composite->xMask, composite->yMask + y1,
+                           composite->xDst, composite->yDst + y1,
+                           composite->width, y2 - y1);
+}
+
+/*
+ * Whether bands of pDst can be composited in any order: pict doesn't read
+ * the pixmap pDst writes to.
+ */
+static Bool
+fbCompositeIndependent(PicturePtr pict, PicturePtr pDst)
+{
+    PixmapPtr pPixmap, pDstPixmap;
+    int xoff, yoff;
+
+    if (!pict)
+        return TRUE;
+    if (pict->alphaMap)
+        return FALSE;
+    /* solid fills and gradients */
+    if (!pict->pDrawable)
+        return TRUE;
+    fbGetDrawablePixmap(pict->pDrawable, pPixmap, xoff, yoff);
+    fbGetDrawablePixmap(pDst->pDrawable, pDstPixmap, xoff, yoff);
+    return pPixmap != pDstPixmap;
+}
+
 void
 fbComposite(CARD8 op,
             PicturePtr pSrc,
@@ -45,33 +101,330 @@ fbComposite(CARD8 op,
             INT16 xMask,
             INT16 yMask, INT16 xDst, INT16 yDst, CARD16 width, CARD16 height)
 {
-    pixman_image_t *src, *mask, *dest;
+    FbCompositeRec composite;
     int src_xoff, src_yoff;
     int msk_xoff, msk_yoff;
     int dst_xoff, dst_yoff;
+    int nbands = 1, band;
 
     miCompositeSourceValidate(pSrc);
     if (pMask)
         miCompositeSourceValidate(pMask);
 
-    src = image_from_pict(pSrc, FALSE, &src_xoff, &src_yoff);
-    mask = image_from_pict(pMask, FALSE, &msk_xoff, &msk_yoff);
-    dest = image_from_pict(pDst, TRUE, &dst_xoff, &dst_yoff);
+    if (!pDst->alphaMap && fbCompositeIndependent(pSrc, pDst) &&
+        fbCompositeIndependent(pMask, pDst))
+        nbands = fbBands((CARD64) width * height, height);
 
-    if (src && dest && !(pMask && !mask)) {
-        pixman_image_composite(op, src, mask, dest,
-                               xSrc + src_xoff, ySrc + src_yoff,
-                               xMask + msk_xoff, yMask + msk_yoff,
-                               xDst + dst_xoff, yDst + dst_yoff, width, height);
+    memset(composite.bands, 0, nbands * sizeof(FbCompositeBandRec));
+    for (band = 0; band < nbands; band++) {
+        FbCompositeBandRec *images = &composite.bands[band];
+
+        images->src = image_from_pict(pSrc, FALSE, &src_xoff, &src_yoff);
+        images->mask = image_from_pict(pMask, FALSE, &msk_xoff, &msk_yoff);
+        images->dest = image_from_pict(pDst, TRUE, &dst_xoff, &dst_yoff);
+        if (!images->src || !images->dest || (pMask && !images->mask))
+            goto out;
     }
 
-    free_pixman_pict(pSrc, src);
-    free_pixman_pict(pMask, mask);
-    free_pixman_pict(pDst, dest);
+    composite.op = op;
+    composite.xSrc = xSrc + src_xoff;
+    composite.ySrc = ySrc + src_yoff;
+    composite.xMask = xMask + msk_xoff;
+    composite.yMask = yMask + msk_yoff;
+    composite.xDst = xDst + dst_xoff;
+    composite.yDst = yDst + dst_yoff;
+    composite.width = width;
+    composite.height = height;
+    RenderThreadsRun(nbands, fbCompositeBand, &composite);
+
+ out:
+    for (band = 0; band < nbands; band++) {
+        free_pixman_pict(pSrc, composite.bands[band].src);
+        free_pixman_pict(pMask, composite.bands[band].mask);
+        free_pixman_pict(pDst, composite.bands[band].dest);
+    }
 }
 
 static pixman_glyph_cache_t *glyphCache;
 
+#ifndef FB_ACCESS_WRAPPER
+
+/*
+ * The glyph atlas.
+ *
+ * When the glyphs of a request share the A8 or a8r8g8b8 format of its
+ * mask, fbGlyphs adds them into the mask itself and composites the whole
+ * request with one pixman call.  The glyphs are read from an atlas per
+ * format: the first time a glyph is drawn its bits are copied onto a page
+ * there, so a line of text comes from a few packed pages rather than a
+ * pixmap per glyph.  Pages are filled a shelf at a time; when all of them
+ * are in use the one used least recently is emptied and filled again.  A
+ * glyph's private says where it is, and holds the serial of its page so
+ * that emptying the page forgets it.
+ */
+
+#define FB_ATLAS_PAGE_SIZE	512
+#define FB_ATLAS_PAGES		4
+#define FB_ATLAS_MAX_GLYPH	128     /* larger glyphs are read in place */
+
+typedef struct _FbAtlasPage {
+    CARD8 *bits;
+    CARD32 serial;              /* new each time the page is emptied */
+    CARD32 used;                /* atlasClock when last drawn from */
+    int x, y;                   /* next free spot */
+    int shelf;                  /* height of the shelf being filled */
+} FbAtlasPageRec, *FbAtlasPagePtr;
+
+typedef struct _FbAtlas {
+    int cpp;
+    int fill;                   /* page being filled */
+    FbAtlasPageRec pages[FB_ATLAS_PAGES];
+} FbAtlasRec, *FbAtlasPtr;
+
+typedef struct _FbGlyphAtlas {
+    CARD32 serial;              /* of the page the glyph is on */
+    CARD16 x, y;
+    CARD8 page;
+} FbGlyphAtlasRec, *FbGlyphAtlasPtr;
+
+static FbAtlasRec fbAtlas[2] = { {1}, {4} };
+static CARD32 atlasSerial, atlasClock;
+static DevPrivateKeyRec fbGlyphAtlasKeyRec;
+
+static void
+fbDestroyGlyphAtlas(void)
+{
+    int a, p;
+
+    for (a = 0; a < 2; a++) {
+        for (p = 0; p < FB_ATLAS_PAGES; p++) {
+            free(fbAtlas[a].pages[p].bits);
+            memset(&fbAtlas[a].pages[p], 0, sizeof(FbAtlasPageRec));
+        }
+        fbAtlas[a].fill = 0;
+    }
+}
+
+/* Find room for a w x h glyph, emptying a page if need be */
+static FbAtlasPagePtr
+fbAtlasAlloc(FbAtlasPtr atlas, int w, int h, int *x, int *y)
+{
+    FbAtlasPagePtr page = &atlas->pages[atlas->fill];
+    int p, lru;
+
+    if (page->bits && page->x + w > FB_ATLAS_PAGE_SIZE) {
+        page->y += page->shelf;
+        page->x = page->shelf = 0;
+    }
+
+    if (!page->bits || page->y + h > FB_ATLAS_PAGE_SIZE) {
+        lru = 0;
+        for (p = 0; p < FB_ATLAS_PAGES; p++) {
+            if (!atlas->pages[p].bits)
+                break;
+            if (atlas->pages[p].used < atlas->pages[lru].used)
+                lru = p;
+        }
+        if (p == FB_ATLAS_PAGES)
+            p = lru;
+
+        page = &atlas->pages[p];
+        if (!page->bits) {
+            page->bits = malloc(FB_ATLAS_PAGE_SIZE * FB_ATLAS_PAGE_SIZE *
+                                atlas->cpp);
+            if (!page->bits)
+                return NULL;
+        }
+        if (!++atlasSerial)
+            ++atlasSerial;
+        page->serial = atlasSerial;
+        page->x = page->y = page->shelf = 0;
+        atlas->fill = p;
+    }
+
+    *x = page->x;
+    *y = page->y;
+    page->x += w;
+    if (h > page->shelf)
+        page->shelf = h;
+    return page;
+}
+
+/*
+ * The bits of a glyph and their stride, from the atlas, after putting it
+ * there if it wasn't.
+ */
+static CARD8 *
+fbGlyphAtlasBits(FbAtlasPtr atlas, GlyphPtr glyph, PicturePtr pPicture,
+                 int *stride)
+{
+    FbGlyphAtlasPtr priv = dixGetPrivateAddr(&glyph->devPrivates,
+                                             &fbGlyphAtlasKeyRec);
+    int width = glyph->info.width * atlas->cpp, height = glyph->info.height;
+    int pageStride = FB_ATLAS_PAGE_SIZE * atlas->cpp;
+    FbAtlasPagePtr page = &atlas->pages[priv->page];
+    FbBits *bits;
+    FbStride bitsStride;
+    int bpp, xoff, yoff, x, y;
+    CARD8 *src, *dst;
+
+    if (priv->serial && page->serial == priv->serial) {
+        page->used = atlasClock;
+        *stride = pageStride;
+        return page->bits + priv->y * pageStride + priv->x * atlas->cpp;
+    }
+
+    fbGetDrawable(pPicture->pDrawable, bits, bitsStride, bpp, xoff, yoff);
+    bitsStride *= sizeof(FbBits);
+    src = (CARD8 *) bits + yoff * bitsStride + xoff * atlas->cpp;
+
+    if (glyph->info.width > FB_ATLAS_MAX_GLYPH ||
+        height > FB_ATLAS_MAX_GLYPH ||
+        !(page = fbAtlasAlloc(atlas, glyph->info.width, height, &x, &y))) {
+        *stride = bitsStride;
+        return src;
+    }
+
+    dst = page->bits + y * pageStride + x * atlas->cpp;
+    while (height--) {
+        memcpy(dst, src, width);
+        dst += pageStride;
+        src += bitsStride;
+    }
+
+    priv->serial = page->serial;
+    priv->page = page - atlas->pages;
+    priv->x = x;
+    priv->y = y;
+    page->used = atlasClock;
+    *stride = pageStride;
+    return page->bits + y * pageStride + x * atlas->cpp;
+}
+
+/* ADD width bytes of each of height rows of src into dst, saturating */
+static void
+fbGlyphAdd(CARD8 *dst, int dstStride, const CARD8 *src, int srcStride,
+           int width, int height)
+{
+    int i, v;
+
+    while (height--) {
+        for (i = 0; i < width; i++) {
+            v = dst[i] + src[i];
+            dst[i] = v > 0xff ? 0xff : v;
+        }
+        dst += dstStride;
+        src += srcStride;
+    }
+}
+
+/*
+ * Draw the glyphs through a mask built from the atlas.  Returns FALSE,
+ * having drawn nothing, when the atlas can't be used for them.
+ */
+static Bool
+fbGlyphsAtlas(CARD8 op,
+              PicturePtr pSrc,
+              PicturePtr pDst,
+              PictFormatPtr maskFormat,
+              INT16 xSrc, INT16 ySrc, int nlist, GlyphListPtr list,
+              GlyphPtr *glyphs)
+{
+    ScreenPtr pScreen = pDst->pDrawable->pScreen;
+    pixman_image_t *srcImage, *dstImage, *maskImage;
+    int srcXoff, srcYoff, dstXoff, dstYoff;
+    int xDst = list->xOff, yDst = list->yOff;
+    int x1 = MAXINT, y1 = MAXINT, x2 = MININT, y2 = MININT;
+    int x, y, i, n, maskStride, stride;
+    FbAtlasPtr atlas;
+    GlyphListPtr l;
+    GlyphPtr *g, glyph;
+    PicturePtr pPicture;
+    CARD8 *mask, *bits;
+
+    if (!dixPrivateKeyRegistered(&fbGlyphAtlasKeyRec))
+        return FALSE;
+    switch (maskFormat->format) {
+    case PICT_a8:
+        atlas = &fbAtlas[0];
+        break;
+    case PICT_a8r8g8b8:
+        atlas = &fbAtlas[1];
+        break;
+    default:
+        return FALSE;
+    }
+
+    /* The extents of the mask, whose format every glyph must have */
+    x = y = 0;
+    for (i = 0, l = list, g = glyphs; i < nlist; i++, l++) {
+        x += l->xOff;
+        y += l->yOff;
+        for (n = l->len; n--; g++) {
+            glyph = *g;
+            pPicture = GetGlyphPicture(glyph, pScreen);
+            if (pPicture && glyph->info.width && glyph->info.height) {
+                if (pPicture->format != maskFormat->format)
+                    return FALSE;
+                x1 = min(x1, x - glyph->info.x);
+                y1 = min(y1, y - glyph->info.y);
+                x2 = max(x2, x - glyph->info.x + glyph->info.width);
+                y2 = max(y2, y - glyph->info.y + glyph->info.height);
+            }
+            x += glyph->info.xOff;
+            y += glyph->info.yOff;
+        }
+    }
+    if (x1 >= x2 || y1 >= y2)
+        return TRUE;
+
+    maskImage = pixman_image_create_bits(maskFormat->format,
+                                         x2 - x1, y2 - y1, NULL, 0);
+    if (!maskImage)
+        return TRUE;
+    if (maskFormat->format == PICT_a8r8g8b8)
+        pixman_image_set_component_alpha(maskImage, TRUE);
+    mask = (CARD8 *) pixman_image_get_data(maskImage);
+    maskStride = pixman_image_get_stride(maskImage);
+
+    atlasClock++;
+    x = y = 0;
+    for (i = 0, l = list, g = glyphs; i < nlist; i++, l++) {
+        x += l->xOff;
+        y += l->yOff;
+        for (n = l->len; n--; g++) {
+            glyph = *g;
+            pPicture = GetGlyphPicture(glyph, pScreen);
+            if (pPicture && glyph->info.width && glyph->info.height) {
+                bits = fbGlyphAtlasBits(atlas, glyph, pPicture, &stride);
+                fbGlyphAdd(mask + (y - glyph->info.y - y1) * maskStride +
+                           (x - glyph->info.x - x1) * atlas->cpp, maskStride,
+                           bits, stride, glyph->info.width * atlas->cpp,
+                           glyph->info.height);
+            }
+            x += glyph->info.xOff;
+            y += glyph->info.yOff;
+        }
+    }
+
+    if ((srcImage = image_from_pict(pSrc, FALSE, &srcXoff, &srcYoff))) {
+        if ((dstImage = image_from_pict(pDst, TRUE, &dstXoff, &dstYoff))) {
+            pixman_image_composite32(op, srcImage, maskImage, dstImage,
+                                     xSrc + srcXoff + x1 - xDst,
+                                     ySrc + srcYoff + y1 - yDst,
+                                     0, 0,
+                                     x1 + dstXoff, y1 + dstYoff,
+                                     x2 - x1, y2 - y1);
+            free_pixman_pict(pDst, dstImage);
+        }
+        free_pixman_pict(pSrc, srcImage);
+    }
+    pixman_image_unref(maskImage);
+    return TRUE;
+}
+
+#endif /* FB_ACCESS_WRAPPER */
+
 void
 fbDestroyGlyphCache(void)
 {
@@ -80,6 +433,9 @@ fbDestroyGlyphCache(void)
 	pixman_glyph_cache_destroy (glyphCache);
 	glyphCache = NULL;
     }
+#ifndef FB_ACCESS_WRAPPER
+    fbDestroyGlyphAtlas();
+#endif
 }
 
 static void
@@ -114,6 +470,12 @@ fbGlyphs(CARD8 op,
 
     miCompositeSourceValidate(pSrc);
 
+#ifndef FB_ACCESS_WRAPPER
+    if (maskFormat && fbGlyphsAtlas(op, pSrc, pDst, maskFormat, xSrc, ySrc,
+                                    nlist, list, glyphs))
+        return;
+#endif
+
     n_glyphs = 0;
     for (i = 0; i < nlist; ++i)
 	n_glyphs += list[i].len;
@@ -471,17 +833,183 @@ image_from_pict_internal(PicturePtr pict, Bool has_clip, int *xoff, int *yoff,
     return image;
 }
 
+/*
+ * Building the pixman image of a Picture -- bits, clip, transform, filter,
+ * repeat -- costs more than a small composite does, so each Picture on a
+ * drawable keeps its last two images, one as a source and one with its
+ * clip as a destination, and hands them out again until something
+ * changes.  ChangePicture, SetPictureTransform, SetPictureFilter and
+ * ValidatePicture, which is where clip changes arrive, throw them away;
+ * the pixmap, its bits and the Picture's place in it are compared on
+ * every use.  An image is lent to one caller at a time, anyone else asking
+ * meanwhile gets a fresh one, as do Pictures with alpha maps and
+ * Pictures with changes not yet validated.  wfb doesn't cache, as its
+ * images bracket access to the pixmap.
+ */
+typedef struct _FbPictureImage {
+    pixman_image_t *image;
+    Bool busy;
+    int xoff, yoff;             /* what image_from_pict returned */
+    PixmapPtr pixmap;           /* what it was made from */
+    unsigned long serialNumber;
+    void *bits;
+    int devKind;
+    int pix_xoff, pix_yoff;
+    int x, y;
+} FbPictureImageRec, *FbPictureImagePtr;
+
+typedef struct _FbPicturePriv {
+    FbPictureImageRec images[2];        /* as a source, and with the clip */
+} FbPicturePrivRec, *FbPicturePrivPtr;
+
+#define fbGetPicturePrivate(pict) ((FbPicturePrivPtr) \
+    dixLookupPrivate(&(pict)->devPrivates, \
+                     &fbGetScreenPrivate((pict)->pDrawable->pScreen)-> \
+                     picturePrivateKeyRec))
+
+/* The cached images of pict, if it can have any */
+static FbPicturePrivPtr
+fbPicturePrivate(PicturePtr pict)
+{
+#ifdef FB_ACCESS_WRAPPER
+    return NULL;
+#else
+    if (!pict || !pict->pDrawable ||
+        !dixPrivateKeyRegistered(&fbGetScreenPrivate(pict->pDrawable->pScreen)->
+                                 picturePrivateKeyRec))
+        return NULL;
+    return fbGetPicturePrivate(pict);
+#endif
+}
+
+static void
+fbPictureImageFree(FbPictureImagePtr cached)
+{
+    /* one on loan is freed when it comes back */
+    if (cached->image && !cached->busy)
+        pixman_image_unref(cached->image);
+    cached->image = NULL;
+    cached->busy = FALSE;
+}
+
+static void
+fbPictureImagesFree(PicturePtr pict)
+{
+    FbPicturePrivPtr pPriv = fbPicturePrivate(pict);
+
+    if (pPriv) {
+        fbPictureImageFree(&pPriv->images[0]);
+        fbPictureImageFree(&pPriv->images[1]);
+    }
+}
+
 pixman_image_t *
 image_from_pict(PicturePtr pict, Bool has_clip, int *xoff, int *yoff)
 {
-    return image_from_pict_internal(pict, has_clip, xoff, yoff, FALSE);
+    FbPicturePrivPtr pPriv = fbPicturePrivate(pict);
+    FbPictureImagePtr cached;
+    pixman_image_t *image;
+    PixmapPtr pixmap;
+    int pix_xoff, pix_yoff;
+
+    if (!pPriv || pict->alphaMap ||
+        (pict->serialNumber & GC_CHANGE_SERIAL_BIT) ||
+        (cached = &pPriv->images[has_clip ? 1 : 0])->busy)
+        return image_from_pict_internal(pict, has_clip, xoff, yoff, FALSE);
+
+    fbGetDrawablePixmap(pict->pDrawable, pixmap, pix_xoff, pix_yoff);
+    if (cached->image &&
+        (cached->pixmap != pixmap ||
+         cached->serialNumber != pixmap->drawable.serialNumber ||
+         cached->bits != pixmap->devPrivate.ptr ||
+         cached->devKind != pixmap->devKind ||
+         cached->pix_xoff != pix_xoff || cached->pix_yoff != pix_yoff ||
+         cached->x != pict->pDrawable->x || cached->y != pict->pDrawable->y))
+        fbPictureImageFree(cached);
+
+    if (!cached->image) {
+        image = image_from_pict_internal(pict, has_clip, &cached->xoff,
+                                         &cached->yoff, FALSE);
+        if (!image)
+            return NULL;
+        cached->image = image;
+        cached->pixmap = pixmap;
+        cached->serialNumber = pixmap->drawable.serialNumber;
+        cached->bits = pixmap->devPrivate.ptr;
+        cached->devKind = pixmap->devKind;
+        cached->pix_xoff = pix_xoff;
+        cached->pix_yoff = pix_yoff;
+        cached->x = pict->pDrawable->x;
+        cached->y = pict->pDrawable->y;
+    }
+
+    cached->busy = TRUE;
+    *xoff = cached->xoff;
+    *yoff = cached->yoff;
+    return cached->image;
 }
 
 void
 free_pixman_pict(PicturePtr pict, pixman_image_t * image)
 {
-    if (image)
-        pixman_image_unref(image);
+    FbPicturePrivPtr pPriv = fbPicturePrivate(pict);
+    int i;
+
+    if (!image)
+        return;
+    for (i = 0; pPriv && i < 2; i++)
+        if (pPriv->images[i].image == image && pPriv->images[i].busy) {
+            pPriv->images[i].busy = FALSE;
+            return;
+        }
+    pixman_image_unref(image);
+}
+
+static void
+fbDestroyPicture(PicturePtr pPicture)
+{
+    FbScreenPrivPtr pScrPriv = fbGetScreenPrivate(pPicture->pDrawable->pScreen);
+
+    fbPictureImagesFree(pPicture);
+    (*pScrPriv->DestroyPicture) (pPicture);
+}
+
+static void
+fbChangePicture(PicturePtr pPicture, Mask mask)
+{
+    FbScreenPrivPtr pScrPriv = fbGetScreenPrivate(pPicture->pDrawable->pScreen);
+
+    fbPictureImagesFree(pPicture);
+    (*pScrPriv->ChangePicture) (pPicture, mask);
+}
+
+static void
+fbValidatePicture(PicturePtr pPicture, Mask mask)
+{
+    FbScreenPrivPtr pScrPriv = fbGetScreenPrivate(pPicture->pDrawable->pScreen);
+
+    fbPictureImagesFree(pPicture);
+    (*pScrPriv->ValidatePicture) (pPicture, mask);
+}
+
+static int
+fbChangePictureTransform(PicturePtr pPicture, PictTransform * transform)
+{
+    FbScreenPrivPtr pScrPriv = fbGetScreenPrivate(pPicture->pDrawable->pScreen);
+
+    fbPictureImagesFree(pPicture);
+    return (*pScrPriv->ChangePictureTransform) (pPicture, transform);
+}
+
+static int
+fbChangePictureFilter(PicturePtr pPicture, int filter, xFixed * params,
+                      int nparams)
+{
+    FbScreenPrivPtr pScrPriv = fbGetScreenPrivate(pPicture->pDrawable->pScreen);
+
+    fbPictureImagesFree(pPicture);
+    return (*pScrPriv->ChangePictureFilter) (pPicture, filter, params,
+                                             nparams);
 }
 
 Bool
@@ -489,10 +1017,32 @@ fbPictureInit(ScreenPtr pScreen, PictFormatPtr formats, int nformats)
 {
 
     PictureScreenPtr ps;
+    FbScreenPrivPtr pScrPriv;
 
     if (!miPictureInit(pScreen, formats, nformats))
         return FALSE;
     ps = GetPictureScreen(pScreen);
+    pScrPriv = fbGetScreenPrivate(pScreen);
+    if (!dixRegisterScreenSpecificPrivateKey(pScreen,
+                                             &pScrPriv->picturePrivateKeyRec,
+                                             PRIVATE_PICTURE,
+                                             sizeof(FbPicturePrivRec)))
+        return FALSE;
+#ifndef FB_ACCESS_WRAPPER
+    if (!dixRegisterPrivateKey(&fbGlyphAtlasKeyRec, PRIVATE_GLYPH,
+                               sizeof(FbGlyphAtlasRec)))
+        return FALSE;
+#endif
+    pScrPriv->DestroyPicture = ps->DestroyPicture;
+    ps->DestroyPicture = fbDestroyPicture;
+    pScrPriv->ChangePicture = ps->ChangePicture;
+    ps->ChangePicture = fbChangePicture;
+    pScrPriv->ValidatePicture = ps->ValidatePicture;
+    ps->ValidatePicture = fbValidatePicture;
+    pScrPriv->ChangePictureTransform = ps->ChangePictureTransform;
+    ps->ChangePictureTransform = fbChangePictureTransform;
+    pScrPriv->ChangePictureFilter = ps->ChangePictureFilter;
+    ps->ChangePictureFilter = fbChangePictureFilter;
     ps->Composite = fbComposite;
     ps->Glyphs = fbGlyphs;
     ps->UnrealizeGlyph = fbUnrealizeGlyph;
@@ -116,6 +116,8 @@ fbSetupScreen(ScreenPtr pScreen, void *pbits, /* pointer to screen bitmap */
     if (!fbAllocatePrivates(pScreen))
         return FALSE;
 
+    fbSetSimdLevel(-1);
+
     if (!dixRegisterPrivateKey(&fbScreenPrivKeyRec, PRIVATE_SCREEN, 0))
         return FALSE;
 
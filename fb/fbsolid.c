@@ -28,6 +28,129 @@
 
 #include "fb.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#ifdef FB_SIMD_AVX2
+#include <immintrin.h>
+#endif
+#elif defined(FB_SIMD_VECTOR)
+#include <arm_neon.h>
+#endif
+
+#ifdef FB_SIMD_VECTOR
+/*
+ * The middle words of a line, n of them: with and == 0 they are only
+ * written, and stream says whether to go around the cache.
+ */
+typedef void (*FbSolidSpanProc) (FbBits * dst, int n, FbBits and, FbBits xor,
+                                 Bool stream);
+
+static inline FbBits *
+fbSolidWords(FbBits * dst, int n, FbBits and, FbBits xor)
+{
+    while (n--) {
+        *dst = FbDoRRop(*dst, and, xor);
+        dst++;
+    }
+    return dst;
+}
+
+#ifdef __SSE2__
+static void
+fbSolidSpanSSE2(FbBits * dst, int n, FbBits and, FbBits xor, Bool stream)
+{
+    const __m128i a = _mm_set1_epi32(and), x = _mm_set1_epi32(xor);
+    int head = (-(uintptr_t) dst >> 2) & 3;
+
+    dst = fbSolidWords(dst, head, and, xor);
+    n -= head;
+    if (!and && stream) {
+        for (; n >= 4; n -= 4, dst += 4)
+            _mm_stream_si128((__m128i *) dst, x);
+        _mm_sfence();
+    }
+    else if (!and) {
+        for (; n >= 4; n -= 4, dst += 4)
+            _mm_store_si128((__m128i *) dst, x);
+    }
+    else {
+        for (; n >= 4; n -= 4, dst += 4) {
+            __m128i d = _mm_load_si128((__m128i *) dst);
+
+            _mm_store_si128((__m128i *) dst,
+                            _mm_xor_si128(_mm_and_si128(d, a), x));
+        }
+    }
+    fbSolidWords(dst, n, and, xor);
+}
+
+#ifdef FB_SIMD_AVX2
+__attribute__((target("avx2")))
+static void
+fbSolidSpanAVX2(FbBits * dst, int n, FbBits and, FbBits xor, Bool stream)
+{
+    const __m256i a = _mm256_set1_epi32(and), x = _mm256_set1_epi32(xor);
+    int head = (-(uintptr_t) dst >> 2) & 7;
+
+    dst = fbSolidWords(dst, head, and, xor);
+    n -= head;
+    if (!and && stream) {
+        for (; n >= 8; n -= 8, dst += 8)
+            _mm256_stream_si256((__m256i *) dst, x);
+        _mm_sfence();
+    }
+    else if (!and) {
+        for (; n >= 8; n -= 8, dst += 8)
+            _mm256_store_si256((__m256i *) dst, x);
+    }
+    else {
+        for (; n >= 8; n -= 8, dst += 8) {
+            __m256i d = _mm256_load_si256((__m256i *) dst);
+
+            _mm256_store_si256((__m256i *) dst,
+                               _mm256_xor_si256(_mm256_and_si256(d, a), x));
+        }
+    }
+    fbSolidWords(dst, n, and, xor);
+}
+#endif
+
+static const FbSolidSpanProc fbSolidSpans[] = {
+    NULL,
+    fbSolidSpanSSE2,
+#ifdef FB_SIMD_AVX2
+    fbSolidSpanAVX2,
+#endif
+};
+
+#else
+
+/* NEON has no cache-bypassing store worth having here */
+static void
+fbSolidSpanNEON(FbBits * dst, int n, FbBits and, FbBits xor, Bool stream)
+{
+    const uint32x4_t a = vdupq_n_u32(and), x = vdupq_n_u32(xor);
+
+    if (!and) {
+        for (; n >= 8; n -= 8, dst += 8) {
+            vst1q_u32(dst, x);
+            vst1q_u32(dst + 4, x);
+        }
+    }
+    else {
+        for (; n >= 4; n -= 4, dst += 4)
+            vst1q_u32(dst, veorq_u32(vandq_u32(vld1q_u32(dst), a), x));
+    }
+    fbSolidWords(dst, n, and, xor);
+}
+
+static const FbSolidSpanProc fbSolidSpans[] = {
+    NULL,
+    fbSolidSpanNEON,
+};
+#endif
+#endif
+
 void
 fbSolid(FbBits * dst,
         FbStride dstStride,
@@ -37,6 +160,11 @@ fbSolid(FbBits * dst,
     int n, nmiddle;
     int startbyte, endbyte;
 
+#ifdef FB_SIMD_VECTOR
+    FbSolidSpanProc span = fbSolidSpans[fbSimdLevel];
+    Bool stream = (size_t) (width >> 3) * height >= FB_SIMD_STREAM_BYTES;
+#endif
+
     dst += dstX >> FB_SHIFT;
     dstX &= FB_MASK;
     FbMaskBitsBytes(dstX, width, and == 0, startmask, startbyte,
@@ -50,6 +178,13 @@ fbSolid(FbBits * dst,
             dst++;
         }
         n = nmiddle;
+#ifdef FB_SIMD_VECTOR
+        if (span && n >= FB_SIMD_MIN) {
+            (*span) (dst, n, and, xor, stream);
+            dst += n;
+            n = 0;
+        }
+#endif
         if (!and)
             while (n--)
                 WRITE(dst++, xor);
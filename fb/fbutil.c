@@ -25,6 +25,7 @@
 #endif
 
 #include "fb.h"
+#include "dixstruct.h"
 
 FbBits
 fbReplicatePixel(Pixel p, int bpp)
@@ -39,6 +40,54 @@ fbReplicatePixel(Pixel p, int bpp)
     return b;
 }
 
+int fbSimdLevel;
+
+/*
+ * Select the kernels of fbSolid and fbBlt: 0 for the plain loops, 1 for
+ * SSE2 or NEON, 2 for AVX2.  A negative level or one this machine can't
+ * run picks the best that it can.  Returns the level in use.
+ */
+int
+fbSetSimdLevel(int level)
+{
+    int best = 0;
+
+#ifdef FB_SIMD_VECTOR
+    best = FB_SIMD_VECTOR;
+#endif
+#ifdef FB_SIMD_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        best = FB_SIMD_AVX2;
+#endif
+    if (level < 0 || level > best)
+        level = best;
+    fbSimdLevel = level;
+    return level;
+}
+
+/*
+ * How many bands to split an operation on this many pixels over this many
+ * lines into, so that the render threads can share it; 1 to do it in one
+ * go.  wfb's access wrappers aren't known to be safe to call from other
+ * threads.
+ */
+int
+fbBands(CARD64 pixels, int lines)
+{
+#ifdef FB_ACCESS_WRAPPER
+    return 1;
+#else
+    int n = RenderThreadsAvailable();
+
+    if (n <= 1 || pixels < FB_BAND_MIN_PIXELS)
+        return 1;
+    n = min(n, FB_BAND_MAX);
+    n = min(n, lines / FB_BAND_MIN_ROWS);
+    return max(n, 1);
+#endif
+}
+
 #define O 0
 #define I FB_ALLONES
 
@@ -4,6 +4,7 @@
 #define fbArc16 wfbArc16
 #define fbArc32 wfbArc32
 #define fbArc8 wfbArc8
+#define fbBands wfbBands
 #define fbBlt wfbBlt
 #define fbBltOne wfbBltOne
 #define fbBltPlane wfbBltPlane
@@ -110,10 +111,12 @@
 #define fbSegment wfbSegment
 #define fbSelectBres wfbSelectBres
 #define fbSetSpans wfbSetSpans
+#define fbSetSimdLevel wfbSetSimdLevel
 #define fbSetupScreen wfbSetupScreen
 #define fbSetVisualTypes wfbSetVisualTypes
 #define fbSetVisualTypesAndMasks wfbSetVisualTypesAndMasks
 #define _fbSetWindowPixmap _wfbSetWindowPixmap
+#define fbSimdLevel wfbSimdLevel
 #define fbSolid wfbSolid
 #define fbSolidBoxClipped wfbSolidBoxClipped
 #define fbTrapezoids wfbTrapezoids
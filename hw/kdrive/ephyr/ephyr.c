@@ -534,6 +534,7 @@ ephyrRandRSetConfig(ScreenPtr pScreen,
         if (!KdShadowSet(screen->pScreen,
                          scrpriv->randr, ephyrShadowUpdate, ephyrWindowLinear))
             goto bail4;
+        shadowSetThreaded(screen->pScreen, TRUE);
     }
     else {
 #ifdef GLAMOR
@@ -719,10 +720,14 @@ ephyrCreateResources(ScreenPtr pScreen)
     EPHYR_LOG("mark pScreen=%p mynum=%d shadow=%d",
               pScreen, pScreen->myNum, scrpriv->shadow);
 
-    if (scrpriv->shadow)
-        return KdShadowSet(pScreen,
-                           scrpriv->randr,
-                           ephyrShadowUpdate, ephyrWindowLinear);
+    if (scrpriv->shadow) {
+        if (!KdShadowSet(pScreen,
+                         scrpriv->randr, ephyrShadowUpdate, ephyrWindowLinear))
+            return FALSE;
+        /* ephyrWindowLinear only points into the host image */
+        shadowSetThreaded(pScreen, TRUE);
+        return TRUE;
+    }
     else {
 #ifdef GLAMOR
         if (ephyr_glamor) {
@@ -64,6 +64,7 @@ from The Open Group.
 #include <sys/shm.h>
 #endif                          /* HAS_SHM */
 #include "dix.h"
+#include "dixstruct.h"
 #include "miline.h"
 #include "glx_extinit.h"
 #include "randrstr.h"
@@ -941,6 +942,9 @@ vfbScreenInit(ScreenPtr pScreen, int argc, char **argv)
 
     miDCInitialize(pScreen, &vfbPointerCursorFuncs);
 
+    /* Rendering to pixmaps is plain fb with no shared state */
+    DispatchThreadAllowScreen(pScreen);
+
     vfbWriteXWDFileHeader(pScreen);
 
     pScreen->blackPixel = pvfb->blackPixel;
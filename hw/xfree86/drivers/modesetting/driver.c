@@ -1511,6 +1511,8 @@ CreateScreenResources(ScreenPtr pScreen)
         if (!shadowAdd(pScreen, rootPixmap, msUpdatePacked, msShadowWindow,
                        0, 0))
             return FALSE;
+        /* msShadowWindow only points into the dumb buffer */
+        shadowSetThreaded(pScreen, TRUE);
     }
 
     err = drmModeDirtyFB(ms->fd, ms->drmmode.fb_id, NULL, 0);
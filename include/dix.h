@@ -285,6 +285,11 @@ extern _X_EXPORT Atom MakeAtom(const char * /*string */ ,
                                unsigned /*len */ ,
                                Bool /*makeit */ );
 
+extern _X_EXPORT Bool MakeAtoms(const char *const * /*names */ ,
+                                int /*count */ ,
+                                Bool /*makeit */ ,
+                                Atom * /*atoms */ );
+
 extern _X_EXPORT Bool ValidAtom(Atom /*atom */ );
 
 extern _X_EXPORT const char *NameForAtom(Atom /*atom */ );
@@ -135,6 +135,46 @@ extern Bool SmartScheduleSignalEnable;
 extern void SmartScheduleStartTimer(void);
 extern void SmartScheduleStopTimer(void);
 
+/*
+ * Request statistics, see dix/reqstats.c
+ */
+extern Bool RequestStatsEnable;
+extern int RequestStatsInterval;
+extern void RequestStatsInit(void);
+extern void RequestStatsRecord(ClientPtr client, CARD64 elapsed);
+extern void RequestStatsDump(void);
+
+/*
+ * Threaded request dispatch, see dix/dispatchthreads.c
+ */
+extern int DispatchThreadCount;
+extern volatile char DispatchThreadBusy[MAXCLIENTS];
+extern void DispatchThreadsInit(void);
+extern void DispatchThreadAllowScreen(ScreenPtr pScreen);
+extern Bool DispatchThreadQueue(ClientPtr client);
+extern void DispatchThreadCancel(ClientPtr client);
+extern void DispatchThreadBarrierSlow(int client);
+
+/* Wait until no request from this client is running on another thread */
+static inline void
+DispatchThreadBarrier(int client)
+{
+    if (DispatchThreadBusy[client])
+        DispatchThreadBarrierSlow(client);
+}
+
+/*
+ * Render threads for splitting large operations into bands, see
+ * dix/renderthreads.c
+ */
+typedef void (*RenderBandProcPtr) (void *closure, int band, int nbands);
+
+extern int RenderThreadCount;
+extern void RenderThreadsInit(void);
+extern _X_EXPORT int RenderThreadsAvailable(void);
+extern _X_EXPORT void RenderThreadsRun(int nbands, RenderBandProcPtr proc,
+                                       void *closure);
+
 /* Client has requests queued or data on the network */
 void mark_client_ready(ClientPtr client);
 
@@ -30,6 +30,12 @@ extern _X_EXPORT char *SeatId;
 extern _X_EXPORT char *ConnectionInfo;
 extern _X_EXPORT sig_atomic_t inSignalContext;
 
+/* Rectangles new Damage objects keep at most, 0 for no limit (-damagerects) */
+extern _X_EXPORT int DamageMaxRects;
+
+/* Whether DAMAGE extension objects batch their reports (-damagebatch) */
+extern _X_EXPORT Bool DamageBatchReports;
+
 #ifdef PANORAMIX
 extern _X_EXPORT Bool PanoramiXExtensionDisabledHack;
 #endif
@@ -603,6 +603,10 @@ extern Mask GetEventMask(DeviceIntPtr dev, xEvent *ev, InputClientsPtr clients);
 extern Mask GetEventFilter(DeviceIntPtr dev, xEvent *event);
 extern Bool WindowXI2MaskIsset(DeviceIntPtr dev, WindowPtr win, xEvent *ev);
 extern int GetXI2MaskByte(XI2Mask *mask, DeviceIntPtr dev, int event_type);
+extern Bool DeliveryCacheLookup(DeviceIntPtr dev, WindowPtr win, xEvent *ev,
+                                Mask filter, InputClientsPtr clients,
+                                InputClientsPtr **list, int *n);
+extern void DeliveryCacheInvalidate(WindowPtr win);
 void FixUpEventFromWindow(SpritePtr pSprite,
                           xEvent *xE,
                           WindowPtr pWin, Window child, Bool calcChild);
@@ -125,6 +125,12 @@ extern _X_EXPORT void SetCriticalOutputPending(void);
 extern _X_EXPORT int WriteToClient(ClientPtr /*who */ , int /*count */ ,
                                    const void * /*buf */ );
 
+extern _X_EXPORT int WriteToClientNoCopy(ClientPtr /*who */ , int /*count */ ,
+                                         void * /*buf */ );
+
+extern _X_EXPORT int WriteToClientLend(ClientPtr /*who */ , int /*count */ ,
+                                       void ** /*buf */ );
+
 extern _X_EXPORT void ResetOsBuffers(void);
 
 extern _X_EXPORT void InitConnectionLimits(void);
@@ -183,6 +189,7 @@ extern void ForceClockId(clockid_t /* forced_clockid */);
 
 extern _X_EXPORT CARD32 GetTimeInMillis(void);
 extern _X_EXPORT CARD64 GetTimeInMicros(void);
+extern _X_EXPORT CARD64 GetTimeInNanos(void);
 
 extern _X_EXPORT void AdjustWaitForDelay(void *waitTime, int newdelay);
 
@@ -68,6 +68,27 @@ typedef struct pixman_region16_data RegDataRec, *RegDataPtr;
 extern _X_EXPORT BoxRec RegionEmptyBox;
 extern _X_EXPORT RegDataRec RegionEmptyData;
 extern _X_EXPORT RegDataRec RegionBrokenData;
+
+/*
+ * Region data pool counters.  Allocations and frees only count the data
+ * the server itself allocates and releases; pixman's go straight to
+ * malloc and free.
+ */
+typedef struct _RegionPoolStats {
+    unsigned long allocs;       /* RegionDataAlloc calls */
+    unsigned long hits;         /* ... served from the pool */
+    unsigned long frees;        /* RegionDataFree calls */
+    unsigned long pooled;       /* ... kept in the pool */
+} RegionPoolStatsRec, *RegionPoolStatsPtr;
+
+extern _X_EXPORT RegionPoolStatsRec RegionPoolStats;
+/* threads other than the main one using regions; while non-zero the pool
+ * is bypassed */
+extern _X_EXPORT volatile int RegionPoolThreads;
+
+extern _X_EXPORT RegDataPtr RegionDataAlloc(int /*n */ );
+
+extern _X_EXPORT void RegionDataFree(RegDataPtr /*data */ );
 static inline Bool
 RegionNil(RegionPtr reg)
 {
@@ -141,11 +162,9 @@ RegionInit(RegionPtr _pReg, BoxPtr _rect, int _size)
         (_pReg)->data = (RegDataPtr) NULL;
     }
     else {
-        size_t rgnSize;
         (_pReg)->extents = RegionEmptyBox;
-        if (((_size) > 1) && ((rgnSize = RegionSizeof(_size)) > 0) &&
-            (((_pReg)->data = (RegDataPtr) malloc(rgnSize)) != NULL)) {
-            (_pReg)->data->size = (_size);
+        if (((_size) > 1) &&
+            (((_pReg)->data = RegionDataAlloc(_size)) != NULL)) {
             (_pReg)->data->numRects = 0;
         }
         else
@@ -163,7 +182,7 @@ static inline void
 RegionUninit(RegionPtr _pReg)
 {
     if ((_pReg)->data && (_pReg)->data->size) {
-        free((_pReg)->data);
+        RegionDataFree((_pReg)->data);
         (_pReg)->data = NULL;
     }
 }
@@ -212,6 +231,8 @@ RegionNull(RegionPtr _pReg)
 
 extern _X_EXPORT void InitRegions(void);
 
+extern _X_EXPORT int RegionSetSimdLevel(int /*level */ );
+
 extern _X_EXPORT RegionPtr RegionCreate(BoxPtr /*rect */ ,
                                         int /*size */ );
 
@@ -232,4 +232,18 @@ extern _X_EXPORT void PrintWindowTree(void);
 extern _X_EXPORT void PrintPassiveGrabs(void);
 
 extern _X_EXPORT VisualPtr WindowGetVisual(WindowPtr /*pWin*/);
+
+/* pointer picking index, see dix/windowpick.c */
+extern _X_EXPORT void WindowPickWalked(WindowPtr /*pParent */ ,
+                                       int /*n */ );
+
+extern _X_EXPORT Bool WindowPickCandidates(WindowPtr /*pParent */ ,
+                                           int /*x */ ,
+                                           int /*y */ ,
+                                           WindowPtr ** /*list */ ,
+                                           int * /*n */ );
+
+extern _X_EXPORT void WindowPickInvalidate(WindowPtr /*pParent */ );
+
+extern _X_EXPORT void WindowPickFree(WindowPtr /*pWin */ );
 #endif                          /* WINDOW_H */
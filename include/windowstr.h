@@ -93,6 +93,9 @@ typedef struct _WindowOpt {
     RegionPtr inputShape;       /* default: NULL */
     struct _OtherInputMasks *inputMasks;        /* default: NULL */
     DevCursorList deviceCursors;        /* default: NULL */
+    struct _PropertyIndex *propIndex;   /* default: NULL */
+    struct _WindowPick *pickIndex;      /* default: NULL */
+    struct _DeliveryCache *deliveryCache;       /* default: NULL */
 } WindowOptRec, *WindowOptPtr;
 
 #define BackgroundPixel	    2L
@@ -65,6 +65,7 @@ in this Software without prior written authorization from The Open Group.
 #define QUEUE_MAXIMUM_SIZE                4096
 #define QUEUE_DROP_BACKTRACE_FREQUENCY     100
 #define QUEUE_DROP_BACKTRACE_MAX            10
+#define QUEUE_COALESCE_LOOKAHEAD            16
 
 #define EnqueueScreen(dev) dev->spriteInfo->sprite->pEnqueueScreen
 #define DequeueScreen(dev) dev->spriteInfo->sprite->pDequeueScreen
@@ -73,86 +74,107 @@ typedef struct _Event {
     InternalEvent *events;
     ScreenPtr pScreen;
     DeviceIntPtr pDev;          /* device this event _originated_ from */
+    unsigned int seq;           /* odd while mieqEnqueue rewrites a motion */
 } EventRec, *EventPtr;
 
+typedef struct _EventRing {
+    size_t nevents;             /* the number of buckets, a power of two */
+    EventRec events[];
+} EventRingRec, *EventRingPtr;
+
+/*
+ * The queue is a ring written by mieqEnqueue, which callers serialise with
+ * input_lock(), and read by mieqProcessInputEvents on the main thread
+ * without taking the lock.  The indices only ever increase; an event's
+ * bucket is its index modulo the size of the ring.
+ *
+ * The main thread claims the event at head by moving head on, copies it,
+ * and then moves done on to hand the bucket back.  mieqEnqueue only fills
+ * buckets behind done, and only rewrites the last event in place, to fold
+ * motion into it, while head says that event is unclaimed: it marks the
+ * bucket first and checks head after, and the main thread waits for the
+ * mark to go before copying.
+ *
+ * Growing the ring moves the buckets, events and all, to a bigger array at
+ * the same indices, so the events pending and the one being copied stay
+ * put.  The old array is freed once the main thread isn't reading it.
+ */
 typedef struct _EventQueue {
     HWEventQueueType head, tail;        /* long for SetInputCheck */
+    HWEventQueueType done;      /* events before this are copied out */
     CARD32 lastEventTime;       /* to avoid time running backwards */
     int lastMotion;             /* device ID if last event motion? */
-    EventRec *events;           /* our queue as an array */
-    size_t nevents;             /* the number of buckets in our queue */
+    EventRingPtr ring;          /* our queue */
+    Bool reading;               /* main thread is reading the ring */
     size_t dropped;             /* counter for number of consecutive dropped events */
     mieqHandler handlers[128];  /* custom event handler */
 } EventQueueRec, *EventQueuePtr;
 
 static EventQueueRec miEventQueue;
 
+static inline EventPtr
+mieqBucket(EventRingPtr ring, unsigned int index)
+{
+    return &ring->events[index & (ring->nevents - 1)];
+}
+
 static size_t
 mieqNumEnqueued(EventQueuePtr eventQueue)
 {
-    size_t n_enqueued = 0;
-
-    if (eventQueue->nevents) {
-        /* % is not well-defined with negative numbers... sigh */
-        n_enqueued = eventQueue->tail - eventQueue->head + eventQueue->nevents;
-        if (n_enqueued >= eventQueue->nevents)
-            n_enqueued -= eventQueue->nevents;
-    }
-    return n_enqueued;
+    return (unsigned int) eventQueue->tail -
+        (unsigned int) __atomic_load_n(&eventQueue->done, __ATOMIC_ACQUIRE);
 }
 
 /* Pre-condition: Called with input_lock held */
 static Bool
 mieqGrowQueue(EventQueuePtr eventQueue, size_t new_nevents)
 {
-    size_t i, n_enqueued, first_hunk;
-    EventRec *new_events;
+    EventRingPtr ring, old;
+    size_t i, old_nevents;
+    unsigned int first;
 
     if (!eventQueue) {
         ErrorF("[mi] mieqGrowQueue called with a NULL eventQueue\n");
         return FALSE;
     }
 
-    if (new_nevents <= eventQueue->nevents)
+    old = eventQueue->ring;
+    old_nevents = old ? old->nevents : 0;
+    if (new_nevents <= old_nevents)
         return FALSE;
 
-    new_events = calloc(new_nevents, sizeof(EventRec));
-    if (new_events == NULL) {
+    ring = calloc(1, sizeof(EventRingRec) + new_nevents * sizeof(EventRec));
+    if (ring == NULL) {
         ErrorF("[mi] mieqGrowQueue memory allocation error.\n");
         return FALSE;
     }
+    ring->nevents = new_nevents;
 
-    n_enqueued = mieqNumEnqueued(eventQueue);
-
-    /* First copy the existing events */
-    first_hunk = eventQueue->nevents - eventQueue->head;
-    memcpy(new_events,
-           &eventQueue->events[eventQueue->head],
-           first_hunk * sizeof(EventRec));
-    memcpy(&new_events[first_hunk],
-           eventQueue->events, eventQueue->head * sizeof(EventRec));
+    /* First move the existing buckets, at the same indices */
+    first = __atomic_load_n(&eventQueue->done, __ATOMIC_ACQUIRE);
+    for (i = 0; i < old_nevents; i++)
+        *mieqBucket(ring, first + i) = *mieqBucket(old, first + i);
 
     /* Initialize the new portion */
-    for (i = eventQueue->nevents; i < new_nevents; i++) {
+    for (i = old_nevents; i < new_nevents; i++) {
         InternalEvent *evlist = InitEventList(1);
 
         if (!evlist) {
             size_t j;
 
-            for (j = 0; j < i; j++)
-                FreeEventList(new_events[j].events, 1);
-            free(new_events);
+            for (j = old_nevents; j < i; j++)
+                FreeEventList(mieqBucket(ring, first + j)->events, 1);
+            free(ring);
             return FALSE;
         }
-        new_events[i].events = evlist;
+        mieqBucket(ring, first + i)->events = evlist;
     }
 
-    /* And update our record */
-    eventQueue->tail = n_enqueued;
-    eventQueue->head = 0;
-    eventQueue->nevents = new_nevents;
-    free(eventQueue->events);
-    eventQueue->events = new_events;
+    /* And swap it in once the main thread is done with the old one */
+    __atomic_store_n(&eventQueue->ring, ring, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&eventQueue->reading, __ATOMIC_SEQ_CST))
+        ;
+    free(old);
 
     return TRUE;
 }
@@ -175,15 +197,44 @@ mieqInit(void)
 void
 mieqFini(void)
 {
+    EventRingPtr ring = miEventQueue.ring;
     int i;
 
-    for (i = 0; i < miEventQueue.nevents; i++) {
-        if (miEventQueue.events[i].events != NULL) {
-            FreeEventList(miEventQueue.events[i].events, 1);
-            miEventQueue.events[i].events = NULL;
+    if (!ring)
+        return;
+    for (i = 0; i < ring->nevents; i++) {
+        if (ring->events[i].events != NULL) {
+            FreeEventList(ring->events[i].events, 1);
+            ring->events[i].events = NULL;
         }
     }
-    free(miEventQueue.events);
+    free(ring);
+    miEventQueue.ring = NULL;
+}
+
+/*
+ * Fold a motion event into the last event on the queue, if the main thread
+ * hasn't taken that one yet.
+ */
+static Bool
+mieqRewriteLast(InternalEvent *e, DeviceIntPtr pDev)
+{
+    unsigned int last = (unsigned int) miEventQueue.tail - 1;
+    EventPtr bucket = mieqBucket(miEventQueue.ring, last);
+    unsigned int seq = bucket->seq;
+
+    __atomic_store_n(&bucket->seq, seq + 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&miEventQueue.head, __ATOMIC_SEQ_CST) ==
+        miEventQueue.tail) {
+        __atomic_store_n(&bucket->seq, seq, __ATOMIC_RELEASE);
+        return FALSE;
+    }
+
+    memcpy(bucket->events, e, e->any.length);
+    bucket->pScreen = pDev ? EnqueueScreen(pDev) : NULL;
+    bucket->pDev = pDev;
+    __atomic_store_n(&bucket->seq, seq + 2, __ATOMIC_RELEASE);
+    return TRUE;
 }
 
 /*
@@ -195,11 +246,12 @@ void
 mieqEnqueue(DeviceIntPtr pDev, InternalEvent *e)
 {
     unsigned int oldtail = miEventQueue.tail;
+    EventPtr bucket;
     InternalEvent *evt;
     int isMotion = 0;
     int evlen;
     Time time;
-    size_t n_enqueued;
+    size_t n_enqueued, dropped;
 
     verify_internal_event(e);
 
@@ -210,16 +262,21 @@ mieqEnqueue(DeviceIntPtr pDev, InternalEvent *e)
         isMotion = pDev->id;
 
     if (isMotion && isMotion == miEventQueue.lastMotion &&
-        oldtail != miEventQueue.head) {
-        oldtail = (oldtail - 1) % miEventQueue.nevents;
+        oldtail != (unsigned int) __atomic_load_n(&miEventQueue.head,
+                                                  __ATOMIC_ACQUIRE) &&
+        mieqRewriteLast(e, pDev)) {
+        evt = mieqBucket(miEventQueue.ring, oldtail - 1)->events;
+        goto queued;
     }
-    else if (n_enqueued + 1 == miEventQueue.nevents) {
-        if (!mieqGrowQueue(&miEventQueue, miEventQueue.nevents << 1)) {
+
+    if (n_enqueued + 1 == miEventQueue.ring->nevents) {
+        if (!mieqGrowQueue(&miEventQueue, miEventQueue.ring->nevents << 1)) {
             /* Toss events which come in late.  Usually this means your server's
              * stuck in an infinite loop in the main thread.
              */
-            miEventQueue.dropped++;
-            if (miEventQueue.dropped == 1) {
+            dropped = __atomic_add_fetch(&miEventQueue.dropped, 1,
+                                         __ATOMIC_RELAXED);
+            if (dropped == 1) {
                 ErrorFSigSafe("[mi] EQ overflowing.  Additional events will be "
                               "discarded until existing events are processed.\n");
                 xorg_backtrace();
@@ -227,12 +284,12 @@ mieqEnqueue(DeviceIntPtr pDev, InternalEvent *e)
                               "a culprit higher up the stack.\n");
                 ErrorFSigSafe("[mi] mieq is *NOT* the cause.  It is a victim.\n");
             }
-            else if (miEventQueue.dropped % QUEUE_DROP_BACKTRACE_FREQUENCY == 0 &&
-                     miEventQueue.dropped / QUEUE_DROP_BACKTRACE_FREQUENCY <=
+            else if (dropped % QUEUE_DROP_BACKTRACE_FREQUENCY == 0 &&
+                     dropped / QUEUE_DROP_BACKTRACE_FREQUENCY <=
                      QUEUE_DROP_BACKTRACE_MAX) {
                 ErrorFSigSafe("[mi] EQ overflow continuing.  %zu events have been "
-                              "dropped.\n", miEventQueue.dropped);
-                if (miEventQueue.dropped / QUEUE_DROP_BACKTRACE_FREQUENCY ==
+                              "dropped.\n", dropped);
+                if (dropped / QUEUE_DROP_BACKTRACE_FREQUENCY ==
                     QUEUE_DROP_BACKTRACE_MAX) {
                     ErrorFSigSafe("[mi] No further overflow reports will be "
                                   "reported until the clog is cleared.\n");
@@ -241,13 +298,18 @@ mieqEnqueue(DeviceIntPtr pDev, InternalEvent *e)
             }
             return;
         }
-        oldtail = miEventQueue.tail;
     }
 
     evlen = e->any.length;
-    evt = miEventQueue.events[oldtail].events;
+    bucket = mieqBucket(miEventQueue.ring, oldtail);
+    evt = bucket->events;
     memcpy(evt, e, evlen);
+    bucket->pScreen = pDev ? EnqueueScreen(pDev) : NULL;
+    bucket->pDev = pDev;
+    __atomic_store_n(&miEventQueue.tail, (HWEventQueueType) (oldtail + 1),
+                     __ATOMIC_RELEASE);
 
+ queued:
     time = e->any.time;
     /* Make sure that event times don't go backwards - this
      * is "unnecessary", but very useful. */
@@ -256,11 +318,7 @@ mieqEnqueue(DeviceIntPtr pDev, InternalEvent *e)
         e->any.time = miEventQueue.lastEventTime;
 
     miEventQueue.lastEventTime = evt->any.time;
-    miEventQueue.events[oldtail].pScreen = pDev ? EnqueueScreen(pDev) : NULL;
-    miEventQueue.events[oldtail].pDev = pDev;
-
     miEventQueue.lastMotion = isMotion;
-    miEventQueue.tail = (oldtail + 1) % miEventQueue.nevents;
 }
 
 /**
@@ -497,6 +555,58 @@ mieqProcessDeviceEvent(DeviceIntPtr dev, InternalEvent *event, ScreenPtr screen)
     }
 }
 
+/* Whether two motion events differ in nothing but time and position */
+static Bool
+mieqSameMotion(DeviceEvent *a, DeviceEvent *b)
+{
+    return a->deviceid == b->deviceid &&
+        a->sourceid == b->sourceid &&
+        a->flags == b->flags &&
+        a->source_type == b->source_type &&
+        a->corestate == b->corestate &&
+        a->root == b->root &&
+        memcmp(a->buttons, b->buttons, sizeof(a->buttons)) == 0 &&
+        memcmp(a->valuators.mask, b->valuators.mask,
+               sizeof(a->valuators.mask)) == 0 &&
+        memcmp(a->valuators.mode, b->valuators.mode,
+               sizeof(a->valuators.mode)) == 0 &&
+        memcmp(&a->mods, &b->mods, sizeof(a->mods)) == 0 &&
+        memcmp(&a->group, &b->group, sizeof(a->group)) == 0;
+}
+
+/*
+ * Whether the motion event at index is made redundant by a later motion
+ * from the same device already on the queue, with only raw events and
+ * other devices' motion in between.  Valuators carry absolute values, so
+ * the later event says everything the earlier one did; raw events and the
+ * motion history are filled in when events are generated, so they stay
+ * complete.  This only finds anything when the queue is backing up.
+ *
+ * The last event on the queue is left alone, as mieqEnqueue may still
+ * fold more motion into it.  Called with miEventQueue.reading set.
+ */
+static Bool
+mieqMotionSuperseded(EventRingPtr ring, unsigned int index, unsigned int tail,
+                     DeviceEvent *ev, DeviceIntPtr dev, ScreenPtr screen)
+{
+    int i, n = min((int) (tail - index) - 2, QUEUE_COALESCE_LOOKAHEAD);
+
+    for (i = 1; i <= n; i++) {
+        EventPtr bucket = mieqBucket(ring, index + i);
+        InternalEvent *next = bucket->events;
+
+        if (next->any.type == ET_RawMotion)
+            continue;
+        if (next->any.type != ET_Motion)
+            return FALSE;
+        if (bucket->pDev != dev)
+            continue;
+        return bucket->pScreen == screen &&
+            mieqSameMotion(ev, &next->device_event);
+    }
+    return FALSE;
+}
+
 /* Call this from ProcessInputEvents(). */
 void
 mieqProcessInputEvents(void)
@@ -505,10 +615,9 @@ mieqProcessInputEvents(void)
     ScreenPtr screen;
     InternalEvent event;
     DeviceIntPtr dev = NULL, master = NULL;
+    size_t dropped;
     static Bool inProcessInputEvents = FALSE;
 
-    input_lock();
-
     /*
      * report an error if mieqProcessInputEvents() is called recursively;
      * this can happen, e.g., if something in the mieqProcessDeviceEvent()
@@ -517,24 +626,47 @@ mieqProcessInputEvents(void)
     BUG_WARN_MSG(inProcessInputEvents, "[mi] mieqProcessInputEvents() called recursively.\n");
     inProcessInputEvents = TRUE;
 
-    if (miEventQueue.dropped) {
+    dropped = __atomic_exchange_n(&miEventQueue.dropped, 0, __ATOMIC_RELAXED);
+    if (dropped) {
         ErrorF("[mi] EQ processing has resumed after %lu dropped events.\n",
-               (unsigned long) miEventQueue.dropped);
+               (unsigned long) dropped);
         ErrorF
             ("[mi] This may be caused by a misbehaving driver monopolizing the server's resources.\n");
-        miEventQueue.dropped = 0;
     }
 
-    while (miEventQueue.head != miEventQueue.tail) {
-        e = &miEventQueue.events[miEventQueue.head];
+    /* No input_lock() here, see the comment at EventQueueRec */
+    for (;;) {
+        unsigned int head = miEventQueue.head;
+        unsigned int tail = __atomic_load_n(&miEventQueue.tail,
+                                            __ATOMIC_ACQUIRE);
+        EventRingPtr ring;
+        Bool superseded;
+
+        if (head == tail)
+            break;
+
+        /* Claim the event, then wait for mieqEnqueue to finish with it */
+        __atomic_store_n(&miEventQueue.head, (HWEventQueueType) (head + 1),
+                         __ATOMIC_SEQ_CST);
+        __atomic_store_n(&miEventQueue.reading, TRUE, __ATOMIC_SEQ_CST);
+        ring = __atomic_load_n(&miEventQueue.ring, __ATOMIC_SEQ_CST);
+        e = mieqBucket(ring, head);
+        while (__atomic_load_n(&e->seq, __ATOMIC_ACQUIRE) & 1)
+            ;
 
         event = *e->events;
         dev = e->pDev;
         screen = e->pScreen;
+        superseded = event.any.type == ET_Motion &&
+            mieqMotionSuperseded(ring, head, tail, &event.device_event,
+                                 dev, screen);
 
-        miEventQueue.head = (miEventQueue.head + 1) % miEventQueue.nevents;
+        __atomic_store_n(&miEventQueue.reading, FALSE, __ATOMIC_RELEASE);
+        __atomic_store_n(&miEventQueue.done, (HWEventQueueType) (head + 1),
+                         __ATOMIC_RELEASE);
 
-        input_unlock();
+        if (superseded)
+            continue;
 
         master = (dev) ? GetMaster(dev, MASTER_ATTACHED) : NULL;
 
@@ -557,11 +689,7 @@ mieqProcessInputEvents(void)
                event.any.type == ET_TouchUpdate) &&
               event.device_event.flags & TOUCH_POINTER_EMULATED)))
             miPointerUpdateSprite(dev);
-
-        input_lock();
     }
 
     inProcessInputEvents = FALSE;
-
-    input_unlock();
 }
@@ -938,6 +938,7 @@ miOverlayMoveWindow(WindowPtr pWin,
     }
     pWin->origin.x = x + (int) bw;
     pWin->origin.y = y + (int) bw;
+    WindowPickInvalidate(pWin->parent);
     x = pWin->drawable.x = pParent->drawable.x + x + (int) bw;
     y = pWin->drawable.y = pParent->drawable.y + y + (int) bw;
 
@@ -1185,6 +1186,7 @@ miOverlayResizeWindow(WindowPtr pWin,
     pWin->origin.y = y + bw;
     pWin->drawable.height = h;
     pWin->drawable.width = w;
+    WindowPickInvalidate(pWin->parent);
 
     x = pWin->drawable.x = newx;
     y = pWin->drawable.y = newy;
@@ -1495,6 +1497,7 @@ miOverlayChangeBorderWidth(WindowPtr pWin, unsigned int width)
 
     pWin->borderWidth = width;
     SetBorderSize(pWin);
+    WindowPickInvalidate(pWin->parent);
 
     if (WasViewable) {
         if (width > oldwidth) {
@@ -177,6 +177,84 @@ miShapedWindowIn(RegionPtr universe, RegionPtr bounding,
 				    HasBorder(w) && \
 				    (w)->backgroundState == ParentRelative)
 
+/*
+ * Move the clips of pParent and everything inside it by dx, dy, with no
+ * exposures.  Used when the clips can't have changed in any other way.
+ * When they don't move at all, only the marked windows need their
+ * exposures cleared.
+ */
+static void
+miTranslateClips(WindowPtr pParent, ScreenPtr pScreen, int dx, int dy)
+{
+    WindowPtr pChild;
+    Bool moved = dx || dy;
+
+    pChild = pParent;
+    while (1) {
+        if (pChild->viewable && (moved || pChild->valdata)) {
+            if (moved && pChild->visibility != VisibilityFullyObscured) {
+                RegionTranslate(&pChild->borderClip, dx, dy);
+                RegionTranslate(&pChild->clipList, dx, dy);
+                pChild->drawable.serialNumber = NEXT_SERIAL_NUMBER;
+                if (pScreen->ClipNotify)
+                    (*pScreen->ClipNotify) (pChild, dx, dy);
+
+            }
+            if (pChild->valdata) {
+                RegionNull(&pChild->valdata->after.borderExposed);
+                if (HasParentRelativeBorder(pChild) && moved) {
+                    RegionSubtract(&pChild->valdata->after.borderExposed,
+                                   &pChild->borderClip, &pChild->winSize);
+                }
+                RegionNull(&pChild->valdata->after.exposed);
+            }
+            if (pChild->firstChild) {
+                pChild = pChild->firstChild;
+                continue;
+            }
+        }
+        while (!pChild->nextSib && (pChild != pParent))
+            pChild = pChild->parent;
+        if (pChild == pParent)
+            break;
+        pChild = pChild->nextSib;
+    }
+}
+
+/*
+ * TRUE iff the new universe for pWin is exactly its old borderClip moved
+ * by dx, dy.  Only meaningful for map, unmap, stack and move, where
+ * nothing inside pWin changes shape or position relative to pWin.
+ */
+static Bool
+miClipUnchanged(WindowPtr pWin, RegionPtr universe, int oldVis,
+                int dx, int dy)
+{
+    BoxPtr newBox, oldBox;
+    int n;
+
+    if (oldVis == VisibilityNotViewable || pWin->valdata->before.borderVisible)
+        return FALSE;
+#ifdef COMPOSITE
+    if (pWin->redirectDraw != RedirectDrawNone)
+        return FALSE;
+#endif
+    if (RegionNar(universe) || RegionNar(&pWin->borderClip))
+        return FALSE;
+
+    n = RegionNumRects(universe);
+    if (n != RegionNumRects(&pWin->borderClip))
+        return FALSE;
+    newBox = RegionRects(universe);
+    oldBox = RegionRects(&pWin->borderClip);
+    for (; n; n--, newBox++, oldBox++) {
+        if (newBox->x1 != oldBox->x1 + dx || newBox->x2 != oldBox->x2 + dx ||
+            newBox->y1 != oldBox->y1 + dy || newBox->y2 != oldBox->y2 + dy)
+            return FALSE;
+    }
+    return TRUE;
+}
+
 /*
  *-----------------------------------------------------------------------
  * miComputeClips --
@@ -286,44 +364,22 @@ miComputeClips(WindowPtr pParent,
     case VTMap:
     case VTStack:
     case VTUnmap:
-        break;
     case VTMove:
+        /*
+         * If the window gets the same piece of the screen as before, just
+         * shifted, nothing inside it can tell the difference, however many
+         * windows the subtree holds.
+         */
         if ((oldVis == newVis) &&
-            ((oldVis == VisibilityFullyObscured) ||
-             (oldVis == VisibilityUnobscured))) {
-            pChild = pParent;
-            while (1) {
-                if (pChild->viewable) {
-                    if (pChild->visibility != VisibilityFullyObscured) {
-                        RegionTranslate(&pChild->borderClip, dx, dy);
-                        RegionTranslate(&pChild->clipList, dx, dy);
-                        pChild->drawable.serialNumber = NEXT_SERIAL_NUMBER;
-                        if (pScreen->ClipNotify)
-                            (*pScreen->ClipNotify) (pChild, dx, dy);
-
-                    }
-                    if (pChild->valdata) {
-                        RegionNull(&pChild->valdata->after.borderExposed);
-                        if (HasParentRelativeBorder(pChild)) {
-                            RegionSubtract(&pChild->valdata->after.
-                                           borderExposed, &pChild->borderClip,
-                                           &pChild->winSize);
-                        }
-                        RegionNull(&pChild->valdata->after.exposed);
-                    }
-                    if (pChild->firstChild) {
-                        pChild = pChild->firstChild;
-                        continue;
-                    }
-                }
-                while (!pChild->nextSib && (pChild != pParent))
-                    pChild = pChild->parent;
-                if (pChild == pParent)
-                    break;
-                pChild = pChild->nextSib;
-            }
+            (((kind == VTMove) &&
+              ((oldVis == VisibilityFullyObscured) ||
+               (oldVis == VisibilityUnobscured))) ||
+             miClipUnchanged(pParent, universe, oldVis, dx, dy))) {
+            miTranslateClips(pParent, pScreen, dx, dy);
             return;
         }
+        if (kind != VTMove)
+            break;
         /* fall through */
     default:
         /*
@@ -268,6 +268,7 @@ miMoveWindow(WindowPtr pWin, int x, int y, WindowPtr pNextSib, VTKind kind)
     }
     pWin->origin.x = x + (int) bw;
     pWin->origin.y = y + (int) bw;
+    WindowPickInvalidate(pWin->parent);
     x = pWin->drawable.x = pParent->drawable.x + x + (int) bw;
     y = pWin->drawable.y = pParent->drawable.y + y + (int) bw;
 
@@ -432,6 +433,7 @@ miResizeWindow(WindowPtr pWin, int x, int y, unsigned int w, unsigned int h,
     pWin->origin.y = y + bw;
     pWin->drawable.height = h;
     pWin->drawable.width = w;
+    WindowPickInvalidate(pWin->parent);
 
     x = pWin->drawable.x = newx;
     y = pWin->drawable.y = newy;
@@ -703,6 +705,7 @@ miChangeBorderWidth(WindowPtr pWin, unsigned int width)
 
     pWin->borderWidth = width;
     SetBorderSize(pWin);
+    WindowPickInvalidate(pWin->parent);
 
     if (WasViewable) {
         if (width > oldwidth) {
@@ -745,46 +748,69 @@ miMarkUnrealizedWindow(WindowPtr pChild, WindowPtr pWin, Bool fromConfigure)
     }
 }
 
-WindowPtr
-miSpriteTrace(SpritePtr pSprite, int x, int y)
+/* Whether the point x, y picks pWin, assuming it picked pWin's parent */
+static Bool
+miSpriteHit(WindowPtr pWin, int x, int y)
 {
-    WindowPtr pWin;
     BoxRec box;
 
-    pWin = DeepestSpriteWin(pSprite)->firstChild;
-    while (pWin) {
-        if ((pWin->mapped) &&
-            (x >= pWin->drawable.x - wBorderWidth(pWin)) &&
-            (x < pWin->drawable.x + (int) pWin->drawable.width +
-             wBorderWidth(pWin)) &&
-            (y >= pWin->drawable.y - wBorderWidth(pWin)) &&
-            (y < pWin->drawable.y + (int) pWin->drawable.height +
-             wBorderWidth(pWin))
-            /* When a window is shaped, a further check
-             * is made to see if the point is inside
-             * borderSize
-             */
-            && (!wBoundingShape(pWin) || PointInBorderSize(pWin, x, y))
-            && (!wInputShape(pWin) ||
-                RegionContainsPoint(wInputShape(pWin),
-                                    x - pWin->drawable.x,
-                                    y - pWin->drawable.y, &box))
-            /* In rootless mode windows may be offscreen, even when
-             * they're in X's stack. (E.g. if the native window system
-             * implements some form of virtual desktop system).
-             */
-            && !pWin->unhittable) {
-            if (pSprite->spriteTraceGood >= pSprite->spriteTraceSize) {
-                pSprite->spriteTraceSize += 10;
-                pSprite->spriteTrace = reallocarray(pSprite->spriteTrace,
-                                                    pSprite->spriteTraceSize,
-                                                    sizeof(WindowPtr));
+    return (pWin->mapped) &&
+        (x >= pWin->drawable.x - wBorderWidth(pWin)) &&
+        (x < pWin->drawable.x + (int) pWin->drawable.width +
+         wBorderWidth(pWin)) &&
+        (y >= pWin->drawable.y - wBorderWidth(pWin)) &&
+        (y < pWin->drawable.y + (int) pWin->drawable.height +
+         wBorderWidth(pWin))
+        /* When a window is shaped, a further check
+         * is made to see if the point is inside
+         * borderSize
+         */
+        && (!wBoundingShape(pWin) || PointInBorderSize(pWin, x, y))
+        && (!wInputShape(pWin) ||
+            RegionContainsPoint(wInputShape(pWin),
+                                x - pWin->drawable.x,
+                                y - pWin->drawable.y, &box))
+        /* In rootless mode windows may be offscreen, even when
+         * they're in X's stack. (E.g. if the native window system
+         * implements some form of virtual desktop system).
+         */
+        && !pWin->unhittable;
+}
+
+WindowPtr
+miSpriteTrace(SpritePtr pSprite, int x, int y)
+{
+    WindowPtr pParent, pWin, *list;
+    int i, n;
+
+    pParent = DeepestSpriteWin(pSprite);
+    for (;;) {
+        /* Only test the children the pick index says may be there */
+        if (WindowPickCandidates(pParent, x, y, &list, &n)) {
+            for (i = 0, pWin = NullWindow; i < n && !pWin; i++)
+                if (miSpriteHit(list[i], x, y))
+                    pWin = list[i];
+        }
+        else {
+            n = 0;
+            for (pWin = pParent->firstChild; pWin; pWin = pWin->nextSib) {
+                n++;
+                if (miSpriteHit(pWin, x, y))
+                    break;
             }
-            pSprite->spriteTrace[pSprite->spriteTraceGood++] = pWin;
-            pWin = pWin->firstChild;
+            WindowPickWalked(pParent, n);
         }
-        else
-            pWin = pWin->nextSib;
+        if (!pWin)
+            break;
+
+        if (pSprite->spriteTraceGood >= pSprite->spriteTraceSize) {
+            pSprite->spriteTraceSize += 10;
+            pSprite->spriteTrace = reallocarray(pSprite->spriteTrace,
+                                                pSprite->spriteTraceSize,
+                                                sizeof(WindowPtr));
+        }
+        pSprite->spriteTrace[pSprite->spriteTraceGood++] = pWin;
+        pParent = pWin;
     }
     return DeepestSpriteWin(pSprite);
 }
@@ -121,6 +121,261 @@ getDrawableDamageRef(DrawablePtr pDrawable)
     DamagePtr	*pPrev = (DamagePtr *) \
 	dixLookupPrivateAddr(&(pWindow)->devPrivates, damageWinPrivateKey)
 
+/* Grids finer than this many tiles are not tried */
+#define DAMAGE_GRID_MAX     (1 << 16)
+
+/*
+ * Clip the damage to what is left of its drawable: the border clip of a
+ * window, the bounds of a pixmap.
+ */
+static void
+damageClipToDrawable(DamagePtr pDamage)
+{
+    DrawablePtr pDrawable = pDamage->pDrawable;
+    RegionPtr pClip;
+    RegionRec pixmapClip;
+
+    if (!pDrawable)
+        return;
+    if (pDrawable->type == DRAWABLE_WINDOW)
+        pClip = &((WindowPtr) pDrawable)->borderClip;
+    else {
+        BoxRec box;
+
+        box.x1 = pDrawable->x;
+        box.y1 = pDrawable->y;
+        box.x2 = pDrawable->x + pDrawable->width;
+        box.y2 = pDrawable->y + pDrawable->height;
+        RegionInit(&pixmapClip, &box, 1);
+        pClip = &pixmapClip;
+    }
+    RegionTranslate(&pDamage->damage, pDrawable->x, pDrawable->y);
+    RegionIntersect(&pDamage->damage, &pDamage->damage, pClip);
+    RegionTranslate(&pDamage->damage, -pDrawable->x, -pDrawable->y);
+    if (pDrawable->type != DRAWABLE_WINDOW)
+        RegionUninit(&pixmapClip);
+}
+
+/*
+ * Round pRegion out to tiles of tile x tile pixels, clipped to its
+ * extents, into pResult.  Fails when that takes more than maxRects
+ * rectangles or too many tiles.
+ */
+static Bool
+damageTileRegion(RegionPtr pRegion, int tile, int maxRects, RegionPtr pResult)
+{
+    BoxPtr extents = RegionExtents(pRegion);
+    BoxPtr pbox = RegionRects(pRegion), out;
+    int nbox = RegionNumRects(pRegion);
+    int cols = (extents->x2 - extents->x1 + tile - 1) / tile;
+    int rows = (extents->y2 - extents->y1 + tile - 1) / tile;
+    int row, col, c0, c1, r0, r1, n = 0, prev = 0, nprev = 0, i;
+    unsigned char *grid;
+
+    if ((CARD64) cols * rows > DAMAGE_GRID_MAX)
+        return FALSE;
+    grid = calloc(rows, cols);
+    if (!grid)
+        return FALSE;
+
+    for (; nbox--; pbox++) {
+        c0 = (pbox->x1 - extents->x1) / tile;
+        c1 = (pbox->x2 - 1 - extents->x1) / tile;
+        r0 = (pbox->y1 - extents->y1) / tile;
+        r1 = (pbox->y2 - 1 - extents->y1) / tile;
+        for (row = r0; row <= r1; row++)
+            memset(grid + row * cols + c0, 1, c1 - c0 + 1);
+    }
+
+    RegionInit(pResult, NullBox, max(maxRects, 2));
+    if (!pResult->data->size) {
+        free(grid);
+        return FALSE;
+    }
+    out = RegionBoxptr(pResult);
+    for (row = 0; row < rows; row++) {
+        short y1 = extents->y1 + row * tile;
+        short y2 = min(y1 + tile, extents->y2);
+        int start = n;
+
+        for (col = 0; col < cols; col++) {
+            if (!grid[row * cols + col])
+                continue;
+            c1 = col + 1;
+            while (c1 < cols && grid[row * cols + c1])
+                c1++;
+            if (n == maxRects) {
+                free(grid);
+                RegionUninit(pResult);
+                return FALSE;
+            }
+            out[n].x1 = extents->x1 + col * tile;
+            out[n].x2 = min(extents->x1 + c1 * tile, extents->x2);
+            out[n].y1 = y1;
+            out[n].y2 = y2;
+            n++;
+            col = c1;
+        }
+
+        /* a row like the one above it joins its band */
+        if (n - start == nprev && nprev) {
+            for (i = 0; i < nprev; i++)
+                if (out[prev + i].x1 != out[start + i].x1 ||
+                    out[prev + i].x2 != out[start + i].x2)
+                    break;
+            if (i == nprev) {
+                for (i = 0; i < nprev; i++)
+                    out[prev + i].y2 = y2;
+                n = start;
+                continue;
+            }
+        }
+        prev = start;
+        nprev = n - start;
+    }
+    free(grid);
+
+    pResult->data->numRects = n;
+    pResult->extents = *extents;
+    if (n == 1) {
+        RegionUninit(pResult);
+        RegionInit(pResult, extents, 1);
+    }
+    return TRUE;
+}
+
+/*
+ * Damage from many small drawing operations piles up into regions of
+ * thousands of rectangles, which everyone reading them then has to walk.
+ * Once a Damage with a limit goes over it, its region is rounded out to
+ * tiles, as fine as will fit in half the limit so that the next few
+ * operations don't bring it straight back, or to its bounding box.  The
+ * area this adds is left in pAdded, when asked for.
+ */
+static void
+damageLimitComplexity(DamagePtr pDamage, RegionPtr pAdded)
+{
+    RegionPtr pRegion = &pDamage->damage;
+    BoxPtr extents = RegionExtents(pRegion);
+    RegionRec coarse;
+    int target = max(pDamage->maxRects / 2, 1);
+    int tile = 16;
+    CARD64 area;
+
+    if (pDamage->complexity == DamageComplexityExact ||
+        RegionNumRects(pRegion) <= pDamage->maxRects)
+        return;
+
+    /* start with tiles about the size that would fill target */
+    area = (CARD64) (extents->x2 - extents->x1) * (extents->y2 - extents->y1);
+    while ((CARD64) tile * tile * target < area)
+        tile *= 2;
+
+    if (pDamage->complexity == DamageComplexityTiles)
+        while (!damageTileRegion(pRegion, tile, target, &coarse)) {
+            if (tile >= MAXSHORT) {
+                RegionInit(&coarse, extents, 1);
+                break;
+            }
+            tile *= 2;
+        }
+    else
+        RegionInit(&coarse, extents, 1);
+
+    DAMAGE_DEBUG(("damage %p: %d rects rounded to %d in %d pixel tiles\n",
+                  pDamage, RegionNumRects(pRegion), RegionNumRects(&coarse),
+                  tile));
+
+    if (pAdded)
+        RegionSubtract(pAdded, &coarse, pRegion);
+    RegionCopy(pRegion, &coarse);
+    RegionUninit(&coarse);
+    /* tiles may stick out past the window */
+    damageClipToDrawable(pDamage);
+    if (pAdded && pDamage->pDrawable)
+        RegionIntersect(pAdded, pAdded, pRegion);
+}
+
+/* Batched Damage objects with reports waiting for the block handler */
+static struct xorg_list damageBatchList = {
+    &damageBatchList, &damageBatchList
+};
+static unsigned long damageBatchGeneration;
+
+/*
+ * Hand a report to the Damage's callback, or for a batched Damage hold it
+ * until damageBatchBlockHandler.  Rectangle reports are merged; the others
+ * are made from the damage region itself when the batch goes out.
+ */
+static void
+damageReport(DamagePtr pDamage, RegionPtr pRegion)
+{
+    if (!pDamage->batched) {
+        (*pDamage->damageReport) (pDamage, pRegion, pDamage->closure);
+        return;
+    }
+    if (pDamage->damageLevel == DamageReportRawRegion ||
+        pDamage->damageLevel == DamageReportDeltaRegion)
+        RegionUnion(&pDamage->batchDamage, &pDamage->batchDamage, pRegion);
+    if (xorg_list_is_empty(&pDamage->batchEntry))
+        xorg_list_append(&pDamage->batchEntry, &damageBatchList);
+}
+
+static void
+damageBatchCancel(DamagePtr pDamage)
+{
+    xorg_list_del(&pDamage->batchEntry);
+    RegionEmpty(&pDamage->batchDamage);
+}
+
+/* Make the one report for everything held back since the last */
+static void
+damageBatchFlush(DamagePtr pDamage)
+{
+    xorg_list_del(&pDamage->batchEntry);
+    switch (pDamage->damageLevel) {
+    case DamageReportDeltaRegion:
+        /* what was subtracted since has been seen already */
+        RegionIntersect(&pDamage->batchDamage, &pDamage->batchDamage,
+                        &pDamage->damage);
+        /* fall through */
+    case DamageReportRawRegion:
+        if (RegionNotEmpty(&pDamage->batchDamage))
+            (*pDamage->damageReport) (pDamage, &pDamage->batchDamage,
+                                      pDamage->closure);
+        RegionEmpty(&pDamage->batchDamage);
+        break;
+    case DamageReportBoundingBox:
+    case DamageReportNonEmpty:
+        if (RegionNotEmpty(&pDamage->damage))
+            (*pDamage->damageReport) (pDamage, &pDamage->damage,
+                                      pDamage->closure);
+        break;
+    case DamageReportNone:
+        break;
+    }
+}
+
+/*
+ * Runs once per trip round Dispatch, ahead of the screen block handlers,
+ * so a client drawing a thousand small things in one time slice leaves
+ * one report per Damage rather than a thousand.
+ */
+static void
+damageBatchBlockHandler(void *data, void *timeout)
+{
+    DamagePtr pDamage, pNext;
+
+    xorg_list_for_each_entry_safe(pDamage, pNext, &damageBatchList,
+                                  batchEntry)
+        damageBatchFlush(pDamage);
+}
+
+static void
+damageBatchWakeupHandler(void *data, int result)
+{
+}
+
 #if DAMAGE_DEBUG_ENABLE
 static void
 _damageRegionAppend(DrawablePtr pDrawable, RegionPtr pRegion, Bool clip,
@@ -264,8 +519,11 @@ damageRegionAppend(DrawablePtr pDrawable, RegionPtr pRegion, Bool clip,
         if (!pDamage->reportAfter) {
             if (pDamage->damageReport)
                 DamageReportDamage(pDamage, pDamageRegion);
-            else
+            else {
                 RegionUnion(&pDamage->damage, &pDamage->damage, pDamageRegion);
+                if (pDamage->maxRects)
+                    damageLimitComplexity(pDamage, NULL);
+            }
         }
 
         /*
@@ -292,9 +550,12 @@ damageRegionProcessPending(DrawablePtr pDrawable)
             /* It's possible that there is only interest in postRendering reporting. */
             if (pDamage->damageReport)
                 DamageReportDamage(pDamage, &pDamage->pendingDamage);
-            else
+            else {
                 RegionUnion(&pDamage->damage, &pDamage->damage,
                             &pDamage->pendingDamage);
+                if (pDamage->maxRects)
+                    damageLimitComplexity(pDamage, NULL);
+            }
         }
 
         if (pDamage->reportAfter)
@@ -1730,6 +1991,12 @@ DamageCreate(DamageReportFunc damageReport,
     pDamage->isWindow = FALSE;
     pDamage->pDrawable = 0;
     pDamage->reportAfter = FALSE;
+    pDamage->complexity = DamageMaxRects ? DamageComplexityTiles :
+        DamageComplexityExact;
+    pDamage->maxRects = DamageMaxRects;
+    pDamage->batched = FALSE;
+    RegionNull(&pDamage->batchDamage);
+    xorg_list_init(&pDamage->batchEntry);
 
     pDamage->damageReport = damageReport;
     pDamage->damageDestroy = damageDestroy;
@@ -1824,6 +2091,7 @@ DamageUnregister(DamagePtr pDamage)
     }
     pDamage->pDrawable = 0;
     damageRemoveDamage(getDrawableDamageRef(pDrawable), pDamage);
+    damageBatchCancel(pDamage);
 }
 
 void
@@ -1839,38 +2107,18 @@ DamageDestroy(DamagePtr pDamage)
     if (pDamage->damageDestroy)
         (*pDamage->damageDestroy) (pDamage, pDamage->closure);
     (*pScrPriv->funcs.Destroy) (pDamage);
+    damageBatchCancel(pDamage);
     RegionUninit(&pDamage->damage);
     RegionUninit(&pDamage->pendingDamage);
+    RegionUninit(&pDamage->batchDamage);
     free(pDamage);
 }
 
 Bool
 DamageSubtract(DamagePtr pDamage, const RegionPtr pRegion)
 {
-    RegionPtr pClip;
-    RegionRec pixmapClip;
-    DrawablePtr pDrawable = pDamage->pDrawable;
-
     RegionSubtract(&pDamage->damage, &pDamage->damage, pRegion);
-    if (pDrawable) {
-        if (pDrawable->type == DRAWABLE_WINDOW)
-            pClip = &((WindowPtr) pDrawable)->borderClip;
-        else {
-            BoxRec box;
-
-            box.x1 = pDrawable->x;
-            box.y1 = pDrawable->y;
-            box.x2 = pDrawable->x + pDrawable->width;
-            box.y2 = pDrawable->y + pDrawable->height;
-            RegionInit(&pixmapClip, &box, 1);
-            pClip = &pixmapClip;
-        }
-        RegionTranslate(&pDamage->damage, pDrawable->x, pDrawable->y);
-        RegionIntersect(&pDamage->damage, &pDamage->damage, pClip);
-        RegionTranslate(&pDamage->damage, -pDrawable->x, -pDrawable->y);
-        if (pDrawable->type != DRAWABLE_WINDOW)
-            RegionUninit(&pixmapClip);
-    }
+    damageClipToDrawable(pDamage);
     return RegionNotEmpty(&pDamage->damage);
 }
 
@@ -1880,6 +2128,21 @@ DamageEmpty(DamagePtr pDamage)
     RegionEmpty(&pDamage->damage);
 }
 
+/*
+ * Hand the accumulated damage over to pDst and leave none behind, by
+ * swapping the two regions' storage rather than copying the rectangles
+ */
+void
+DamageTakeRegion(DamagePtr pDamage, RegionPtr pDst)
+{
+    RegionRec tmp;
+
+    tmp = *pDst;
+    *pDst = pDamage->damage;
+    pDamage->damage = tmp;
+    RegionEmpty(&pDamage->damage);
+}
+
 RegionPtr
 DamageRegion(DamagePtr pDamage)
 {
@@ -1923,6 +2186,42 @@ DamageSetReportAfterOp(DamagePtr pDamage, Bool reportAfter)
     pDamage->reportAfter = reportAfter;
 }
 
+/*
+ * Limit the damage region to maxRects rectangles by rounding it out as
+ * complexity says, once it goes over.  New Damage objects start with the
+ * limit given by -damagerects; a maxRects of 0 removes the limit.
+ */
+void
+DamageSetComplexity(DamagePtr pDamage, DamageComplexity complexity,
+                    int maxRects)
+{
+    if (maxRects <= 0)
+        complexity = DamageComplexityExact;
+    pDamage->complexity = complexity;
+    pDamage->maxRects = complexity == DamageComplexityExact ? 0 : maxRects;
+}
+
+/*
+ * Hold the reports of pDamage until the server next goes round Dispatch,
+ * and then make one report of everything since.  Only for callbacks that
+ * can wait: the block handler runs after the work queue, so a report that
+ * queues work is not looked at until the next time round.
+ */
+Bool
+DamageSetReportBatched(DamagePtr pDamage, Bool batched)
+{
+    if (batched && damageBatchGeneration != serverGeneration) {
+        if (!RegisterBlockAndWakeupHandlers(damageBatchBlockHandler,
+                                            damageBatchWakeupHandler, NULL))
+            return FALSE;
+        damageBatchGeneration = serverGeneration;
+    }
+    if (!batched && !xorg_list_is_empty(&pDamage->batchEntry))
+        damageBatchFlush(pDamage);
+    pDamage->batched = batched;
+    return TRUE;
+}
+
 DamageScreenFuncsPtr
 DamageGetScreenFuncs(ScreenPtr pScreen)
 {
@@ -1930,6 +2229,16 @@ DamageGetScreenFuncs(ScreenPtr pScreen)
     return &pScrPriv->funcs;
 }
 
+/* Whether any Damage is registered on the drawable, i.e. whether rendering
+ * to it would go through the damage wrappers rather than straight down */
+Bool
+DamageDrawableIsTracked(DrawablePtr pDrawable)
+{
+    if (!dixPrivateKeyRegistered(damagePixPrivateKey))
+        return FALSE;
+    return getDrawableDamage(pDrawable) != NULL;
+}
+
 void
 DamageReportDamage(DamagePtr pDamage, RegionPtr pDamageRegion)
 {
@@ -1940,35 +2249,52 @@ DamageReportDamage(DamagePtr pDamage, RegionPtr pDamageRegion)
     switch (pDamage->damageLevel) {
     case DamageReportRawRegion:
         RegionUnion(&pDamage->damage, &pDamage->damage, pDamageRegion);
-        (*pDamage->damageReport) (pDamage, pDamageRegion, pDamage->closure);
+        if (pDamage->maxRects)
+            damageLimitComplexity(pDamage, NULL);
+        damageReport(pDamage, pDamageRegion);
         break;
     case DamageReportDeltaRegion:
         RegionNull(&tmpRegion);
         RegionSubtract(&tmpRegion, pDamageRegion, &pDamage->damage);
         if (RegionNotEmpty(&tmpRegion)) {
             RegionUnion(&pDamage->damage, &pDamage->damage, pDamageRegion);
-            (*pDamage->damageReport) (pDamage, &tmpRegion, pDamage->closure);
+            /*
+             * Whatever rounding out adds won't be reported later, so it
+             * goes out now with the rest
+             */
+            if (pDamage->maxRects &&
+                RegionNumRects(&pDamage->damage) > pDamage->maxRects) {
+                RegionRec added;
+
+                RegionNull(&added);
+                damageLimitComplexity(pDamage, &added);
+                RegionUnion(&tmpRegion, &tmpRegion, &added);
+                RegionUninit(&added);
+            }
+            damageReport(pDamage, &tmpRegion);
         }
         RegionUninit(&tmpRegion);
         break;
     case DamageReportBoundingBox:
         tmpBox = *RegionExtents(&pDamage->damage);
         RegionUnion(&pDamage->damage, &pDamage->damage, pDamageRegion);
-        if (!BOX_SAME(&tmpBox, RegionExtents(&pDamage->damage))) {
-            (*pDamage->damageReport) (pDamage, &pDamage->damage,
-                                      pDamage->closure);
-        }
+        if (pDamage->maxRects)
+            damageLimitComplexity(pDamage, NULL);
+        if (!BOX_SAME(&tmpBox, RegionExtents(&pDamage->damage)))
+            damageReport(pDamage, &pDamage->damage);
         break;
     case DamageReportNonEmpty:
         was_empty = !RegionNotEmpty(&pDamage->damage);
         RegionUnion(&pDamage->damage, &pDamage->damage, pDamageRegion);
-        if (was_empty && RegionNotEmpty(&pDamage->damage)) {
-            (*pDamage->damageReport) (pDamage, &pDamage->damage,
-                                      pDamage->closure);
-        }
+        if (pDamage->maxRects)
+            damageLimitComplexity(pDamage, NULL);
+        if (was_empty && RegionNotEmpty(&pDamage->damage))
+            damageReport(pDamage, &pDamage->damage);
         break;
     case DamageReportNone:
         RegionUnion(&pDamage->damage, &pDamage->damage, pDamageRegion);
+        if (pDamage->maxRects)
+            damageLimitComplexity(pDamage, NULL);
         break;
     }
 }
@@ -37,6 +37,13 @@ typedef enum _damageReportLevel {
     DamageReportNone
 } DamageReportLevel;
 
+/* What to do with a damage region that grows too complex */
+typedef enum _damageComplexity {
+    DamageComplexityExact,      /* nothing, keep every rectangle */
+    DamageComplexityTiles,      /* round it out to a grid of tiles */
+    DamageComplexityBounds      /* replace it with its bounding box */
+} DamageComplexity;
+
 typedef void (*DamageReportFunc) (DamagePtr pDamage, RegionPtr pRegion,
                                   void *closure);
 typedef void (*DamageDestroyFunc) (DamagePtr pDamage, void *closure);
@@ -85,6 +92,9 @@ extern _X_EXPORT Bool
 extern _X_EXPORT void
  DamageEmpty(DamagePtr pDamage);
 
+extern _X_EXPORT void
+ DamageTakeRegion(DamagePtr pDamage, RegionPtr pDst);
+
 extern _X_EXPORT RegionPtr
  DamageRegion(DamagePtr pDamage);
 
@@ -110,6 +120,16 @@ extern _X_EXPORT void
 extern _X_EXPORT void
  DamageSetReportAfterOp(DamagePtr pDamage, Bool reportAfter);
 
+extern _X_EXPORT void
+ DamageSetComplexity(DamagePtr pDamage, DamageComplexity complexity,
+                     int maxRects);
+
+extern _X_EXPORT Bool
+ DamageSetReportBatched(DamagePtr pDamage, Bool batched);
+
 extern _X_EXPORT DamageScreenFuncsPtr DamageGetScreenFuncs(ScreenPtr);
 
+extern _X_EXPORT Bool
+ DamageDrawableIsTracked(DrawablePtr pDrawable);
+
 #endif                          /* _DAMAGE_H_ */
@@ -31,6 +31,7 @@
 #include "gcstruct.h"
 #include "privates.h"
 #include "picturestr.h"
+#include "list.h"
 
 typedef struct _damage {
     DamagePtr pNext;
@@ -49,6 +50,13 @@ typedef struct _damage {
     Bool reportAfter;
     RegionRec pendingDamage;    /* will be flushed post submission at the latest */
     ScreenPtr pScreen;
+
+    DamageComplexity complexity;
+    int maxRects;               /* 0 for no limit */
+
+    Bool batched;
+    RegionRec batchDamage;      /* reported at the next block handler */
+    struct xorg_list batchEntry;
 } DamageRec;
 
 typedef struct _damageScrPriv {
@@ -34,7 +34,9 @@
 #include    "regionstr.h"
 #include    "globals.h"
 #include    "gcstruct.h"
+#include    "dixstruct.h"
 #include    "shadow.h"
+#include    "shtile.h"
 
 static DevPrivateKeyRec shadowScrPrivateKeyRec;
 #define shadowScrPrivateKey (&shadowScrPrivateKeyRec)
@@ -141,6 +143,7 @@ shadowSetup(ScreenPtr pScreen)
     pBuf->pPixmap = 0;
     pBuf->closure = 0;
     pBuf->randr = 0;
+    pBuf->threaded = FALSE;
 
     dixSetPrivate(&pScreen->devPrivates, shadowScrPrivateKey, pBuf);
     return TRUE;
@@ -191,5 +194,99 @@ shadowRemove(ScreenPtr pScreen, PixmapPtr pPixmap)
         pBuf->randr = 0;
         pBuf->closure = 0;
         pBuf->pPixmap = 0;
+        pBuf->threaded = FALSE;
+    }
+}
+
+/*
+ * Say that the window proc given to shadowAdd only works out addresses
+ * in one linear framebuffer, so that its windows stay valid and it can be
+ * called from any thread.  The update procs then copy several lines at a
+ * time and share big updates out among the render threads.  Lasts until
+ * shadowRemove.
+ */
+void
+shadowSetThreaded(ScreenPtr pScreen, Bool threaded)
+{
+    shadowBuf(pScreen);
+
+    pBuf->threaded = threaded;
+}
+
+typedef struct _shadowTiles {
+    ScreenPtr pScreen;
+    shadowBufPtr pBuf;
+    ShadowBoxProc proc;
+    BoxPtr tiles;
+    int ntiles;
+} shadowTilesRec;
+
+static void
+shadowTilesBand(void *closure, int band, int nbands)
+{
+    shadowTilesRec *tiles = closure;
+    int i = tiles->ntiles * band / nbands;
+    int end = tiles->ntiles * (band + 1) / nbands;
+
+    for (; i < end; i++)
+        (*tiles->proc) (tiles->pScreen, tiles->pBuf, &tiles->tiles[i]);
+}
+
+/*
+ * Call proc for the damage in tiles of at most tileWidth x tileHeight
+ * pixels, on the render threads when the screen allows it and there is
+ * enough to do.
+ */
+void
+shadowUpdateTiles(ScreenPtr pScreen, shadowBufPtr pBuf, ShadowBoxProc proc,
+                  int tileWidth, int tileHeight)
+{
+    RegionPtr damage = DamageRegion(pBuf->pDamage);
+    int nbox = RegionNumRects(damage);
+    BoxPtr pbox = RegionRects(damage);
+    shadowTilesRec tiles;
+    CARD64 pixels = 0;
+    int nbands = 1, i, x, y;
+    BoxRec tile;
+
+    tiles.ntiles = 0;
+    for (i = 0; i < nbox; i++) {
+        int w = pbox[i].x2 - pbox[i].x1, h = pbox[i].y2 - pbox[i].y1;
+
+        tiles.ntiles += ((w + tileWidth - 1) / tileWidth) *
+            ((h + tileHeight - 1) / tileHeight);
+        pixels += (CARD64) w * h;
+    }
+
+    if (pBuf->threaded && pixels >= SHADOW_THREAD_PIXELS &&
+        RenderThreadsAvailable() > 1) {
+        nbands = min(tiles.ntiles, RenderThreadsAvailable() * 4);
+        tiles.tiles = xallocarray(tiles.ntiles, sizeof(BoxRec));
+        if (!tiles.tiles)
+            nbands = 1;
+    }
+
+    tiles.ntiles = 0;
+    for (i = 0; i < nbox; i++, pbox++) {
+        for (y = pbox->y1; y < pbox->y2; y += tileHeight) {
+            for (x = pbox->x1; x < pbox->x2; x += tileWidth) {
+                tile.x1 = x;
+                tile.y1 = y;
+                tile.x2 = min(x + tileWidth, pbox->x2);
+                tile.y2 = min(y + tileHeight, pbox->y2);
+                if (nbands > 1)
+                    tiles.tiles[tiles.ntiles++] = tile;
+                else
+                    (*proc) (pScreen, pBuf, &tile);
+            }
+        }
+    }
+
+    if (nbands > 1) {
+        tiles.pScreen = pScreen;
+        tiles.pBuf = pBuf;
+        tiles.proc = proc;
+        RenderThreadsRun(nbands, shadowTilesBand, &tiles);
+        free(tiles.tiles);
     }
 }
@@ -55,6 +55,9 @@ typedef struct _shadowBuf {
     GetImageProcPtr GetImage;
     CloseScreenProcPtr CloseScreen;
     ScreenBlockHandlerProcPtr BlockHandler;
+
+    /* see shadowSetThreaded */
+    Bool threaded;
 } shadowBufRec;
 
 /* Match defines from randr extension */
@@ -81,6 +84,9 @@ shadowAdd(ScreenPtr pScreen,
 extern _X_EXPORT void
  shadowRemove(ScreenPtr pScreen, PixmapPtr pPixmap);
 
+extern _X_EXPORT void
+ shadowSetThreaded(ScreenPtr pScreen, Bool threaded);
+
 extern _X_EXPORT void
  shadowUpdateAfb4(ScreenPtr pScreen, shadowBufPtr pBuf);
 
@@ -38,15 +38,13 @@
 #include    "globals.h"
 #include    "gcstruct.h"
 #include    "shadow.h"
+#include    "shtile.h"
 #include    "fb.h"
 
-void
-shadowUpdatePacked(ScreenPtr pScreen, shadowBufPtr pBuf)
+static void
+shadowUpdatePackedBox(ScreenPtr pScreen, shadowBufPtr pBuf, BoxPtr pbox)
 {
-    RegionPtr damage = DamageRegion(pBuf->pDamage);
     PixmapPtr pShadow = pBuf->pPixmap;
-    int nbox = RegionNumRects(damage);
-    BoxPtr pbox = RegionRects(damage);
     FbBits *shaBase, *shaLine, *sha;
     FbStride shaStride;
     int scrBase, scrLine, scr;
@@ -59,51 +57,55 @@ shadowUpdatePacked(ScreenPtr pScreen, shadowBufPtr pBuf)
 
     fbGetDrawable(&pShadow->drawable, shaBase, shaStride, shaBpp, shaXoff,
                   shaYoff);
-    while (nbox--) {
-        x = pbox->x1 * shaBpp;
-        y = pbox->y1;
-        w = (pbox->x2 - pbox->x1) * shaBpp;
-        h = pbox->y2 - pbox->y1;
+    x = pbox->x1 * shaBpp;
+    y = pbox->y1;
+    w = (pbox->x2 - pbox->x1) * shaBpp;
+    h = pbox->y2 - pbox->y1;
 
-        scrLine = (x >> FB_SHIFT);
-        shaLine = shaBase + y * shaStride + (x >> FB_SHIFT);
+    scrLine = (x >> FB_SHIFT);
+    shaLine = shaBase + y * shaStride + (x >> FB_SHIFT);
 
-        x &= FB_MASK;
-        w = (w + x + FB_MASK) >> FB_SHIFT;
+    x &= FB_MASK;
+    w = (w + x + FB_MASK) >> FB_SHIFT;
 
-        while (h--) {
-            winSize = 0;
-            scrBase = 0;
-            width = w;
-            scr = scrLine;
-            sha = shaLine;
-            while (width) {
-                /* how much remains in this window */
-                i = scrBase + winSize - scr;
-                if (i <= 0 || scr < scrBase) {
-                    winBase = (FbBits *) (*pBuf->window) (pScreen,
-                                                          y,
-                                                          scr * sizeof(FbBits),
-                                                          SHADOW_WINDOW_WRITE,
-                                                          &winSize,
-                                                          pBuf->closure);
-                    if (!winBase)
-                        return;
-                    scrBase = scr;
-                    winSize /= sizeof(FbBits);
-                    i = winSize;
-                }
-                win = winBase + (scr - scrBase);
-                if (i > width)
-                    i = width;
-                width -= i;
-                scr += i;
-                memcpy(win, sha, i * sizeof(FbBits));
-                sha += i;
+    while (h--) {
+        winSize = 0;
+        scrBase = 0;
+        width = w;
+        scr = scrLine;
+        sha = shaLine;
+        while (width) {
+            /* how much remains in this window */
+            i = scrBase + winSize - scr;
+            if (i <= 0 || scr < scrBase) {
+                winBase = (FbBits *) (*pBuf->window) (pScreen,
+                                                      y,
+                                                      scr * sizeof(FbBits),
+                                                      SHADOW_WINDOW_WRITE,
+                                                      &winSize,
+                                                      pBuf->closure);
+                if (!winBase)
+                    return;
+                scrBase = scr;
+                winSize /= sizeof(FbBits);
+                i = winSize;
             }
-            shaLine += shaStride;
-            y++;
+            win = winBase + (scr - scrBase);
+            if (i > width)
+                i = width;
+            width -= i;
+            scr += i;
+            memcpy(win, sha, i * sizeof(FbBits));
+            sha += i;
         }
-        pbox++;
+        shaLine += shaStride;
+        y++;
     }
 }
+
+void
+shadowUpdatePacked(ScreenPtr pScreen, shadowBufPtr pBuf)
+{
+    shadowUpdateTiles(pScreen, pBuf, shadowUpdatePackedBox,
+                      MAXSHORT, SHADOW_TILE_LINES);
+}
@@ -80,6 +80,41 @@ shadowUpdateRotatePacked(ScreenPtr pScreen, shadowBufPtr pBuf)
 
     fbGetDrawable(&pShadow->drawable, shaBits, shaStride, shaBpp, shaXoff,
                   shaYoff);
+
+    /*
+     * Plain rotations of a shadow the size of the screen have procs of
+     * their own, which work in tiles and copy whole pixels
+     */
+    if (!(pBuf->randr & SHADOW_REFLECT_ALL) &&
+        shaWidth == pScreen->width && shaHeight == pScreen->height) {
+        ShadowUpdateProc update = NULL;
+
+        switch (pBuf->randr & SHADOW_ROTATE_ALL) {
+        case SHADOW_ROTATE_0:
+            update = shadowUpdatePacked;
+            break;
+        case SHADOW_ROTATE_90:
+            update = shaBpp == 32 ? shadowUpdateRotate32_90 :
+                shaBpp == 16 ? shadowUpdateRotate16_90 :
+                shaBpp == 8 ? shadowUpdateRotate8_90 : NULL;
+            break;
+        case SHADOW_ROTATE_180:
+            update = shaBpp == 32 ? shadowUpdateRotate32_180 :
+                shaBpp == 16 ? shadowUpdateRotate16_180 :
+                shaBpp == 8 ? shadowUpdateRotate8_180 : NULL;
+            break;
+        case SHADOW_ROTATE_270:
+            update = shaBpp == 32 ? shadowUpdateRotate32_270 :
+                shaBpp == 16 ? shadowUpdateRotate16_270 :
+                shaBpp == 8 ? shadowUpdateRotate8_270 : NULL;
+            break;
+        }
+        if (update) {
+            (*update) (pScreen, pBuf);
+            return;
+        }
+    }
+
     pixelsPerBits = (sizeof(FbBits) * 8) / shaBpp;
     pixelsMask = ~(pixelsPerBits - 1);
     shaMask = FbBitsMask(FB_UNIT - shaBpp, shaBpp);
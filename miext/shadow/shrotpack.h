@@ -43,8 +43,14 @@
 #include    "globals.h"
 #include    "gcstruct.h"
 #include    "shadow.h"
+#include    "shtile.h"
 #include    "fb.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#define SHROT_SSE2
+#endif
+
 #define DANDEBUG         0
 
 #if ROTATE == 270
@@ -93,102 +99,315 @@
 
 #endif
 
-void
-FUNC(ScreenPtr pScreen, shadowBufPtr pBuf)
+#define SHROT_PASTE(a,b)    a##b
+#define SHROT_NAME(a,b)     SHROT_PASTE(a,b)
+#define LINE                SHROT_NAME(FUNC,Line)
+#define GROUP               SHROT_NAME(FUNC,Group)
+#define BOX                 SHROT_NAME(FUNC,Box)
+
+#ifdef SHROT_SSE2
+
+/*
+ * Lines a vector wide, turned around for 180 degrees: sha points at the
+ * first pixel to write, the rest lie before it.  Returns the number of
+ * pixels copied.
+ */
+static inline int
+shadowReverse32(CARD32 *win, CARD32 *sha, int width)
+{
+    int t;
+
+    for (t = 0; t + 4 <= width; t += 4) {
+        __m128i v = _mm_loadu_si128((__m128i *) (sha - t - 3));
+
+        v = _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3));
+        _mm_storeu_si128((__m128i *) (win + t), v);
+    }
+    return t;
+}
+
+static inline __m128i
+shadowReverseWords(__m128i v)
+{
+    v = _mm_shufflelo_epi16(v, 0x1b);
+    v = _mm_shufflehi_epi16(v, 0x1b);
+    return _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2));
+}
+
+static inline int
+shadowReverse16(CARD16 *win, CARD16 *sha, int width)
+{
+    int t;
+
+    for (t = 0; t + 8 <= width; t += 8) {
+        __m128i v = _mm_loadu_si128((__m128i *) (sha - t - 7));
+
+        _mm_storeu_si128((__m128i *) (win + t), shadowReverseWords(v));
+    }
+    return t;
+}
+
+static inline int
+shadowReverse8(CARD8 *win, CARD8 *sha, int width)
+{
+    int t;
+
+    for (t = 0; t + 16 <= width; t += 16) {
+        __m128i v = _mm_loadu_si128((__m128i *) (sha - t - 15));
+
+        v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+        _mm_storeu_si128((__m128i *) (win + t), shadowReverseWords(v));
+    }
+    return t;
+}
+
+/*
+ * Lines for 90 and 270 degrees, a vector's worth at once: win[m] is the
+ * line made of the pixels next to sha[m], the next pixel of each line
+ * stepX further on in the shadow.
+ */
+static inline void
+shadowTranspose32(CARD32 **win, CARD32 *sha, FbStride stepX, int width)
+{
+    int t, m;
+
+    for (t = 0; t + 4 <= width; t += 4) {
+        CARD32 *s = sha + t * stepX;
+        __m128i r0 = _mm_loadu_si128((__m128i *) s);
+        __m128i r1 = _mm_loadu_si128((__m128i *) (s + stepX));
+        __m128i r2 = _mm_loadu_si128((__m128i *) (s + 2 * stepX));
+        __m128i r3 = _mm_loadu_si128((__m128i *) (s + 3 * stepX));
+        __m128i t0 = _mm_unpacklo_epi32(r0, r1);
+        __m128i t1 = _mm_unpacklo_epi32(r2, r3);
+        __m128i t2 = _mm_unpackhi_epi32(r0, r1);
+        __m128i t3 = _mm_unpackhi_epi32(r2, r3);
+
+        _mm_storeu_si128((__m128i *) (win[0] + t), _mm_unpacklo_epi64(t0, t1));
+        _mm_storeu_si128((__m128i *) (win[1] + t), _mm_unpackhi_epi64(t0, t1));
+        _mm_storeu_si128((__m128i *) (win[2] + t), _mm_unpacklo_epi64(t2, t3));
+        _mm_storeu_si128((__m128i *) (win[3] + t), _mm_unpackhi_epi64(t2, t3));
+    }
+    for (; t < width; t++)
+        for (m = 0; m < 4; m++)
+            win[m][t] = sha[t * stepX + m];
+}
+
+static inline void
+shadowTranspose16(CARD16 **win, CARD16 *sha, FbStride stepX, int width)
+{
+    int t, m;
+
+    for (t = 0; t + 8 <= width; t += 8) {
+        CARD16 *s = sha + t * stepX;
+        __m128i r[8], b[8], c[8];
+
+        for (m = 0; m < 8; m++)
+            r[m] = _mm_loadu_si128((__m128i *) (s + m * stepX));
+        for (m = 0; m < 8; m += 2) {
+            b[m] = _mm_unpacklo_epi16(r[m], r[m + 1]);
+            b[m + 1] = _mm_unpackhi_epi16(r[m], r[m + 1]);
+        }
+        for (m = 0; m < 8; m += 4) {
+            c[m] = _mm_unpacklo_epi32(b[m], b[m + 2]);
+            c[m + 1] = _mm_unpackhi_epi32(b[m], b[m + 2]);
+            c[m + 2] = _mm_unpacklo_epi32(b[m + 1], b[m + 3]);
+            c[m + 3] = _mm_unpackhi_epi32(b[m + 1], b[m + 3]);
+        }
+        for (m = 0; m < 4; m++) {
+            _mm_storeu_si128((__m128i *) (win[2 * m] + t),
+                             _mm_unpacklo_epi64(c[m], c[m + 4]));
+            _mm_storeu_si128((__m128i *) (win[2 * m + 1] + t),
+                             _mm_unpackhi_epi64(c[m], c[m + 4]));
+        }
+    }
+    for (; t < width; t++)
+        for (m = 0; m < 8; m++)
+            win[m][t] = sha[t * stepX + m];
+}
+
+#if ROTATE == 90 || ROTATE == 270
+#define SHROT_TRANSPOSE
+#endif
+
+#endif                          /* SHROT_SSE2 */
+
+/*
+ * Copy one line of the screen, starting at scr, from the shadow pixels at
+ * sha, sha + stepX, ...  Returns FALSE when the screen can't be reached.
+ */
+static Bool
+LINE(ScreenPtr pScreen, shadowBufPtr pBuf, int scrY, int scr, Data *sha,
+     FbStride stepX, int width)
+{
+    int scrBase = 0;
+    int i;
+    Data *winBase = NULL, *win;
+    CARD32 winSize = 0;
+
+    while (width) {
+        /*  how much remains in this window */
+        i = scrBase + winSize - scr;
+        if (i <= 0 || scr < scrBase) {
+            winBase = (Data *) (*pBuf->window) (pScreen,
+                                                scrY,
+                                                scr * sizeof(Data),
+                                                SHADOW_WINDOW_WRITE,
+                                                &winSize, pBuf->closure);
+            if (!winBase)
+                return FALSE;
+            scrBase = scr;
+            winSize /= sizeof(Data);
+            i = winSize;
+        }
+        win = winBase + (scr - scrBase);
+        if (i > width)
+            i = width;
+        width -= i;
+        scr += i;
+#if ROTATE == 0
+        memcpy(win, sha, i * sizeof(Data));
+        sha += i;
+#else
+#if ROTATE == 180 && defined(SHROT_SSE2)
+        {
+            int n;
+
+            if (sizeof(Data) == 4)
+                n = shadowReverse32((CARD32 *) win, (CARD32 *) sha, i);
+            else if (sizeof(Data) == 2)
+                n = shadowReverse16((CARD16 *) win, (CARD16 *) sha, i);
+            else
+                n = shadowReverse8((CARD8 *) win, (CARD8 *) sha, i);
+            win += n;
+            sha -= n;
+            i -= n;
+        }
+#endif
+        while (i--) {
+            *win++ = *sha;
+            sha += stepX;
+        }
+#endif
+    }
+    return TRUE;
+}
+
+#ifdef SHROT_TRANSPOSE
+#define SHROT_GROUP     ((int) (16 / sizeof(Data)))
+
+/*
+ * Copy SHROT_GROUP lines of the screen, the first starting from sha and
+ * each of the rest stepY further on.  The windows of all of them are
+ * needed at once, which is why this is only done for screens that said
+ * so with shadowSetThreaded.
+ */
+static Bool
+GROUP(ScreenPtr pScreen, shadowBufPtr pBuf, int *scrY, int scr, Data *sha,
+      FbStride stepX, FbStride stepY, int width)
+{
+    Data *win[16], *line;
+    CARD32 winSize;
+    int k;
+
+    for (k = 0; k < SHROT_GROUP; k++) {
+        line = (Data *) (*pBuf->window) (pScreen, scrY[k], scr * sizeof(Data),
+                                         SHADOW_WINDOW_WRITE, &winSize,
+                                         pBuf->closure);
+        if (!line || (int) (winSize / sizeof(Data)) < width) {
+            for (k = 0; k < SHROT_GROUP; k++)
+                if (!LINE(pScreen, pBuf, scrY[k], scr, sha + k * stepY,
+                          stepX, width))
+                    return FALSE;
+            return TRUE;
+        }
+        /* vector lanes go up through the shadow */
+        win[stepY > 0 ? k : SHROT_GROUP - 1 - k] = line;
+    }
+    if (stepY < 0)
+        sha -= SHROT_GROUP - 1;
+    if (sizeof(Data) == 4)
+        shadowTranspose32((CARD32 **) win, (CARD32 *) sha, stepX, width);
+    else
+        shadowTranspose16((CARD16 **) win, (CARD16 *) sha, stepX, width);
+    return TRUE;
+}
+#endif
+
+static void
+BOX(ScreenPtr pScreen, shadowBufPtr pBuf, BoxPtr pbox)
 {
-    RegionPtr damage = DamageRegion(pBuf->pDamage);
     PixmapPtr pShadow = pBuf->pPixmap;
-    int nbox = RegionNumRects(damage);
-    BoxPtr pbox = RegionRects(damage);
     FbBits *shaBits;
-    Data *shaBase, *shaLine, *sha;
+    Data *shaBase, *shaLine;
     FbStride shaStride;
-    int scrBase, scrLine, scr;
+    int scrLine;
     int shaBpp;
     _X_UNUSED int shaXoff, shaYoff;
     int x, y, w, h, width;
-    int i;
-    Data *winBase = NULL, *win;
-    CARD32 winSize;
+#ifdef SHROT_TRANSPOSE
+    int group = pBuf->threaded && sizeof(Data) > 1 ? SHROT_GROUP : 0;
+    int groupY[16], n = 0, i;
+    Data *groupSha = NULL;
+#endif
 
     fbGetDrawable(&pShadow->drawable, shaBits, shaStride, shaBpp, shaXoff,
                   shaYoff);
     shaBase = (Data *) shaBits;
     shaStride = shaStride * sizeof(FbBits) / sizeof(Data);
-#if (DANDEBUG > 1)
-    ErrorF
-        ("-> Entering Shadow Update:\r\n   |- Origins: pShadow=%x, pScreen=%x, damage=%x\r\n   |- Metrics: shaStride=%d, shaBase=%x, shaBpp=%d\r\n   |                                                     \n",
-         pShadow, pScreen, damage, shaStride, shaBase, shaBpp);
-#endif
-    while (nbox--) {
-        x = pbox->x1;
-        y = pbox->y1;
-        w = (pbox->x2 - pbox->x1);
-        h = pbox->y2 - pbox->y1;
+
+    x = pbox->x1;
+    y = pbox->y1;
+    w = (pbox->x2 - pbox->x1);
+    h = pbox->y2 - pbox->y1;
 
 #if (DANDEBUG > 2)
-        ErrorF
-            ("   |-> Redrawing box - Metrics: X=%d, Y=%d, Width=%d, Height=%d\n",
-             x, y, w, h);
-#endif
-        scrLine = SCRLEFT(x, y, w, h);
-        shaLine = shaBase + FIRSTSHA(x, y, w, h);
-
-        while (STEPDOWN(x, y, w, h)) {
-            winSize = 0;
-            scrBase = 0;
-            width = SCRWIDTH(x, y, w, h);
-            scr = scrLine;
-            sha = shaLine;
-#if (DANDEBUG > 3)
-            ErrorF("   |   |-> StepDown - Metrics: width=%d, scr=%x, sha=%x\n",
-                   width, scr, sha);
+    ErrorF("   |-> Redrawing box - Metrics: X=%d, Y=%d, Width=%d, Height=%d\n",
+           x, y, w, h);
 #endif
-            while (width) {
-                /*  how much remains in this window */
-                i = scrBase + winSize - scr;
-                if (i <= 0 || scr < scrBase) {
-                    winBase = (Data *) (*pBuf->window) (pScreen,
-                                                        SCRY(x, y, w, h),
-                                                        scr * sizeof(Data),
-                                                        SHADOW_WINDOW_WRITE,
-                                                        &winSize,
-                                                        pBuf->closure);
-                    if (!winBase)
-                        return;
-                    scrBase = scr;
-                    winSize /= sizeof(Data);
-                    i = winSize;
-#if(DANDEBUG > 4)
-                    ErrorF
-                        ("   |   |   |-> Starting New Line - Metrics: winBase=%x, scrBase=%x, winSize=%d\r\n   |   |   |   Xstride=%d, Ystride=%d, w=%d h=%d\n",
-                         winBase, scrBase, winSize, SHASTEPX(shaStride),
-                         SHASTEPY(shaStride), w, h);
+    scrLine = SCRLEFT(x, y, w, h);
+    shaLine = shaBase + FIRSTSHA(x, y, w, h);
+    width = SCRWIDTH(x, y, w, h);
+
+    while (STEPDOWN(x, y, w, h)) {
+#ifdef SHROT_TRANSPOSE
+        if (group) {
+            if (!n)
+                groupSha = shaLine;
+            groupY[n++] = SCRY(x, y, w, h);
+            if (n == group) {
+                if (!GROUP(pScreen, pBuf, groupY, scrLine, groupSha,
+                           SHASTEPX(shaStride), SHASTEPY(shaStride), width))
+                    return;
+                n = 0;
+            }
+        }
+        else
 #endif
-                }
-                win = winBase + (scr - scrBase);
-                if (i > width)
-                    i = width;
-                width -= i;
-                scr += i;
-#if(DANDEBUG > 5)
-                ErrorF
-                    ("   |   |   |-> Writing Line - Metrics: win=%x, sha=%x\n",
-                     win, sha);
+        if (!LINE(pScreen, pBuf, SCRY(x, y, w, h), scrLine, shaLine,
+                  SHASTEPX(shaStride), width))
+            return;
+        shaLine += SHASTEPY(shaStride);
+        NEXTY(x, y, w, h);
+    }
+#ifdef SHROT_TRANSPOSE
+    for (i = 0; i < n; i++)
+        if (!LINE(pScreen, pBuf, groupY[i], scrLine,
+                  groupSha + i * SHASTEPY(shaStride), SHASTEPX(shaStride),
+                  width))
+            return;
 #endif
-                while (i--) {
-#if(DANDEBUG > 6)
-                    ErrorF
-                        ("   |   |   |-> Writing Pixel - Metrics: win=%x, sha=%d, remaining=%d\n",
-                         win, sha, i);
+}
+
+/*
+ * Rotations go in square tiles, so that the shadow lines read for one
+ * line of the screen are still in the cache for the next.
+ */
+void
+FUNC(ScreenPtr pScreen, shadowBufPtr pBuf)
+{
+#if ROTATE == 90 || ROTATE == 270
+    shadowUpdateTiles(pScreen, pBuf, BOX, SHADOW_TILE_SIZE, SHADOW_TILE_SIZE);
+#else
+    shadowUpdateTiles(pScreen, pBuf, BOX, MAXSHORT, SHADOW_TILE_LINES);
 #endif
-                    *win++ = *sha;
-                    sha += SHASTEPX(shaStride);
-                }               /*  i */
-            }                   /*  width */
-            shaLine += SHASTEPY(shaStride);
-            NEXTY(x, y, w, h);
-        }                       /*  STEPDOWN */
-        pbox++;
-    }                           /*  nbox */
 }
@@ -0,0 +1,49 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Update procs that work a box at a time let shadowUpdateTiles split the
+ * damage up for them.  Tiles are square for the rotations, so that the
+ * lines of the shadow read for one tile are still in the cache for the
+ * next line written; copies without rotation take whole lines of a box,
+ * in bands.
+ */
+
+#ifndef _SHTILE_H_
+#define _SHTILE_H_
+
+#include "shadow.h"
+
+/* Tiles for rotations, in pixels */
+#define SHADOW_TILE_SIZE        64
+/* Lines per tile for updates without rotation */
+#define SHADOW_TILE_LINES       64
+/* Updates this big go to the render threads, when the screen allows */
+#define SHADOW_THREAD_PIXELS    (256 * 1024)
+
+typedef void (*ShadowBoxProc) (ScreenPtr pScreen, shadowBufPtr pBuf,
+                               BoxPtr pbox);
+
+extern void
+ shadowUpdateTiles(ScreenPtr pScreen, shadowBufPtr pBuf, ShadowBoxProc proc,
+                   int tileWidth, int tileHeight);
+
+#endif                          /* _SHTILE_H_ */
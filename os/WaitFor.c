@@ -94,8 +94,16 @@ SOFTWARE.
 #include <X11/extensions/dpmsconst.h>
 #endif
 
+/*
+ * Pending timers live in a binary min-heap ordered by expiry (then by
+ * when they were set, so timers due at the same time still run in the
+ * order they were set), making TimerSet and TimerCancel O(log n).
+ * The heap always has room for every allocated timer, so setting a
+ * timer never fails once TimerSet has handed it out.
+ */
 struct _OsTimerRec {
-    struct xorg_list list;
+    int index;                  /* position in timer_heap, -1 if idle */
+    CARD32 seq;
     CARD32 expires;
     CARD32 delta;
     OsTimerCallback callback;
@@ -105,15 +113,86 @@ struct _OsTimerRec {
 static void DoTimer(OsTimerPtr timer, CARD32 now);
 static void DoTimers(CARD32 now);
 static void CheckAllTimers(void);
-static volatile struct xorg_list timers;
+static OsTimerPtr *timer_heap;
+static int timer_count;         /* pending timers */
+static int timer_allocated;     /* timers handed out by TimerSet */
+static int timer_heap_size;
+static CARD32 timer_seq;
+
+static inline Bool
+timer_before(OsTimerPtr a, OsTimerPtr b)
+{
+    int d = (int) (a->expires - b->expires);
+
+    return d < 0 || (d == 0 && (int) (a->seq - b->seq) < 0);
+}
+
+static inline void
+timer_heap_place(OsTimerPtr timer, int i)
+{
+    timer_heap[i] = timer;
+    timer->index = i;
+}
+
+static void
+timer_heap_up(OsTimerPtr timer, int i)
+{
+    while (i > 0) {
+        int parent = (i - 1) >> 1;
+
+        if (!timer_before(timer, timer_heap[parent]))
+            break;
+        timer_heap_place(timer_heap[parent], i);
+        i = parent;
+    }
+    timer_heap_place(timer, i);
+}
+
+static void
+timer_heap_down(OsTimerPtr timer, int i)
+{
+    for (;;) {
+        int child = 2 * i + 1;
+
+        if (child >= timer_count)
+            break;
+        if (child + 1 < timer_count &&
+            timer_before(timer_heap[child + 1], timer_heap[child]))
+            child++;
+        if (!timer_before(timer_heap[child], timer))
+            break;
+        timer_heap_place(timer_heap[child], i);
+        i = child;
+    }
+    timer_heap_place(timer, i);
+}
+
+static void
+timer_heap_insert(OsTimerPtr timer)
+{
+    timer->seq = timer_seq++;
+    timer_heap_up(timer, timer_count++);
+}
+
+static void
+timer_heap_remove(OsTimerPtr timer)
+{
+    int i = timer->index;
+    OsTimerPtr last = timer_heap[--timer_count];
+
+    timer->index = -1;
+    if (last == timer)
+        return;
+    if (i > 0 && timer_before(last, timer_heap[(i - 1) >> 1]))
+        timer_heap_up(last, i);
+    else
+        timer_heap_down(last, i);
+}
 
 static inline OsTimerPtr
 first_timer(void)
 {
-    /* inline xorg_list_is_empty which can't handle volatile */
-    if (timers.next == &timers)
-        return NULL;
-    return xorg_list_first_entry(&timers, struct _OsTimerRec, list);
+    return timer_count ? timer_heap[0] : NULL;
 }
 
 /*
@@ -124,25 +203,31 @@ static int
 check_timers(void)
 {
     OsTimerPtr timer;
+    CARD32 now, delta;
+    int timeout;
 
-    if ((timer = first_timer()) != NULL) {
-        CARD32 now = GetTimeInMillis();
-        int timeout = timer->expires - now;
-
-        if (timeout <= 0) {
-            DoTimers(now);
-        } else {
-            /* Make sure the timeout is sane */
-            if (timeout < timer->delta + 250)
-                return timeout;
+    input_lock();
+    if ((timer = first_timer()) == NULL) {
+        input_unlock();
+        return -1;
+    }
+    now = GetTimeInMillis();
+    timeout = timer->expires - now;
+    delta = timer->delta;
+    input_unlock();
 
-            /* time has rewound.  reset the timers. */
-            CheckAllTimers();
-        }
+    if (timeout <= 0) {
+        DoTimers(now);
+    } else {
+        /* Make sure the timeout is sane */
+        if (timeout < delta + 250)
+            return timeout;
 
-        return 0;
+        /* time has rewound.  reset the timers. */
+        CheckAllTimers();
     }
-    return -1;
+
+    return 0;
 }
 
 /*****************
@@ -243,22 +328,24 @@ AdjustWaitForDelay(void *waitTime, int newdelay)
 }
 
 static inline Bool timer_pending(OsTimerPtr timer) {
-    return !xorg_list_is_empty(&timer->list);
+    return timer->index >= 0;
 }
 
 /* If time has rewound, re-run every affected timer.
- * Timers might drop out of the list, so we have to restart every time. */
+ * Timers might move around in the heap, so we have to restart every time. */
 static void
 CheckAllTimers(void)
 {
     OsTimerPtr timer;
     CARD32 now;
+    int i;
 
     input_lock();
  start:
     now = GetTimeInMillis();
 
-    xorg_list_for_each_entry(timer, &timers, list) {
+    for (i = 0; i < timer_count; i++) {
+        timer = timer_heap[i];
         if (timer->expires - now > timer->delta + 250) {
             DoTimer(timer, now);
             goto start;
@@ -272,7 +359,7 @@ DoTimer(OsTimerPtr timer, CARD32 now)
 {
     CARD32 newTime;
 
-    xorg_list_del(&timer->list);
+    timer_heap_remove(timer);
     newTime = (*timer->callback) (timer, now, timer->arg);
     if (newTime)
         TimerSet(timer, 0, newTime, timer->callback, timer->arg);
@@ -292,23 +379,46 @@ DoTimers(CARD32 now)
     input_unlock();
 }
 
+/* Make sure the heap can hold one more timer */
+static Bool
+TimerReserve(void)
+{
+    OsTimerPtr *heap;
+    int size;
+
+    if (timer_allocated < timer_heap_size)
+        return TRUE;
+    size = timer_heap_size ? timer_heap_size * 2 : 64;
+    heap = reallocarray(timer_heap, size, sizeof(OsTimerPtr));
+    if (!heap)
+        return FALSE;
+    timer_heap = heap;
+    timer_heap_size = size;
+    return TRUE;
+}
+
 OsTimerPtr
 TimerSet(OsTimerPtr timer, int flags, CARD32 millis,
          OsTimerCallback func, void *arg)
 {
-    OsTimerPtr existing, tmp;
     CARD32 now = GetTimeInMillis();
 
     if (!timer) {
-        timer = calloc(1, sizeof(struct _OsTimerRec));
+        input_lock();
+        if (TimerReserve())
+            timer = calloc(1, sizeof(struct _OsTimerRec));
+        if (timer) {
+            timer->index = -1;
+            timer_allocated++;
+        }
+        input_unlock();
         if (!timer)
             return NULL;
-        xorg_list_init(&timer->list);
     }
     else {
         input_lock();
         if (timer_pending(timer)) {
-            xorg_list_del(&timer->list);
+            timer_heap_remove(timer);
             if (flags & TimerForceOld)
                 (void) (*timer->callback) (timer, now, timer->arg);
         }
@@ -328,12 +438,7 @@ TimerSet(OsTimerPtr timer, int flags, CARD32 millis,
     timer->arg = arg;
     input_lock();
 
-    /* Sort into list */
-    xorg_list_for_each_entry_safe(existing, tmp, &timers, list)
-        if ((int) (existing->expires - millis) > 0)
-            break;
-    /* This even works at the end of the list -- existing->list will be timers */
-    xorg_list_add(&timer->list, existing->list.prev);
+    timer_heap_insert(timer);
 
     /* Check to see if the timer is ready to run now */
     if ((int) (millis - now) <= 0)
@@ -362,7 +467,8 @@ TimerCancel(OsTimerPtr timer)
     if (!timer)
         return;
     input_lock();
-    xorg_list_del(&timer->list);
+    if (timer_pending(timer))
+        timer_heap_remove(timer);
     input_unlock();
 }
 
@@ -371,7 +477,11 @@ TimerFree(OsTimerPtr timer)
 {
     if (!timer)
         return;
-    TimerCancel(timer);
+    input_lock();
+    if (timer_pending(timer))
+        timer_heap_remove(timer);
+    timer_allocated--;
+    input_unlock();
     free(timer);
 }
 
@@ -384,18 +494,10 @@ TimerCheck(void)
 void
 TimerInit(void)
 {
-    static Bool been_here;
-    OsTimerPtr timer, tmp;
-
-    if (!been_here) {
-        been_here = TRUE;
-        xorg_list_init((struct xorg_list*) &timers);
-    }
+    OsTimerPtr timer;
 
-    xorg_list_for_each_entry_safe(timer, tmp, &timers, list) {
-        xorg_list_del(&timer->list);
-        free(timer);
-    }
+    while ((timer = first_timer()))
+        TimerFree(timer);
 }
 
 #ifdef DPMSExtension
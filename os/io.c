@@ -91,20 +91,37 @@ typedef struct _connectionInput {
     unsigned int ignoreBytes;   /* bytes to ignore before the next request */
 } ConnectionInput;
 
+/*
+ * Pending output is a queue of buffers hanging off oc->output.  Small
+ * writes are copied into the last buffer so they go out together; large
+ * buffers handed over with WriteToClientNoCopy are queued by reference
+ * and freed once written.  A partial write only advances 'start', so a
+ * slow client never makes us shuffle its backlog around.
+ */
 typedef struct _connectionOutput {
     struct _connectionOutput *next;
+    struct _connectionOutput *last;     /* tail of the queue, head only */
     unsigned char *buf;
     int size;
-    int count;
+    int start;                  /* first byte not yet written */
+    int count;                  /* end of the data in buf */
+    Bool owned;                 /* buf belongs to us, not the free list */
 } ConnectionOutput;
 
+/* iovecs handed to one writev(), well below any system's IOV_MAX */
+#define OUTPUT_IOVECS 64
+
+/* spare output buffers kept around for reuse; the rest are freed */
+#define MAX_FREE_OUTPUTS 4
+
 static ConnectionInputPtr AllocateInputBuffer(void);
-static ConnectionOutputPtr AllocateOutputBuffer(void);
+static ConnectionOutputPtr AllocateOutputBuffer(int size);
 
 static Bool CriticalOutputPending;
 static int timesThisConnection = 0;
 static ConnectionInputPtr FreeInputs = (ConnectionInputPtr) NULL;
 static ConnectionOutputPtr FreeOutputs = (ConnectionOutputPtr) NULL;
+static int NumFreeOutputs;
 static OsCommPtr AvailableInput = (OsCommPtr) NULL;
 
 #define get_req_len(req,cli) ((cli)->swapped ? \
@@ -661,24 +678,121 @@ AbortClient(ClientPtr client)
     }
 }
 
-/*****************
- * WriteToClient
- *    Copies buf into ClientPtr.buf if it fits (with padding), else
- *    flushes ClientPtr.buf and buf to client.  As of this writing,
- *    every use of WriteToClient is cast to void, and the result
- *    is ignored.  Potentially, this could be used by requests
- *    that are sending several chunks of data and want to break
- *    out of a loop on error.  Thus, we will leave the type of
- *    this routine as int.
- *****************/
+static ConnectionOutputPtr
+GetOutputBuffer(int size)
+{
+    ConnectionOutputPtr oco;
 
-int
-WriteToClient(ClientPtr who, int count, const void *__buf)
+    if (size <= BUFSIZE && (oco = FreeOutputs)) {
+        FreeOutputs = oco->next;
+        NumFreeOutputs--;
+    }
+    else if (!(oco = AllocateOutputBuffer(max(size, BUFSIZE))))
+        return NULL;
+    oco->next = NULL;
+    oco->start = oco->count = 0;
+    return oco;
+}
+
+static void
+ReleaseOutputBuffer(ConnectionOutputPtr oco)
+{
+    if (oco->owned || oco->size > BUFWATERMARK ||
+        NumFreeOutputs >= MAX_FREE_OUTPUTS) {
+        free(oco->buf);
+        free(oco);
+    }
+    else {
+        oco->next = FreeOutputs;
+        FreeOutputs = oco;
+        NumFreeOutputs++;
+    }
+}
+
+static void
+AppendOutputBuffer(OsCommPtr oc, ConnectionOutputPtr oco)
+{
+    oco->next = NULL;
+    if (oc->output)
+        oc->output->last->next = oco;
+    else
+        oc->output = oco;
+    oc->output->last = oco;
+}
+
+static void
+PopOutputBuffer(OsCommPtr oc)
+{
+    ConnectionOutputPtr oco = oc->output;
+
+    oc->output = oco->next;
+    if (oc->output)
+        oc->output->last = oco->last;
+    ReleaseOutputBuffer(oco);
+}
+
+static void
+DiscardOutput(OsCommPtr oc)
+{
+    while (oc->output)
+        PopOutputBuffer(oc);
+}
+
+/* Copy len bytes of data plus pad zero bytes onto the end of the queue */
+static Bool
+QueueOutput(OsCommPtr oc, const char *data, long len, long pad)
+{
+    ConnectionOutputPtr oco = oc->output ? oc->output->last : NULL;
+
+    if (!oco || oco->owned || oco->count + len + pad > oco->size) {
+        if (len + pad > INT_MAX - BUFSIZE)
+            return FALSE;
+        if (!(oco = GetOutputBuffer(len + pad)))
+            return FALSE;
+        AppendOutputBuffer(oc, oco);
+    }
+    if (len) {
+        memcpy(oco->buf + oco->count, data, len);
+        oco->count += len;
+    }
+    if (pad) {
+        memset(oco->buf + oco->count, '\0', pad);
+        oco->count += pad;
+    }
+    return TRUE;
+}
+
+/* Queue buf[start..count) by reference; buf is freed once it is written */
+static Bool
+QueueOutputNoCopy(OsCommPtr oc, void *buf, int start, int count)
+{
+    ConnectionOutputPtr oco;
+
+    if (!(oco = malloc(sizeof(ConnectionOutput))))
+        return FALSE;
+    oco->buf = buf;
+    oco->size = count;
+    oco->start = start;
+    oco->count = count;
+    oco->owned = TRUE;
+    AppendOutputBuffer(oc, oco);
+    return TRUE;
+}
+
+static int FlushOutput(ClientPtr who, OsCommPtr oc, const char *extraBuf,
+                       int extraCount, void **owned);
+
+/*
+ * Common body of the WriteToClient variants.  If *owned is
+ * non-NULL it is the caller's malloc()ed buf; it is set to NULL when buf
+ * ends up referenced from the output queue, otherwise the caller frees it.
+ */
+static int
+WriteOutput(ClientPtr who, int count, const char *buf, void **owned)
 {
     OsCommPtr oc;
     ConnectionOutputPtr oco;
     int padBytes;
-    const char *buf = __buf;
 
     BUG_RETURN_VAL_MSG(in_input_thread(), 0,
                        "******** %s called from input thread *********\n", __func__);
@@ -689,7 +803,6 @@ WriteToClient(ClientPtr who, int count, const void *__buf)
     if (!count || !who || who == serverClient || who->clientGone)
         return 0;
     oc = who->osPrivate;
-    oco = oc->output;
 #ifdef DEBUG_COMMUNICATION
     {
         char info[128];
@@ -731,18 +844,6 @@ WriteToClient(ClientPtr who, int count, const void *__buf)
     }
 #endif
 
-    if (!oco) {
-        if ((oco = FreeOutputs)) {
-            FreeOutputs = oco->next;
-        }
-        else if (!(oco = AllocateOutputBuffer())) {
-            AbortClient(who);
-            MarkClientException(who);
-            return -1;
-        }
-        oc->output = oco;
-    }
-
     padBytes = padding_for_int32(count);
 
     if (ReplyCallback) {
@@ -785,25 +886,81 @@ WriteToClient(ClientPtr who, int count, const void *__buf)
         }
     }
 #endif
-    if (oco->count == 0 || oco->count + count + padBytes > oco->size) {
-        output_pending_clear(who);
-        if (!any_output_pending()) {
-            CriticalOutputPending = FALSE;
-            NewOutputPending = FALSE;
-        }
 
-        return FlushClient(who, oc, buf, count);
+    /* While output is queued, anything that fits in a buffer joins the
+     * queue; otherwise try to get everything out now. */
+    oco = oc->output ? oc->output->last : NULL;
+    if (oco && (oco->owned ? !owned && count + padBytes <= BUFSIZE
+                           : oco->count + count + padBytes <= oco->size)) {
+        if (!QueueOutput(oc, buf, count, padBytes)) {
+            AbortClient(who);
+            MarkClientException(who);
+            DiscardOutput(oc);
+            return -1;
+        }
+        NewOutputPending = TRUE;
+        output_pending_mark(who);
+        return count;
     }
 
-    NewOutputPending = TRUE;
-    output_pending_mark(who);
-    memmove((char *) oco->buf + oco->count, buf, count);
-    oco->count += count;
-    if (padBytes) {
-        memset(oco->buf + oco->count, '\0', padBytes);
-        oco->count += padBytes;
+    output_pending_clear(who);
+    if (!any_output_pending()) {
+        CriticalOutputPending = FALSE;
+        NewOutputPending = FALSE;
     }
-    return count;
+
+    return FlushOutput(who, oc, buf, count, owned);
+}
+
+/*****************
+ * WriteToClient
+ *    Copies buf into the client's output queue if there is output
+ *    pending and it fits (with padding), else flushes the queue and buf
+ *    to the client.  As of this writing,
+ *    every use of WriteToClient is cast to void, and the result
+ *    is ignored.  Potentially, this could be used by requests
+ *    that are sending several chunks of data and want to break
+ *    out of a loop on error.  Thus, we will leave the type of
+ *    this routine as int.
+ *****************/
+
+int
+WriteToClient(ClientPtr who, int count, const void *buf)
+{
+    return WriteOutput(who, count, buf, NULL);
+}
+
+/*****************
+ * WriteToClientNoCopy
+ *    Like WriteToClient, but takes ownership of buf, which must come
+ *    from malloc().  Whatever the client can't take right away is
+ *    queued by reference rather than copied, and buf is freed once
+ *    it has been written or the client goes away.
+ *****************/
+
+int
+WriteToClientNoCopy(ClientPtr who, int count, void *buf)
+{
+    void *owned = buf;
+    int ret;
+
+    ret = WriteOutput(who, count, buf, &owned);
+    free(owned);
+    return ret;
+}
+
+/*****************
+ * WriteToClientLend
+ *    Like WriteToClientNoCopy, but only gives up *buf if it had to be
+ *    queued by reference, in which case *buf is set to NULL.  Otherwise
+ *    the data has been written or copied and *buf is still the caller's
+ *    to reuse.
+ *****************/
+
+int
+WriteToClientLend(ClientPtr who, int count, void **buf)
+{
+    return WriteOutput(who, count, *buf, buf);
 }
 
  /********************
@@ -817,23 +974,29 @@ WriteToClient(ClientPtr who, int count, const void *__buf)
  **********************/
 
 int
-FlushClient(ClientPtr who, OsCommPtr oc, const void *__extraBuf, int extraCount)
+FlushClient(ClientPtr who, OsCommPtr oc, const void *extraBuf, int extraCount)
 {
-    ConnectionOutputPtr oco = oc->output;
+    return FlushOutput(who, oc, extraBuf, extraCount, NULL);
+}
+
+static int
+FlushOutput(ClientPtr who, OsCommPtr oc, const char *extraBuf, int extraCount,
+            void **owned)
+{
+    ConnectionOutputPtr oco;
     XtransConnInfo trans_conn = oc->trans_conn;
-    struct iovec iov[3];
+    struct iovec iov[OUTPUT_IOVECS];
     static char padBuffer[3];
-    const char *extraBuf = __extraBuf;
-    long written;
+    long extraDone;             /* bytes of extraBuf and padding written */
     long padsize;
     long notWritten;
     long todo;
 
-    if (!oco)
-	return 0;
-    written = 0;
+    extraDone = 0;
     padsize = padding_for_int32(extraCount);
-    notWritten = oco->count + extraCount + padsize;
+    notWritten = extraCount + padsize;
+    for (oco = oc->output; oco; oco = oco->next)
+        notWritten += oco->count - oco->start;
     if (!notWritten)
         return 0;
 
@@ -842,47 +1005,54 @@ FlushClient(ClientPtr who, OsCommPtr oc, const void *__extraBuf, int extraCount)
 
     todo = notWritten;
     while (notWritten) {
-        long before = written;  /* amount of whole thing written */
         long remain = todo;     /* amount to try this time, <= notWritten */
         int i = 0;
         long len;
 
-        /* You could be very general here and have "in" and "out" iovecs
-         * and write a loop without using a macro, but what the heck.  This
-         * translates to:
-         *
-         *     how much of this piece is new?
-         *     if more new then we are trying this time, clamp
-         *     if nothing new
-         *         then bump down amount already written, for next piece
-         *         else put new stuff in iovec, will need all of next piece
-         *
-         * Note that todo had better be at least 1 or else we'll end up
-         * writing 0 iovecs.
-         */
-#define InsertIOV(pointer, length) \
-	len = (length) - before; \
-	if (len > remain) \
-	    len = remain; \
-	if (len <= 0) { \
-	    before = (-len); \
-	} else { \
-	    iov[i].iov_len = len; \
-	    iov[i].iov_base = (pointer) + before;	\
-	    i++; \
-	    remain -= len; \
-	    before = 0; \
-	}
-
-        InsertIOV((char *) oco->buf, oco->count)
-            InsertIOV((char *) extraBuf, extraCount)
-            InsertIOV(padBuffer, padsize)
-
-            errno = 0;
+        /* Gather the queue, then the new data and its padding once the
+         * whole queue fits.  todo had better be at least 1 or else we'll
+         * end up writing 0 iovecs. */
+        for (oco = oc->output; oco && remain && i < OUTPUT_IOVECS - 2;
+             oco = oco->next) {
+            len = min(oco->count - oco->start, remain);
+            if (len <= 0)
+                continue;
+            iov[i].iov_base = (char *) oco->buf + oco->start;
+            iov[i].iov_len = len;
+            i++;
+            remain -= len;
+        }
+        if (!oco) {
+            if (remain && extraDone < extraCount) {
+                len = min(extraCount - extraDone, remain);
+                iov[i].iov_base = (char *) extraBuf + extraDone;
+                iov[i].iov_len = len;
+                i++;
+                remain -= len;
+            }
+            len = min(extraCount + padsize - max(extraDone, extraCount),
+                      remain);
+            if (len > 0) {
+                iov[i].iov_base = padBuffer;
+                iov[i].iov_len = len;
+                i++;
+            }
+        }
+
+        errno = 0;
         if (trans_conn && (len = _XSERVTransWritev(trans_conn, iov, i)) >= 0) {
-            written += len;
             notWritten -= len;
             todo = notWritten;
+            while (len && (oco = oc->output)) {
+                if (len < oco->count - oco->start) {
+                    oco->start += len;
+                    len = 0;
+                    break;
+                }
+                len -= oco->count - oco->start;
+                PopOutputBuffer(oc);
+            }
+            extraDone += len;
         }
         else if (ETEST(errno)
 #ifdef SUNSYSV                  /* check for another brain-damaged OS bug */
@@ -893,46 +1063,36 @@ FlushClient(ClientPtr who, OsCommPtr oc, const void *__extraBuf, int extraCount)
 #endif
             ) {
             /* If we've arrived here, then the client is stuffed to the gills
-               and not ready to accept more.  Make a note of it and buffer
+               and not ready to accept more.  Make a note of it and queue
                the rest. */
+            Bool queued = TRUE;
+
             output_pending_mark(who);
 
-            if (written < oco->count) {
-                if (written > 0) {
-                    oco->count -= written;
-                    memmove((char *) oco->buf,
-                            (char *) oco->buf + written, oco->count);
-                    written = 0;
+            if (extraDone < extraCount) {
+                if (owned && *owned) {
+                    queued = QueueOutputNoCopy(oc, *owned, extraDone,
+                                               extraCount);
+                    if (queued)
+                        *owned = NULL;
+                    if (queued && padsize)
+                        queued = QueueOutput(oc, NULL, 0, padsize);
                 }
+                else
+                    queued = QueueOutput(oc, extraBuf + extraDone,
+                                         extraCount - extraDone, padsize);
             }
-            else {
-                written -= oco->count;
-                oco->count = 0;
-            }
-
-            if (notWritten > oco->size) {
-                unsigned char *obuf = NULL;
-
-                if (notWritten + BUFSIZE <= INT_MAX) {
-                    obuf = realloc(oco->buf, notWritten + BUFSIZE);
-                }
-                if (!obuf) {
-                    AbortClient(who);
-                    MarkClientException(who);
-                    oco->count = 0;
-                    return -1;
-                }
-                oco->size = notWritten + BUFSIZE;
-                oco->buf = obuf;
+            else if (extraDone < extraCount + padsize)
+                queued = QueueOutput(oc, NULL, 0,
+                                     extraCount + padsize - extraDone);
+
+            if (!queued) {
+                AbortClient(who);
+                MarkClientException(who);
+                DiscardOutput(oc);
+                return -1;
             }
 
-            /* If the amount written extended into the padBuffer, then the
-               difference "extraCount - written" may be less than 0 */
-            if ((len = extraCount - written) > 0)
-                memmove((char *) oco->buf + oco->count,
-                        extraBuf + written, len);
-
-            oco->count = notWritten;    /* this will include the pad */
             ospoll_listen(server_poll, oc->fd, X_NOTIFY_WRITE);
 
             /* return only the amount explicitly requested */
@@ -946,24 +1106,13 @@ FlushClient(ClientPtr who, OsCommPtr oc, const void *__extraBuf, int extraCount)
         else {
             AbortClient(who);
             MarkClientException(who);
-            oco->count = 0;
+            DiscardOutput(oc);
             return -1;
         }
     }
 
     /* everything was flushed out */
-    oco->count = 0;
     output_pending_clear(who);
-
-    if (oco->size > BUFWATERMARK) {
-        free(oco->buf);
-        free(oco);
-    }
-    else {
-        oco->next = FreeOutputs;
-        FreeOutputs = oco;
-    }
-    oc->output = (ConnectionOutputPtr) NULL;
     return extraCount;          /* return only the amount explicitly requested */
 }
 
@@ -989,20 +1138,22 @@ AllocateInputBuffer(void)
 }
 
 static ConnectionOutputPtr
-AllocateOutputBuffer(void)
+AllocateOutputBuffer(int size)
 {
     ConnectionOutputPtr oco;
 
     oco = malloc(sizeof(ConnectionOutput));
     if (!oco)
         return NULL;
-    oco->buf = calloc(1, BUFSIZE);
+    oco->buf = malloc(size);
     if (!oco->buf) {
         free(oco);
         return NULL;
     }
-    oco->size = BUFSIZE;
+    oco->size = size;
+    oco->start = 0;
     oco->count = 0;
+    oco->owned = FALSE;
     return oco;
 }
 
@@ -1028,16 +1179,9 @@ FreeOsBuffers(OsCommPtr oc)
             oci->ignoreBytes = 0;
         }
     }
-    if ((oco = oc->output)) {
-        if (FreeOutputs) {
-            free(oco->buf);
-            free(oco);
-        }
-        else {
-            FreeOutputs = oco;
-            oco->next = (ConnectionOutputPtr) NULL;
-            oco->count = 0;
-        }
+    while ((oco = oc->output)) {
+        oc->output = oco->next;
+        ReleaseOutputBuffer(oco);
     }
 }
 
@@ -1057,4 +1201,5 @@ ResetOsBuffers(void)
         free(oco->buf);
         free(oco);
     }
+    NumFreeOutputs = 0;
 }
@@ -29,6 +29,7 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include "misc.h"               /* for typedef of pointer */
+#include "os.h"
 #include "ospoll.h"
 #include "list.h"
 
@@ -56,6 +57,21 @@
 #define HAVE_OSPOLL     1
 #endif
 
+/* io_uring is a run-time option on top of the epoll implementation */
+#if EPOLL && defined(HAVE_LINUX_IO_URING_H)
+#include <linux/io_uring.h>
+#ifdef IORING_ENTER_EXT_ARG
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <poll.h>
+#include <signal.h>
+#include <errno.h>
+#define URING           1
+#endif
+#endif
+
+Bool ospoll_use_uring = FALSE;
+
 #if POLLSET
 
 // pollset-based implementation (as seen on AIX)
@@ -88,7 +104,32 @@ struct ospollfd {
     void                (*callback)(int fd, int xevents, void *data);
     void                *data;
     struct xorg_list    deleted;
+#if URING
+    int                 armed;          /* events of the outstanding poll */
+    int                 fired;          /* edge events seen since reset */
+    uint32_t            seq;            /* tags the outstanding poll */
+#endif
+};
+
+#if URING
+struct ospoll_uring {
+    int                 fd;
+    void                *ring;
+    size_t              ring_size;
+    struct io_uring_sqe *sqes;
+    size_t              sqes_size;
+    unsigned            *sq_head;
+    unsigned            *sq_tail;
+    unsigned            *sq_array;
+    unsigned            sq_mask;
+    unsigned            sq_entries;
+    unsigned            *cq_head;
+    unsigned            *cq_tail;
+    struct io_uring_cqe *cqes;
+    unsigned            cq_mask;
+    uint32_t            seq;
 };
+#endif
 
 struct ospoll {
     int                 epoll_fd;
@@ -96,6 +137,9 @@ struct ospoll {
     int                 num;
     int                 size;
     struct xorg_list    deleted;
+#if URING
+    struct ospoll_uring *uring;         /* NULL when using epoll */
+#endif
 };
 
 #endif
@@ -198,6 +242,231 @@ array_delete(void *base, size_t num, size_t size, size_t pos)
 }
 
 
+#if URING
+
+/*
+ * io_uring backend.
+ *
+ * Every fd being listened on has one one-shot IORING_OP_POLL_ADD
+ * outstanding.  Changes from ospoll_listen/ospoll_mute/ospoll_reset_events
+ * and the re-arming done after each callback only queue SQEs; the whole
+ * batch goes to the kernel with the wait for the next events in a single
+ * io_uring_enter(), instead of an epoll_ctl() per change.
+ *
+ * Edge triggering is emulated the way the poll() implementation does it:
+ * an edge-triggered fd is not re-armed for events it has reported until
+ * ospoll_reset_events or ospoll_listen asks for them again.
+ *
+ * Needs IORING_FEAT_EXT_ARG (Linux 5.11) for the wait timeout; anything
+ * older, or a kernel that refuses io_uring, gets epoll.
+ */
+
+#define URING_ENTRIES   256
+#define URING_IGNORE    (~(__u64) 0)
+
+static int
+uring_enter(struct ospoll_uring *uring, unsigned submit, unsigned wait,
+            struct __kernel_timespec *ts)
+{
+    struct io_uring_getevents_arg arg = {
+        .sigmask_sz = _NSIG / 8,
+        .ts = (__u64) (uintptr_t) ts,
+    };
+
+    return syscall(__NR_io_uring_enter, uring->fd, submit, wait,
+                   IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG,
+                   &arg, sizeof (arg));
+}
+
+static unsigned
+uring_unsubmitted(struct ospoll_uring *uring)
+{
+    return *uring->sq_tail - __atomic_load_n(uring->sq_head, __ATOMIC_ACQUIRE);
+}
+
+static struct ospoll_uring *
+uring_create(void)
+{
+    struct io_uring_params params = { 0 };
+    struct ospoll_uring *uring;
+    unsigned char *ring;
+    int fd;
+
+    fd = syscall(__NR_io_uring_setup, URING_ENTRIES, &params);
+    if (fd < 0)
+        return NULL;
+
+    if (!(params.features & IORING_FEAT_EXT_ARG) ||
+        !(params.features & IORING_FEAT_SINGLE_MMAP) ||
+        !(uring = calloc(1, sizeof (struct ospoll_uring)))) {
+        close(fd);
+        return NULL;
+    }
+
+    uring->fd = fd;
+    uring->ring_size = max(params.sq_off.array +
+                           params.sq_entries * sizeof (unsigned),
+                           params.cq_off.cqes +
+                           params.cq_entries * sizeof (struct io_uring_cqe));
+    uring->ring = mmap(NULL, uring->ring_size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    uring->sqes_size = params.sq_entries * sizeof (struct io_uring_sqe);
+    uring->sqes = mmap(NULL, uring->sqes_size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (uring->ring == MAP_FAILED || uring->sqes == MAP_FAILED) {
+        if (uring->ring != MAP_FAILED)
+            munmap(uring->ring, uring->ring_size);
+        if (uring->sqes != MAP_FAILED)
+            munmap(uring->sqes, uring->sqes_size);
+        close(fd);
+        free(uring);
+        return NULL;
+    }
+
+    ring = uring->ring;
+    uring->sq_head = (unsigned *) (ring + params.sq_off.head);
+    uring->sq_tail = (unsigned *) (ring + params.sq_off.tail);
+    uring->sq_array = (unsigned *) (ring + params.sq_off.array);
+    uring->sq_mask = *(unsigned *) (ring + params.sq_off.ring_mask);
+    uring->sq_entries = params.sq_entries;
+    uring->cq_head = (unsigned *) (ring + params.cq_off.head);
+    uring->cq_tail = (unsigned *) (ring + params.cq_off.tail);
+    uring->cqes = (struct io_uring_cqe *) (ring + params.cq_off.cqes);
+    uring->cq_mask = *(unsigned *) (ring + params.cq_off.ring_mask);
+    return uring;
+}
+
+static void
+uring_destroy(struct ospoll_uring *uring)
+{
+    munmap(uring->sqes, uring->sqes_size);
+    munmap(uring->ring, uring->ring_size);
+    close(uring->fd);
+    free(uring);
+}
+
+/* Queue an SQE, pushing the queue to the kernel early if it is full */
+static void
+uring_queue(struct ospoll_uring *uring, __u8 opcode, int fd,
+            __u64 addr, __u16 poll_events, __u64 user_data)
+{
+    struct io_uring_sqe *sqe;
+    unsigned tail = *uring->sq_tail;
+    unsigned index;
+
+    if (uring_unsubmitted(uring) >= uring->sq_entries &&
+        uring_enter(uring, uring_unsubmitted(uring), 0, NULL) < 0 &&
+        uring_unsubmitted(uring) >= uring->sq_entries) {
+        ErrorF("ospoll: io_uring submission queue stuck: %s\n",
+               strerror(errno));
+        return;
+    }
+
+    index = tail & uring->sq_mask;
+    sqe = &uring->sqes[index];
+    memset(sqe, 0, sizeof (*sqe));
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    sqe->addr = addr;
+    sqe->poll_events = poll_events;
+    sqe->user_data = user_data;
+    uring->sq_array[index] = index;
+    __atomic_store_n(uring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+/* Bring the outstanding poll for osfd in line with what it wants */
+static void
+uring_arm(struct ospoll *ospoll, struct ospollfd *osfd)
+{
+    struct ospoll_uring *uring = ospoll->uring;
+    int want = osfd->callback ? osfd->xevents & ~osfd->fired : 0;
+    __u16 events = 0;
+
+    if (want == osfd->armed)
+        return;
+
+    if (osfd->armed)
+        uring_queue(uring, IORING_OP_POLL_REMOVE, -1,
+                    ((__u64) osfd->seq << 32) | (uint32_t) osfd->fd, 0,
+                    URING_IGNORE);
+    osfd->armed = want;
+    if (!want)
+        return;
+
+    if (want & X_NOTIFY_READ)
+        events |= POLLIN;
+    if (want & X_NOTIFY_WRITE)
+        events |= POLLOUT;
+    osfd->seq = ++uring->seq;
+    uring_queue(uring, IORING_OP_POLL_ADD, osfd->fd, 0, events,
+                ((__u64) osfd->seq << 32) | (uint32_t) osfd->fd);
+}
+
+static int
+uring_wait(struct ospoll *ospoll, int timeout)
+{
+    struct ospoll_uring *uring = ospoll->uring;
+    struct __kernel_timespec ts, *pts = NULL;
+    unsigned head, tail;
+    int ret, nready = 0;
+
+    if (timeout >= 0) {
+        ts.tv_sec = timeout / 1000;
+        ts.tv_nsec = (timeout % 1000) * 1000000;
+        pts = &ts;
+    }
+
+    ret = uring_enter(uring, uring_unsubmitted(uring), timeout != 0, pts);
+    if (ret < 0 && errno != ETIME && errno != EINTR && errno != EBUSY)
+        return -1;
+
+    head = *uring->cq_head;
+    tail = __atomic_load_n(uring->cq_tail, __ATOMIC_ACQUIRE);
+    for (; head != tail; head++) {
+        struct io_uring_cqe *cqe = &uring->cqes[head & uring->cq_mask];
+        struct ospollfd *osfd;
+        int pos, xevents = 0;
+
+        if (cqe->user_data == URING_IGNORE)
+            continue;
+
+        /* ignore polls that have since been cancelled or replaced */
+        pos = ospoll_find(ospoll, (int) (uint32_t) cqe->user_data);
+        if (pos < 0)
+            continue;
+        osfd = ospoll->fds[pos];
+        if (!osfd->armed || osfd->seq != (uint32_t) (cqe->user_data >> 32))
+            continue;
+        osfd->armed = 0;
+
+        if (cqe->res < 0)
+            xevents |= X_NOTIFY_ERROR;
+        else {
+            if (cqe->res & POLLIN)
+                xevents |= X_NOTIFY_READ;
+            if (cqe->res & POLLOUT)
+                xevents |= X_NOTIFY_WRITE;
+            if (cqe->res & ~(POLLIN|POLLOUT))
+                xevents |= X_NOTIFY_ERROR;
+        }
+        if (osfd->trigger == ospoll_trigger_edge)
+            osfd->fired |= xevents & (X_NOTIFY_READ|X_NOTIFY_WRITE);
+
+        nready++;
+        if (osfd->callback)
+            osfd->callback(osfd->fd, xevents, osfd->data);
+        if (osfd->callback)
+            uring_arm(ospoll, osfd);
+    }
+    __atomic_store_n(uring->cq_head, head, __ATOMIC_RELEASE);
+
+    if (ret < 0 && errno == EINTR && !nready)
+        return -1;
+    return nready;
+}
+
+#endif
+
 struct ospoll *
 ospoll_create(void)
 {
@@ -225,12 +494,23 @@ ospoll_create(void)
 #if EPOLL
     struct ospoll       *ospoll = calloc(1, sizeof (struct ospoll));
 
+    xorg_list_init(&ospoll->deleted);
+#if URING
+    if (ospoll_use_uring) {
+        ospoll->uring = uring_create();
+        if (ospoll->uring) {
+            ospoll->epoll_fd = -1;
+            return ospoll;
+        }
+        LogMessageVerb(X_WARNING, 1, "ospoll: io_uring unavailable (%s), "
+                       "using epoll\n", strerror(errno));
+    }
+#endif
     ospoll->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
     if (ospoll->epoll_fd < 0) {
         free (ospoll);
         return NULL;
     }
-    xorg_list_init(&ospoll->deleted);
     return ospoll;
 #endif
 #if POLL
@@ -252,6 +532,11 @@ ospoll_destroy(struct ospoll *ospoll)
 #if EPOLL || PORT
     if (ospoll) {
         assert (ospoll->num == 0);
+#if URING
+        if (ospoll->uring)
+            uring_destroy(ospoll->uring);
+        else
+#endif
         close(ospoll->epoll_fd);
         ospoll_clean_deleted(ospoll);
         free(ospoll->fds);
@@ -362,7 +647,11 @@ ospoll_add(struct ospoll *ospoll, int fd,
         ev.data.ptr = osfd;
         if (trigger == ospoll_trigger_edge)
             ev.events |= EPOLLET;
-        if (epoll_ctl(ospoll->epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+        if (
+#if URING
+            !ospoll->uring &&
+#endif
+            epoll_ctl(ospoll->epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1) {
             free(osfd);
             return FALSE;
         }
@@ -445,6 +734,13 @@ ospoll_remove(struct ospoll *ospoll, int fd)
         struct epoll_event ev;
         ev.events = 0;
         ev.data.ptr = osfd;
+#if URING
+        if (ospoll->uring) {
+            osfd->callback = NULL;
+            uring_arm(ospoll, osfd);
+        }
+        else
+#endif
         (void) epoll_ctl(ospoll->epoll_fd, EPOLL_CTL_DEL, fd, &ev);
 
         array_delete(ospoll->fds, ospoll->num, sizeof (ospoll->fds[0]), pos);
@@ -480,6 +776,12 @@ static void
 epoll_mod(struct ospoll *ospoll, struct ospollfd *osfd)
 {
     struct epoll_event ev;
+#if URING
+    if (ospoll->uring) {
+        uring_arm(ospoll, osfd);
+        return;
+    }
+#endif
     ev.events = 0;
     if (osfd->xevents & X_NOTIFY_READ)
         ev.events |= EPOLLIN;
@@ -514,6 +816,9 @@ ospoll_listen(struct ospoll *ospoll, int fd, int xevents)
 #if EPOLL || PORT
         struct ospollfd *osfd = ospoll->fds[pos];
         osfd->xevents |= xevents;
+#if URING
+        osfd->fired &= ~xevents;
+#endif
         epoll_mod(ospoll, osfd);
 #endif
 #if POLL
@@ -633,6 +938,13 @@ ospoll_wait(struct ospoll *ospoll, int timeout)
     struct epoll_event events[MAX_EVENTS];
     int i;
 
+#if URING
+    if (ospoll->uring) {
+        nready = uring_wait(ospoll, timeout);
+        ospoll_clean_deleted(ospoll);
+        return nready;
+    }
+#endif
     nready = epoll_wait(ospoll->epoll_fd, events, MAX_EVENTS, timeout);
     for (i = 0; i < nready; i++) {
         struct epoll_event *ev = &events[i];
@@ -706,6 +1018,15 @@ ospoll_reset_events(struct ospoll *ospoll, int fd)
 
     epoll_mod(ospoll, ospoll->fds[pos]);
 #endif
+#if URING
+    int pos = ospoll_find(ospoll, fd);
+
+    if (pos < 0 || !ospoll->uring)
+        return;
+
+    ospoll->fds[pos]->fired = 0;
+    uring_arm(ospoll, ospoll->fds[pos]);
+#endif
 #if POLL
     int pos = ospoll_find(ospoll, fd);
 
@@ -41,6 +41,13 @@ enum ospoll_trigger {
     ospoll_trigger_level
 };
 
+/**
+ * Use io_uring rather than epoll for ospolls created from now on,
+ * where the system supports it (-iouring).  Falls back to epoll
+ * when io_uring is unavailable.
+ */
+extern Bool ospoll_use_uring;
+
 /**
  * Create a new ospoll structure
  */
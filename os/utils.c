@@ -82,6 +82,7 @@ __stdcall unsigned long GetTickCount(void);
 #include "dixfont.h"
 #include <X11/fonts/libxfont2.h>
 #include "osdep.h"
+#include "ospoll.h"
 #include "extension.h"
 #include <signal.h>
 #ifndef WIN32
@@ -109,16 +110,22 @@ __stdcall unsigned long GetTickCount(void);
 #include "xkbsrv.h"
 
 #include "picture.h"
+#ifdef COMPOSITE
+#include "compositeext.h"
+#endif
 
 Bool noTestExtensions;
 
 #ifdef COMPOSITE
 Bool noCompositeExtension = FALSE;
+Bool CompositeUnredirectFullscreen = FALSE;
 #endif
 
 #ifdef DAMAGE
 Bool noDamageExtension = FALSE;
 #endif
+int DamageMaxRects = 0;
+Bool DamageBatchReports = FALSE;
 #ifdef DBE
 Bool noDbeExtension = FALSE;
 #endif
@@ -449,6 +456,11 @@ GetTimeInMicros(void)
 {
     return (CARD64) GetTickCount() * 1000;
 }
+CARD64
+GetTimeInNanos(void)
+{
+    return (CARD64) GetTickCount() * 1000000;
+}
 #else
 CARD32
 GetTimeInMillis(void)
@@ -500,6 +512,29 @@ GetTimeInMicros(void)
     X_GETTIMEOFDAY(&tv);
     return (CARD64) tv.tv_sec * (CARD64)1000000 + (CARD64) tv.tv_usec;
 }
+
+CARD64
+GetTimeInNanos(void)
+{
+    struct timeval tv;
+#ifdef MONOTONIC_CLOCK
+    struct timespec tp;
+    static clockid_t nclockid;
+
+    if (!nclockid) {
+        if (clock_gettime(CLOCK_MONOTONIC, &tp) == 0)
+            nclockid = CLOCK_MONOTONIC;
+        else
+            nclockid = ~0L;
+    }
+    if (nclockid != ~0L && clock_gettime(nclockid, &tp) == 0)
+        return (CARD64) tp.tv_sec * (CARD64)1000000000 + tp.tv_nsec;
+#endif
+
+    X_GETTIMEOFDAY(&tv);
+    return (CARD64) tv.tv_sec * (CARD64)1000000000 +
+        (CARD64) tv.tv_usec * 1000;
+}
 #endif
 
 void
@@ -518,6 +553,8 @@ UseMsg(void)
     ErrorF("-cc int                default color visual class\n");
     ErrorF("-nocursor              disable the cursor\n");
     ErrorF("-core                  generate core dump on fatal error\n");
+    ErrorF("-damagebatch           send DAMAGE events once per dispatch cycle\n");
+    ErrorF("-damagerects int       round damage out to tiles past N rectangles\n");
     ErrorF("-displayfd fd          file descriptor to write display number to when ready to connect\n");
     ErrorF("-dpi int               screen resolution in dots per inch\n");
 #ifdef DPMSExtension
@@ -525,6 +562,7 @@ UseMsg(void)
 #endif
     ErrorF
         ("-deferglyphs [none|all|16] defer loading of [no|all|16-bit] glyphs\n");
+    ErrorF("-dispatchthreads int   render to private pixmaps on N threads\n");
     ErrorF("-f #                   bell base (0-100)\n");
     ErrorF("-fc string             cursor font\n");
     ErrorF("-fn string             default font name\n");
@@ -533,6 +571,7 @@ UseMsg(void)
     ErrorF("+iglx                  Allow creating indirect GLX contexts\n");
     ErrorF("-iglx                  Prohibit creating indirect GLX contexts (default)\n");
     ErrorF("-I                     ignore all remaining arguments\n");
+    ErrorF("-iouring               use io_uring for connection polling if available\n");
 #ifdef RLIMIT_DATA
     ErrorF("-ld int                limit data space to N Kb\n");
 #endif
@@ -557,6 +596,9 @@ UseMsg(void)
     ErrorF("-r                     turns off auto-repeat\n");
     ErrorF("r                      turns on auto-repeat \n");
     ErrorF("-render [default|mono|gray|color] set render color alloc policy\n");
+    ErrorF("-renderthreads int     split large software rendering over N threads\n");
+    ErrorF("-reqstats              collect request statistics, log on reset\n");
+    ErrorF("-reqstatsinterval int  also log request statistics every N seconds\n");
     ErrorF("-retro                 start with classic stipple and cursor\n");
     ErrorF("-s #                   screen-saver timeout (minutes)\n");
     ErrorF("-seat string           seat to run on\n");
@@ -565,6 +607,9 @@ UseMsg(void)
     ErrorF("-to #                  connection time out\n");
     ErrorF("-tst                   disable testing extensions\n");
     ErrorF("ttyxx                  server started from init on /dev/ttyxx\n");
+#ifdef COMPOSITE
+    ErrorF("-unredirectfullscreen  draw fullscreen windows straight to the screen\n");
+#endif
     ErrorF("v                      video blanking for screen-saver\n");
     ErrorF("-v                     screen-saver without video blanking\n");
     ErrorF("-wm                    WhenMapped default backing-store\n");
@@ -903,6 +948,10 @@ ProcessCommandLine(int argc, char *argv[])
             PartialNetwork = TRUE;
         else if (strcmp(argv[i], "-nopn") == 0)
             PartialNetwork = FALSE;
+#ifdef COMPOSITE
+        else if (strcmp(argv[i], "-unredirectfullscreen") == 0)
+            CompositeUnredirectFullscreen = TRUE;
+#endif
         else if (strcmp(argv[i], "r") == 0)
             defaultKeyboardControl.autoRepeat = TRUE;
         else if (strcmp(argv[i], "-r") == 0)
@@ -995,6 +1044,34 @@ ProcessCommandLine(int argc, char *argv[])
             i = skip - 1;
         }
 #endif
+        else if (strcmp(argv[i], "-reqstats") == 0) {
+            RequestStatsEnable = TRUE;
+        }
+        else if (strcmp(argv[i], "-reqstatsinterval") == 0) {
+            if (++i < argc) {
+                RequestStatsEnable = TRUE;
+                RequestStatsInterval = atoi(argv[i]);
+            }
+            else
+                UseMsg();
+        }
+        else if (strcmp(argv[i], "-iouring") == 0) {
+            ospoll_use_uring = TRUE;
+        }
+        else if (strcmp(argv[i], "-damagebatch") == 0)
+            DamageBatchReports = TRUE;
+        else if (strcmp(argv[i], "-damagerects") == 0) {
+            if (++i < argc)
+                DamageMaxRects = atoi(argv[i]);
+            else
+                UseMsg();
+        }
+        else if (strcmp(argv[i], "-dispatchthreads") == 0) {
+            if (++i < argc)
+                DispatchThreadCount = atoi(argv[i]);
+            else
+                UseMsg();
+        }
         else if (strcmp(argv[i], "-dumbSched") == 0) {
             InputThreadEnable = FALSE;
 #ifdef HAVE_SETITIMER
@@ -1028,6 +1105,12 @@ ProcessCommandLine(int argc, char *argv[])
             else
                 UseMsg();
         }
+        else if (strcmp(argv[i], "-renderthreads") == 0) {
+            if (++i < argc)
+                RenderThreadCount = atoi(argv[i]);
+            else
+                UseMsg();
+        }
         else if (strcmp(argv[i], "-sigstop") == 0) {
             RunFromSigStopParent = TRUE;
         }
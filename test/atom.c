@@ -0,0 +1,179 @@
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <X11/Xatom.h>
+#include "misc.h"
+#include "dix.h"
+#include "resource.h"
+
+#include "tests-common.h"
+
+/* Unit tests and interning benchmarks for dix/atom.c */
+
+static void
+atom_predefined(void)
+{
+    InitAtoms();
+
+    assert(MakeAtom("PRIMARY", 7, FALSE) == XA_PRIMARY);
+    assert(MakeAtom("WM_TRANSIENT_FOR", 16, TRUE) == XA_WM_TRANSIENT_FOR);
+    assert(strcmp(NameForAtom(XA_STRING), "STRING") == 0);
+    assert(ValidAtom(XA_LAST_PREDEFINED));
+    assert(!ValidAtom(XA_LAST_PREDEFINED + 1));
+    assert(!ValidAtom(None));
+    assert(NameForAtom(None) == NULL);
+    assert(NameForAtom(XA_LAST_PREDEFINED + 1) == NULL);
+}
+
+static void
+atom_make_lookup(void)
+{
+    const int n = 100000;
+    char name[64], *big;
+    Atom a, first;
+    int i, len;
+
+    InitAtoms();
+
+    /* names sharing long prefixes */
+    first = XA_LAST_PREDEFINED + 1;
+    for (i = 0; i < n; i++) {
+        len = snprintf(name, sizeof(name), "_NET_WM_STATE_MAXIMIZED_%d", i);
+        assert(MakeAtom(name, len, FALSE) == None);
+        assert(MakeAtom(name, len, TRUE) == first + i);
+    }
+    for (i = 0; i < n; i++) {
+        len = snprintf(name, sizeof(name), "_NET_WM_STATE_MAXIMIZED_%d", i);
+        assert(MakeAtom(name, len, FALSE) == first + i);
+        assert(strcmp(NameForAtom(first + i), name) == 0);
+    }
+    assert(ValidAtom(first + n - 1));
+    assert(!ValidAtom(first + n));
+
+    /* only len bytes of the name count */
+    a = MakeAtom("FOOBAR", 3, TRUE);
+    assert(strcmp(NameForAtom(a), "FOO") == 0);
+    assert(MakeAtom("FOO", 3, FALSE) == a);
+    assert(MakeAtom("FOOBAR", 6, FALSE) == None);
+    assert(MakeAtom("FO", 2, FALSE) == None);
+
+    /* the empty name is an atom like any other */
+    a = MakeAtom("", 0, TRUE);
+    assert(a != None && a != BAD_RESOURCE);
+    assert(MakeAtom("", 0, FALSE) == a);
+
+    /* names larger than an arena block */
+    big = malloc(100000);
+    memset(big, 'x', 100000);
+    a = MakeAtom(big, 100000, TRUE);
+    assert(strlen(NameForAtom(a)) == 100000);
+    assert(MakeAtom(big, 100000, FALSE) == a);
+    big[99999] = 'y';
+    assert(MakeAtom(big, 100000, FALSE) == None);
+    free(big);
+    assert(MakeAtom("FOO", 3, FALSE) != None);
+
+    /* and all of it again after a reset */
+    InitAtoms();
+    assert(MakeAtom("FOO", 3, FALSE) == None);
+    assert(MakeAtom("FOO", 3, TRUE) == XA_LAST_PREDEFINED + 1);
+}
+
+static void
+atom_bulk(void)
+{
+    static const char *const names[] = {
+        "UTF8_STRING", "_NET_WM_NAME", "PRIMARY", "_NET_WM_PID",
+        "UTF8_STRING", "WM_PROTOCOLS",
+    };
+    Atom atoms[ARRAY_SIZE(names)];
+
+    InitAtoms();
+
+    assert(MakeAtoms(names, ARRAY_SIZE(names), FALSE, atoms));
+    assert(atoms[0] == None && atoms[2] == XA_PRIMARY);
+
+    assert(MakeAtoms(names, ARRAY_SIZE(names), TRUE, atoms));
+    assert(atoms[0] == XA_LAST_PREDEFINED + 1);
+    assert(atoms[1] == XA_LAST_PREDEFINED + 2);
+    assert(atoms[2] == XA_PRIMARY);
+    assert(atoms[4] == atoms[0]);
+    assert(atoms[5] == XA_LAST_PREDEFINED + 4);
+    assert(strcmp(NameForAtom(atoms[3]), "_NET_WM_PID") == 0);
+}
+
+/*
+ * A client starting up interns a few hundred atoms, most of which other
+ * clients have already interned.  Time server startup, the first client,
+ * and then many more clients interning the same names.
+ */
+static void
+atom_benchmark(void)
+{
+    const int nnames = 400, nclients = 1000, nmany = 1000000;
+    static const char *const prefixes[] = {
+        "_NET_WM_", "_NET_WM_STATE_", "_GTK_", "_KDE_NET_WM_", "WM_",
+        "_XSETTINGS_S", "_NET_SYSTEM_TRAY_S", "_QT_SELECTION",
+    };
+    char (*names)[64] = calloc(nmany, 64);
+    unsigned *lens = calloc(nmany, sizeof(unsigned));
+    struct timespec start;
+    double init, first, others, many, lookup;
+    int i, c;
+
+    for (i = 0; i < nmany; i++)
+        lens[i] = snprintf(names[i], 64, "%sATOM_%d",
+                           prefixes[i % ARRAY_SIZE(prefixes)], i);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    InitAtoms();
+    init = test_elapsed_ns(&start);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < nnames; i++)
+        MakeAtom(names[i], lens[i], TRUE);
+    first = test_elapsed_ns(&start);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (c = 0; c < nclients; c++)
+        for (i = 0; i < nnames; i++)
+            MakeAtom(names[i], lens[i], TRUE);
+    others = test_elapsed_ns(&start) / nclients;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < nmany; i++)
+        MakeAtom(names[i], lens[i], TRUE);
+    many = test_elapsed_ns(&start) / nmany;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < nmany; i++)
+        NameForAtom(MakeAtom(names[(i * 7919L) % nmany],
+                             lens[(i * 7919L) % nmany], FALSE));
+    lookup = test_elapsed_ns(&start) / nmany;
+
+    printf("InitAtoms: %.1f us\n", init / 1000);
+    printf("first client, %d new atoms: %.1f us\n", nnames, first / 1000);
+    printf("later clients, %d existing atoms: %.1f us per client\n",
+           nnames, others / 1000);
+    printf("%d atoms: %.1f ns/MakeAtom, %.1f ns/lookup\n",
+           nmany, many, lookup);
+
+    free(names);
+    free(lens);
+}
+
+int
+atom_test(void)
+{
+    atom_predefined();
+    atom_make_lookup();
+    atom_bulk();
+    if (run_benchmarks)
+        atom_benchmark();
+
+    return 0;
+}
@@ -0,0 +1,255 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * What a compositing manager does each frame on software rendering:
+ * composite a screen-sized ARGB window pixmap onto the root window with
+ * Over and Src, and copy a screen-sized pixmap to it.  Reports
+ * milliseconds per frame; compare a plain server with one started with
+ * -renderthreads.  At the end an Over of a striped source is read back
+ * down a whole column and checked against the result worked out here, so
+ * a seam between bands shows up as a failure.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <xcb/xcb.h>
+#include <xcb/render.h>
+
+#define FRAMES 30
+#define STRIPE 7
+
+static xcb_connection_t *c;
+static xcb_screen_t *screen;
+static int width, height;
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+sync_server(void)
+{
+    free(xcb_get_input_focus_reply(c, xcb_get_input_focus(c), NULL));
+}
+
+/* a8r8g8b8 for depth 32, x8r8g8b8 for depth 24 */
+static xcb_render_pictformat_t
+find_format(int depth)
+{
+    xcb_render_query_pict_formats_reply_t *formats;
+    xcb_render_pictforminfo_iterator_t i;
+    xcb_render_pictformat_t id = 0;
+
+    formats = xcb_render_query_pict_formats_reply(c,
+                  xcb_render_query_pict_formats(c), NULL);
+    if (!formats)
+        return 0;
+    for (i = xcb_render_query_pict_formats_formats_iterator(formats);
+         i.rem; xcb_render_pictforminfo_next(&i)) {
+        xcb_render_directformat_t *d = &i.data->direct;
+
+        if (i.data->type == XCB_RENDER_PICT_TYPE_DIRECT &&
+            i.data->depth == depth &&
+            d->red_shift == 16 && d->red_mask == 0xff &&
+            d->green_shift == 8 && d->green_mask == 0xff &&
+            d->blue_shift == 0 && d->blue_mask == 0xff &&
+            d->alpha_mask == (depth == 32 ? 0xff : 0)) {
+            id = i.data->id;
+            break;
+        }
+    }
+    free(formats);
+    return id;
+}
+
+static xcb_pixmap_t
+pixmap(int depth)
+{
+    xcb_pixmap_t pix = xcb_generate_id(c);
+
+    xcb_create_pixmap(c, depth, pix, screen->root, width, height);
+    return pix;
+}
+
+static void
+fill(xcb_drawable_t drawable, uint32_t pixel, int y, int h)
+{
+    xcb_gcontext_t gc = xcb_generate_id(c);
+    xcb_rectangle_t r = { 0, y, width, h };
+
+    xcb_create_gc(c, gc, drawable, XCB_GC_FOREGROUND, &pixel);
+    xcb_poly_fill_rectangle(c, drawable, gc, 1, &r);
+    xcb_free_gc(c, gc);
+}
+
+/* A premultiplied pixel, different for each stripe */
+static uint32_t
+stripe_pixel(int y)
+{
+    int s = y / STRIPE;
+
+    return 0x80000000 | ((s * 13) & 0x7f) << 16 | ((s * 7) & 0x7f) << 8 |
+        ((s * 3) & 0x7f);
+}
+
+/* pixman's x * a / 255, rounded */
+static int
+mul_un8(int x, int a)
+{
+    int t = x * a + 0x80;
+
+    return (t + (t >> 8)) >> 8;
+}
+
+static uint32_t
+over(uint32_t src, uint32_t dst)
+{
+    int ia = 255 - (src >> 24), shift;
+    uint32_t result = 0;
+
+    for (shift = 0; shift < 24; shift += 8) {
+        int v = ((src >> shift) & 0xff) + mul_un8((dst >> shift) & 0xff, ia);
+
+        result |= (uint32_t) (v > 255 ? 255 : v) << shift;
+    }
+    return result;
+}
+
+static void
+frames(const char *what, xcb_render_picture_t src, xcb_pixmap_t copy,
+       xcb_render_picture_t dst, uint8_t op)
+{
+    xcb_gcontext_t gc = xcb_generate_id(c);
+    double start, elapsed;
+    int i;
+
+    xcb_create_gc(c, gc, screen->root, 0, NULL);
+    sync_server();
+    start = now();
+    for (i = 0; i < FRAMES; i++) {
+        if (copy)
+            xcb_copy_area(c, copy, screen->root, gc, 0, 0, 0, 0,
+                          width, height);
+        else
+            xcb_render_composite(c, op, src, XCB_RENDER_PICTURE_NONE, dst,
+                                 0, 0, 0, 0, 0, 0, width, height);
+        sync_server();
+    }
+    elapsed = now() - start;
+    xcb_free_gc(c, gc);
+
+    printf("%-16s %dx%d %8.2f ms/frame\n", what, width, height,
+           elapsed * 1000 / FRAMES);
+}
+
+static int
+check(xcb_render_picture_t src, xcb_pixmap_t background,
+      xcb_render_picture_t dst, uint32_t bg)
+{
+    xcb_gcontext_t gc = xcb_generate_id(c);
+    xcb_get_image_reply_t *image;
+    uint32_t *column;
+    int x = width / 3, y, failed = 0;
+
+    xcb_create_gc(c, gc, screen->root, 0, NULL);
+    xcb_copy_area(c, background, screen->root, gc, 0, 0, 0, 0, width, height);
+    xcb_render_composite(c, XCB_RENDER_PICT_OP_OVER, src,
+                         XCB_RENDER_PICTURE_NONE, dst,
+                         0, 0, 0, 0, 0, 0, width, height);
+    xcb_free_gc(c, gc);
+
+    image = xcb_get_image_reply(c,
+                xcb_get_image(c, XCB_IMAGE_FORMAT_Z_PIXMAP, screen->root,
+                              x, 0, 1, height, ~0), NULL);
+    if (!image || xcb_get_image_data_length(image) < height * 4) {
+        fprintf(stderr, "GetImage failed\n");
+        free(image);
+        return 1;
+    }
+    column = (uint32_t *) xcb_get_image_data(image);
+    for (y = 0; y < height; y++) {
+        uint32_t want = over(stripe_pixel(y), bg);
+
+        if ((column[y] & 0xffffff) != want) {
+            fprintf(stderr, "pixel %d,%d is 0x%06x, not 0x%06x\n", x, y,
+                    column[y] & 0xffffff, want);
+            failed = 1;
+            break;
+        }
+    }
+    free(image);
+    return failed;
+}
+
+int main(int argc, char **argv)
+{
+    const uint32_t bg = 0x336699;
+    xcb_render_query_version_reply_t *version;
+    xcb_render_pictformat_t argb, rgb;
+    xcb_render_picture_t src, dst;
+    xcb_pixmap_t window, background;
+    int y;
+
+    c = xcb_connect(NULL, NULL);
+    if (xcb_connection_has_error(c)) {
+        fprintf(stderr, "Failed to connect to the X server\n");
+        exit(1);
+    }
+    screen = xcb_setup_roots_iterator(xcb_get_setup(c)).data;
+    width = screen->width_in_pixels;
+    height = screen->height_in_pixels;
+
+    version = xcb_render_query_version_reply(c,
+                  xcb_render_query_version(c, 0, 11), NULL);
+    argb = find_format(32);
+    rgb = find_format(24);
+    if (!version || !argb || !rgb || screen->root_depth != 24) {
+        fprintf(stderr, "Needs RENDER and a depth 24 screen\n");
+        exit(1);
+    }
+    free(version);
+
+    /* a translucent window's pixmap, in stripes */
+    window = pixmap(32);
+    for (y = 0; y < height; y += STRIPE)
+        fill(window, stripe_pixel(y), y, STRIPE);
+    background = pixmap(screen->root_depth);
+    fill(background, bg, 0, height);
+
+    src = xcb_generate_id(c);
+    xcb_render_create_picture(c, src, window, argb, 0, NULL);
+    dst = xcb_generate_id(c);
+    xcb_render_create_picture(c, dst, screen->root, rgb, 0, NULL);
+
+    frames("composite over", src, 0, dst, XCB_RENDER_PICT_OP_OVER);
+    frames("composite src", src, 0, dst, XCB_RENDER_PICT_OP_SRC);
+    frames("copy area", 0, background, 0, 0);
+
+    exit(check(src, background, dst, bg));
+}
@@ -0,0 +1,205 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * What a window redirected by Composite costs to resize and to map: an
+ * interactive resize, growing a window a few pixels at a time and
+ * shrinking it back, then a window mapped and unmapped over and over.
+ * Each step waits for the server, so the times include allocating and
+ * filling the backing pixmap.  At the end the window contents are checked:
+ * what was drawn before the resizes must have stayed put, as the window
+ * has NorthWest bit gravity, and what it grew into must show its
+ * background, both in the window and on the screen.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <xcb/xcb.h>
+#include <xcb/composite.h>
+
+#define X 50
+#define Y 50
+#define MIN_W 200
+#define MIN_H 150
+#define MAX_W 1400
+#define MAX_H 1000
+#define STEP 8
+#define ROUNDS 3
+#define MAPS 500
+
+#define BACKGROUND 0x336699
+#define MARKER 0xff0000
+
+static xcb_connection_t *c;
+static xcb_screen_t *screen;
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+sync_server(void)
+{
+    free(xcb_get_input_focus_reply(c, xcb_get_input_focus(c), NULL));
+}
+
+static xcb_window_t
+create_window(int w, int h)
+{
+    xcb_window_t window = xcb_generate_id(c);
+    uint32_t values[3] = { BACKGROUND, XCB_GRAVITY_NORTH_WEST, 1 };
+
+    xcb_create_window(c, XCB_COPY_FROM_PARENT, window, screen->root,
+                      X, Y, w, h, 0, XCB_WINDOW_CLASS_INPUT_OUTPUT,
+                      screen->root_visual,
+                      XCB_CW_BACK_PIXEL | XCB_CW_BIT_GRAVITY |
+                      XCB_CW_OVERRIDE_REDIRECT, values);
+    xcb_composite_redirect_window(c, window,
+                                  XCB_COMPOSITE_REDIRECT_AUTOMATIC);
+    return window;
+}
+
+static void
+resize(xcb_window_t window, int w, int h)
+{
+    uint32_t values[2] = { w, h };
+
+    xcb_configure_window(c, window,
+                         XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT,
+                         values);
+    sync_server();
+}
+
+static uint32_t
+get_pixel(xcb_drawable_t drawable, int x, int y)
+{
+    xcb_get_image_reply_t *image;
+    uint32_t pixel;
+
+    image = xcb_get_image_reply(c,
+                xcb_get_image(c, XCB_IMAGE_FORMAT_Z_PIXMAP, drawable,
+                              x, y, 1, 1, ~0), NULL);
+    if (!image || xcb_get_image_data_length(image) < 4) {
+        free(image);
+        return ~0;
+    }
+    pixel = *(uint32_t *) xcb_get_image_data(image) & 0xffffff;
+    free(image);
+    return pixel;
+}
+
+static int
+check_pixel(const char *what, xcb_drawable_t drawable, int x, int y,
+            uint32_t want)
+{
+    uint32_t got = get_pixel(drawable, x, y);
+
+    if (got == want)
+        return 0;
+    fprintf(stderr, "%s pixel %d,%d is 0x%06x, not 0x%06x\n", what, x, y,
+            got, want);
+    return 1;
+}
+
+int main(int argc, char **argv)
+{
+    xcb_composite_query_version_reply_t *version;
+    xcb_window_t window;
+    xcb_gcontext_t gc;
+    xcb_rectangle_t marker = { 0, 0, 40, 30 };
+    uint32_t pixel = MARKER;
+    double start, elapsed;
+    int i, w, h, n = 0, failed = 0;
+
+    c = xcb_connect(NULL, NULL);
+    if (xcb_connection_has_error(c)) {
+        fprintf(stderr, "Failed to connect to the X server\n");
+        exit(1);
+    }
+    screen = xcb_setup_roots_iterator(xcb_get_setup(c)).data;
+    if (screen->root_depth != 24) {
+        fprintf(stderr, "Needs a depth 24 screen\n");
+        exit(1);
+    }
+    version = xcb_composite_query_version_reply(c,
+                  xcb_composite_query_version(c, 0, 4), NULL);
+    if (!version) {
+        fprintf(stderr, "Needs Composite\n");
+        exit(1);
+    }
+    free(version);
+
+    window = create_window(MIN_W, MIN_H);
+    xcb_map_window(c, window);
+    gc = xcb_generate_id(c);
+    xcb_create_gc(c, gc, window, XCB_GC_FOREGROUND, &pixel);
+    xcb_poly_fill_rectangle(c, window, gc, 1, &marker);
+    sync_server();
+
+    start = now();
+    for (i = 0; i < ROUNDS; i++) {
+        for (w = MIN_W, h = MIN_H; w < MAX_W; w += STEP, h += STEP * 3 / 4) {
+            resize(window, w, h);
+            n++;
+        }
+        for (; w > MIN_W; w -= STEP, h -= STEP * 3 / 4) {
+            resize(window, w, h);
+            n++;
+        }
+    }
+    elapsed = now() - start;
+    printf("resize     %5d times %8.3f ms/resize\n", n, elapsed * 1000 / n);
+
+    /* grow once more to check what it grew into */
+    resize(window, MAX_W, MAX_H);
+    failed |= check_pixel("window", window, 10, 10, MARKER);
+    failed |= check_pixel("window", window, MAX_W - 10, MAX_H - 10,
+                          BACKGROUND);
+    sync_server();
+    failed |= check_pixel("screen", screen->root, X + 10, Y + 10, MARKER);
+    failed |= check_pixel("screen", screen->root, X + MAX_W - 10,
+                          Y + MAX_H - 10, BACKGROUND);
+    xcb_destroy_window(c, window);
+
+    window = create_window(640, 480);
+    sync_server();
+    start = now();
+    for (i = 0; i < MAPS; i++) {
+        xcb_map_window(c, window);
+        xcb_unmap_window(c, window);
+        sync_server();
+    }
+    elapsed = now() - start;
+    printf("map        %5d times %8.3f ms/map\n", MAPS, elapsed * 1000 / MAPS);
+
+    xcb_map_window(c, window);
+    sync_server();
+    failed |= check_pixel("mapped window", window, 320, 240, BACKGROUND);
+
+    xcb_disconnect(c);
+    exit(failed);
+}
@@ -0,0 +1,220 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * A client drawing many tiny rectangles into a window that a compositor
+ * watches with DeltaRectangles damage.  Reports the time to draw them,
+ * the DamageNotify events the compositor gets, and the region
+ * DamageSubtract hands it: its rectangles, and its area over the area
+ * drawn.  Run as the server comes, with -damagebatch to see the events
+ * merged, and with -damagerects N, passing N as the argument so that the
+ * limit can be checked.  Either way the region must cover everything drawn.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <xcb/xcb.h>
+#include <xcb/xfixes.h>
+#include <xcb/damage.h>
+
+#define WIDTH 1024
+#define HEIGHT 768
+#define OPS 20000
+
+static xcb_connection_t *c, *compositor;
+static uint8_t damage_event;
+static unsigned char drawn[HEIGHT][WIDTH];
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+sync_server(xcb_connection_t *conn)
+{
+    free(xcb_get_input_focus_reply(conn, xcb_get_input_focus(conn), NULL));
+}
+
+/* DamageNotify events waiting for the compositor */
+static int
+count_events(void)
+{
+    xcb_generic_event_t *event;
+    int n = 0;
+
+    sync_server(compositor);
+    while ((event = xcb_poll_for_event(compositor))) {
+        if ((event->response_type & 0x7f) == damage_event + XCB_DAMAGE_NOTIFY)
+            n++;
+        free(event);
+    }
+    return n;
+}
+
+/* Scattered specks, or lines of text-sized cells */
+static xcb_rectangle_t
+op_rect(int scattered, int i)
+{
+    xcb_rectangle_t r;
+
+    if (scattered) {
+        r.x = (i * 7919) % (WIDTH - 2);
+        r.y = (i * 104729 / 7) % (HEIGHT - 2);
+        r.width = r.height = 2;
+    }
+    else {
+        r.x = (i % 160) * 6 + 16;
+        r.y = (i / 160) * 14 % (HEIGHT - 10);
+        r.width = 5;
+        r.height = 10;
+    }
+    return r;
+}
+
+static int
+run(const char *what, int scattered, xcb_window_t window, int limit)
+{
+    xcb_gcontext_t gc = xcb_generate_id(c);
+    xcb_damage_damage_t damage = xcb_generate_id(compositor);
+    xcb_xfixes_region_t parts = xcb_generate_id(compositor);
+    xcb_xfixes_fetch_region_reply_t *region;
+    xcb_rectangle_t *rects;
+    uint32_t pixel = 0xffffff;
+    double start, elapsed;
+    long area = 0, drawn_area = 0;
+    int i, x, y, nrects, events, failed = 0;
+
+    xcb_create_gc(c, gc, window, XCB_GC_FOREGROUND, &pixel);
+    xcb_damage_create(compositor, damage, window,
+                      XCB_DAMAGE_REPORT_LEVEL_DELTA_RECTANGLES);
+    xcb_damage_subtract(compositor, damage, XCB_XFIXES_REGION_NONE,
+                        XCB_XFIXES_REGION_NONE);
+    count_events();
+    memset(drawn, 0, sizeof(drawn));
+
+    sync_server(c);
+    start = now();
+    for (i = 0; i < OPS; i++) {
+        xcb_rectangle_t r = op_rect(scattered, i);
+
+        xcb_poly_fill_rectangle(c, window, gc, 1, &r);
+        for (y = r.y; y < r.y + r.height; y++)
+            memset(&drawn[y][r.x], 1, r.width);
+    }
+    sync_server(c);
+    elapsed = now() - start;
+    events = count_events();
+
+    xcb_xfixes_create_region(compositor, parts, 0, NULL);
+    xcb_damage_subtract(compositor, damage, XCB_XFIXES_REGION_NONE, parts);
+    region = xcb_xfixes_fetch_region_reply(compositor,
+                 xcb_xfixes_fetch_region(compositor, parts), NULL);
+    if (!region) {
+        fprintf(stderr, "FetchRegion failed\n");
+        return 1;
+    }
+    rects = xcb_xfixes_fetch_region_rectangles(region);
+    nrects = xcb_xfixes_fetch_region_rectangles_length(region);
+
+    /* what the region covers goes from 1 to 2, or 0 to 3 if not drawn */
+    for (i = 0; i < nrects; i++) {
+        area += rects[i].width * rects[i].height;
+        for (y = rects[i].y; y < rects[i].y + rects[i].height; y++)
+            for (x = rects[i].x; x < rects[i].x + rects[i].width; x++)
+                if (x < WIDTH && y < HEIGHT)
+                    drawn[y][x] = drawn[y][x] ? 2 : 3;
+    }
+    for (y = 0; y < HEIGHT; y++)
+        for (x = 0; x < WIDTH; x++) {
+            if (drawn[y][x] == 1 && !failed) {
+                fprintf(stderr, "%s: drawn pixel %d,%d not in the damage\n",
+                        what, x, y);
+                failed = 1;
+            }
+            drawn_area += drawn[y][x] == 1 || drawn[y][x] == 2;
+        }
+    if (limit && nrects > limit) {
+        fprintf(stderr, "%s: %d rectangles, more than %d\n", what, nrects,
+                limit);
+        failed = 1;
+    }
+
+    printf("%-10s %d ops %8.2f ms %6d events %6d rects %6.2fx overdraw\n",
+           what, OPS, elapsed * 1000, events, nrects,
+           (double) area / drawn_area);
+
+    free(region);
+    xcb_xfixes_destroy_region(compositor, parts);
+    xcb_damage_destroy(compositor, damage);
+    xcb_free_gc(c, gc);
+    return failed;
+}
+
+int main(int argc, char **argv)
+{
+    xcb_xfixes_query_version_reply_t *xfixes;
+    xcb_damage_query_version_reply_t *version;
+    xcb_screen_t *screen;
+    xcb_window_t window;
+    uint32_t values[2] = { 0, 1 };
+    int limit = argc > 1 ? atoi(argv[1]) : 0, failed;
+
+    c = xcb_connect(NULL, NULL);
+    compositor = xcb_connect(NULL, NULL);
+    if (xcb_connection_has_error(c) || xcb_connection_has_error(compositor)) {
+        fprintf(stderr, "Failed to connect to the X server\n");
+        exit(1);
+    }
+    screen = xcb_setup_roots_iterator(xcb_get_setup(c)).data;
+
+    xfixes = xcb_xfixes_query_version_reply(compositor,
+                 xcb_xfixes_query_version(compositor, 4, 0), NULL);
+    version = xcb_damage_query_version_reply(compositor,
+                  xcb_damage_query_version(compositor, 1, 1), NULL);
+    if (!xfixes || !version) {
+        fprintf(stderr, "Needs XFIXES and DAMAGE\n");
+        exit(1);
+    }
+    free(xfixes);
+    free(version);
+    damage_event = xcb_get_extension_data(compositor,
+                                          &xcb_damage_id)->first_event;
+
+    window = xcb_generate_id(c);
+    xcb_create_window(c, XCB_COPY_FROM_PARENT, window, screen->root,
+                      0, 0, WIDTH, HEIGHT, 0, XCB_WINDOW_CLASS_INPUT_OUTPUT,
+                      screen->root_visual,
+                      XCB_CW_BACK_PIXEL | XCB_CW_OVERRIDE_REDIRECT, values);
+    xcb_map_window(c, window);
+    sync_server(c);
+
+    failed = run("scattered", 1, window, limit);
+    failed |= run("text", 0, window, limit);
+
+    exit(failed);
+}
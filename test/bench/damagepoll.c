@@ -0,0 +1,284 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * A compositor polling complex damage frame after frame: a client draws
+ * scattered specks into a window, then the compositor moves the damage
+ * into a region with DamageSubtract and fetches it.  Reports the time each
+ * poll takes, as the compositor waits for it, and the rectangles and bytes
+ * it brings back.  Each fetched region must hold exactly what was drawn
+ * that frame, so nothing may be left behind in the Damage.
+ *
+ * With "shared" the region comes from CreateSharedRegion instead, and each
+ * poll sends DamageSubtract and then reads the region out of the memfd
+ * once its generation moves on, with no reply to wait for.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <xcb/xcb.h>
+#include <xcb/xcbext.h>
+#include <xcb/xfixes.h>
+#include <xcb/damage.h>
+
+#define WIDTH 1024
+#define HEIGHT 768
+#define FRAMES 200
+#define SPECKS 2000
+
+/* CreateSharedRegion isn't in xcb-xfixes, so it is sent by hand */
+#define XFIXES_CREATE_SHARED_REGION 35
+
+struct shared_region {
+    uint32_t generation;        /* odd while the server writes */
+    uint32_t num_rects;
+    uint32_t max_rects;
+    uint32_t pad;
+    int16_t x1, y1, x2, y2;
+    struct {
+        int16_t x1, y1, x2, y2;
+    } boxes[];
+};
+
+static xcb_connection_t *c, *compositor;
+static struct shared_region *shared;
+static uint32_t generation;
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+sync_server(xcb_connection_t *conn)
+{
+    free(xcb_get_input_focus_reply(conn, xcb_get_input_focus(conn), NULL));
+}
+
+/* Specks on a grid of 4x4 cells, so that no two touch */
+static xcb_rectangle_t
+speck(int frame, int i)
+{
+    xcb_rectangle_t r;
+    int cell = (i * 7919 + frame * 104729) % (WIDTH / 4 * HEIGHT / 4);
+
+    r.x = cell % (WIDTH / 4) * 4;
+    r.y = cell / (WIDTH / 4) * 4;
+    r.width = r.height = 2;
+    return r;
+}
+
+static struct shared_region *
+create_shared_region(xcb_xfixes_region_t region, uint32_t max_rects)
+{
+    static const xcb_protocol_request_t request = {
+        .count = 2,
+        .ext = &xcb_xfixes_id,
+        .opcode = XFIXES_CREATE_SHARED_REGION,
+        .isvoid = 0,
+    };
+    struct {
+        uint8_t major_opcode, minor_opcode;
+        uint16_t length;
+        uint32_t region, max_rects;
+    } out = { .region = region, .max_rects = max_rects };
+    struct iovec parts[4];
+    xcb_generic_reply_t *reply;
+    xcb_generic_error_t *error;
+    struct shared_region *shared;
+    uint32_t size;
+    int fd;
+
+    parts[2].iov_base = &out;
+    parts[2].iov_len = sizeof(out);
+    parts[3].iov_base = NULL;
+    parts[3].iov_len = 0;
+    reply = xcb_wait_for_reply(compositor,
+                xcb_send_request(compositor,
+                                 XCB_REQUEST_CHECKED | XCB_REQUEST_REPLY_FDS,
+                                 parts + 2, &request), &error);
+    if (!reply) {
+        free(error);
+        return NULL;
+    }
+    size = ((uint32_t *) reply)[2];
+    fd = xcb_get_reply_fds(compositor, reply, sizeof(*reply))[0];
+    free(reply);
+
+    shared = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    return shared == MAP_FAILED ? NULL : shared;
+}
+
+/*
+ * Waits for the region to be rewritten past generation, then copies its
+ * boxes out, trying again if the server wrote to it meanwhile
+ */
+static int
+read_shared_region(void)
+{
+    static typeof(shared->boxes[0]) boxes[SPECKS * 2];
+    uint32_t g, n;
+
+    do {
+        while ((g = __atomic_load_n(&shared->generation, __ATOMIC_ACQUIRE))
+               == generation || (g & 1))
+            sched_yield();
+        n = shared->num_rects;
+        if (n <= shared->max_rects)
+            memcpy(boxes, shared->boxes, n * sizeof(boxes[0]));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while (__atomic_load_n(&shared->generation, __ATOMIC_RELAXED) != g);
+
+    generation = g;
+    return n;
+}
+
+/* DamageSubtract into parts, and count the rectangles it brings back */
+static int
+poll_damage(xcb_damage_damage_t damage, xcb_xfixes_region_t parts)
+{
+    xcb_xfixes_fetch_region_reply_t *region;
+    int n;
+
+    xcb_damage_subtract(compositor, damage, XCB_XFIXES_REGION_NONE, parts);
+    if (shared) {
+        xcb_flush(compositor);
+        return read_shared_region();
+    }
+
+    region = xcb_xfixes_fetch_region_reply(compositor,
+                 xcb_xfixes_fetch_region(compositor, parts), NULL);
+    if (!region) {
+        fprintf(stderr, "FetchRegion failed\n");
+        exit(1);
+    }
+    n = xcb_xfixes_fetch_region_rectangles_length(region);
+    free(region);
+    return n;
+}
+
+int main(int argc, char **argv)
+{
+    xcb_xfixes_query_version_reply_t *xfixes;
+    xcb_damage_query_version_reply_t *version;
+    xcb_screen_t *screen;
+    xcb_window_t window;
+    xcb_gcontext_t gc;
+    xcb_damage_damage_t damage;
+    xcb_xfixes_region_t parts;
+    xcb_rectangle_t specks[SPECKS];
+    uint32_t values[2] = { 0, 1 }, pixel = 0xffffff;
+    double start, elapsed = 0;
+    long rects = 0;
+    int i, n, frame, failed = 0;
+
+    c = xcb_connect(NULL, NULL);
+    compositor = xcb_connect(NULL, NULL);
+    if (xcb_connection_has_error(c) || xcb_connection_has_error(compositor)) {
+        fprintf(stderr, "Failed to connect to the X server\n");
+        exit(1);
+    }
+    screen = xcb_setup_roots_iterator(xcb_get_setup(c)).data;
+
+    xfixes = xcb_xfixes_query_version_reply(compositor,
+                 xcb_xfixes_query_version(compositor, 4, 0), NULL);
+    version = xcb_damage_query_version_reply(compositor,
+                  xcb_damage_query_version(compositor, 1, 1), NULL);
+    if (!xfixes || !version) {
+        fprintf(stderr, "Needs XFIXES and DAMAGE\n");
+        exit(1);
+    }
+    free(xfixes);
+    free(version);
+
+    window = xcb_generate_id(c);
+    xcb_create_window(c, XCB_COPY_FROM_PARENT, window, screen->root,
+                      0, 0, WIDTH, HEIGHT, 0, XCB_WINDOW_CLASS_INPUT_OUTPUT,
+                      screen->root_visual,
+                      XCB_CW_BACK_PIXEL | XCB_CW_OVERRIDE_REDIRECT, values);
+    xcb_map_window(c, window);
+    gc = xcb_generate_id(c);
+    xcb_create_gc(c, gc, window, XCB_GC_FOREGROUND, &pixel);
+    sync_server(c);
+
+    damage = xcb_generate_id(compositor);
+    parts = xcb_generate_id(compositor);
+    xcb_damage_create(compositor, damage, window,
+                      XCB_DAMAGE_REPORT_LEVEL_NON_EMPTY);
+    if (argc > 1 && strcmp(argv[1], "shared") == 0) {
+        shared = create_shared_region(parts, SPECKS * 2);
+        if (!shared) {
+            fprintf(stderr, "Needs CreateSharedRegion\n");
+            exit(1);
+        }
+    }
+    else
+        xcb_xfixes_create_region(compositor, parts, 0, NULL);
+    xcb_damage_subtract(compositor, damage, XCB_XFIXES_REGION_NONE,
+                        XCB_XFIXES_REGION_NONE);
+    sync_server(compositor);
+    if (shared)
+        generation = __atomic_load_n(&shared->generation, __ATOMIC_ACQUIRE);
+
+    for (frame = 0; frame < FRAMES && !failed; frame++) {
+        for (i = 0; i < SPECKS; i++)
+            specks[i] = speck(frame, i);
+        xcb_poly_fill_rectangle(c, window, gc, SPECKS, specks);
+        sync_server(c);
+
+        start = now();
+        n = poll_damage(damage, parts);
+        elapsed += now() - start;
+
+        /* the specks don't touch, so each is a rectangle of its own */
+        if (n != SPECKS) {
+            fprintf(stderr, "frame %d: %d rectangles, drew %d\n", frame,
+                    n, SPECKS);
+            failed = 1;
+        }
+        rects += n;
+    }
+
+    /* with nothing drawn since, the next poll must come back empty */
+    if (poll_damage(damage, parts)) {
+        fprintf(stderr, "damage left behind after DamageSubtract\n");
+        failed = 1;
+    }
+
+    printf("damage poll%s %d frames %8.3f ms/poll %6ld rects "
+           "%8ld bytes/poll\n", shared ? " shared" : "", frame,
+           elapsed * 1000 / frame, rects / frame,
+           rects / frame * (long) sizeof(xcb_rectangle_t));
+
+    xcb_disconnect(compositor);
+    xcb_disconnect(c);
+    exit(failed);
+}
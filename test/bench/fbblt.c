@@ -0,0 +1,248 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * fb fill and copy bandwidth.  For a range of rectangle sizes, time fills
+ * and copies that end up in fbSolid and fbBlt rather than in pixman or
+ * memcpy: fills with a plane mask, and copies to the right within a
+ * pixmap, which overlap, with and without a plane mask.  Plain fills are
+ * timed too for comparison.  Prints MB/s written; run it at several
+ * screen depths to cover 8, 16 and 32 bits per pixel.  At the end a small
+ * fill and copy are read back and checked against the same operations
+ * done here.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <xcb/xcb.h>
+
+#define PIX_W 2048
+#define PIX_H 1200
+
+static xcb_connection_t *c;
+static xcb_screen_t *screen;
+static xcb_pixmap_t pix;
+static int bpp;
+static uint32_t depth_mask, plane_mask;
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+sync_server(void)
+{
+    free(xcb_get_input_focus_reply(c, xcb_get_input_focus(c), NULL));
+}
+
+static int
+depth_bpp(int depth)
+{
+    xcb_format_iterator_t f =
+        xcb_setup_pixmap_formats_iterator(xcb_get_setup(c));
+
+    for (; f.rem; xcb_format_next(&f))
+        if (f.data->depth == depth)
+            return f.data->bits_per_pixel;
+    return 0;
+}
+
+static xcb_gcontext_t
+gc(uint32_t fg, uint32_t planes)
+{
+    xcb_gcontext_t g = xcb_generate_id(c);
+
+    xcb_create_gc(c, g, pix, XCB_GC_FOREGROUND | XCB_GC_PLANE_MASK,
+                  (uint32_t[]) { fg, planes });
+    return g;
+}
+
+/* pixels the copies move right by: a multiple of 32 bits */
+static int
+shift(void)
+{
+    return 256 / bpp;
+}
+
+static void
+fill(xcb_gcontext_t g, int w, int h, int i)
+{
+    xcb_rectangle_t r = { i & 7, i & 3, w, h };
+
+    xcb_poly_fill_rectangle(c, pix, g, 1, &r);
+}
+
+static void
+copy(xcb_gcontext_t g, int w, int h, int i)
+{
+    xcb_copy_area(c, pix, pix, g, i & 7, 0, (i & 7) + shift(), 0, w, h);
+}
+
+static void
+run(const char *what, void (*op) (xcb_gcontext_t, int, int, int),
+    xcb_gcontext_t g, int w, int h)
+{
+    double start, elapsed;
+    long n = 0, batch = 1 + (1 << 22) / ((long) w * h);
+    int i;
+
+    start = now();
+    do {
+        for (i = 0; i < batch; i++)
+            op(g, w, h, n + i);
+        n += batch;
+        sync_server();
+        elapsed = now() - start;
+    } while (elapsed < 0.5);
+
+    printf("%-24s %4dx%-4d %10.1f MB/s\n", what, w, h,
+           (double) w * h * bpp / 8 * n / elapsed / 1e6);
+}
+
+/* the pixel at x, y of a ZPixmap image */
+static uint32_t
+image_pixel(const uint8_t *data, int stride, int x, int y)
+{
+    const uint8_t *p = data + y * stride + x * bpp / 8;
+    uint32_t v;
+
+    switch (bpp) {
+    case 8:
+        return *p;
+    case 16:
+        return *(const uint16_t *) p;
+    default:
+        memcpy(&v, p, 4);
+        return v & depth_mask;
+    }
+}
+
+static void
+image_set(uint8_t *data, int stride, int x, int y, uint32_t v)
+{
+    uint8_t *p = data + y * stride + x * bpp / 8;
+
+    switch (bpp) {
+    case 8:
+        *p = v;
+        break;
+    case 16:
+        *(uint16_t *) p = v;
+        break;
+    default:
+        memcpy(p, &v, 4);
+        break;
+    }
+}
+
+/* an overlapping copy and a fill with a plane mask, against a model */
+static int
+check(xcb_gcontext_t copy_gc, xcb_gcontext_t fill_gc, uint32_t fg)
+{
+    enum { W = 200, H = 4 };
+    int stride = W * bpp / 8, s = shift(), x, y, failed = 0;
+    uint32_t model[H][W], before[H][W];
+    uint8_t *data = malloc(stride * H);
+    xcb_get_image_reply_t *image;
+    xcb_rectangle_t r = { 30, 1, 100, 2 };
+
+    for (y = 0; y < H; y++)
+        for (x = 0; x < W; x++) {
+            model[y][x] = (x * 2654435761u ^ y * 40503u) & depth_mask;
+            image_set(data, stride, x, y, model[y][x]);
+        }
+    xcb_put_image(c, XCB_IMAGE_FORMAT_Z_PIXMAP, pix, copy_gc, W, H, 0, 0,
+                  0, screen->root_depth, stride * H, data);
+
+    xcb_copy_area(c, pix, pix, copy_gc, 3, 0, 3 + s, 0, W - 3 - s, H);
+    memcpy(before, model, sizeof(model));
+    for (y = 0; y < H; y++)
+        for (x = 3 + s; x < W; x++)
+            model[y][x] = (before[y][x - s] & plane_mask) |
+                (model[y][x] & ~plane_mask);
+
+    xcb_poly_fill_rectangle(c, pix, fill_gc, 1, &r);
+    for (y = r.y; y < r.y + r.height; y++)
+        for (x = r.x; x < r.x + r.width; x++)
+            model[y][x] = (fg & plane_mask) | (model[y][x] & ~plane_mask);
+
+    image = xcb_get_image_reply(c,
+                xcb_get_image(c, XCB_IMAGE_FORMAT_Z_PIXMAP, pix, 0, 0, W, H,
+                              ~0), NULL);
+    for (y = 0; y < H; y++)
+        for (x = 0; x < W; x++)
+            if (image_pixel(xcb_get_image_data(image), stride, x, y) !=
+                model[y][x]) {
+                fprintf(stderr, "pixel %d,%d is 0x%x, not 0x%x\n", x, y,
+                        image_pixel(xcb_get_image_data(image), stride, x, y),
+                        model[y][x]);
+                failed = 1;
+            }
+    free(image);
+    free(data);
+    return failed;
+}
+
+int main(int argc, char **argv)
+{
+    static const int sizes[][2] = {
+        { 64, 64 }, { 256, 256 }, { 1024, 768 }, { 1920, 1080 },
+    };
+    xcb_gcontext_t plain, masked;
+    uint32_t fg;
+    int i;
+
+    c = xcb_connect(NULL, NULL);
+    if (xcb_connection_has_error(c)) {
+        fprintf(stderr, "Failed to connect to the X server\n");
+        exit(1);
+    }
+    screen = xcb_setup_roots_iterator(xcb_get_setup(c)).data;
+    bpp = depth_bpp(screen->root_depth);
+    depth_mask = screen->root_depth == 32 ? ~0u :
+        (1u << screen->root_depth) - 1;
+    plane_mask = 0x5a5a5a5a & depth_mask;
+    fg = 0x12345678 & depth_mask;
+
+    pix = xcb_generate_id(c);
+    xcb_create_pixmap(c, screen->root_depth, pix, screen->root, PIX_W, PIX_H);
+    plain = gc(fg, ~0);
+    masked = gc(fg, plane_mask);
+
+    printf("depth %d, %d bits per pixel\n", screen->root_depth, bpp);
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        int w = sizes[i][0], h = sizes[i][1];
+
+        run("fill", fill, plain, w, h);
+        run("fill with plane mask", fill, masked, w, h);
+        run("copy right", copy, plain, w, h);
+        run("copy right with plane mask", copy, masked, w, h);
+    }
+
+    exit(check(masked, masked, fg));
+}
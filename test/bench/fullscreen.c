@@ -0,0 +1,214 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * A game-like client: a window covering the screen, redirected
+ * automatically by Composite, redrawn whole frame after frame.  Each frame
+ * is read back from the screen, so the times include getting it there.
+ * With -unredirectfullscreen, the window is drawn straight to the screen,
+ * and the _COMPOSITE_FULLSCREEN_WINDOW root property must name it while it
+ * is alone and be gone while a small window is mapped over it.  Run as
+ * "fullscreen redirected" against a server without the option, the window
+ * goes through its pixmap and the property must never be set.  Either way
+ * the screen must show what was last drawn.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <xcb/xcb.h>
+#include <xcb/composite.h>
+
+#define FRAMES 200
+
+static xcb_connection_t *c;
+static xcb_screen_t *screen;
+static xcb_atom_t fullscreen_atom;
+static int redirected;
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static xcb_window_t
+create_window(int x, int y, int w, int h, uint32_t background)
+{
+    xcb_window_t window = xcb_generate_id(c);
+    uint32_t values[2] = { background, 1 };
+
+    xcb_create_window(c, XCB_COPY_FROM_PARENT, window, screen->root,
+                      x, y, w, h, 0, XCB_WINDOW_CLASS_INPUT_OUTPUT,
+                      screen->root_visual,
+                      XCB_CW_BACK_PIXEL | XCB_CW_OVERRIDE_REDIRECT, values);
+    return window;
+}
+
+static uint32_t
+get_pixel(xcb_drawable_t drawable, int x, int y)
+{
+    xcb_get_image_reply_t *image;
+    uint32_t pixel;
+
+    image = xcb_get_image_reply(c,
+                xcb_get_image(c, XCB_IMAGE_FORMAT_Z_PIXMAP, drawable,
+                              x, y, 1, 1, ~0), NULL);
+    if (!image || xcb_get_image_data_length(image) < 4) {
+        free(image);
+        return ~0;
+    }
+    pixel = *(uint32_t *) xcb_get_image_data(image) & 0xffffff;
+    free(image);
+    return pixel;
+}
+
+/* The window the property names, or XCB_NONE */
+static xcb_window_t
+fullscreen_window(void)
+{
+    xcb_get_property_reply_t *prop;
+    xcb_window_t window = XCB_NONE;
+
+    prop = xcb_get_property_reply(c,
+               xcb_get_property(c, 0, screen->root, fullscreen_atom,
+                                XCB_ATOM_WINDOW, 0, 1), NULL);
+    if (prop && xcb_get_property_value_length(prop) == 4)
+        memcpy(&window, xcb_get_property_value(prop), 4);
+    free(prop);
+    return window;
+}
+
+static int
+check_property(const char *what, xcb_window_t want)
+{
+    xcb_window_t got = fullscreen_window();
+
+    if (redirected)
+        want = XCB_NONE;
+    if (got == want)
+        return 0;
+    fprintf(stderr, "%s: property names 0x%x, not 0x%x\n", what, got, want);
+    return 1;
+}
+
+static int
+check_pixel(const char *what, int x, int y, uint32_t want)
+{
+    uint32_t got = get_pixel(screen->root, x, y);
+
+    if (got == want)
+        return 0;
+    fprintf(stderr, "%s: screen pixel %d,%d is 0x%06x, not 0x%06x\n", what,
+            x, y, got, want);
+    return 1;
+}
+
+int main(int argc, char **argv)
+{
+    xcb_composite_query_version_reply_t *version;
+    xcb_intern_atom_reply_t *atom;
+    xcb_window_t window, popup;
+    xcb_gcontext_t gc;
+    xcb_rectangle_t r;
+    uint32_t pixel = 0;
+    double start, elapsed;
+    int i, width, height, failed = 0;
+
+    redirected = argc > 1 && strcmp(argv[1], "redirected") == 0;
+    c = xcb_connect(NULL, NULL);
+    if (xcb_connection_has_error(c)) {
+        fprintf(stderr, "Failed to connect to the X server\n");
+        exit(1);
+    }
+    screen = xcb_setup_roots_iterator(xcb_get_setup(c)).data;
+    width = screen->width_in_pixels;
+    height = screen->height_in_pixels;
+    if (screen->root_depth != 24) {
+        fprintf(stderr, "Needs a depth 24 screen\n");
+        exit(1);
+    }
+    version = xcb_composite_query_version_reply(c,
+                  xcb_composite_query_version(c, 0, 4), NULL);
+    if (!version) {
+        fprintf(stderr, "Needs Composite\n");
+        exit(1);
+    }
+    free(version);
+    atom = xcb_intern_atom_reply(c,
+               xcb_intern_atom(c, 0, strlen("_COMPOSITE_FULLSCREEN_WINDOW"),
+                               "_COMPOSITE_FULLSCREEN_WINDOW"), NULL);
+    if (!atom) {
+        fprintf(stderr, "InternAtom failed\n");
+        exit(1);
+    }
+    fullscreen_atom = atom->atom;
+    free(atom);
+
+    window = create_window(0, 0, width, height, 0x000000);
+    xcb_composite_redirect_window(c, window,
+                                  XCB_COMPOSITE_REDIRECT_AUTOMATIC);
+    xcb_map_window(c, window);
+    gc = xcb_generate_id(c);
+    xcb_create_gc(c, gc, window, XCB_GC_FOREGROUND, &pixel);
+    get_pixel(screen->root, 0, 0);
+    failed |= check_property("alone", window);
+
+    r.x = r.y = 0;
+    r.width = width;
+    r.height = height;
+    start = now();
+    for (i = 0; i < FRAMES; i++) {
+        pixel = i & 1 ? 0x336699 : 0x996633;
+        xcb_change_gc(c, gc, XCB_GC_FOREGROUND, &pixel);
+        xcb_poly_fill_rectangle(c, window, gc, 1, &r);
+        get_pixel(screen->root, width / 2, height / 2);
+    }
+    elapsed = now() - start;
+    printf("fullscreen %dx%d %5d frames %8.3f ms/frame\n", width, height,
+           FRAMES, elapsed * 1000 / FRAMES);
+    failed |= check_pixel("alone", width / 2, height / 2, pixel);
+
+    /* something over it sends it back to its pixmap */
+    popup = create_window(width / 4, height / 4, width / 2, height / 2,
+                          0xff0000);
+    xcb_map_window(c, popup);
+    get_pixel(screen->root, 0, 0);
+    failed |= check_property("covered", XCB_NONE);
+    failed |= check_pixel("covered", width / 2, height / 2, 0xff0000);
+    failed |= check_pixel("covered", 10, 10, pixel);
+
+    pixel = 0x00ff00;
+    xcb_change_gc(c, gc, XCB_GC_FOREGROUND, &pixel);
+    xcb_poly_fill_rectangle(c, window, gc, 1, &r);
+    xcb_unmap_window(c, popup);
+    get_pixel(screen->root, 0, 0);
+    failed |= check_property("uncovered", window);
+    failed |= check_pixel("uncovered", width / 2, height / 2, pixel);
+    failed |= check_pixel("uncovered", 10, 10, pixel);
+
+    xcb_disconnect(c);
+    exit(failed);
+}
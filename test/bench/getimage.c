@@ -0,0 +1,108 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * GetImage throughput on a 3840x2160 pixmap.  Run against an Xvfb with a
+ * 4K screen; reports frames per second and MB/s both for one request at a
+ * time and with several requests in flight, which keeps the server's
+ * output queue for this client backed up.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <xcb/xcb.h>
+
+#define WIDTH 3840
+#define HEIGHT 2160
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+run(xcb_connection_t *c, xcb_pixmap_t pixmap, int frames, int inflight)
+{
+    xcb_get_image_cookie_t *cookies = calloc(inflight, sizeof(*cookies));
+    double start, elapsed, bytes = 0;
+    int sent = 0, done = 0;
+
+    start = now();
+    while (done < frames) {
+        xcb_get_image_reply_t *reply;
+
+        while (sent < frames && sent - done < inflight) {
+            cookies[sent % inflight] =
+                xcb_get_image(c, XCB_IMAGE_FORMAT_Z_PIXMAP, pixmap,
+                              0, 0, WIDTH, HEIGHT, ~0);
+            sent++;
+        }
+        reply = xcb_get_image_reply(c, cookies[done % inflight], NULL);
+        if (!reply) {
+            fprintf(stderr, "GetImage failed\n");
+            exit(1);
+        }
+        bytes += xcb_get_image_data_length(reply);
+        free(reply);
+        done++;
+    }
+    elapsed = now() - start;
+
+    printf("getimage %dx%d, %d in flight: %.1f frames/s, %.1f MB/s\n",
+           WIDTH, HEIGHT, inflight, frames / elapsed,
+           bytes / elapsed / (1024 * 1024));
+    free(cookies);
+}
+
+int main(int argc, char **argv)
+{
+    int frames = argc > 1 ? atoi(argv[1]) : 50;
+    xcb_connection_t *c = xcb_connect(NULL, NULL);
+    xcb_screen_t *screen;
+    xcb_pixmap_t pixmap;
+    xcb_gcontext_t gc;
+    xcb_rectangle_t rect = { 0, 0, WIDTH / 2, HEIGHT / 2 };
+
+    if (xcb_connection_has_error(c)) {
+        fprintf(stderr, "Failed to connect to the X server\n");
+        exit(1);
+    }
+    screen = xcb_setup_roots_iterator(xcb_get_setup(c)).data;
+
+    pixmap = xcb_generate_id(c);
+    xcb_create_pixmap(c, screen->root_depth, pixmap, screen->root,
+                      WIDTH, HEIGHT);
+    gc = xcb_generate_id(c);
+    xcb_create_gc(c, gc, pixmap, XCB_GC_FOREGROUND,
+                  (uint32_t[]) { 0x336699 });
+    xcb_poly_fill_rectangle(c, pixmap, gc, 1, &rect);
+
+    run(c, pixmap, frames, 1);
+    run(c, pixmap, frames, 4);
+
+    xcb_disconnect(c);
+    exit(0);
+}
@@ -0,0 +1,305 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * Text the way a terminal draws it: lines of glyphs, each line one
+ * CompositeGlyphs request with an A8 or ARGB mask, at several glyph
+ * sizes.  Reports glyphs per second.  The largest size has more glyphs
+ * than the server keeps at hand, so that forgetting and fetching them
+ * again is timed as well.  At the end two overlapping glyphs are drawn
+ * and read back, and where they overlap their coverage must add up.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <xcb/xcb.h>
+#include <xcb/render.h>
+
+#define SIZE 1024
+#define NGLYPHS 255
+#define COLUMNS 80
+
+static xcb_connection_t *c;
+static xcb_screen_t *screen;
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+sync_server(void)
+{
+    free(xcb_get_input_focus_reply(c, xcb_get_input_focus(c), NULL));
+}
+
+/* a8r8g8b8, x8r8g8b8 or a8 */
+static xcb_render_pictformat_t
+find_format(int depth, int rgb, int alpha)
+{
+    xcb_render_query_pict_formats_reply_t *formats;
+    xcb_render_pictforminfo_iterator_t i;
+    xcb_render_pictformat_t id = 0;
+
+    formats = xcb_render_query_pict_formats_reply(c,
+                  xcb_render_query_pict_formats(c), NULL);
+    if (!formats)
+        return 0;
+    for (i = xcb_render_query_pict_formats_formats_iterator(formats);
+         i.rem; xcb_render_pictforminfo_next(&i)) {
+        xcb_render_directformat_t *d = &i.data->direct;
+
+        if (i.data->type == XCB_RENDER_PICT_TYPE_DIRECT &&
+            i.data->depth == depth &&
+            d->red_mask == (rgb ? 0xff : 0) &&
+            (!rgb || (d->red_shift == 16 && d->green_shift == 8 &&
+                      d->blue_shift == 0)) &&
+            d->alpha_mask == (alpha ? 0xff : 0)) {
+            id = i.data->id;
+            break;
+        }
+    }
+    free(formats);
+    return id;
+}
+
+/* A picture of a w x h pixmap filled with pixel, which is kept if asked */
+static xcb_render_picture_t
+picture(int depth, xcb_render_pictformat_t format, int w, int h,
+        uint32_t pixel, int repeat, xcb_pixmap_t *keep)
+{
+    xcb_pixmap_t pix = xcb_generate_id(c);
+    xcb_gcontext_t gc = xcb_generate_id(c);
+    xcb_render_picture_t pict = xcb_generate_id(c);
+    xcb_rectangle_t r = { 0, 0, w, h };
+    uint32_t value = repeat ? XCB_RENDER_REPEAT_NORMAL : 0;
+
+    xcb_create_pixmap(c, depth, pix, screen->root, w, h);
+    xcb_create_gc(c, gc, pix, XCB_GC_FOREGROUND, &pixel);
+    xcb_poly_fill_rectangle(c, pix, gc, 1, &r);
+    xcb_free_gc(c, gc);
+    xcb_render_create_picture(c, pict, pix, format,
+                              repeat ? XCB_RENDER_CP_REPEAT : 0, &value);
+    if (keep)
+        *keep = pix;
+    else
+        xcb_free_pixmap(c, pix);
+    return pict;
+}
+
+/*
+ * A glyph set of NGLYPHS w x h glyphs, ids 1 to NGLYPHS, each with a
+ * pattern of its own.  cpp is 1 for A8 and 4 for ARGB.
+ */
+static xcb_render_glyphset_t
+glyph_set(xcb_render_pictformat_t format, int cpp, int w, int h)
+{
+    xcb_render_glyphset_t set = xcb_generate_id(c);
+    int stride = (w * cpp + 3) & ~3;
+    uint8_t *data = calloc(stride, h);
+    int id, x, y;
+
+    xcb_render_create_glyph_set(c, set, format);
+    for (id = 1; id <= NGLYPHS; id++) {
+        xcb_render_glyphinfo_t info = { w, h, 0, h, w, 0 };
+        uint32_t glyph = id;
+
+        for (y = 0; y < h; y++)
+            for (x = 0; x < w * cpp; x++)
+                data[y * stride + x] = ((x * 7 + y * 3) % id) * 0xff / id;
+        xcb_render_add_glyphs(c, set, 1, &glyph, &info, stride * h, data);
+    }
+    free(data);
+    return set;
+}
+
+/* One CompositeGlyphs8 request for a line of n glyphs */
+static void
+line(uint8_t op, xcb_render_picture_t src, xcb_render_picture_t dst,
+     xcb_render_pictformat_t mask, xcb_render_glyphset_t set,
+     int x, int y, const uint8_t *ids, int n)
+{
+    uint8_t cmds[8 + COLUMNS + 3];
+    int16_t delta[2] = { x, y };
+
+    memset(cmds, 0, sizeof(cmds));
+    cmds[0] = n;
+    memcpy(cmds + 4, delta, sizeof(delta));
+    memcpy(cmds + 8, ids, n);
+    xcb_render_composite_glyphs_8(c, op, src, dst, mask, set, 0, 0,
+                                  (8 + n + 3) & ~3, cmds);
+}
+
+static void
+run(const char *what, xcb_render_picture_t src, xcb_render_picture_t dst,
+    xcb_render_pictformat_t format, int cpp, int w, int h)
+{
+    xcb_render_glyphset_t set = glyph_set(format, cpp, w, h);
+    int columns = SIZE / w < COLUMNS ? SIZE / w : COLUMNS;
+    int rows = SIZE / h, glyphs = 8000000 / (w * h), lines, i, j;
+    uint8_t ids[COLUMNS];
+    double start, elapsed;
+
+    if (glyphs < 20000)
+        glyphs = 20000;
+    lines = glyphs / columns;
+
+    sync_server();
+    start = now();
+    for (i = 0; i < lines; i++) {
+        for (j = 0; j < columns; j++)
+            ids[j] = (i * 37 + j * 11) % NGLYPHS + 1;
+        line(XCB_RENDER_PICT_OP_OVER, src, dst, format, set,
+             0, (i % rows + 1) * h, ids, columns);
+    }
+    sync_server();
+    elapsed = now() - start;
+    xcb_render_free_glyph_set(c, set);
+
+    printf("%-5s %2dx%-2d %10.0f glyphs/s\n", what, w, h,
+           lines * columns / elapsed);
+}
+
+/* pixman's x * a / 255, rounded */
+static int
+mul_un8(int x, int a)
+{
+    int t = x * a + 0x80;
+
+    return (t + (t >> 8)) >> 8;
+}
+
+/* src IN mask OVER dst, for a solid src and an a8 mask */
+static uint32_t
+in_over(uint32_t src, int mask, uint32_t dst)
+{
+    int ia = 255 - mul_un8(src >> 24, mask), shift;
+    uint32_t result = 0;
+
+    for (shift = 0; shift < 24; shift += 8) {
+        int v = mul_un8((src >> shift) & 0xff, mask) +
+            mul_un8((dst >> shift) & 0xff, ia);
+
+        result |= (uint32_t) (v > 255 ? 255 : v) << shift;
+    }
+    return result;
+}
+
+/*
+ * Two 8x8 glyphs of coverage 0x60, the second starting four pixels into
+ * the first: the middle four columns must be drawn with coverage 0xc0.
+ */
+static int
+check(xcb_render_picture_t src, xcb_render_picture_t dst,
+      xcb_pixmap_t dst_pixmap, xcb_render_pictformat_t a8)
+{
+    const uint32_t bg = 0x336699, fg = 0xff204080;
+    const xcb_render_color_t bg_color = { 0x3333, 0x6666, 0x9999, 0xffff };
+    xcb_rectangle_t all = { 0, 0, SIZE, SIZE };
+    xcb_render_glyphset_t set = xcb_generate_id(c);
+    xcb_render_glyphinfo_t info = { 8, 8, 0, 8, 4, 0 };
+    const uint8_t ids[2] = { 1, 1 };
+    xcb_get_image_reply_t *image;
+    uint8_t data[8 * 8];
+    uint32_t *pixels, glyph = 1, want;
+    int failed = 0, i;
+
+    xcb_render_fill_rectangles(c, XCB_RENDER_PICT_OP_SRC, dst, bg_color,
+                               1, &all);
+    memset(data, 0x60, sizeof(data));
+    xcb_render_create_glyph_set(c, set, a8);
+    xcb_render_add_glyphs(c, set, 1, &glyph, &info, sizeof(data), data);
+    line(XCB_RENDER_PICT_OP_OVER, src, dst, a8, set, 100, 108, ids, 2);
+    xcb_render_free_glyph_set(c, set);
+
+    image = xcb_get_image_reply(c,
+                xcb_get_image(c, XCB_IMAGE_FORMAT_Z_PIXMAP, dst_pixmap,
+                              96, 96, 32, 32, ~0), NULL);
+    if (!image || xcb_get_image_data_length(image) < 32 * 32 * 4) {
+        fprintf(stderr, "GetImage failed\n");
+        free(image);
+        return 1;
+    }
+    pixels = (uint32_t *) xcb_get_image_data(image);
+    for (i = 0; i < 32 * 32; i++) {
+        int x = i % 32 + 96, y = i / 32 + 96, mask = 0;
+
+        if (y >= 100 && y < 108 && x >= 100 && x < 112)
+            mask = x >= 104 && x < 108 ? 0xc0 : 0x60;
+        want = mask ? in_over(fg, mask, bg) : bg;
+        if ((pixels[i] & 0xffffff) != want) {
+            fprintf(stderr, "pixel %d,%d is 0x%06x, not 0x%06x\n", x, y,
+                    pixels[i] & 0xffffff, want);
+            failed = 1;
+            break;
+        }
+    }
+    free(image);
+    return failed;
+}
+
+int main(int argc, char **argv)
+{
+    static const struct {
+        int w, h;
+    } sizes[] = {
+        { 6, 13 }, { 9, 18 }, { 16, 32 }, { 72, 72 },
+    };
+    xcb_render_query_version_reply_t *version;
+    xcb_render_pictformat_t argb, rgb, a8;
+    xcb_render_picture_t solid, dst;
+    xcb_pixmap_t dst_pixmap;
+    int i;
+
+    c = xcb_connect(NULL, NULL);
+    if (xcb_connection_has_error(c)) {
+        fprintf(stderr, "Failed to connect to the X server\n");
+        exit(1);
+    }
+    screen = xcb_setup_roots_iterator(xcb_get_setup(c)).data;
+
+    version = xcb_render_query_version_reply(c,
+                  xcb_render_query_version(c, 0, 11), NULL);
+    argb = find_format(32, 1, 1);
+    rgb = find_format(24, 1, 0);
+    a8 = find_format(8, 0, 1);
+    if (!version || !argb || !rgb || !a8) {
+        fprintf(stderr, "Needs RENDER with a8r8g8b8, x8r8g8b8 and a8\n");
+        exit(1);
+    }
+    free(version);
+
+    dst = picture(24, rgb, SIZE, SIZE, 0x336699, 0, &dst_pixmap);
+    solid = picture(32, argb, 1, 1, 0xff204080, 1, NULL);
+
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        run("a8", solid, dst, a8, 1, sizes[i].w, sizes[i].h);
+        run("argb", solid, dst, argb, 4, sizes[i].w, sizes[i].h);
+    }
+
+    exit(check(solid, dst, dst_pixmap, a8));
+}
@@ -0,0 +1,174 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * Several clients each rendering to their own offscreen pixmap with
+ * PutImage, PolyFillRectangle and CopyArea.  Reports the aggregate
+ * throughput and each client's frame latency; compare a plain server with
+ * one started with -dispatchthreads to see how well independent clients
+ * scale.  Every client finishes with a GetImage of a corner of its pixmap
+ * and checks the contents, so a request dispatched out of order shows up
+ * as a failure rather than as a good number.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <xcb/xcb.h>
+
+#define SIZE 1024
+#define IMAGE_W 512
+#define IMAGE_H 256
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+sync_server(xcb_connection_t *c)
+{
+    free(xcb_get_input_focus_reply(c, xcb_get_input_focus(c), NULL));
+}
+
+static int
+client(int id, int frames, int go)
+{
+    xcb_connection_t *c = xcb_connect(NULL, NULL);
+    xcb_screen_t *screen;
+    xcb_pixmap_t pixmap;
+    xcb_gcontext_t gc;
+    xcb_get_image_reply_t *reply;
+    xcb_rectangle_t rect = { 0, 0, SIZE, SIZE };
+    uint32_t *image, *data;
+    double start, worst = 0, elapsed;
+    char byte;
+    int i, f;
+
+    if (xcb_connection_has_error(c)) {
+        fprintf(stderr, "Failed to connect to the X server\n");
+        return 1;
+    }
+    screen = xcb_setup_roots_iterator(xcb_get_setup(c)).data;
+
+    pixmap = xcb_generate_id(c);
+    xcb_create_pixmap(c, 24, pixmap, screen->root, SIZE, SIZE);
+    gc = xcb_generate_id(c);
+    xcb_create_gc(c, gc, pixmap,
+                  XCB_GC_FOREGROUND | XCB_GC_GRAPHICS_EXPOSURES,
+                  (uint32_t[]) { 0x000000, 0 });
+
+    image = malloc(IMAGE_W * IMAGE_H * 4);
+    for (i = 0; i < IMAGE_W * IMAGE_H; i++)
+        image[i] = (id * 0x10101 + i) & 0xffffff;
+    sync_server(c);
+
+    /* wait for everybody to be connected */
+    if (read(go, &byte, 1) != 0)
+        return 1;
+
+    start = now();
+    for (f = 0; f < frames; f++) {
+        double t = now();
+
+        xcb_change_gc(c, gc, XCB_GC_FOREGROUND,
+                      (uint32_t[]) { (f * 0x030507) & 0xffffff });
+        xcb_poly_fill_rectangle(c, pixmap, gc, 1, &rect);
+        xcb_put_image(c, XCB_IMAGE_FORMAT_Z_PIXMAP, pixmap, gc,
+                      IMAGE_W, IMAGE_H, 0, 0, 0, 24,
+                      IMAGE_W * IMAGE_H * 4, (uint8_t *) image);
+        xcb_copy_area(c, pixmap, pixmap, gc, 0, 0, SIZE / 2, SIZE / 2,
+                      SIZE / 2, SIZE / 2);
+        sync_server(c);
+
+        t = now() - t;
+        if (t > worst)
+            worst = t;
+    }
+    elapsed = now() - start;
+
+    reply = xcb_get_image_reply(c,
+                                xcb_get_image(c, XCB_IMAGE_FORMAT_Z_PIXMAP,
+                                              pixmap, SIZE / 2, SIZE / 2,
+                                              IMAGE_W, IMAGE_H, ~0), NULL);
+    if (!reply) {
+        fprintf(stderr, "GetImage failed\n");
+        return 1;
+    }
+    data = (uint32_t *) xcb_get_image_data(reply);
+    for (i = 0; i < IMAGE_W * IMAGE_H; i++)
+        if ((data[i] & 0xffffff) != image[i]) {
+            fprintf(stderr, "client %d: bad pixel at %d\n", id, i);
+            return 1;
+        }
+    free(reply);
+
+    printf("client %d: %.1f frames/s, worst frame %.1f ms\n",
+           id, frames / elapsed, worst * 1000);
+    xcb_disconnect(c);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    int nclients = argc > 1 ? atoi(argv[1]) : 8;
+    int frames = argc > 2 ? atoi(argv[2]) : 200;
+    int go[2], i, status, failed = 0;
+    double start, elapsed;
+
+    if (pipe(go) < 0) {
+        perror("pipe");
+        exit(1);
+    }
+
+    for (i = 0; i < nclients; i++) {
+        if (fork() == 0) {
+            close(go[1]);
+            exit(client(i, frames, go[0]));
+        }
+    }
+    close(go[0]);
+
+    /* give the clients time to connect before starting the clock */
+    sleep(1);
+    start = now();
+    close(go[1]);
+
+    for (i = 0; i < nclients; i++) {
+        wait(&status);
+        if (!WIFEXITED(status) || WEXITSTATUS(status))
+            failed = 1;
+    }
+    elapsed = now() - start;
+
+    printf("privdraw %d clients: %.1f frames/s total, %.1f MB/s uploaded\n",
+           nclients, nclients * frames / elapsed,
+           nclients * frames * (IMAGE_W * IMAGE_H * 4.0) / elapsed /
+           (1024 * 1024));
+    exit(failed);
+}
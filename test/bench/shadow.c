@@ -0,0 +1,261 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * Cost of the shadow update on a rotated screen.  Run in an Xephyr started
+ * with -screen WxH@ROTATION, itself running on the X server named by
+ * HOST_DISPLAY; xephyr-shadow.sh sets that up.  Each frame fills the whole
+ * root window and reads back one pixel of it, which makes the shadow copy
+ * the screen out; the same done to a pixmap is taken off as the cost of
+ * the fill.  Reports milliseconds per frame and per megapixel.  At the end
+ * two rectangles are drawn and looked for in Xephyr's window on the host,
+ * turned by SHADOW_ROTATION degrees, so a tile put in the wrong place shows
+ * up as a failure.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <xcb/xcb.h>
+
+#define FRAMES 20
+
+static xcb_connection_t *c;
+static xcb_screen_t *screen;
+static int width, height, rotation;
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+fill(xcb_drawable_t drawable, uint32_t pixel, int x, int y, int w, int h)
+{
+    xcb_gcontext_t gc = xcb_generate_id(c);
+    xcb_rectangle_t r = { x, y, w, h };
+
+    xcb_create_gc(c, gc, drawable, XCB_GC_FOREGROUND, &pixel);
+    xcb_poly_fill_rectangle(c, drawable, gc, 1, &r);
+    xcb_free_gc(c, gc);
+}
+
+/* GetImage on a window brings the shadow up to date first */
+static void
+sync_drawable(xcb_drawable_t drawable)
+{
+    free(xcb_get_image_reply(c,
+             xcb_get_image(c, XCB_IMAGE_FORMAT_Z_PIXMAP, drawable,
+                           0, 0, 1, 1, ~0), NULL));
+}
+
+static double
+frames(xcb_drawable_t drawable)
+{
+    double start;
+    int i;
+
+    sync_drawable(drawable);
+    start = now();
+    for (i = 0; i < FRAMES; i++) {
+        fill(drawable, i & 1 ? 0x336699 : 0x996633, 0, 0, width, height);
+        sync_drawable(drawable);
+    }
+    return (now() - start) / FRAMES;
+}
+
+/* Where pixel x,y of the screen ends up in the host window */
+static void
+rotate(int x, int y, int *px, int *py)
+{
+    switch (rotation) {
+    case 90:
+        *px = y;
+        *py = width - 1 - x;
+        break;
+    case 180:
+        *px = width - 1 - x;
+        *py = height - 1 - y;
+        break;
+    case 270:
+        *px = height - 1 - y;
+        *py = x;
+        break;
+    default:
+        *px = x;
+        *py = y;
+        break;
+    }
+}
+
+/* Xephyr's window: the child of the host root window of the right size */
+static xcb_window_t
+find_host_window(xcb_connection_t *host, int w, int h)
+{
+    xcb_screen_t *root = xcb_setup_roots_iterator(xcb_get_setup(host)).data;
+    xcb_query_tree_reply_t *tree;
+    xcb_window_t *children, found = XCB_NONE;
+    int i;
+
+    tree = xcb_query_tree_reply(host, xcb_query_tree(host, root->root), NULL);
+    if (!tree)
+        return XCB_NONE;
+    children = xcb_query_tree_children(tree);
+    for (i = 0; i < xcb_query_tree_children_length(tree) && !found; i++) {
+        xcb_get_geometry_reply_t *geometry =
+            xcb_get_geometry_reply(host, xcb_get_geometry(host, children[i]),
+                                   NULL);
+
+        if (geometry && geometry->width == w && geometry->height == h)
+            found = children[i];
+        free(geometry);
+    }
+    free(tree);
+    return found;
+}
+
+/* Compare the area around the two rectangles with what the host shows */
+static int
+compare(xcb_connection_t *host, xcb_window_t window, int quiet)
+{
+    const int x0 = 90, y0 = 40, w = 100, h = 50;
+    xcb_get_image_reply_t *image;
+    uint32_t *pixels;
+    int px0 = width + height, py0 = width + height, px1 = 0, py1 = 0;
+    int x, y, px, py, stride;
+
+    for (y = y0; y < y0 + h; y += h - 1)
+        for (x = x0; x < x0 + w; x += w - 1) {
+            rotate(x, y, &px, &py);
+            px0 = px < px0 ? px : px0;
+            py0 = py < py0 ? py : py0;
+            px1 = px > px1 ? px : px1;
+            py1 = py > py1 ? py : py1;
+        }
+    stride = px1 - px0 + 1;
+
+    image = xcb_get_image_reply(host,
+                xcb_get_image(host, XCB_IMAGE_FORMAT_Z_PIXMAP, window,
+                              px0, py0, stride, py1 - py0 + 1, ~0), NULL);
+    if (!image ||
+        xcb_get_image_data_length(image) < stride * (py1 - py0 + 1) * 4) {
+        fprintf(stderr, "GetImage of the host window failed\n");
+        free(image);
+        return 1;
+    }
+    pixels = (uint32_t *) xcb_get_image_data(image);
+    for (y = y0; y < y0 + h; y++)
+        for (x = x0; x < x0 + w; x++) {
+            uint32_t want = 0x336699, got;
+
+            if (x >= 100 && x < 137 && y >= 50 && y < 73)
+                want = 0xff0000;
+            else if (x >= 137 && x < 174 && y >= 50 && y < 73)
+                want = 0x00ff00;
+            rotate(x, y, &px, &py);
+            got = pixels[(py - py0) * stride + px - px0] & 0xffffff;
+            if (got != want) {
+                if (!quiet)
+                    fprintf(stderr, "pixel %d,%d is 0x%06x on the host at "
+                            "%d,%d, not 0x%06x\n", x, y, got, px, py, want);
+                free(image);
+                return 1;
+            }
+        }
+    free(image);
+    return 0;
+}
+
+static int
+check(void)
+{
+    xcb_connection_t *host = xcb_connect(getenv("HOST_DISPLAY"), NULL);
+    xcb_window_t window;
+    int pw = width, ph = height, tries, failed;
+
+    if (xcb_connection_has_error(host)) {
+        fprintf(stderr, "Failed to connect to the host X server\n");
+        return 1;
+    }
+    if (rotation == 90 || rotation == 270) {
+        pw = height;
+        ph = width;
+    }
+    window = find_host_window(host, pw, ph);
+    if (!window) {
+        fprintf(stderr, "No %dx%d window on the host\n", pw, ph);
+        return 1;
+    }
+
+    fill(screen->root, 0x336699, 0, 0, width, height);
+    fill(screen->root, 0xff0000, 100, 50, 37, 23);
+    fill(screen->root, 0x00ff00, 137, 50, 37, 23);
+    sync_drawable(screen->root);
+
+    /* Xephyr puts the image up on the host in its own time */
+    for (tries = 0; tries < 20; tries++) {
+        if (!compare(host, window, 1))
+            break;
+        usleep(50000);
+    }
+    failed = tries == 20 ? compare(host, window, 0) : 0;
+    xcb_disconnect(host);
+    return failed;
+}
+
+int main(int argc, char **argv)
+{
+    const char *env = getenv("SHADOW_ROTATION");
+    xcb_pixmap_t pixmap;
+    double root, base, mpixels;
+
+    c = xcb_connect(NULL, NULL);
+    if (xcb_connection_has_error(c)) {
+        fprintf(stderr, "Failed to connect to the X server\n");
+        exit(1);
+    }
+    screen = xcb_setup_roots_iterator(xcb_get_setup(c)).data;
+    width = screen->width_in_pixels;
+    height = screen->height_in_pixels;
+    rotation = env ? atoi(env) : 0;
+    if (screen->root_depth != 24) {
+        fprintf(stderr, "Needs a depth 24 screen\n");
+        exit(1);
+    }
+
+    pixmap = xcb_generate_id(c);
+    xcb_create_pixmap(c, screen->root_depth, pixmap, screen->root,
+                      width, height);
+
+    root = frames(screen->root);
+    base = frames(pixmap);
+    mpixels = (double) width * height / 1e6;
+    printf("shadow update @%d %dx%d %8.2f ms/frame %8.2f ms/Mpixel\n",
+           rotation, width, height, (root - base) * 1000,
+           (root - base) * 1000 / mpixels);
+
+    exit(check());
+}
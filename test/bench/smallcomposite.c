@@ -0,0 +1,277 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * Many small composites, where setting up the operation costs as much as
+ * the pixels: icons blended onto a pixmap, text-like solid colour through
+ * an A8 mask, and a scaled, filtered source.  Reports composites per
+ * second.  The run ends by changing the scaled source's transform, filter
+ * and contents, compositing it once more and checking the result against
+ * the one worked out here, so that stale picture state shows up as a
+ * failure.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <xcb/xcb.h>
+#include <xcb/render.h>
+
+#define SIZE 1024
+#define COMPOSITES 200000
+
+static xcb_connection_t *c;
+static xcb_screen_t *screen;
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+sync_server(void)
+{
+    free(xcb_get_input_focus_reply(c, xcb_get_input_focus(c), NULL));
+}
+
+/* a8r8g8b8, x8r8g8b8 or a8 */
+static xcb_render_pictformat_t
+find_format(int depth, int rgb, int alpha)
+{
+    xcb_render_query_pict_formats_reply_t *formats;
+    xcb_render_pictforminfo_iterator_t i;
+    xcb_render_pictformat_t id = 0;
+
+    formats = xcb_render_query_pict_formats_reply(c,
+                  xcb_render_query_pict_formats(c), NULL);
+    if (!formats)
+        return 0;
+    for (i = xcb_render_query_pict_formats_formats_iterator(formats);
+         i.rem; xcb_render_pictforminfo_next(&i)) {
+        xcb_render_directformat_t *d = &i.data->direct;
+
+        if (i.data->type == XCB_RENDER_PICT_TYPE_DIRECT &&
+            i.data->depth == depth &&
+            d->red_mask == (rgb ? 0xff : 0) &&
+            (!rgb || (d->red_shift == 16 && d->green_shift == 8 &&
+                      d->blue_shift == 0)) &&
+            d->alpha_mask == (alpha ? 0xff : 0)) {
+            id = i.data->id;
+            break;
+        }
+    }
+    free(formats);
+    return id;
+}
+
+/* A picture of a w x h pixmap filled with pixel, which is kept if asked */
+static xcb_render_picture_t
+picture(int depth, xcb_render_pictformat_t format, int w, int h,
+        uint32_t pixel, int repeat, xcb_pixmap_t *keep)
+{
+    xcb_pixmap_t pix = xcb_generate_id(c);
+    xcb_gcontext_t gc = xcb_generate_id(c);
+    xcb_render_picture_t pict = xcb_generate_id(c);
+    xcb_rectangle_t r = { 0, 0, w, h };
+    uint32_t value = repeat ? XCB_RENDER_REPEAT_NORMAL : 0;
+
+    xcb_create_pixmap(c, depth, pix, screen->root, w, h);
+    xcb_create_gc(c, gc, pix, XCB_GC_FOREGROUND, &pixel);
+    xcb_poly_fill_rectangle(c, pix, gc, 1, &r);
+    xcb_free_gc(c, gc);
+    xcb_render_create_picture(c, pict, pix, format,
+                              repeat ? XCB_RENDER_CP_REPEAT : 0, &value);
+    if (keep)
+        *keep = pix;
+    else
+        xcb_free_pixmap(c, pix);
+    return pict;
+}
+
+static void
+run(const char *what, uint8_t op, xcb_render_picture_t src,
+    xcb_render_picture_t mask, xcb_render_picture_t dst, int w, int h)
+{
+    double start, elapsed;
+    int i;
+
+    sync_server();
+    start = now();
+    for (i = 0; i < COMPOSITES; i++)
+        xcb_render_composite(c, op, src, mask, dst, i & 31, i & 15, 0, 0,
+                             (i * 37) % (SIZE - w), (i * 101) % (SIZE - h),
+                             w, h);
+    sync_server();
+    elapsed = now() - start;
+
+    printf("%-28s %2dx%-2d %10.0f composites/s\n", what, w, h,
+           COMPOSITES / elapsed);
+}
+
+static void
+set_scale(xcb_render_picture_t pict, int scale)
+{
+    xcb_render_transform_t t = {
+        scale, 0, 0,
+        0, scale, 0,
+        0, 0, 1 << 16,
+    };
+
+    xcb_render_set_picture_transform(c, pict, t);
+}
+
+static void
+set_filter(xcb_render_picture_t pict, const char *filter)
+{
+    xcb_render_set_picture_filter(c, pict, strlen(filter), filter, 0, NULL);
+}
+
+/* pixman's x * a / 255, rounded */
+static int
+mul_un8(int x, int a)
+{
+    int t = x * a + 0x80;
+
+    return (t + (t >> 8)) >> 8;
+}
+
+/* src IN mask OVER dst, for a solid src and an a8 mask */
+static uint32_t
+in_over(uint32_t src, int mask, uint32_t dst)
+{
+    int ia = 255 - mul_un8(src >> 24, mask), shift;
+    uint32_t result = 0;
+
+    for (shift = 0; shift < 24; shift += 8) {
+        int v = mul_un8((src >> shift) & 0xff, mask) +
+            mul_un8((dst >> shift) & 0xff, ia);
+
+        result |= (uint32_t) (v > 255 ? 255 : v) << shift;
+    }
+    return result;
+}
+
+/*
+ * Composite with a source whose transform, filter and contents changed
+ * after its last use, and check that the changes were seen: a stale
+ * scale would spread its corner over the whole area.
+ */
+static int
+check(xcb_render_picture_t src, xcb_render_picture_t mask,
+      xcb_render_picture_t dst, xcb_pixmap_t dst_pixmap)
+{
+    const uint32_t bg = 0x336699, fg = 0xc0204080;
+    const xcb_render_color_t bg_color = { 0x3333, 0x6666, 0x9999, 0xffff };
+    const xcb_render_color_t fg_color = { 0x2020, 0x4040, 0x8080, 0xc0c0 };
+    const xcb_render_color_t clear = { 0, 0, 0, 0 };
+    xcb_rectangle_t all = { 0, 0, SIZE, SIZE };
+    xcb_rectangle_t source = { 0, 0, 64, 64 }, corner = { 0, 0, 8, 8 };
+    xcb_get_image_reply_t *image;
+    uint32_t *pixels, want;
+    int failed = 0, i;
+
+    xcb_render_fill_rectangles(c, XCB_RENDER_PICT_OP_SRC, dst, bg_color,
+                               1, &all);
+    set_scale(src, 1 << 16);
+    set_filter(src, "nearest");
+    xcb_render_fill_rectangles(c, XCB_RENDER_PICT_OP_SRC, src, clear,
+                               1, &source);
+    xcb_render_fill_rectangles(c, XCB_RENDER_PICT_OP_SRC, src, fg_color,
+                               1, &corner);
+    xcb_render_composite(c, XCB_RENDER_PICT_OP_OVER, src, mask, dst,
+                         0, 0, 0, 0, 100, 100, 16, 16);
+
+    image = xcb_get_image_reply(c,
+                xcb_get_image(c, XCB_IMAGE_FORMAT_Z_PIXMAP, dst_pixmap,
+                              92, 92, 32, 32, ~0), NULL);
+    if (!image || xcb_get_image_data_length(image) < 32 * 32 * 4) {
+        fprintf(stderr, "GetImage failed\n");
+        free(image);
+        return 1;
+    }
+    pixels = (uint32_t *) xcb_get_image_data(image);
+    for (i = 0; i < 32 * 32; i++) {
+        int x = i % 32 + 92, y = i / 32 + 92;
+        int inside = x >= 100 && x < 108 && y >= 100 && y < 108;
+
+        want = inside ? in_over(fg, 0x80, bg) : bg;
+        if ((pixels[i] & 0xffffff) != want) {
+            fprintf(stderr, "pixel %d,%d is 0x%06x, not 0x%06x\n", x, y,
+                    pixels[i] & 0xffffff, want);
+            failed = 1;
+            break;
+        }
+    }
+    free(image);
+    return failed;
+}
+
+int main(int argc, char **argv)
+{
+    xcb_render_query_version_reply_t *version;
+    xcb_render_pictformat_t argb, rgb, a8;
+    xcb_render_picture_t icon, solid, glyph, scaled, dst;
+    xcb_pixmap_t dst_pixmap;
+
+    c = xcb_connect(NULL, NULL);
+    if (xcb_connection_has_error(c)) {
+        fprintf(stderr, "Failed to connect to the X server\n");
+        exit(1);
+    }
+    screen = xcb_setup_roots_iterator(xcb_get_setup(c)).data;
+
+    version = xcb_render_query_version_reply(c,
+                  xcb_render_query_version(c, 0, 11), NULL);
+    argb = find_format(32, 1, 1);
+    rgb = find_format(24, 1, 0);
+    a8 = find_format(8, 0, 1);
+    if (!version || !argb || !rgb || !a8) {
+        fprintf(stderr, "Needs RENDER with a8r8g8b8, x8r8g8b8 and a8\n");
+        exit(1);
+    }
+    free(version);
+
+    dst = picture(24, rgb, SIZE, SIZE, 0x336699, 0, &dst_pixmap);
+    icon = picture(32, argb, 64, 64, 0x80402010, 0, NULL);
+    solid = picture(32, argb, 1, 1, 0xff204080, 1, NULL);
+    glyph = picture(8, a8, 16, 16, 0x80, 0, NULL);
+    scaled = picture(32, argb, 64, 64, 0x40102040, 1, NULL);
+    set_scale(scaled, 1 << 15);
+    set_filter(scaled, "bilinear");
+
+    run("icon over", XCB_RENDER_PICT_OP_OVER, icon,
+        XCB_RENDER_PICTURE_NONE, dst, 16, 16);
+    run("icon over", XCB_RENDER_PICT_OP_OVER, icon,
+        XCB_RENDER_PICTURE_NONE, dst, 32, 32);
+    run("solid in glyph over", XCB_RENDER_PICT_OP_OVER, solid, glyph, dst,
+        8, 12);
+    run("solid in glyph over", XCB_RENDER_PICT_OP_OVER, solid, glyph, dst,
+        16, 16);
+    run("scaled bilinear src", XCB_RENDER_PICT_OP_SRC, scaled,
+        XCB_RENDER_PICTURE_NONE, dst, 16, 16);
+
+    exit(check(scaled, glyph, dst, dst_pixmap));
+}
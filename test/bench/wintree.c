@@ -0,0 +1,277 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * Window tree validation.  A top-level window holding a few hundred nested
+ * children sits partially under two other top-levels; time moving and
+ * resizing it, restacking the windows above it, and dragging a small
+ * window across it, one round trip per request.  At the end every leaf
+ * window that should be visible is checked to show its own background, so
+ * a clip that went wrong shows up as a failure.
+ *
+ * Each operation runs ROUNDS times and the fastest and median rounds are
+ * reported, so runs against two servers can be compared.  The client only
+ * speaks core protocol; to compare against another build, run it under
+ * that build's Xvfb, e.g. "simple-xinit ./wintree -- /path/to/Xvfb :99".
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <xcb/xcb.h>
+
+#define COLS 20
+#define ROWS 10
+#define LEAVES 2
+#define CELL_W 40
+#define CELL_H 60
+#define ROUNDS 5
+
+static xcb_connection_t *c;
+static xcb_screen_t *screen;
+static xcb_window_t leaves[COLS * ROWS * LEAVES];
+static xcb_window_t tree_win, covers[2], drag;
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+sync_server(void)
+{
+    free(xcb_get_input_focus_reply(c, xcb_get_input_focus(c), NULL));
+}
+
+static xcb_window_t
+window(xcb_window_t parent, int x, int y, int w, int h, uint32_t pixel)
+{
+    xcb_window_t win = xcb_generate_id(c);
+
+    xcb_create_window(c, XCB_COPY_FROM_PARENT, win, parent, x, y, w, h, 0,
+                      XCB_WINDOW_CLASS_INPUT_OUTPUT, XCB_COPY_FROM_PARENT,
+                      XCB_CW_BACK_PIXEL | XCB_CW_OVERRIDE_REDIRECT,
+                      (uint32_t[]) { pixel, 1 });
+    return win;
+}
+
+static uint32_t
+leaf_pixel(int i)
+{
+    return 0x100000 + i * 0x101;
+}
+
+/* top, a COLS x ROWS grid of cells, each holding a column of leaves */
+static xcb_window_t
+tree(void)
+{
+    xcb_window_t top, cell;
+    int i, j, k;
+
+    top = window(screen->root, 100, 100, COLS * CELL_W, ROWS * CELL_H,
+                 0x202020);
+    for (i = 0; i < ROWS; i++)
+        for (j = 0; j < COLS; j++) {
+            cell = window(top, j * CELL_W, i * CELL_H, CELL_W, CELL_H,
+                          0x404040);
+            for (k = 0; k < LEAVES; k++) {
+                int n = (i * COLS + j) * LEAVES + k;
+
+                leaves[n] = window(cell, 4, 4 + k * (CELL_H / LEAVES),
+                                   CELL_W - 8, CELL_H / LEAVES - 8,
+                                   leaf_pixel(n));
+            }
+            xcb_map_subwindows(c, cell);
+        }
+    xcb_map_subwindows(c, top);
+    xcb_map_window(c, top);
+    return top;
+}
+
+static void
+configure(xcb_window_t win, uint16_t mask, const uint32_t *values)
+{
+    xcb_configure_window(c, win, mask, values);
+    sync_server();
+}
+
+static int
+compare(const void *a, const void *b)
+{
+    double x = *(const double *) a, y = *(const double *) b;
+
+    return x < y ? -1 : x > y;
+}
+
+/* runs op(0) .. op(n - 1) ROUNDS times, reporting per-op times */
+static void
+bench(const char *what, void (*op)(int), int n)
+{
+    double rounds[ROUNDS], start;
+    int r, i;
+
+    for (r = 0; r < ROUNDS; r++) {
+        start = now();
+        for (i = 0; i < n; i++)
+            op(i);
+        rounds[r] = (now() - start) * 1e6 / n;
+    }
+    qsort(rounds, ROUNDS, sizeof(rounds[0]), compare);
+    printf("%-40s %8.1f us/op (median %.1f)\n",
+           what, rounds[0], rounds[ROUNDS / 2]);
+}
+
+static void
+move_tree(int i)
+{
+    configure(tree_win, XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y,
+              (uint32_t[]) { 100 + i % 2, 100 + (i / 2) % 2 });
+}
+
+static void
+move_tree_vertically(int i)
+{
+    configure(tree_win, XCB_CONFIG_WINDOW_Y, (uint32_t[]) { 100 + i % 40 });
+}
+
+static void
+resize_tree(int i)
+{
+    configure(tree_win, XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT,
+              (uint32_t[]) { COLS * CELL_W - i % 50, ROWS * CELL_H - i % 30 });
+}
+
+static void
+restack_covers(int i)
+{
+    configure(covers[i % 2], XCB_CONFIG_WINDOW_STACK_MODE,
+              (uint32_t[]) { i & 2 ? XCB_STACK_MODE_ABOVE :
+                             XCB_STACK_MODE_BELOW });
+}
+
+static void
+drag_window(int i)
+{
+    configure(drag, XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y,
+              (uint32_t[]) { 100 + (i * 7) % (COLS * CELL_W),
+                             100 + (i * 3) % (ROWS * CELL_H) });
+}
+
+static void
+unmap_map_cover(int i)
+{
+    xcb_unmap_window(c, covers[0]);
+    xcb_map_window(c, covers[0]);
+    sync_server();
+}
+
+/* every leaf that isn't under a covering window shows its own pixel */
+static int
+check(xcb_window_t *wins, int nwins)
+{
+    xcb_get_geometry_reply_t *cover[2];
+    int i, j, failed = 0;
+
+    for (j = 0; j < nwins; j++)
+        cover[j] = xcb_get_geometry_reply(c, xcb_get_geometry(c, wins[j]),
+                                          NULL);
+
+    for (i = 0; i < COLS * ROWS * LEAVES; i++) {
+        xcb_translate_coordinates_reply_t *pos;
+        xcb_get_image_reply_t *image;
+        int x, y, covered = 0;
+
+        pos = xcb_translate_coordinates_reply(c,
+                  xcb_translate_coordinates(c, leaves[i], screen->root,
+                                            (CELL_W - 8) / 2, 4), NULL);
+        x = pos->dst_x;
+        y = pos->dst_y;
+        free(pos);
+
+        for (j = 0; j < nwins; j++)
+            if (x >= cover[j]->x && x < cover[j]->x + cover[j]->width &&
+                y >= cover[j]->y && y < cover[j]->y + cover[j]->height)
+                covered = 1;
+        if (covered || x < 0 || y < 0 ||
+            x >= screen->width_in_pixels || y >= screen->height_in_pixels)
+            continue;
+
+        image = xcb_get_image_reply(c,
+                    xcb_get_image(c, XCB_IMAGE_FORMAT_Z_PIXMAP, screen->root,
+                                  x, y, 1, 1, ~0), NULL);
+        if ((*(uint32_t *) xcb_get_image_data(image) & 0xffffff) !=
+            leaf_pixel(i)) {
+            fprintf(stderr, "leaf %d at %d,%d shows the wrong pixel\n",
+                    i, x, y);
+            failed = 1;
+        }
+        free(image);
+    }
+
+    for (j = 0; j < nwins; j++)
+        free(cover[j]);
+    return failed;
+}
+
+int main(int argc, char **argv)
+{
+    int n = argc > 1 ? atoi(argv[1]) : 500;
+
+    c = xcb_connect(NULL, NULL);
+    if (xcb_connection_has_error(c)) {
+        fprintf(stderr, "Failed to connect to the X server\n");
+        exit(1);
+    }
+    screen = xcb_setup_roots_iterator(xcb_get_setup(c)).data;
+
+    tree_win = tree();
+    /* two windows over the top-left and bottom-right corners */
+    covers[0] = window(screen->root, 50, 50, 200, 150, 0xff0000);
+    covers[1] = window(screen->root, 700, 500, 300, 200, 0x00ff00);
+    drag = window(screen->root, 0, 0, 60, 60, 0x0000ff);
+    xcb_map_window(c, covers[0]);
+    xcb_map_window(c, covers[1]);
+    sync_server();
+
+    bench("move partially covered tree", move_tree, n);
+    bench("move partially covered tree vertically", move_tree_vertically, n);
+    bench("resize tree", resize_tree, n);
+    bench("restack windows over tree", restack_covers, n);
+    configure(covers[0], XCB_CONFIG_WINDOW_STACK_MODE,
+              (uint32_t[]) { XCB_STACK_MODE_ABOVE });
+    configure(covers[1], XCB_CONFIG_WINDOW_STACK_MODE,
+              (uint32_t[]) { XCB_STACK_MODE_ABOVE });
+
+    xcb_map_window(c, drag);
+    bench("drag small window across tree", drag_window, n);
+    xcb_unmap_window(c, drag);
+
+    bench("unmap and map window over tree", unmap_map_cover, n);
+
+    configure(tree_win, XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y |
+              XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT,
+              (uint32_t[]) { 120, 110, COLS * CELL_W, ROWS * CELL_H });
+    exit(check(covers, 2));
+}
@@ -0,0 +1,13 @@
+#!/bin/sh
+
+# Run the shadow benchmark in an Xephyr with a rotated 4K screen, hosted by
+# the X server this is started on.  SHADOW_ROTATION picks the rotation; any
+# arguments are passed on to Xephyr.
+export HOST_DISPLAY=$DISPLAY
+
+exec $XSERVER_BUILDDIR/test/simple-xinit \
+        $XSERVER_BUILDDIR/test/bench/shadow \
+        -- \
+        $XSERVER_BUILDDIR/hw/kdrive/ephyr/Xephyr \
+        -screen 3840x2160@$SHADOW_ROTATION \
+        "$@"
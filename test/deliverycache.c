@@ -0,0 +1,254 @@
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <X11/extensions/XI2proto.h>
+#include "misc.h"
+#include "windowstr.h"
+#include "inputstr.h"
+#include "inpututils.h"
+#include "exevents.h"
+#include "exglobals.h"
+
+#include "tests-common.h"
+
+/*
+ * Tests and a benchmark for the event delivery cache, dix/deliverycache.c:
+ * a window's cached list has to hold exactly the clients GetEventMask lets
+ * the event through to, in the order of the window's list, and has to
+ * follow the clients' masks as they change.
+ */
+
+static DeviceIntRec all_devices, all_master_devices, master, slave;
+
+static WindowPtr
+deliverycache_window(void)
+{
+    WindowPtr pWin = calloc(1, sizeof(WindowRec));
+
+    assert(pWin);
+    pWin->optional = calloc(1, sizeof(WindowOptRec));
+    assert(pWin->optional);
+    pWin->optional->inputMasks = calloc(1, sizeof(OtherInputMasks));
+    assert(pWin->optional->inputMasks);
+    pWin->optional->inputMasks->xi2mask = xi2mask_new();
+    return pWin;
+}
+
+/* n XI clients, three in eight selecting for raw motion in some way */
+static void
+deliverycache_clients(WindowPtr pWin, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++) {
+        InputClientsPtr other = calloc(1, sizeof(InputClients));
+
+        assert(other);
+        other->xi2mask = xi2mask_new();
+        switch (i % 8) {
+        case 0:
+            xi2mask_set(other->xi2mask, XIAllDevices, XI_RawMotion);
+            break;
+        case 2:
+            xi2mask_set(other->xi2mask, XIAllMasterDevices, XI_RawMotion);
+            break;
+        case 4:
+            xi2mask_set(other->xi2mask, slave.id, XI_RawMotion);
+            break;
+        case 6:
+            xi2mask_set(other->xi2mask, XIAllDevices, XI_RawButtonPress);
+            break;
+        }
+        other->resource = i;
+        other->next = pWin->optional->inputMasks->inputClients;
+        pWin->optional->inputMasks->inputClients = other;
+    }
+    RecalculateDeviceDeliverableEvents(pWin);
+}
+
+static void
+deliverycache_free(WindowPtr pWin)
+{
+    InputClientsPtr other, next;
+
+    DeliveryCacheInvalidate(pWin);
+    for (other = pWin->optional->inputMasks->inputClients; other;
+         other = next) {
+        next = other->next;
+        xi2mask_free(&other->xi2mask);
+        free(other);
+    }
+    xi2mask_free(&pWin->optional->inputMasks->xi2mask);
+    free(pWin->optional->inputMasks);
+    free(pWin->optional);
+    free(pWin);
+}
+
+static void
+deliverycache_event(xGenericEvent *ev, int evtype)
+{
+    memset(ev, 0, sizeof(*ev));
+    ev->type = GenericEvent;
+    ev->extension = IReqCode;
+    ev->evtype = evtype;
+}
+
+/* The cached list against a walk of all the clients */
+static void
+deliverycache_check(DeviceIntPtr dev, WindowPtr pWin, xEvent *ev, Mask filter)
+{
+    InputClientsPtr other, *list;
+    int i = 0, n;
+
+    assert(DeliveryCacheLookup(dev, pWin, ev, filter,
+                               pWin->optional->inputMasks->inputClients,
+                               &list, &n));
+    for (other = pWin->optional->inputMasks->inputClients; other;
+         other = other->next)
+        if (GetEventMask(dev, ev, other) & filter) {
+            assert(i < n);
+            assert(list[i++] == other);
+        }
+    assert(i == n);
+}
+
+static void
+deliverycache_lists(void)
+{
+    WindowPtr pWin;
+    InputClientsPtr *list, *again;
+    xGenericEvent motion, press, release;
+    int n, m;
+
+    deliverycache_event(&motion, XI_RawMotion);
+    deliverycache_event(&press, XI_RawButtonPress);
+    deliverycache_event(&release, XI_RawButtonRelease);
+
+    /* a few clients are tried one by one */
+    pWin = deliverycache_window();
+    deliverycache_clients(pWin, 7);
+    assert(!DeliveryCacheLookup(&slave, pWin, (xEvent *) &motion,
+                                GetEventFilter(&slave, (xEvent *) &motion),
+                                pWin->optional->inputMasks->inputClients,
+                                &list, &n));
+    assert(!pWin->optional->deliveryCache);
+    deliverycache_free(pWin);
+
+    /* many get a list per event type, device and filter */
+    pWin = deliverycache_window();
+    deliverycache_clients(pWin, 50);
+    deliverycache_check(&slave, pWin, (xEvent *) &motion,
+                        GetEventFilter(&slave, (xEvent *) &motion));
+    deliverycache_check(&master, pWin, (xEvent *) &motion,
+                        GetEventFilter(&master, (xEvent *) &motion));
+    deliverycache_check(&slave, pWin, (xEvent *) &press,
+                        GetEventFilter(&slave, (xEvent *) &press));
+    deliverycache_check(&slave, pWin, (xEvent *) &release,
+                        GetEventFilter(&slave, (xEvent *) &release));
+    assert(pWin->optional->deliveryCache);
+
+    /* which is kept from one event to the next */
+    assert(DeliveryCacheLookup(&slave, pWin, (xEvent *) &motion,
+                               GetEventFilter(&slave, (xEvent *) &motion),
+                               pWin->optional->inputMasks->inputClients,
+                               &list, &n));
+    assert(DeliveryCacheLookup(&slave, pWin, (xEvent *) &motion,
+                               GetEventFilter(&slave, (xEvent *) &motion),
+                               pWin->optional->inputMasks->inputClients,
+                               &again, &m));
+    assert(list == again && n == m && n == 13);
+
+    /* and follows the masks as clients select */
+    xi2mask_set(pWin->optional->inputMasks->inputClients->xi2mask,
+                XIAllDevices, XI_RawButtonRelease);
+    xi2mask_zero(pWin->optional->inputMasks->inputClients->next->xi2mask, -1);
+    RecalculateDeviceDeliverableEvents(pWin);
+    assert(!pWin->optional->deliveryCache);
+    deliverycache_check(&slave, pWin, (xEvent *) &motion,
+                        GetEventFilter(&slave, (xEvent *) &motion));
+    deliverycache_check(&slave, pWin, (xEvent *) &release,
+                        GetEventFilter(&slave, (xEvent *) &release));
+    deliverycache_free(pWin);
+}
+
+/*
+ * Raw motion on a root window with more and more XI2 clients on it, a
+ * quarter of them selecting for raw motion from the device: the clients
+ * delivery has to consider, found by walking the window's list as before,
+ * and from the cache.
+ */
+static void
+deliverycache_benchmark(void)
+{
+    static const int sizes[] = { 8, 32, 128, 512 };
+    const int iterations = 100000;
+    struct timespec start;
+    xGenericEvent motion;
+    Mask filter;
+    volatile int found;
+    double walk, cached;
+    int s, i;
+
+    deliverycache_event(&motion, XI_RawMotion);
+    filter = GetEventFilter(&slave, (xEvent *) &motion);
+
+    printf("%10s %16s %16s\n", "clients", "walk ns/event", "cache ns/event");
+    for (s = 0; s < ARRAY_SIZE(sizes); s++) {
+        WindowPtr pWin = deliverycache_window();
+        InputClientsPtr other, *list;
+        int n;
+
+        deliverycache_clients(pWin, sizes[s]);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (i = 0; i < iterations; i++) {
+            found = 0;
+            for (other = pWin->optional->inputMasks->inputClients; other;
+                 other = other->next)
+                if (GetEventMask(&slave, (xEvent *) &motion, other) & filter)
+                    found++;
+        }
+        walk = test_elapsed_ns(&start) / iterations;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (i = 0; i < iterations; i++) {
+            DeliveryCacheLookup(&slave, pWin, (xEvent *) &motion, filter,
+                                pWin->optional->inputMasks->inputClients,
+                                &list, &n);
+            found = n;
+        }
+        cached = test_elapsed_ns(&start) / iterations;
+
+        printf("%10d %16.1f %16.1f\n", sizes[s], walk, cached);
+        deliverycache_free(pWin);
+    }
+}
+
+int
+deliverycache_test(void)
+{
+    DeviceIntPtr saved_all = inputInfo.all_devices;
+    DeviceIntPtr saved_all_master = inputInfo.all_master_devices;
+
+    all_devices.id = XIAllDevices;
+    all_master_devices.id = XIAllMasterDevices;
+    inputInfo.all_devices = &all_devices;
+    inputInfo.all_master_devices = &all_master_devices;
+    master.id = 2;
+    master.type = MASTER_POINTER;
+    slave.id = 6;
+    slave.type = SLAVE;
+
+    deliverycache_lists();
+    if (run_benchmarks)
+        deliverycache_benchmark();
+
+    inputInfo.all_devices = saved_all;
+    inputInfo.all_master_devices = saved_all_master;
+    return 0;
+}
@@ -26,6 +26,10 @@
 #endif
 
 #include <stdint.h>
+#if INPUTTHREAD
+#include <pthread.h>
+#include <sched.h>
+#endif
 #include <X11/X.h>
 #include "misc.h"
 #include "resource.h"
@@ -1841,6 +1845,219 @@ mieq_test(void)
     mieqFini();
 }
 
+/* Motion queued behind later motion from the same device is dropped, as
+ * long as nothing but raw events and other devices' motion is in between.
+ */
+static int mieq_coalesce_log[64];
+static int mieq_coalesce_nlog;
+
+static void
+mieq_coalesce_event_handler(int screenNum, InternalEvent *ie, DeviceIntPtr dev)
+{
+    assert(mieq_coalesce_nlog < ARRAY_SIZE(mieq_coalesce_log));
+    mieq_coalesce_log[mieq_coalesce_nlog++] = ie->any.type == ET_RawMotion ?
+        -(int) ie->raw_event.flags : ie->device_event.root_x;
+}
+
+static void
+mieq_coalesce_enqueue(DeviceIntPtr dev, enum EventType type, int n,
+                      int naxes)
+{
+    InternalEvent e = { 0 };
+    int i;
+
+    e.any.header = ET_Internal;
+    e.any.type = type;
+    e.any.time = GetTimeInMillis();
+    if (type == ET_RawMotion) {
+        e.any.length = sizeof(RawDeviceEvent);
+        e.raw_event.deviceid = dev->id;
+        e.raw_event.flags = n;
+    }
+    else {
+        e.any.length = sizeof(DeviceEvent);
+        e.device_event.deviceid = e.device_event.sourceid = dev->id;
+        e.device_event.root_x = n;
+        for (i = 0; i < naxes; i++)
+            SetBit(e.device_event.valuators.mask, i);
+    }
+    mieqEnqueue(dev, &e);
+}
+
+static void
+mieq_coalesce_check(const int *expected, int n)
+{
+    mieq_coalesce_nlog = 0;
+    mieqProcessInputEvents();
+    assert(mieq_coalesce_nlog == n);
+    assert(memcmp(mieq_coalesce_log, expected, n * sizeof(int)) == 0);
+}
+
+static void
+mieq_coalesce_test(void)
+{
+    static DeviceIntRec dev[2];
+    static SpriteInfoRec spriteInfo;
+    static SpriteRec sprite;
+    int i;
+
+    for (i = 0; i < ARRAY_SIZE(dev); i++) {
+        dev[i].id = 2 + i;
+        dev[i].enabled = 1;
+        dev[i].spriteInfo = &spriteInfo;
+    }
+    spriteInfo.sprite = &sprite;
+
+    mieqInit();
+    mieqSetHandler(ET_Motion, mieq_coalesce_event_handler);
+    mieqSetHandler(ET_RawMotion, mieq_coalesce_event_handler);
+    mieqSetHandler(ET_ButtonPress, mieq_coalesce_event_handler);
+
+    /* raw events all come out; motion only when nothing newer is queued,
+     * and the last event is never looked at */
+    for (i = 1; i <= 20; i++) {
+        mieq_coalesce_enqueue(&dev[0], ET_RawMotion, i, 2);
+        mieq_coalesce_enqueue(&dev[0], ET_Motion, i, 2);
+    }
+    {
+        int expected[22];
+
+        for (i = 1; i <= 19; i++)
+            expected[i - 1] = -i;
+        expected[19] = 19;
+        expected[20] = -20;
+        expected[21] = 20;
+        mieq_coalesce_check(expected, ARRAY_SIZE(expected));
+    }
+
+    /* other devices' motion in between doesn't stop it */
+    mieq_coalesce_enqueue(&dev[0], ET_Motion, 1, 2);
+    mieq_coalesce_enqueue(&dev[1], ET_Motion, 2, 2);
+    mieq_coalesce_enqueue(&dev[0], ET_Motion, 3, 2);
+    mieq_coalesce_enqueue(&dev[1], ET_Motion, 4, 2);
+    mieq_coalesce_enqueue(&dev[0], ET_RawMotion, 5, 2);
+    {
+        const int expected[] = { 3, 4, -5 };
+
+        mieq_coalesce_check(expected, ARRAY_SIZE(expected));
+    }
+
+    /* a button press in between, or different valuators, keep both */
+    mieq_coalesce_enqueue(&dev[0], ET_Motion, 1, 2);
+    mieq_coalesce_enqueue(&dev[0], ET_ButtonPress, 2, 2);
+    mieq_coalesce_enqueue(&dev[0], ET_Motion, 3, 2);
+    mieq_coalesce_enqueue(&dev[0], ET_RawMotion, 4, 2);
+    mieq_coalesce_enqueue(&dev[0], ET_Motion, 5, 3);
+    mieq_coalesce_enqueue(&dev[0], ET_RawMotion, 6, 2);
+    {
+        const int expected[] = { 1, 2, 3, -4, 5, -6 };
+
+        mieq_coalesce_check(expected, ARRAY_SIZE(expected));
+    }
+
+    mieqFini();
+}
+
+#if INPUTTHREAD
+/* Flood the queue from another thread, as the input thread does, while this
+ * thread takes events off it.  Motion superseded by later motion may go
+ * missing, but the raw events and the last motion have to come out, in
+ * order.
+ */
+#define MIEQ_FLOOD_EVENTS 200000
+#define MIEQ_FLOOD_LAG 3000
+
+static unsigned char mieq_flood_seen[MIEQ_FLOOD_EVENTS + 1];
+static uint32_t mieq_flood_last_processed;
+
+static Bool
+mieq_flood_is_motion(uint32_t i)
+{
+    return i % 8 < 5;
+}
+
+static void
+mieq_flood_event_handler(int screenNum, InternalEvent *ie, DeviceIntPtr dev)
+{
+    uint32_t flags = ie->any.type == ET_Motion ?
+        ie->device_event.valuators.data[0] : ie->raw_event.flags;
+
+    assert(ie->any.type == (mieq_flood_is_motion(flags) ? ET_Motion :
+                            ET_RawMotion));
+    assert(flags > mieq_flood_last_processed);
+    mieq_flood_seen[flags] = 1;
+    __atomic_store_n(&mieq_flood_last_processed, flags, __ATOMIC_RELEASE);
+}
+
+static void *
+mieq_flood_thread(void *arg)
+{
+    static DeviceIntRec dev;
+    static SpriteInfoRec spriteInfo;
+    static SpriteRec sprite;
+    uint32_t i;
+
+    dev.id = 2;
+    dev.enabled = 1;
+    dev.spriteInfo = &spriteInfo;
+    spriteInfo.sprite = &sprite;
+
+    for (i = 1; i <= MIEQ_FLOOD_EVENTS; i++) {
+        InternalEvent e = { 0 };
+
+        /* Let the queue grow, but not without bounds */
+        while (i - __atomic_load_n(&mieq_flood_last_processed,
+                                   __ATOMIC_ACQUIRE) > MIEQ_FLOOD_LAG)
+            sched_yield();
+
+        e.any.header = ET_Internal;
+        e.any.time = GetTimeInMillis();
+        if (mieq_flood_is_motion(i)) {
+            e.any.type = ET_Motion;
+            e.any.length = sizeof(DeviceEvent);
+            e.device_event.valuators.data[0] = i;
+        }
+        else {
+            e.any.type = ET_RawMotion;
+            e.any.length = sizeof(RawDeviceEvent);
+            e.raw_event.flags = i;
+        }
+
+        input_lock();
+        mieqEnqueue(&dev, &e);
+        input_unlock();
+    }
+    return NULL;
+}
+
+static void
+mieq_flood_test(void)
+{
+    pthread_t thread;
+    uint32_t i;
+
+    mieq_flood_last_processed = 0;
+    memset(mieq_flood_seen, 0, sizeof(mieq_flood_seen));
+    mieqInit();
+    mieqSetHandler(ET_Motion, mieq_flood_event_handler);
+    mieqSetHandler(ET_RawMotion, mieq_flood_event_handler);
+
+    assert(pthread_create(&thread, NULL, mieq_flood_thread, NULL) == 0);
+    while (__atomic_load_n(&mieq_flood_last_processed, __ATOMIC_ACQUIRE) <
+           MIEQ_FLOOD_EVENTS)
+        mieqProcessInputEvents();
+    pthread_join(thread, NULL);
+
+    for (i = 1; i <= MIEQ_FLOOD_EVENTS; i++)
+        if (i == MIEQ_FLOOD_EVENTS || !mieq_flood_is_motion(i))
+            assert(mieq_flood_seen[i]);
+
+    mieqSetHandler(ET_Motion, NULL);
+    mieqSetHandler(ET_RawMotion, NULL);
+    mieqFini();
+}
+#endif
+
 /* Simple check that we're replaying events in-order */
 static void
 process_input_proc(InternalEvent *ev, DeviceIntPtr device)
@@ -1927,6 +2144,10 @@ input_test(void)
     dix_get_master();
     input_option_test();
     mieq_test();
+    mieq_coalesce_test();
+#if INPUTTHREAD
+    mieq_flood_test();
+#endif
 
     return 0;
 }
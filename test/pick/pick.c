@@ -0,0 +1,302 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * The window under the pointer, through the server's own request paths.
+ * A parent with enough children for the pointer picking index is built,
+ * then its children are moved, resized, restacked, reparented, unmapped,
+ * mapped and destroyed with ordinary requests.  After each change the
+ * pointer is warped onto the spots that changed and QueryPointer has to
+ * name the child a walk of the client's copy of the tree finds, so a grid
+ * that a request path forgot to invalidate shows up as a stale answer.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <xcb/xcb.h>
+
+#define COLS 8
+#define ROWS 8
+#define PITCH 64
+#define SIZE 40
+#define MAX_CHILDREN (COLS * ROWS + 1)
+
+struct child {
+    xcb_window_t id;
+    int x, y, w, h, bw;         /* outer position, inside size */
+    int mapped;
+};
+
+static xcb_connection_t *c;
+static xcb_screen_t *screen;
+static xcb_window_t parent, holder;
+
+/* top of the stack first */
+static struct child children[MAX_CHILDREN];
+static int nchildren;
+
+static xcb_window_t
+window(xcb_window_t where, int x, int y, int w, int h, int bw)
+{
+    xcb_window_t win = xcb_generate_id(c);
+
+    xcb_create_window(c, XCB_COPY_FROM_PARENT, win, where, x, y, w, h, bw,
+                      XCB_WINDOW_CLASS_INPUT_OUTPUT, XCB_COPY_FROM_PARENT,
+                      XCB_CW_OVERRIDE_REDIRECT, (uint32_t[]) { 1 });
+    return win;
+}
+
+/* Moves children[i] to the top of the stack */
+static void
+raise_child(int i)
+{
+    struct child tmp = children[i];
+
+    for (; i > 0; i--)
+        children[i] = children[i - 1];
+    children[0] = tmp;
+}
+
+static void
+remove_child(int i)
+{
+    for (; i < nchildren - 1; i++)
+        children[i] = children[i + 1];
+    nchildren--;
+}
+
+static xcb_window_t
+expected(int x, int y)
+{
+    for (int i = 0; i < nchildren; i++) {
+        struct child *ch = &children[i];
+
+        if (ch->mapped &&
+            x >= ch->x && x < ch->x + ch->w + 2 * ch->bw &&
+            y >= ch->y && y < ch->y + ch->h + 2 * ch->bw)
+            return ch->id;
+    }
+    return XCB_NONE;
+}
+
+/*
+ * The parent sits at the root's origin, so its coordinates are the
+ * root's.  Warping off the parent first makes the server trace the
+ * pointer again even when it lands where it already was.
+ */
+static void
+check(const char *what, int x, int y)
+{
+    xcb_query_pointer_reply_t *reply;
+    xcb_window_t want = expected(x, y);
+
+    xcb_warp_pointer(c, XCB_NONE, screen->root, 0, 0, 0, 0,
+                     screen->width_in_pixels - 1,
+                     screen->height_in_pixels - 1);
+    xcb_warp_pointer(c, XCB_NONE, screen->root, 0, 0, 0, 0, x, y);
+    reply = xcb_query_pointer_reply(c, xcb_query_pointer(c, parent), NULL);
+    if (!reply) {
+        fprintf(stderr, "QueryPointer failed\n");
+        exit(1);
+    }
+    if (reply->child != want) {
+        fprintf(stderr, "%s: at %d,%d got 0x%x, expected 0x%x\n",
+                what, x, y, reply->child, want);
+        exit(1);
+    }
+    free(reply);
+}
+
+/* Checks the middle of a child's old and new extents */
+static void
+check_child(const char *what, struct child *old, struct child *new)
+{
+    check(what, old->x + old->w / 2 + old->bw, old->y + old->h / 2 + old->bw);
+    check(what, new->x + new->w / 2 + new->bw, new->y + new->h / 2 + new->bw);
+}
+
+static void
+configure(int i, uint16_t mask, const uint32_t *values)
+{
+    xcb_configure_window(c, children[i].id, mask, values);
+}
+
+static void
+test_move(void)
+{
+    int i = 5;
+    struct child old = children[i];
+
+    children[i].x += PITCH / 2;
+    children[i].y += PITCH / 2;
+    configure(i, XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y,
+              (uint32_t[]) { children[i].x, children[i].y });
+    check_child("move", &old, &children[i]);
+}
+
+static void
+test_resize(void)
+{
+    int i = nchildren - 1;
+    struct child old = children[i];
+
+    children[i].w = SIZE / 4;
+    children[i].h = SIZE / 4;
+    configure(i, XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT,
+              (uint32_t[]) { children[i].w, children[i].h });
+    check_child("resize", &old, &children[i]);
+
+    old = children[i];
+    children[i].bw = SIZE / 2;
+    configure(i, XCB_CONFIG_WINDOW_BORDER_WIDTH,
+              (uint32_t[]) { children[i].bw });
+    check_child("border", &old, &children[i]);
+}
+
+/* A window near the bottom is moved under another, then raised over it */
+static void
+test_restack(void)
+{
+    int i = nchildren - 2;
+    struct child *over = &children[0];
+    struct child old = children[i];
+
+    children[i].x = over->x + SIZE / 2;
+    children[i].y = over->y + SIZE / 2;
+    configure(i, XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y,
+              (uint32_t[]) { children[i].x, children[i].y });
+    check_child("move under", &old, &children[i]);
+    check("move under", children[i].x + 1, children[i].y + 1);
+
+    configure(i, XCB_CONFIG_WINDOW_STACK_MODE,
+              (uint32_t[]) { XCB_STACK_MODE_ABOVE });
+    raise_child(i);
+    check("raise", children[0].x + 1, children[0].y + 1);
+
+    i = 0;
+    configure(i, XCB_CONFIG_WINDOW_STACK_MODE,
+              (uint32_t[]) { XCB_STACK_MODE_BELOW });
+    old = children[i];
+    remove_child(i);
+    children[nchildren++] = old;
+    check("lower", old.x + 1, old.y + 1);
+}
+
+static void
+test_reparent(void)
+{
+    xcb_window_t in = window(holder, 0, 0, SIZE, SIZE, 0);
+    struct child *ch;
+    struct child old;
+    int i;
+
+    xcb_map_window(c, in);
+
+    /* in from another parent, at the top of the stack */
+    xcb_reparent_window(c, in, parent, PITCH * 3 + 8, PITCH * 3 + 8);
+    raise_child(nchildren++);
+    ch = &children[0];
+    *ch = (struct child) {
+        in, PITCH * 3 + 8, PITCH * 3 + 8, SIZE, SIZE, 0, 1
+    };
+    check("reparent in", ch->x + 1, ch->y + 1);
+
+    /* within the same parent, which moves it */
+    i = nchildren - 1;
+    old = children[i];
+    xcb_reparent_window(c, old.id, parent, PITCH / 2, PITCH / 2);
+    raise_child(i);
+    children[0].x = children[0].y = PITCH / 2;
+    check_child("reparent within", &old, &children[0]);
+
+    /* out again */
+    old = children[0];
+    xcb_reparent_window(c, old.id, holder, 0, 0);
+    remove_child(0);
+    check("reparent out", old.x + old.w / 2, old.y + old.h / 2);
+}
+
+static void
+test_map(void)
+{
+    struct child *ch = &children[COLS + 1];
+
+    xcb_unmap_window(c, ch->id);
+    ch->mapped = 0;
+    check("unmap", ch->x + 1, ch->y + 1);
+
+    xcb_map_window(c, ch->id);
+    ch->mapped = 1;
+    check("map", ch->x + 1, ch->y + 1);
+}
+
+static void
+test_destroy(void)
+{
+    struct child old = children[0];
+
+    xcb_destroy_window(c, old.id);
+    remove_child(0);
+    check("destroy", old.x + 1, old.y + 1);
+}
+
+int
+main(int argc, char **argv)
+{
+    c = xcb_connect(NULL, NULL);
+    if (xcb_connection_has_error(c)) {
+        fprintf(stderr, "Failed to connect to server\n");
+        return 1;
+    }
+    screen = xcb_setup_roots_iterator(xcb_get_setup(c)).data;
+
+    parent = window(screen->root, 0, 0, COLS * PITCH, ROWS * PITCH, 0);
+    holder = window(screen->root, COLS * PITCH, 0, PITCH, PITCH, 0);
+
+    /* created at the top of the stack, so the last one is children[0] */
+    for (int i = 0; i < COLS * ROWS; i++) {
+        struct child ch = {
+            .x = (i % COLS) * PITCH, .y = (i / COLS) * PITCH,
+            .w = SIZE, .h = SIZE, .mapped = 1,
+        };
+
+        ch.id = window(parent, ch.x, ch.y, ch.w, ch.h, 0);
+        children[nchildren++] = ch;
+        raise_child(nchildren - 1);
+    }
+    xcb_map_subwindows(c, parent);
+    xcb_map_window(c, parent);
+    xcb_map_window(c, holder);
+
+    /* walk past the first children so the parent gets indexed */
+    for (int i = 0; i < nchildren; i++)
+        check("initial", children[i].x + 1, children[i].y + 1);
+
+    test_move();
+    test_resize();
+    test_restack();
+    test_reparent();
+    test_map();
+    test_destroy();
+
+    xcb_disconnect(c);
+    return 0;
+}
@@ -0,0 +1,181 @@
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <stdio.h>
+#include <time.h>
+#include <X11/Xatom.h>
+#include "misc.h"
+#include "dix.h"
+#include "dixstruct.h"
+#include "windowstr.h"
+#include "propertyst.h"
+#include "property.h"
+
+#include "tests-common.h"
+
+/* Unit tests and a lookup benchmark for window properties, dix/property.c */
+
+static ClientRec test_client;
+
+static WindowPtr
+property_window(void)
+{
+    WindowPtr pWin = calloc(1, sizeof(WindowRec));
+
+    assert(pWin);
+    pWin->optional = calloc(1, sizeof(WindowOptRec));
+    assert(pWin->optional);
+    return pWin;
+}
+
+static void
+property_window_free(WindowPtr pWin)
+{
+    DeleteAllWindowProperties(pWin);
+    free(pWin->optional);
+    free(pWin);
+}
+
+static void
+property_set(WindowPtr pWin, Atom name, CARD32 value)
+{
+    assert(dixChangeWindowProperty(&test_client, pWin, name, XA_INTEGER, 32,
+                                   PropModeReplace, 1, &value,
+                                   FALSE) == Success);
+}
+
+static Bool
+property_get(WindowPtr pWin, Atom name, CARD32 *value)
+{
+    PropertyPtr pProp;
+
+    if (dixLookupProperty(&pProp, pWin, name, &test_client,
+                          DixReadAccess) != Success)
+        return FALSE;
+    assert(pProp->propertyName == name);
+    *value = *(CARD32 *) pProp->data;
+    return TRUE;
+}
+
+/* Properties are listed newest first; check the list against that */
+static void
+property_check_order(WindowPtr pWin, int n, int step)
+{
+    PropertyPtr pProp = wUserProps(pWin);
+    int i;
+
+    for (i = n; i > 0; i--) {
+        if (step && i % step == 0)
+            continue;
+        assert(pProp);
+        assert(pProp->propertyName == i);
+        pProp = pProp->next;
+    }
+    assert(!pProp);
+}
+
+static void
+property_add_lookup_delete(void)
+{
+    const int n = 1000;
+    WindowPtr pWin = property_window();
+    CARD32 value;
+    int i;
+
+    for (i = 1; i <= n; i++) {
+        property_set(pWin, i, i);
+        /* earlier properties stay reachable as the index is built and grows */
+        assert(property_get(pWin, 1, &value) && value == 1);
+        assert(property_get(pWin, i / 2 + 1, &value) && value == i / 2 + 1);
+    }
+    property_check_order(pWin, n, 0);
+
+    /* replacing a value leaves the property where it was in the list */
+    for (i = 1; i <= n; i++)
+        property_set(pWin, i, i * 2);
+    property_check_order(pWin, n, 0);
+    for (i = 1; i <= n; i++)
+        assert(property_get(pWin, i, &value) && value == i * 2);
+    assert(!property_get(pWin, n + 1, &value));
+
+    for (i = 3; i <= n; i += 3)
+        assert(DeleteProperty(&test_client, pWin, i) == Success);
+    property_check_order(pWin, n, 3);
+    for (i = 1; i <= n; i++)
+        assert(property_get(pWin, i, &value) == (i % 3 != 0));
+
+    /* deleting something that isn't there is not an error */
+    assert(DeleteProperty(&test_client, pWin, 3) == Success);
+
+    /* delete and re-add many times, so deleted slots get reused */
+    for (i = 0; i < 10 * n; i++) {
+        Atom name = (i % 333 + 1) * 3;
+
+        property_set(pWin, name, i);
+        assert(property_get(pWin, name, &value) && value == i);
+        assert(DeleteProperty(&test_client, pWin, name) == Success);
+        assert(!property_get(pWin, name, &value));
+    }
+    property_check_order(pWin, n, 3);
+
+    for (i = 1; i <= n; i++)
+        if (i % 3)
+            assert(DeleteProperty(&test_client, pWin, i) == Success);
+    assert(!wUserProps(pWin));
+    assert(!pWin->optional->propIndex);
+
+    /* and back up again on the same window */
+    for (i = 1; i <= n; i++)
+        property_set(pWin, i, i);
+    for (i = 1; i <= n; i++)
+        assert(property_get(pWin, i, &value) && value == i);
+    property_check_order(pWin, n, 0);
+
+    property_window_free(pWin);
+}
+
+static void
+property_benchmark(void)
+{
+    static const int sizes[] = { 4, 32, 1000 };
+    const int iterations = 1000000;
+    struct timespec start;
+    double lookup, change;
+    CARD32 value;
+    int s, i, n;
+
+    printf("%10s %14s %14s\n", "properties", "lookup ns/op", "replace ns/op");
+    for (s = 0; s < ARRAY_SIZE(sizes); s++) {
+        WindowPtr pWin = property_window();
+
+        n = sizes[s];
+        for (i = 1; i <= n; i++)
+            property_set(pWin, i, i);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (i = 0; i < iterations; i++)
+            property_get(pWin, (int) (((long) i * 7919) % n) + 1, &value);
+        lookup = test_elapsed_ns(&start) / iterations;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (i = 0; i < iterations / 10; i++)
+            property_set(pWin, (int) (((long) i * 7919) % n) + 1, i);
+        change = test_elapsed_ns(&start) / (iterations / 10);
+
+        printf("%10d %14.1f %14.1f\n", n, lookup, change);
+        property_window_free(pWin);
+    }
+}
+
+int
+property_test(void)
+{
+    test_client.index = 1;
+
+    property_add_lookup_delete();
+    if (run_benchmarks)
+        property_benchmark();
+
+    return 0;
+}
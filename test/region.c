@@ -0,0 +1,345 @@
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "misc.h"
+#include "regionstr.h"
+#include "gc.h"
+
+#include "tests-common.h"
+
+/*
+ * Equivalence tests and benchmarks for the box kernels in dix/region.c:
+ * every kernel level has to build exactly the region the plain C code does,
+ * and that has to be the region pixman builds from the same rectangles.
+ * Also tests and benchmarks for the region data pool.
+ */
+
+static int
+region_random(int n)
+{
+    return random() % n;
+}
+
+/* Damage-like boxes: anywhere, any size, overlapping */
+static void
+region_rects_scattered(xRectangle *rects, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++) {
+        rects[i].x = region_random(2000) - 100;
+        rects[i].y = region_random(2000) - 100;
+        rects[i].width = region_random(200);
+        rects[i].height = region_random(200);
+    }
+}
+
+/*
+ * Terminal-like boxes: runs of cells on a grid, repeated over several
+ * rows, so that bands coalesce.  Some cells are dropped to make bands
+ * that almost but don't quite match.
+ */
+static void
+region_rects_grid(xRectangle *rects, int n)
+{
+    int cols = 4 + region_random(40), rows = 1 + region_random(8);
+    int i;
+
+    for (i = 0; i < n; i++) {
+        int cell = region_random(cols * 2);
+        int row = region_random(rows);
+
+        rects[i].x = cell * 10;
+        rects[i].width = (cell & 1) || region_random(20) == 0 ? 10 : 6;
+        rects[i].y = row * 16;
+        rects[i].height = 16;
+    }
+}
+
+static void
+region_check_equal(RegionPtr a, RegionPtr b)
+{
+    assert(RegionNumRects(a) == RegionNumRects(b));
+    assert(memcmp(RegionExtents(a), RegionExtents(b), sizeof(BoxRec)) == 0);
+    assert(memcmp(RegionRects(a), RegionRects(b),
+                  RegionNumRects(a) * sizeof(BoxRec)) == 0);
+}
+
+static void
+region_check_level(int level, xRectangle *rects, int n, RegionPtr ref)
+{
+    RegionPtr reg, banded;
+    xRectangle *out;
+    BoxPtr box;
+    int i, nbox;
+
+    assert(RegionSetSimdLevel(level) == level);
+
+    reg = RegionFromRects(n, rects, CT_UNSORTED);
+    region_check_equal(reg, ref);
+
+    /* and from an already banded list, which only computes the extents */
+    nbox = RegionNumRects(reg);
+    box = RegionRects(reg);
+    out = calloc(nbox + 1, sizeof(xRectangle));
+    for (i = 0; i < nbox; i++) {
+        out[i].x = box[i].x1;
+        out[i].y = box[i].y1;
+        out[i].width = box[i].x2 - box[i].x1;
+        out[i].height = box[i].y2 - box[i].y1;
+    }
+    banded = RegionFromRects(nbox, out, CT_YXBANDED);
+    region_check_equal(banded, ref);
+
+    RegionDestroy(banded);
+    RegionDestroy(reg);
+    free(out);
+}
+
+static void
+region_equivalence(void)
+{
+    static const int sizes[] = { 2, 3, 5, 8, 17, 64, 300, 2000 };
+    int best = RegionSetSimdLevel(-1);
+    int s, iter, level, i;
+
+    for (s = 0; s < ARRAY_SIZE(sizes); s++) {
+        int n = sizes[s];
+        xRectangle *rects = calloc(n, sizeof(xRectangle));
+
+        for (iter = 0; iter < 200; iter++) {
+            RegionPtr ref;
+            RegionRec pix;
+            BoxPtr boxes = calloc(n, sizeof(BoxRec));
+            int nbox = 0;
+
+            if (iter & 1)
+                region_rects_grid(rects, n);
+            else
+                region_rects_scattered(rects, n);
+
+            RegionSetSimdLevel(0);
+            ref = RegionFromRects(n, rects, CT_UNSORTED);
+
+            /* the plain C code against pixman */
+            for (i = 0; i < n; i++) {
+                if (!rects[i].width || !rects[i].height)
+                    continue;
+                boxes[nbox].x1 = rects[i].x;
+                boxes[nbox].y1 = rects[i].y;
+                boxes[nbox].x2 = rects[i].x + rects[i].width;
+                boxes[nbox].y2 = rects[i].y + rects[i].height;
+                nbox++;
+            }
+            assert(pixman_region_init_rects(&pix, boxes, nbox));
+            assert(RegionEqual(ref, &pix));
+            pixman_region_fini(&pix);
+
+            for (level = 0; level <= best; level++)
+                region_check_level(level, rects, n, ref);
+
+            RegionDestroy(ref);
+            free(boxes);
+        }
+        free(rects);
+    }
+    RegionSetSimdLevel(-1);
+}
+
+/* RegionAppend followed by RegionValidate, as miValidateTree does */
+static void
+region_append_validate(void)
+{
+    int best = RegionSetSimdLevel(-1);
+    int iter, level, i;
+
+    for (iter = 0; iter < 200; iter++) {
+        xRectangle rects[16];
+        RegionRec reg[ARRAY_SIZE(rects)], ref;
+        Bool overlap;
+
+        region_rects_grid(rects, ARRAY_SIZE(rects));
+        for (level = 0; level <= best; level++) {
+            RegionRec acc;
+
+            RegionSetSimdLevel(level);
+            RegionNull(&acc);
+            for (i = 0; i < ARRAY_SIZE(rects); i++) {
+                BoxRec box = {
+                    rects[i].x, rects[i].y,
+                    rects[i].x + rects[i].width, rects[i].y + rects[i].height
+                };
+
+                RegionInit(&reg[i], &box, 1);
+                assert(RegionAppend(&acc, &reg[i]));
+                RegionUninit(&reg[i]);
+            }
+            assert(RegionValidate(&acc, &overlap));
+
+            if (level == 0) {
+                ref = acc;
+                continue;
+            }
+            region_check_equal(&acc, &ref);
+            RegionUninit(&acc);
+        }
+        RegionUninit(&ref);
+    }
+    RegionSetSimdLevel(-1);
+}
+
+static void
+region_pool(void)
+{
+    RegionPoolStatsRec before;
+    xRectangle rects[300];
+    RegionPtr reg;
+    RegionRec acc, one;
+    Bool overlap;
+    int i, iter;
+
+    /* the same frame over and over hardly mallocs after the first time */
+    region_rects_scattered(rects, ARRAY_SIZE(rects));
+    RegionDestroy(RegionFromRects(ARRAY_SIZE(rects), rects, CT_UNSORTED));
+    before = RegionPoolStats;
+    for (iter = 0; iter < 100; iter++)
+        RegionDestroy(RegionFromRects(ARRAY_SIZE(rects), rects, CT_UNSORTED));
+    assert(RegionPoolStats.allocs > before.allocs);
+    assert((RegionPoolStats.hits - before.hits) * 10 >=
+           (RegionPoolStats.allocs - before.allocs) * 9);
+
+
+    /* growing through the size classes keeps the boxes */
+    RegionNull(&acc);
+    for (i = 0; i < 2000; i++) {
+        BoxRec box = { i * 2, 0, i * 2 + 1, 1 };
+
+        RegionInit(&one, &box, 1);
+        assert(RegionAppend(&acc, &one));
+        RegionUninit(&one);
+        assert(RegionNumRects(&acc) == i + 1);
+        assert(RegionRects(&acc)[i / 2].x1 == (i / 2) * 2);
+        assert(RegionRects(&acc)[i].x1 == i * 2);
+    }
+    assert(RegionValidate(&acc, &overlap) && !overlap);
+    assert(RegionNumRects(&acc) == 2000);
+    RegionUninit(&acc);
+
+    /* data bigger than the largest class comes and goes through malloc */
+    reg = RegionCreate(NULL, 5000);
+    assert(RegionSize(reg) >= 5000);
+    before = RegionPoolStats;
+    RegionDestroy(reg);
+    assert(RegionPoolStats.frees == before.frees + 1);
+    assert(RegionPoolStats.pooled == before.pooled);
+
+    /* while other threads use regions, the pool stays out of it */
+    RegionPoolThreads = 1;
+    before = RegionPoolStats;
+    RegionDestroy(RegionFromRects(ARRAY_SIZE(rects), rects, CT_UNSORTED));
+    assert(memcmp(&before, &RegionPoolStats, sizeof(before)) == 0);
+    RegionPoolThreads = 0;
+}
+
+/*
+ * A frame of terminal damage: full rows of 80 cells, each row of cells
+ * becoming one band that coalesces with the rows above it, both unsorted
+ * and already banded; and a frame of scattered browser-tile damage.
+ */
+static void
+region_benchmark(void)
+{
+    const int n = 4000, iterations = 200;
+    int best = RegionSetSimdLevel(-1);
+    xRectangle *terminal = calloc(n, sizeof(xRectangle));
+    xRectangle *tiles = calloc(n, sizeof(xRectangle));
+    struct timespec start;
+    double t[3];
+    int level, i, j;
+
+    for (i = 0; i < n; i++) {
+        terminal[i].x = (i % 80) * 16;
+        terminal[i].y = (i / 80) * 18;
+        terminal[i].width = 8 + (i & 1) * 2;
+        terminal[i].height = 18;
+    }
+    region_rects_scattered(tiles, n);
+
+    printf("%6s %18s %18s %18s\n", "level", "terminal us/frame",
+           "banded us/frame", "tiles us/frame");
+    for (level = 0; level <= best; level++) {
+        RegionSetSimdLevel(level);
+        for (j = 0; j < 3; j++) {
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            for (i = 0; i < iterations; i++)
+                RegionDestroy(RegionFromRects(n, j == 2 ? tiles : terminal,
+                                              j == 1 ? CT_YXBANDED :
+                                              CT_UNSORTED));
+            t[j] = test_elapsed_ns(&start) / iterations;
+        }
+        printf("%6d %18.1f %18.1f %18.1f\n", level,
+               t[0] / 1000, t[1] / 1000, t[2] / 1000);
+    }
+    RegionSetSimdLevel(-1);
+    free(terminal);
+    free(tiles);
+}
+
+/*
+ * The short-lived regions of a frame: scratch regions of a few boxes that
+ * grow a bit, as in clip and damage computation, with and without the pool.
+ */
+static void
+region_pool_benchmark(void)
+{
+    const int iterations = 1000000;
+    struct timespec start;
+    RegionPoolStatsRec before;
+    unsigned long hits = 0, allocs = 0;
+    double t[2];
+    int i, j, pooled;
+
+    for (pooled = 1; pooled >= 0; pooled--) {
+        RegionPoolThreads = !pooled;
+        before = RegionPoolStats;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (i = 0; i < iterations; i++) {
+            RegionRec reg[4];
+
+            for (j = 0; j < ARRAY_SIZE(reg); j++)
+                RegionInit(&reg[j], NULL, 8 << j);
+            assert(RegionRectAlloc(&reg[0], 20));
+            for (j = 0; j < ARRAY_SIZE(reg); j++)
+                RegionUninit(&reg[j]);
+        }
+        t[pooled] = test_elapsed_ns(&start) / iterations;
+        if (pooled) {
+            hits = RegionPoolStats.hits - before.hits;
+            allocs = RegionPoolStats.allocs - before.allocs;
+        }
+    }
+    RegionPoolThreads = 0;
+    printf("scratch regions: %.1f ns/frame pooled, %.1f ns/frame malloc; "
+           "%lu of %lu allocations from the pool\n", t[1], t[0], hits, allocs);
+}
+
+int
+region_test(void)
+{
+    InitRegions();
+
+    region_equivalence();
+    region_append_validate();
+    region_pool();
+    if (run_benchmarks) {
+        region_benchmark();
+        region_pool_benchmark();
+    }
+
+    return 0;
+}
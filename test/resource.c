@@ -0,0 +1,248 @@
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include "misc.h"
+#include "dix.h"
+#include "dixstruct.h"
+#include "opaque.h"
+#include "resource.h"
+
+#include "tests-common.h"
+
+/* Unit tests and a small add/lookup/free benchmark for dix/resource.c */
+
+static ClientRec server_client;
+static ClientRec test_client;
+static RESTYPE test_type, other_type;
+static int deleted;
+
+static int
+test_delete(void *value, XID id)
+{
+    deleted++;
+    return Success;
+}
+
+static XID
+test_id(int i)
+{
+    return test_client.clientAsMask | i;
+}
+
+static void
+resource_init(void)
+{
+    serverClient = &server_client;
+    server_client.index = 0;
+    assert(InitClientResources(serverClient));
+
+    test_client.index = 1;
+    test_client.clientAsMask = (XID) 1 << CLIENTOFFSET;
+    assert(InitClientResources(&test_client));
+
+    test_type = CreateNewResourceType(test_delete, "TEST");
+    other_type = CreateNewResourceType(test_delete, "OTHER");
+    assert(test_type && other_type);
+}
+
+static void
+resource_fini(void)
+{
+    FreeClientResources(&test_client);
+    deleted = 0;
+    assert(InitClientResources(&test_client));
+}
+
+static void
+resource_add_lookup_free(void)
+{
+    const int n = 50000;
+    void *val;
+    int i;
+
+    for (i = 0; i < n; i++) {
+        assert(AddResource(test_id(i), test_type, (void *) (intptr_t) i));
+        /* earlier entries stay reachable while the table grows */
+        if ((i & 1023) == 0)
+            assert(dixLookupResourceByType(&val, test_id(i / 2), test_type,
+                                           NULL, DixReadAccess) == Success);
+    }
+
+    for (i = 0; i < n; i++) {
+        assert(dixLookupResourceByType(&val, test_id(i), test_type,
+                                       NULL, DixReadAccess) == Success);
+        assert(val == (void *) (intptr_t) i);
+        assert(dixLookupResourceByType(&val, test_id(i), other_type,
+                                       NULL, DixReadAccess) != Success);
+    }
+
+    for (i = 0; i < n; i += 2)
+        FreeResource(test_id(i), RT_NONE);
+    assert(deleted == n / 2);
+
+    for (i = 0; i < n; i++) {
+        int rc = dixLookupResourceByClass(&val, test_id(i), RC_ANY,
+                                          NULL, DixReadAccess);
+        assert((i & 1) ? rc == Success : rc == BadValue);
+    }
+
+    /* re-adding over tombstones */
+    for (i = 0; i < n; i += 2)
+        assert(AddResource(test_id(i), test_type, (void *) (intptr_t) i));
+
+    resource_fini();
+}
+
+static void
+resource_shared_id(void)
+{
+    void *val;
+
+    assert(AddResource(test_id(1), test_type, &test_type));
+    assert(AddResource(test_id(1), other_type, &other_type));
+
+    assert(dixLookupResourceByType(&val, test_id(1), test_type,
+                                   NULL, DixReadAccess) == Success);
+    assert(val == &test_type);
+    assert(dixLookupResourceByType(&val, test_id(1), other_type,
+                                   NULL, DixReadAccess) == Success);
+    assert(val == &other_type);
+
+    assert(ChangeResourceValue(test_id(1), test_type, &deleted));
+    assert(dixLookupResourceByType(&val, test_id(1), test_type,
+                                   NULL, DixReadAccess) == Success);
+    assert(val == &deleted);
+
+    FreeResourceByType(test_id(1), test_type, TRUE);
+    assert(deleted == 0);
+    assert(dixLookupResourceByType(&val, test_id(1), test_type,
+                                   NULL, DixReadAccess) != Success);
+    assert(dixLookupResourceByType(&val, test_id(1), other_type,
+                                   NULL, DixReadAccess) == Success);
+
+    assert(AddResource(test_id(1), test_type, &test_type));
+    FreeResource(test_id(1), RT_NONE);
+    assert(deleted == 2);
+    assert(dixLookupResourceByClass(&val, test_id(1), RC_ANY,
+                                    NULL, DixReadAccess) == BadValue);
+
+    resource_fini();
+}
+
+static int visited;
+
+static void
+count_resource(void *value, XID id, void *cdata)
+{
+    visited++;
+}
+
+static void
+free_resource(void *value, XID id, void *cdata)
+{
+    visited++;
+    FreeResource(id, RT_NONE);
+}
+
+static void
+add_resource(void *value, XID id, void *cdata)
+{
+    int *next = cdata;
+
+    visited++;
+    if (*next < 20000)
+        AddResource(test_id((*next)++), other_type, NULL);
+}
+
+static void
+resource_iterate(void)
+{
+    const int n = 10000;
+    int i, next;
+
+    for (i = 0; i < n; i++) {
+        assert(AddResource(test_id(i), test_type, NULL));
+        if (i % 3 == 0)
+            assert(AddResource(test_id(i), other_type, NULL));
+    }
+
+    visited = 0;
+    FindClientResourcesByType(&test_client, test_type, count_resource, NULL);
+    assert(visited == n);
+
+    visited = 0;
+    FindClientResourcesByType(&test_client, 0, count_resource, NULL);
+    assert(visited == n + (n + 2) / 3);
+
+    /* every resource is seen even if the table grows underneath us */
+    next = n;
+    visited = 0;
+    FindClientResourcesByType(&test_client, test_type, add_resource, &next);
+    assert(visited >= n);
+
+    visited = 0;
+    FindClientResourcesByType(&test_client, test_type, free_resource, NULL);
+    assert(visited >= n);
+
+    visited = 0;
+    FindClientResourcesByType(&test_client, test_type, count_resource, NULL);
+    assert(visited == 0);
+
+    FreeClientResources(&test_client);
+    assert(deleted == n + (n + 2) / 3 + (next - n));
+    deleted = 0;
+    assert(InitClientResources(&test_client));
+}
+
+static void
+resource_benchmark(void)
+{
+    static const int sizes[] = { 1000, 10000, 100000, 1000000 };
+    struct timespec start;
+    double add, lookup, del;
+    void *val;
+    int s, i, n;
+
+    printf("%10s %12s %12s %12s\n", "resources", "add ns/op",
+           "lookup ns/op", "free ns/op");
+    for (s = 0; s < ARRAY_SIZE(sizes); s++) {
+        n = sizes[s];
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (i = 0; i < n; i++)
+            AddResource(test_id(i), test_type, NULL);
+        add = test_elapsed_ns(&start) / n;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (i = 0; i < n; i++)
+            dixLookupResourceByType(&val, test_id((int) (((long) i * 7919) % n)), test_type,
+                                    NULL, DixReadAccess);
+        lookup = test_elapsed_ns(&start) / n;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (i = 0; i < n; i++)
+            FreeResource(test_id(i), RT_NONE);
+        del = test_elapsed_ns(&start) / n;
+
+        printf("%10d %12.1f %12.1f %12.1f\n", n, add, lookup, del);
+        resource_fini();
+    }
+}
+
+int
+resource_test(void)
+{
+    resource_init();
+
+    resource_add_lookup_free();
+    resource_shared_id();
+    resource_iterate();
+    if (run_benchmarks)
+        resource_benchmark();
+
+    return 0;
+}
@@ -6,6 +6,17 @@
 
 #include "tests-common.h"
 
+int run_benchmarks;
+
+double
+test_elapsed_ns(struct timespec *start)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1e9 + (now.tv_nsec - start->tv_nsec);
+}
+
 void
 run_test_in_child(int (*func)(void), const char *funcname)
 {
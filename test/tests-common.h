@@ -1,6 +1,8 @@
 #ifndef TESTS_COMMON_H
 #define TESTS_COMMON_H
 
+#include <time.h>
+
 #include "tests.h"
 
 #define ARRAY_SIZE(a)  (sizeof((a)) / sizeof((a)[0]))
@@ -9,4 +11,10 @@
 
 void run_test_in_child(int (*func)(void), const char *funcname);
 
+/* set by "tests --benchmark"; the timing loops only run when asked for */
+extern int run_benchmarks;
+
+/* nanoseconds since start, from CLOCK_MONOTONIC */
+double test_elapsed_ns(struct timespec *start);
+
 #endif /* TESTS_COMMON_H */
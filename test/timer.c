@@ -0,0 +1,171 @@
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "misc.h"
+#include "os.h"
+
+#include "tests-common.h"
+
+/* Stress test for the OsTimer heap in os/WaitFor.c: 100k timers set,
+ * cancelled and re-set, checking that every live timer fires exactly
+ * once, not early, and in expiry order. */
+
+#define NTIMERS 100000
+#define SPREAD  64              /* ms */
+
+typedef struct {
+    OsTimerPtr timer;
+    CARD32 expires;
+    int order;                  /* when it was last set */
+    int fired;
+    Bool live;
+} TimerInfo;
+
+static TimerInfo info[NTIMERS];
+static CARD32 last_expires;
+static int last_order;
+static int fired;
+
+static CARD32
+timer_callback(OsTimerPtr timer, CARD32 now, void *arg)
+{
+    TimerInfo *t = arg;
+
+    assert(t->timer == timer);
+    assert(t->live);
+    assert((int) (now - t->expires) >= 0);
+    /* expiry order, ties in the order they were set */
+    assert((int) (t->expires - last_expires) >= 0);
+    assert(t->expires != last_expires || t->order > last_order);
+
+    last_expires = t->expires;
+    last_order = t->order;
+    t->fired++;
+    fired++;
+    return 0;
+}
+
+static int repeats;
+
+static CARD32
+repeat_callback(OsTimerPtr timer, CARD32 now, void *arg)
+{
+    return ++repeats < 5 ? 1 : 0;
+}
+
+static void
+wait_for_timers(int expected)
+{
+    CARD32 start = GetTimeInMillis();
+
+    while (fired < expected) {
+        struct timespec ts = { 0, 500000 };
+
+        TimerCheck();
+        nanosleep(&ts, NULL);
+        assert(GetTimeInMillis() - start < 10000);
+    }
+}
+
+static void
+timer_stress(void)
+{
+    struct timespec start;
+    double set, cancel;
+    CARD32 base;
+    int i, order = 0, live = 0;
+
+    srand(0x7133);
+    for (i = 0; i < NTIMERS; i++) {
+        info[i].timer = TimerSet(NULL, 0, 0, NULL, NULL);
+        assert(info[i].timer);
+    }
+
+    /* far enough out that nothing fires before we are done setting up */
+    base = GetTimeInMillis() + 500;
+    last_expires = base;
+    last_order = -1;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < NTIMERS; i++) {
+        TimerInfo *t = &info[i];
+
+        t->expires = base + rand() % SPREAD;
+        t->order = order++;
+        t->live = TRUE;
+        TimerSet(t->timer, TimerAbsolute, t->expires, timer_callback, t);
+    }
+    set = test_elapsed_ns(&start) / NTIMERS;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < NTIMERS; i += 3) {
+        TimerCancel(info[i].timer);
+        info[i].live = FALSE;
+    }
+    cancel = test_elapsed_ns(&start) / ((NTIMERS + 2) / 3);
+
+    /* re-set some, both cancelled and pending ones */
+    for (i = 0; i < NTIMERS; i += 5) {
+        TimerInfo *t = &info[i];
+
+        t->expires = base + rand() % SPREAD;
+        t->order = order++;
+        t->live = TRUE;
+        assert(TimerSet(t->timer, TimerAbsolute, t->expires,
+                        timer_callback, t) == t->timer);
+    }
+
+    for (i = 0; i < NTIMERS; i++)
+        live += info[i].live;
+
+    wait_for_timers(live);
+
+    for (i = 0; i < NTIMERS; i++) {
+        assert(info[i].fired == (info[i].live ? 1 : 0));
+        /* nothing left pending */
+        assert(!TimerForce(info[i].timer));
+        TimerFree(info[i].timer);
+    }
+
+    if (run_benchmarks)
+        printf("%d timers: set %.1f ns/op, cancel %.1f ns/op\n",
+               NTIMERS, set, cancel);
+}
+
+static void
+timer_repeat(void)
+{
+    OsTimerPtr timer;
+    CARD32 start = GetTimeInMillis();
+
+    timer = TimerSet(NULL, 0, 1, repeat_callback, NULL);
+    while (repeats < 5) {
+        TimerCheck();
+        assert(GetTimeInMillis() - start < 10000);
+    }
+    assert(!TimerForce(timer));
+
+    /* TimerForce runs a pending timer right away */
+    repeats = 4;
+    TimerSet(timer, 0, 100000, repeat_callback, NULL);
+    assert(TimerForce(timer));
+    assert(repeats == 5);
+    assert(!TimerForce(timer));
+    TimerFree(timer);
+}
+
+int
+timer_test(void)
+{
+    TimerInit();
+
+    timer_repeat();
+    timer_stress();
+
+    return 0;
+}
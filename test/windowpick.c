@@ -0,0 +1,297 @@
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "misc.h"
+#include "windowstr.h"
+#include "inputstr.h"
+#include "mi.h"
+
+#include "tests-common.h"
+
+/*
+ * Tests and a benchmark for the pointer picking index, dix/windowpick.c:
+ * miSpriteTrace has to find the same window with the index as a plain walk
+ * of the tree does, before and after windows move, restack and go away.
+ * The helpers here link windows and invalidate by hand; test/pick makes
+ * the same changes through the server's request paths under Xvfb.
+ */
+
+static SpriteRec sprite;
+
+static WindowPtr
+windowpick_window(WindowPtr pParent, int x, int y, int w, int h, int bw)
+{
+    WindowPtr pWin = calloc(1, sizeof(WindowRec));
+
+    assert(pWin);
+    pWin->optional = calloc(1, sizeof(WindowOptRec));
+    assert(pWin->optional);
+    pWin->borderWidth = bw;
+    pWin->drawable.width = w;
+    pWin->drawable.height = h;
+    pWin->mapped = TRUE;
+
+    if (pParent) {
+        pWin->parent = pParent;
+        pWin->origin.x = x + bw;
+        pWin->origin.y = y + bw;
+        pWin->drawable.x = pParent->drawable.x + pWin->origin.x;
+        pWin->drawable.y = pParent->drawable.y + pWin->origin.y;
+        /* at the bottom of the stack */
+        pWin->prevSib = pParent->lastChild;
+        if (pParent->lastChild)
+            pParent->lastChild->nextSib = pWin;
+        else
+            pParent->firstChild = pWin;
+        pParent->lastChild = pWin;
+        WindowPickInvalidate(pParent);
+    }
+    return pWin;
+}
+
+static void
+windowpick_unlink(WindowPtr pWin)
+{
+    WindowPtr pParent = pWin->parent;
+
+    if (pParent->firstChild == pWin)
+        pParent->firstChild = pWin->nextSib;
+    if (pParent->lastChild == pWin)
+        pParent->lastChild = pWin->prevSib;
+    if (pWin->nextSib)
+        pWin->nextSib->prevSib = pWin->prevSib;
+    if (pWin->prevSib)
+        pWin->prevSib->nextSib = pWin->nextSib;
+    pWin->nextSib = pWin->prevSib = NULL;
+    WindowPickInvalidate(pParent);
+}
+
+static void
+windowpick_free(WindowPtr pWin)
+{
+    while (pWin->firstChild) {
+        WindowPtr pChild = pWin->firstChild;
+
+        windowpick_unlink(pChild);
+        windowpick_free(pChild);
+    }
+    WindowPickFree(pWin);
+    free(pWin->optional);
+    free(pWin);
+}
+
+static void
+windowpick_raise(WindowPtr pWin)
+{
+    WindowPtr pParent = pWin->parent;
+
+    windowpick_unlink(pWin);
+    pWin->nextSib = pParent->firstChild;
+    if (pParent->firstChild)
+        pParent->firstChild->prevSib = pWin;
+    else
+        pParent->lastChild = pWin;
+    pParent->firstChild = pWin;
+}
+
+static void
+windowpick_offset(WindowPtr pWin, int dx, int dy)
+{
+    WindowPtr pChild;
+
+    pWin->drawable.x += dx;
+    pWin->drawable.y += dy;
+    for (pChild = pWin->firstChild; pChild; pChild = pChild->nextSib)
+        windowpick_offset(pChild, dx, dy);
+}
+
+static void
+windowpick_move(WindowPtr pWin, int dx, int dy)
+{
+    pWin->origin.x += dx;
+    pWin->origin.y += dy;
+    windowpick_offset(pWin, dx, dy);
+    WindowPickInvalidate(pWin->parent);
+}
+
+/* What miSpriteTrace found before there was an index */
+static WindowPtr
+windowpick_walk(WindowPtr pParent, int x, int y)
+{
+    WindowPtr pWin = pParent->firstChild;
+
+    while (pWin) {
+        if (pWin->mapped &&
+            x >= pWin->drawable.x - (int) pWin->borderWidth &&
+            x < pWin->drawable.x + pWin->drawable.width + pWin->borderWidth &&
+            y >= pWin->drawable.y - (int) pWin->borderWidth &&
+            y < pWin->drawable.y + pWin->drawable.height + pWin->borderWidth)
+        {
+            pParent = pWin;
+            pWin = pWin->firstChild;
+        }
+        else
+            pWin = pWin->nextSib;
+    }
+    return pParent;
+}
+
+static WindowPtr
+windowpick_trace(WindowPtr pRoot, int x, int y)
+{
+    sprite.spriteTrace[0] = pRoot;
+    sprite.spriteTraceGood = 1;
+    return miSpriteTrace(&sprite, x, y);
+}
+
+static void
+windowpick_check(WindowPtr pRoot, int npoints)
+{
+    int i;
+
+    for (i = 0; i < npoints; i++) {
+        int x = random() % 2400 - 200, y = random() % 2400 - 200;
+
+        assert(windowpick_trace(pRoot, x, y) == windowpick_walk(pRoot, x, y));
+    }
+}
+
+static int
+windowpick_random(int n)
+{
+    return random() % n;
+}
+
+static WindowPtr
+windowpick_desktop(int ntop)
+{
+    WindowPtr pRoot = windowpick_window(NULL, 0, 0, 2000, 2000, 0);
+    WindowPtr pWin;
+    int i, j;
+
+    for (i = 0; i < ntop; i++) {
+        pWin = windowpick_window(pRoot,
+                                 windowpick_random(2200) - 200,
+                                 windowpick_random(2200) - 200,
+                                 1 + windowpick_random(300),
+                                 1 + windowpick_random(300),
+                                 windowpick_random(4));
+        pWin->mapped = windowpick_random(10) != 0;
+    }
+
+    /* and one with a grid of overlapping children, some nested again */
+    pWin = windowpick_window(pRoot, 300, 300, 1000, 800, 2);
+    windowpick_raise(pWin);
+    for (i = 0; i < 200; i++) {
+        WindowPtr pChild = windowpick_window(pWin, (i % 20) * 50 - 5,
+                                             (i / 20) * 80 - 5, 60, 90,
+                                             i % 3);
+
+        for (j = 0; j < (i % 7 ? 0 : 20); j++)
+            windowpick_window(pChild, j * 3, j * 4, 10, 10, 0);
+    }
+    return pRoot;
+}
+
+static void
+windowpick_equivalence(void)
+{
+    WindowPtr pRoot, pWin, *list;
+    int i, n;
+
+    pRoot = windowpick_desktop(300);
+    windowpick_check(pRoot, 20000);
+    /* the walks were long, so the root got an index */
+    assert(WindowPickCandidates(pRoot, 10, 10, &list, &n));
+
+    /* move, restack and destroy, then check again */
+    for (i = 0; i < 100; i++) {
+        pWin = pRoot->firstChild;
+        for (n = windowpick_random(250); n && pWin->nextSib; n--)
+            pWin = pWin->nextSib;
+        switch (i % 3) {
+        case 0:
+            windowpick_move(pWin, windowpick_random(400) - 200,
+                            windowpick_random(400) - 200);
+            break;
+        case 1:
+            windowpick_raise(pWin);
+            break;
+        case 2:
+            windowpick_unlink(pWin);
+            windowpick_free(pWin);
+            break;
+        }
+        windowpick_check(pRoot, 200);
+    }
+
+    /* unmapping doesn't change the index, only what it finds */
+    for (pWin = pRoot->firstChild; pWin; pWin = pWin->nextSib)
+        pWin->mapped = !pWin->mapped;
+    windowpick_check(pRoot, 20000);
+    windowpick_free(pRoot);
+
+    /* a few children don't get an index */
+    pRoot = windowpick_desktop(0);
+    windowpick_check(pRoot, 1000);
+    assert(!WindowPickCandidates(pRoot, 10, 10, &list, &n));
+    windowpick_free(pRoot);
+
+    /* nor do lots of windows on top of each other */
+    pRoot = windowpick_window(NULL, 0, 0, 2000, 2000, 0);
+    for (i = 0; i < 40; i++)
+        windowpick_window(pRoot, i - 20, i - 20, 2000, 2000, 0)->mapped =
+            i == 39;
+    windowpick_check(pRoot, 1000);
+    assert(!WindowPickCandidates(pRoot, 10, 10, &list, &n));
+    windowpick_free(pRoot);
+}
+
+/* Pointer motion over desktops with more and more top-level windows */
+static void
+windowpick_benchmark(void)
+{
+    static const int sizes[] = { 10, 100, 1000, 5000 };
+    const int iterations = 200000;
+    struct timespec start;
+    WindowPtr volatile found;
+    double walk, trace;
+    int s, i;
+
+    printf("%10s %14s %14s\n", "windows", "walk ns/pick", "index ns/pick");
+    for (s = 0; s < ARRAY_SIZE(sizes); s++) {
+        WindowPtr pRoot = windowpick_desktop(sizes[s]);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (i = 0; i < iterations; i++)
+            found = windowpick_walk(pRoot, (i * 7) % 2000, (i * 13) % 2000);
+        walk = test_elapsed_ns(&start) / iterations;
+
+        windowpick_trace(pRoot, 0, 0);
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (i = 0; i < iterations; i++)
+            found = windowpick_trace(pRoot, (i * 7) % 2000, (i * 13) % 2000);
+        trace = test_elapsed_ns(&start) / iterations;
+
+        printf("%10d %14.1f %14.1f\n", sizes[s], walk, trace);
+        windowpick_free(pRoot);
+    }
+}
+
+int
+windowpick_test(void)
+{
+    sprite.spriteTraceSize = 1;
+    sprite.spriteTrace = calloc(1, sizeof(WindowPtr));
+
+    windowpick_equivalence();
+    if (run_benchmarks)
+        windowpick_benchmark();
+
+    free(sprite.spriteTrace);
+    return 0;
+}
@@ -32,8 +32,30 @@
 #include <gcstruct.h>
 #include <window.h>
 
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
 RESTYPE RegionResType;
 
+/*
+ * A shared region is a second resource under the region's XID, holding
+ * the mapping of the memfd the client was given
+ */
+typedef struct _SharedRegion {
+    RegionPtr pRegion;
+    xXFixesSharedRegionHeader *header;
+    size_t size;
+    CARD32 maxRects;
+    CARD32 generation;          /* the client can write the memfd too */
+} SharedRegionRec, *SharedRegionPtr;
+
+/* 8MB of boxes */
+#define SHARED_REGION_MAX_RECTS (1 << 20)
+
+static RESTYPE SharedRegionResType;
+static int SharedRegions;
+
 static int
 RegionResFree(void *data, XID id)
 {
@@ -58,12 +80,69 @@ XFixesRegionCopy(RegionPtr pRegion)
     return pNew;
 }
 
+static int
+SharedRegionResFree(void *data, XID id)
+{
+    SharedRegionPtr pShared = (SharedRegionPtr) data;
+
+    munmap(pShared->header, pShared->size);
+    free(pShared);
+    SharedRegions--;
+    return Success;
+}
+
+/* Copy the region into the memfd, bracketed by odd and even generations */
+static void
+SharedRegionWrite(SharedRegionPtr pShared)
+{
+    xXFixesSharedRegionHeader *header = pShared->header;
+    RegionPtr pRegion = pShared->pRegion;
+    BoxPtr pExtent = RegionExtents(pRegion);
+    int nBox = RegionNumRects(pRegion);
+
+    __atomic_store_n(&header->generation, pShared->generation + 1,
+                     __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    header->numRects = nBox;
+    header->maxRects = pShared->maxRects;
+    header->x1 = pExtent->x1;
+    header->y1 = pExtent->y1;
+    header->x2 = pExtent->x2;
+    header->y2 = pExtent->y2;
+    if (nBox <= pShared->maxRects)
+        memcpy(header + 1, RegionRects(pRegion), nBox * sizeof(BoxRec));
+
+    pShared->generation += 2;
+    __atomic_store_n(&header->generation, pShared->generation,
+                     __ATOMIC_RELEASE);
+}
+
+/*
+ * Called after a request has written to a region, to update the client's
+ * copy if it has one
+ */
+void
+XFixesRegionChanged(XID region)
+{
+    SharedRegionPtr pShared;
+
+    if (!SharedRegions)
+        return;
+    if (dixLookupResourceByType((void **) &pShared, region,
+                                SharedRegionResType, serverClient,
+                                DixReadAccess) == Success)
+        SharedRegionWrite(pShared);
+}
+
 Bool
 XFixesRegionInit(void)
 {
     RegionResType = CreateNewResourceType(RegionResFree, "XFixesRegion");
+    SharedRegionResType = CreateNewResourceType(SharedRegionResFree,
+                                                "XFixesSharedRegion");
 
-    return RegionResType != 0;
+    return RegionResType != 0 && SharedRegionResType != 0;
 }
 
 int
@@ -338,6 +417,7 @@ ProcXFixesSetRegion(ClientPtr client)
         return BadAlloc;
     }
     RegionDestroy(pNew);
+    XFixesRegionChanged(stuff->region);
     return Success;
 }
 
@@ -366,6 +446,7 @@ ProcXFixesCopyRegion(ClientPtr client)
 
     if (!RegionCopy(pDestination, pSource))
         return BadAlloc;
+    XFixesRegionChanged(stuff->destination);
 
     return Success;
 }
@@ -408,6 +489,7 @@ ProcXFixesCombineRegion(ClientPtr client)
             return BadAlloc;
         break;
     }
+    XFixesRegionChanged(stuff->destination);
 
     return Success;
 }
@@ -452,6 +534,7 @@ ProcXFixesInvertRegion(ClientPtr client)
 
     if (!RegionInverse(pDestination, pSource, &bounds))
         return BadAlloc;
+    XFixesRegionChanged(stuff->destination);
 
     return Success;
 }
@@ -483,6 +566,7 @@ ProcXFixesTranslateRegion(ClientPtr client)
     VERIFY_REGION(pRegion, stuff->region, client, DixWriteAccess);
 
     RegionTranslate(pRegion, stuff->dx, stuff->dy);
+    XFixesRegionChanged(stuff->region);
     return Success;
 }
 
@@ -511,6 +595,7 @@ ProcXFixesRegionExtents(ClientPtr client)
     VERIFY_REGION(pDestination, stuff->destination, client, DixWriteAccess);
 
     RegionReset(pDestination, RegionExtents(pSource));
+    XFixesRegionChanged(stuff->destination);
 
     return Success;
 }
@@ -527,15 +612,21 @@ SProcXFixesRegionExtents(ClientPtr client)
     return (*ProcXFixesVector[stuff->xfixesReqType]) (client);
 }
 
+/*
+ * Damage regions fetched every frame can run to thousands of rectangles,
+ * so rather than build the whole reply, they go out a chunk at a time
+ */
+#define FETCH_REGION_CHUNK  256
+
 int
 ProcXFixesFetchRegion(ClientPtr client)
 {
     RegionPtr pRegion;
-    xXFixesFetchRegionReply *reply;
-    xRectangle *pRect;
+    xXFixesFetchRegionReply reply;
+    xRectangle rects[FETCH_REGION_CHUNK];
     BoxPtr pExtent;
     BoxPtr pBox;
-    int i, nBox;
+    int i, n, nBox;
 
     REQUEST(xXFixesFetchRegionReq);
 
@@ -546,37 +637,39 @@ ProcXFixesFetchRegion(ClientPtr client)
     pBox = RegionRects(pRegion);
     nBox = RegionNumRects(pRegion);
 
-    reply = calloc(sizeof(xXFixesFetchRegionReply) + nBox * sizeof(xRectangle),
-                   1);
-    if (!reply)
-        return BadAlloc;
-    reply->type = X_Reply;
-    reply->sequenceNumber = client->sequence;
-    reply->length = nBox << 1;
-    reply->x = pExtent->x1;
-    reply->y = pExtent->y1;
-    reply->width = pExtent->x2 - pExtent->x1;
-    reply->height = pExtent->y2 - pExtent->y1;
-
-    pRect = (xRectangle *) (reply + 1);
-    for (i = 0; i < nBox; i++) {
-        pRect[i].x = pBox[i].x1;
-        pRect[i].y = pBox[i].y1;
-        pRect[i].width = pBox[i].x2 - pBox[i].x1;
-        pRect[i].height = pBox[i].y2 - pBox[i].y1;
-    }
+    reply = (xXFixesFetchRegionReply) {
+        .type = X_Reply,
+        .sequenceNumber = client->sequence,
+        .length = nBox << 1,
+        .x = pExtent->x1,
+        .y = pExtent->y1,
+        .width = pExtent->x2 - pExtent->x1,
+        .height = pExtent->y2 - pExtent->y1
+    };
     if (client->swapped) {
-        swaps(&reply->sequenceNumber);
-        swapl(&reply->length);
-        swaps(&reply->x);
-        swaps(&reply->y);
-        swaps(&reply->width);
-        swaps(&reply->height);
-        SwapShorts((INT16 *) pRect, nBox * 4);
+        swaps(&reply.sequenceNumber);
+        swapl(&reply.length);
+        swaps(&reply.x);
+        swaps(&reply.y);
+        swaps(&reply.width);
+        swaps(&reply.height);
+    }
+    WriteToClient(client, sizeof(xXFixesFetchRegionReply), &reply);
+
+    while (nBox) {
+        n = min(nBox, FETCH_REGION_CHUNK);
+        for (i = 0; i < n; i++) {
+            rects[i].x = pBox[i].x1;
+            rects[i].y = pBox[i].y1;
+            rects[i].width = pBox[i].x2 - pBox[i].x1;
+            rects[i].height = pBox[i].y2 - pBox[i].y1;
+        }
+        if (client->swapped)
+            SwapShorts((INT16 *) rects, n * 4);
+        WriteToClient(client, n * sizeof(xRectangle), rects);
+        pBox += n;
+        nBox -= n;
     }
-    WriteToClient(client, sizeof(xXFixesFetchRegionReply) +
-                         nBox * sizeof(xRectangle), (char *) reply);
-    free(reply);
     return Success;
 }
 
@@ -796,6 +889,7 @@ ProcXFixesExpandRegion(ClientPtr client)
         }
         free(pTmp);
     }
+    XFixesRegionChanged(stuff->destination);
     return Success;
 }
 
@@ -815,6 +909,122 @@ SProcXFixesExpandRegion(ClientPtr client)
     return (*ProcXFixesVector[stuff->xfixesReqType]) (client);
 }
 
+/*
+ * A memfd of the given size, sealed so that the client can't shrink it
+ * under the server's mapping
+ */
+static int
+SharedRegionMemfd(size_t size)
+{
+#ifdef HAVE_MEMFD_CREATE
+    int fd = memfd_create("xfixes-region", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+
+    if (fd < 0)
+        return -1;
+    if (ftruncate(fd, size) < 0 ||
+        fcntl(fd, F_ADD_SEALS,
+              F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+#else
+    return -1;
+#endif
+}
+
+int
+ProcXFixesCreateSharedRegion(ClientPtr client)
+{
+    SharedRegionPtr pShared;
+    RegionPtr pRegion;
+    void *map;
+    size_t size;
+    int fd;
+
+    REQUEST(xXFixesCreateSharedRegionReq);
+    xXFixesCreateSharedRegionReply rep = {
+        .type = X_Reply,
+        .nfd = 1,
+        .sequenceNumber = client->sequence,
+        .length = 0,
+    };
+
+    REQUEST_SIZE_MATCH(xXFixesCreateSharedRegionReq);
+    if (!client->local)
+        return BadRequest;
+    LEGAL_NEW_RESOURCE(stuff->region, client);
+    if (stuff->maxRects > SHARED_REGION_MAX_RECTS) {
+        client->errorValue = stuff->maxRects;
+        return BadValue;
+    }
+
+    size = sizeof(xXFixesSharedRegionHeader) +
+        stuff->maxRects * sizeof(BoxRec);
+    fd = SharedRegionMemfd(size);
+    if (fd < 0)
+        return BadAlloc;
+    map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        close(fd);
+        return BadAlloc;
+    }
+
+    pShared = calloc(1, sizeof(SharedRegionRec));
+    pRegion = RegionCreate(NullBox, 0);
+    if (!pShared || !pRegion) {
+        if (pRegion)
+            RegionDestroy(pRegion);
+        free(pShared);
+        munmap(map, size);
+        close(fd);
+        return BadAlloc;
+    }
+    pShared->pRegion = pRegion;
+    pShared->header = map;
+    pShared->size = size;
+    pShared->maxRects = stuff->maxRects;
+    SharedRegions++;
+
+    if (!AddResource(stuff->region, RegionResType, (void *) pRegion)) {
+        SharedRegionResFree(pShared, stuff->region);
+        close(fd);
+        return BadAlloc;
+    }
+    if (!AddResource(stuff->region, SharedRegionResType, (void *) pShared)) {
+        FreeResource(stuff->region, RT_NONE);
+        close(fd);
+        return BadAlloc;
+    }
+    SharedRegionWrite(pShared);
+
+    if (WriteFdToClient(client, fd, TRUE) < 0) {
+        FreeResource(stuff->region, RT_NONE);
+        close(fd);
+        return BadAlloc;
+    }
+    rep.size = size;
+    if (client->swapped) {
+        swaps(&rep.sequenceNumber);
+        swapl(&rep.length);
+        swapl(&rep.size);
+    }
+    WriteToClient(client, sizeof(xXFixesCreateSharedRegionReply), &rep);
+    return Success;
+}
+
+int _X_COLD
+SProcXFixesCreateSharedRegion(ClientPtr client)
+{
+    REQUEST(xXFixesCreateSharedRegionReq);
+
+    swaps(&stuff->length);
+    REQUEST_SIZE_MATCH(xXFixesCreateSharedRegionReq);
+    swapl(&stuff->region);
+    swapl(&stuff->maxRects);
+    return (*ProcXFixesVector[stuff->xfixesReqType]) (client);
+}
+
 #ifdef PANORAMIX
 #include "panoramiX.h"
 #include "panoramiXsrv.h"
@@ -105,7 +105,7 @@ static const int version_requests[] = {
     X_XFixesDestroyPointerBarrier,      /* Version 5 */
 };
 
-int (*ProcXFixesVector[XFixesNumberRequests]) (ClientPtr) = {
+int (*ProcXFixesVector[XFixesNumberServerRequests]) (ClientPtr) = {
 /*************** Version 1 ******************/
     ProcXFixesQueryVersion,
         ProcXFixesChangeSaveSet,
@@ -139,7 +139,9 @@ int (*ProcXFixesVector[XFixesNumberRequests]) (ClientPtr) = {
 /*************** Version 4 ****************/
         ProcXFixesHideCursor, ProcXFixesShowCursor,
 /*************** Version 5 ****************/
-ProcXFixesCreatePointerBarrier, ProcXFixesDestroyPointerBarrier,};
+ProcXFixesCreatePointerBarrier, ProcXFixesDestroyPointerBarrier,
+/*************** Not in the protocol headers ****************/
+        [X_XFixesCreateSharedRegion] = ProcXFixesCreateSharedRegion,};
 
 static int
 ProcXFixesDispatch(ClientPtr client)
@@ -149,6 +151,10 @@ ProcXFixesDispatch(ClientPtr client)
 
     if (pXFixesClient->major_version >= ARRAY_SIZE(version_requests))
         return BadRequest;
+    /* goes with the other region requests */
+    if (stuff->xfixesReqType == X_XFixesCreateSharedRegion)
+        return pXFixesClient->major_version >= 2 ?
+            ProcXFixesCreateSharedRegion(client) : BadRequest;
     if (stuff->xfixesReqType > version_requests[pXFixesClient->major_version])
         return BadRequest;
     return (*ProcXFixesVector[stuff->xfixesReqType]) (client);
@@ -166,7 +172,7 @@ SProcXFixesQueryVersion(ClientPtr client)
     return (*ProcXFixesVector[stuff->xfixesReqType]) (client);
 }
 
-static int (*SProcXFixesVector[XFixesNumberRequests]) (ClientPtr) = {
+static int (*SProcXFixesVector[XFixesNumberServerRequests]) (ClientPtr) = {
 /*************** Version 1 ******************/
     SProcXFixesQueryVersion,
         SProcXFixesChangeSaveSet,
@@ -200,13 +206,16 @@ static int (*SProcXFixesVector[XFixesNumberRequests]) (ClientPtr) = {
 /*************** Version 4 ****************/
         SProcXFixesHideCursor, SProcXFixesShowCursor,
 /*************** Version 5 ****************/
-SProcXFixesCreatePointerBarrier, SProcXFixesDestroyPointerBarrier,};
+SProcXFixesCreatePointerBarrier, SProcXFixesDestroyPointerBarrier,
+/*************** Not in the protocol headers ****************/
+        [X_XFixesCreateSharedRegion] = SProcXFixesCreateSharedRegion,};
 
 static _X_COLD int
 SProcXFixesDispatch(ClientPtr client)
 {
     REQUEST(xXFixesReq);
-    if (stuff->xfixesReqType >= XFixesNumberRequests)
+    if (stuff->xfixesReqType >= XFixesNumberServerRequests ||
+        !SProcXFixesVector[stuff->xfixesReqType])
         return BadRequest;
     return (*SProcXFixesVector[stuff->xfixesReqType]) (client);
 }
@@ -240,14 +249,14 @@ XFixesExtensionInit(void)
 
 #ifdef PANORAMIX
 
-int (*PanoramiXSaveXFixesVector[XFixesNumberRequests]) (ClientPtr);
+int (*PanoramiXSaveXFixesVector[XFixesNumberServerRequests]) (ClientPtr);
 
 void
 PanoramiXFixesInit(void)
 {
     int i;
 
-    for (i = 0; i < XFixesNumberRequests; i++)
+    for (i = 0; i < XFixesNumberServerRequests; i++)
         PanoramiXSaveXFixesVector[i] = ProcXFixesVector[i];
     /*
      * Stuff in Xinerama aware request processing hooks
@@ -264,7 +273,7 @@ PanoramiXFixesReset(void)
 {
     int i;
 
-    for (i = 0; i < XFixesNumberRequests; i++)
+    for (i = 0; i < XFixesNumberServerRequests; i++)
         ProcXFixesVector[i] = PanoramiXSaveXFixesVector[i];
 }
 
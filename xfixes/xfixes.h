@@ -51,6 +51,9 @@ extern int XFixesErrorBase;
 extern RegionPtr
  XFixesRegionCopy(RegionPtr pRegion);
 
+extern void
+ XFixesRegionChanged(XID region);
+
 #include "xibarriers.h"
 
 #endif                          /* _XFIXES_H_ */
@@ -69,7 +69,62 @@ typedef struct _XFixesClient {
 
 #define GetXFixesClient(pClient) ((XFixesClientPtr)dixLookupPrivate(&(pClient)->devPrivates, XFixesClientPrivateKey))
 
-extern int (*ProcXFixesVector[XFixesNumberRequests]) (ClientPtr);
+/*
+ * CreateSharedRegion isn't in the protocol headers, so it is defined here,
+ * numbered after the last request they know of.  It creates an empty
+ * region, like CreateRegion, and replies with a memfd holding a copy of
+ * it which the server rewrites whenever a request changes the region.
+ * Only local clients may use it.
+ */
+#define X_XFixesCreateSharedRegion          35
+#define XFixesNumberServerRequests          (X_XFixesCreateSharedRegion + 1)
+
+#if XFixesNumberRequests > X_XFixesCreateSharedRegion
+#error "X_XFixesCreateSharedRegion collides with a protocol request"
+#endif
+
+typedef struct {
+    CARD8 reqType;
+    CARD8 xfixesReqType;
+    CARD16 length;
+    CARD32 region;
+    CARD32 maxRects;
+} xXFixesCreateSharedRegionReq;
+
+#define sz_xXFixesCreateSharedRegionReq     12
+
+typedef struct {
+    BYTE type;                  /* X_Reply */
+    CARD8 nfd;
+    CARD16 sequenceNumber;
+    CARD32 length;
+    CARD32 size;                /* of the memfd, in bytes */
+    CARD32 pad2;
+    CARD32 pad3;
+    CARD32 pad4;
+    CARD32 pad5;
+    CARD32 pad6;
+} xXFixesCreateSharedRegionReply;
+
+#define sz_xXFixesCreateSharedRegionReply   32
+
+/*
+ * The start of the memfd, in the server's byte order, followed by room for
+ * maxRects boxes.  generation is odd while the server is writing, and goes
+ * up by two each time the region changes, so a reader copies the region
+ * out and then checks generation is still the even value it started with.
+ * When the region holds more than maxRects boxes only numRects and the
+ * extents are written, and the boxes have to be fetched with FetchRegion.
+ */
+typedef struct {
+    CARD32 generation;
+    CARD32 numRects;
+    CARD32 maxRects;
+    CARD32 pad;
+    INT16 x1, y1, x2, y2;       /* extents, as in a BoxRec */
+} xXFixesSharedRegionHeader;
+
+extern int (*ProcXFixesVector[XFixesNumberServerRequests]) (ClientPtr);
 
 /* Save set */
 int
@@ -253,6 +308,12 @@ int
 int
  SProcXFixesExpandRegion(ClientPtr client);
 
+int
+ ProcXFixesCreateSharedRegion(ClientPtr client);
+
+int
+ SProcXFixesCreateSharedRegion(ClientPtr client);
+
 int
  PanoramiXFixesSetGCClipRegion(ClientPtr client);
 
@@ -292,7 +353,8 @@ int
 
 /* Xinerama */
 #ifdef PANORAMIX
-extern int (*PanoramiXSaveXFixesVector[XFixesNumberRequests]) (ClientPtr);
+extern int (*PanoramiXSaveXFixesVector[XFixesNumberServerRequests])
+    (ClientPtr);
 void PanoramiXFixesInit(void);
 void PanoramiXFixesReset(void);
 #endif